@@ -5,8 +5,21 @@ class AppConstants {
   // Firebase database paths
   static const String parcelsPath = 'parcels';
   static const String historyPath = 'history';
+  static const String historyRollupPath = 'history_rollup';
   static const String deviceStatusPath = 'device_status';
   static const String locksStatusPath = 'locks_status';
+  static const String liveStatusKey = 'live';
+  static const String timestampKey = 'timestamp';
+
+  // Parcels are loaded newest first, this many per query (history screen)
+  static const int parcelPageSize = 25;
+  static const String commandsKey = 'commands';
+
+  // Remote command types (CommandChannel.h on the device)
+  static const String commandUnlock = 'unlock';
+  static const String commandLock = 'lock';
+  static const String commandEmergency = 'emergency';
+  static const Duration commandAckTimeout = Duration(seconds: 15);
 
   // Parcel statuses
   static const String statusPending = 'pending';
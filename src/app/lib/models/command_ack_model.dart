@@ -0,0 +1,52 @@
+/// Device acknowledgement of a remote command queued at
+/// `device_status/<id>/commands/<pushId>` (see CommandChannel.h in the
+/// firmware). Times are epoch milliseconds.
+class CommandAckModel {
+  static const String statusDone = 'done';
+
+  /// Written before the device runs the command; not the final ack.
+  static const String statusAccepted = 'accepted';
+
+  final String id;
+  final String status;
+  final int issuedAt;
+  final int executedAt;
+  final int ackedAt;
+  final int execUs;
+
+  /// Measured by the app: push written → ack seen
+  final Duration roundTrip;
+
+  CommandAckModel({
+    required this.id,
+    required this.status,
+    required this.issuedAt,
+    required this.executedAt,
+    required this.ackedAt,
+    required this.execUs,
+    required this.roundTrip,
+  });
+
+  bool get done => status == statusDone;
+
+  /// Server issue time → relay switched (device NTP clock; 0 if unknown)
+  int get issueToExecuteMs =>
+      executedAt > 0 && issuedAt > 0 ? executedAt - issuedAt : 0;
+
+  /// Null until the device has written its final status.
+  static CommandAckModel? fromMap(
+      String id, Object? value, Duration roundTrip) {
+    if (value is! Map || value['status'] == null) return null;
+    if (value['status'] == statusAccepted) return null;
+    int asInt(Object? v) => v is num ? v.toInt() : 0;
+    return CommandAckModel(
+      id: id,
+      status: value['status'].toString(),
+      issuedAt: asInt(value['issued_at']),
+      executedAt: asInt(value['executed_at']),
+      ackedAt: asInt(value['acked_at']),
+      execUs: asInt(value['exec_us']),
+      roundTrip: roundTrip,
+    );
+  }
+}
@@ -0,0 +1,66 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+/// Live status word published by the locker at `device_status/<id>/live`
+/// once a second: 12 little-endian bytes, base64 encoded (see StatusWord.h
+/// in the firmware for the layout).
+class DeviceStatusModel {
+  static const int version = 1;
+  static const int _length = 12;
+
+  // 0x01 and 0x02 are reserved: the word is only sent while the device is
+  // online, so its arrival is the connectivity signal.
+  static const int _flagDelivery = 0x04;
+  static const int _flagBreach = 0x08;
+
+  final int seq;
+  final int locksOpen;
+  final int doorsOpen;
+  final int flags;
+  final int rssi;
+  final int heapFreeKb;
+  final int uptimeS;
+
+  DeviceStatusModel({
+    required this.seq,
+    required this.locksOpen,
+    required this.doorsOpen,
+    required this.flags,
+    required this.rssi,
+    required this.heapFreeKb,
+    required this.uptimeS,
+  });
+
+  /// Compartment numbers are 1-based, as on the device.
+  bool isLockOpen(int compartment) =>
+      ((locksOpen >> (compartment - 1)) & 1) == 1;
+  bool isDoorOpen(int compartment) =>
+      ((doorsOpen >> (compartment - 1)) & 1) == 1;
+
+  bool get deliveryInProgress => (flags & _flagDelivery) != 0;
+  bool get breach => (flags & _flagBreach) != 0;
+
+  /// Null if the value is missing, malformed or from an unknown version.
+  /// Bytes past the known layout are ignored (fields are only appended).
+  static DeviceStatusModel? decode(Object? value) {
+    if (value is! String) return null;
+    final Uint8List bytes;
+    try {
+      bytes = base64.decode(value);
+    } on FormatException {
+      return null;
+    }
+    if (bytes.length < _length || bytes[0] != version) return null;
+
+    final data = ByteData.sublistView(bytes);
+    return DeviceStatusModel(
+      seq: data.getUint8(1),
+      locksOpen: data.getUint8(2),
+      doorsOpen: data.getUint8(3),
+      flags: data.getUint8(4),
+      rssi: data.getInt8(5),
+      heapFreeKb: data.getUint16(6, Endian.little),
+      uptimeS: data.getUint32(8, Endian.little),
+    );
+  }
+}
@@ -1,9 +1,12 @@
+/// One event under `history/<device>/<yyyy-mm-dd>/<pushId>`. Entries are
+/// compact ({p, e, t}); the device and day come from the path.
 class HistoryModel {
   final String id;
   final String parcelId;
   final String event;
   final int timestamp;
   final String deviceId;
+  final bool replayed;
 
   HistoryModel({
     required this.id,
@@ -11,15 +14,19 @@ class HistoryModel {
     required this.event,
     required this.timestamp,
     required this.deviceId,
+    this.replayed = false,
   });
 
-  factory HistoryModel.fromMap(String key, Map<dynamic, dynamic> map) {
+  factory HistoryModel.fromMap(
+      String key, String deviceId, Map<dynamic, dynamic> map) {
+    final t = map['t'];
     return HistoryModel(
       id: key,
-      parcelId: (map['parcel_id'] ?? '').toString(),
-      event: (map['event'] ?? '').toString(),
-      timestamp: (map['timestamp'] ?? 0) as int,
-      deviceId: (map['device_id'] ?? '').toString(),
+      parcelId: (map['p'] ?? '').toString(),
+      event: (map['e'] ?? '').toString(),
+      timestamp: t is num ? t.toInt() : 0,
+      deviceId: deviceId,
+      replayed: map['r'] != null,
     );
   }
 }
@@ -0,0 +1,38 @@
+/// Per-day counters kept by the locker at
+/// `history_rollup/<device>/<yyyy-mm-dd>` (see CloudWriter.h in the
+/// firmware). Days are the locker's local time.
+class HistoryRollupModel {
+  final String day;
+  final int deliveries;
+  final int failedValidations;
+  final int breaches;
+  final int scans;
+
+  HistoryRollupModel({
+    required this.day,
+    required this.deliveries,
+    required this.failedValidations,
+    required this.breaches,
+    required this.scans,
+  });
+
+  static String dayKey(DateTime day) {
+    String two(int v) => v.toString().padLeft(2, '0');
+    return '${day.year}-${two(day.month)}-${two(day.day)}';
+  }
+
+  factory HistoryRollupModel.fromMap(String day, Map<dynamic, dynamic> map) {
+    int count(String key) {
+      final v = map[key];
+      return v is num ? v.toInt() : 0;
+    }
+
+    return HistoryRollupModel(
+      day: day,
+      deliveries: count('deliveries'),
+      failedValidations: count('failed_validations'),
+      breaches: count('breaches'),
+      scans: count('scans'),
+    );
+  }
+}
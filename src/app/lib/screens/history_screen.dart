@@ -1,7 +1,6 @@
 import 'package:flutter/material.dart';
-import 'package:firebase_database/firebase_database.dart';
-import '../config/app_constants.dart';
 import '../models/parcel_model.dart';
+import '../services/parcel_feed.dart';
 import '../widgets/parcel_card.dart';
 
 class HistoryScreen extends StatefulWidget {
@@ -13,14 +12,39 @@ class HistoryScreen extends StatefulWidget {
 
 class _HistoryScreenState extends State<HistoryScreen> {
   final _searchController = TextEditingController();
+  final _feed = ParcelFeed();
   String _searchQuery = '';
 
+  @override
+  void initState() {
+    super.initState();
+    _feed.loadMore();
+  }
+
   @override
   void dispose() {
     _searchController.dispose();
+    _feed.dispose();
     super.dispose();
   }
 
+  // The footer is built just before it scrolls into view: fetch the next page
+  Widget _footer() {
+    if (_feed.error != null && !_feed.loading) {
+      return Center(
+        child: TextButton(
+          onPressed: _feed.loadMore,
+          child: const Text('Could not load more - retry'),
+        ),
+      );
+    }
+    WidgetsBinding.instance.addPostFrameCallback((_) => _feed.loadMore());
+    return const Padding(
+      padding: EdgeInsets.all(16),
+      child: Center(child: CircularProgressIndicator()),
+    );
+  }
+
   List<ParcelModel> _filter(List<ParcelModel> parcels) {
     if (_searchQuery.isEmpty) return parcels;
     final q = _searchQuery.toLowerCase();
@@ -58,45 +82,40 @@ class _HistoryScreenState extends State<HistoryScreen> {
             ),
           ),
           Expanded(
-            child: StreamBuilder<DatabaseEvent>(
-              stream: FirebaseDatabase.instance
-                  .ref()
-                  .child(AppConstants.parcelsPath)
-                  .onValue,
-              builder: (context, snapshot) {
-                if (snapshot.connectionState == ConnectionState.waiting) {
-                  return const Center(child: CircularProgressIndicator());
-                }
-                if (snapshot.hasError) {
-                  return Center(child: Text('Error: ${snapshot.error}'));
-                }
-                final data = snapshot.data?.snapshot.value;
-                if (data == null) {
+            child: ListenableBuilder(
+              listenable: _feed,
+              builder: (context, _) {
+                final parcels = _feed.parcels;
+                if (parcels.isEmpty) {
+                  if (_feed.hasMore && _feed.error == null) {
+                    return const Center(child: CircularProgressIndicator());
+                  }
+                  if (_feed.error != null) {
+                    return Center(child: Text('Error: ${_feed.error}'));
+                  }
                   return const _EmptyState();
                 }
-                final map = data as Map<dynamic, dynamic>;
-                final parcels = map.entries
-                    .map((e) => ParcelModel.fromMap(
-                        e.key.toString(), e.value as Map<dynamic, dynamic>))
-                    .toList()
-                  ..sort((a, b) => b.timestamp.compareTo(a.timestamp));
 
+                // Search covers loaded pages; the footer keeps paging in
                 final filtered = _filter(parcels);
-                if (filtered.isEmpty) {
+                final more = _feed.hasMore ? 1 : 0;
+                if (filtered.isEmpty && more == 0) {
                   return const _EmptyState(isSearchResult: true);
                 }
 
                 return ListView.builder(
                   padding: const EdgeInsets.only(bottom: 16),
-                  itemCount: filtered.length,
-                  itemBuilder: (_, i) => ParcelCard(
-                    parcel: filtered[i],
-                    onTap: () => Navigator.pushNamed(
-                      context,
-                      '/qr-result',
-                      arguments: filtered[i].parcelId,
-                    ),
-                  ),
+                  itemCount: filtered.length + more,
+                  itemBuilder: (_, i) => i == filtered.length
+                      ? _footer()
+                      : ParcelCard(
+                          parcel: filtered[i],
+                          onTap: () => Navigator.pushNamed(
+                            context,
+                            '/qr-result',
+                            arguments: filtered[i].parcelId,
+                          ),
+                        ),
                 );
               },
             ),
@@ -1,5 +1,10 @@
+import 'dart:async';
 import 'package:firebase_database/firebase_database.dart';
 import '../config/app_constants.dart';
+import '../models/command_ack_model.dart';
+import '../models/device_status_model.dart';
+import '../models/history_model.dart';
+import '../models/history_rollup_model.dart';
 import '../models/parcel_model.dart';
 
 class DatabaseService {
@@ -12,18 +17,38 @@ class DatabaseService {
         .set(parcel.toMap());
   }
 
-  Future<List<ParcelModel>> getParcels() async {
-    final snapshot = await _db.child(AppConstants.parcelsPath).get();
-    if (!snapshot.exists) return [];
-    final map = snapshot.value as Map<dynamic, dynamic>;
-    return map.entries
-        .map((e) => ParcelModel.fromMap(e.key.toString(), e.value as Map<dynamic, dynamic>))
+  /// One page of parcels ordered by creation time: the newest [limit], or
+  /// the [limit] just older than ([beforeTimestamp], [beforeKey]). Served by
+  /// the `.indexOn: timestamp` rule on /parcels (database.rules.json).
+  Query parcelsPage(int limit, {int? beforeTimestamp, String? beforeKey}) {
+    Query query = _db
+        .child(AppConstants.parcelsPath)
+        .orderByChild(AppConstants.timestampKey);
+    if (beforeTimestamp != null) {
+      query = query.endBefore(beforeTimestamp, key: beforeKey);
+    }
+    return query.limitToLast(limit);
+  }
+
+  /// Newest [limit] parcels, newest first.
+  Future<List<ParcelModel>> getRecentParcels(
+      {int limit = AppConstants.parcelPageSize}) async {
+    final snapshot = await parcelsPage(limit).get();
+    return snapshot.children
+        .map((c) => ParcelModel.fromMap(
+            c.key!, c.value as Map<dynamic, dynamic>))
         .toList()
-      ..sort((a, b) => b.timestamp.compareTo(a.timestamp));
+        .reversed
+        .toList();
   }
 
-  Stream<DatabaseEvent> parcelsStream() {
-    return _db.child(AppConstants.parcelsPath).onValue;
+  Future<bool> parcelExists(String parcelId) async {
+    final snapshot = await _db
+        .child(AppConstants.parcelsPath)
+        .child(parcelId)
+        .child(AppConstants.timestampKey)
+        .get();
+    return snapshot.exists;
   }
 
   Future<ParcelModel?> getParcel(String parcelId) async {
@@ -33,4 +58,77 @@ class DatabaseService {
     return ParcelModel.fromMap(
         parcelId, snapshot.value as Map<dynamic, dynamic>);
   }
+
+  /// Raw events of one locker for one local day, oldest first.
+  Future<List<HistoryModel>> getHistoryDay(String deviceId, DateTime day) async {
+    final snapshot = await _db
+        .child(AppConstants.historyPath)
+        .child(deviceId)
+        .child(HistoryRollupModel.dayKey(day))
+        .get();
+    return snapshot.children
+        .where((c) => c.value is Map)
+        .map((c) => HistoryModel.fromMap(
+            c.key!, deviceId, c.value as Map<dynamic, dynamic>))
+        .toList();
+  }
+
+  /// Per-day counters of one locker from [from] to [to] (inclusive), oldest
+  /// first; days without any counted event are absent.
+  Future<List<HistoryRollupModel>> getRollups(
+      String deviceId, DateTime from, DateTime to) async {
+    final snapshot = await _db
+        .child(AppConstants.historyRollupPath)
+        .child(deviceId)
+        .orderByKey()
+        .startAt(HistoryRollupModel.dayKey(from))
+        .endAt(HistoryRollupModel.dayKey(to))
+        .get();
+    return snapshot.children
+        .where((c) => c.value is Map)
+        .map((c) => HistoryRollupModel.fromMap(c.key!, c.value as Map))
+        .toList();
+  }
+
+  /// Packed live status of one locker; null until it has published one.
+  Stream<DeviceStatusModel?> deviceStatusStream(String deviceId) {
+    return _db
+        .child(AppConstants.deviceStatusPath)
+        .child(deviceId)
+        .child(AppConstants.liveStatusKey)
+        .onValue
+        .map((event) => DeviceStatusModel.decode(event.snapshot.value));
+  }
+
+  /// Queue a remote command and wait for the locker to ack it. The device
+  /// runs each push ID once; the command is removed after the ack is seen.
+  /// Throws a TimeoutException if no ack arrives in time (the command is
+  /// left queued: the device acks it "expired" if it comes back too late).
+  Future<CommandAckModel> sendCommand(String deviceId, String type,
+      {int? lock}) async {
+    final ref = _db
+        .child(AppConstants.deviceStatusPath)
+        .child(deviceId)
+        .child(AppConstants.commandsKey)
+        .push();
+    final id = ref.key!;
+    final stopwatch = Stopwatch()..start();
+
+    final ack = ref.onValue
+        .map((event) => CommandAckModel.fromMap(
+            id, event.snapshot.value, stopwatch.elapsed))
+        .firstWhere((ack) => ack != null)
+        .timeout(AppConstants.commandAckTimeout);
+
+    await ref.set({
+      'id': id,
+      'type': type,
+      if (lock != null) 'lock': lock,
+      'issued_at': ServerValue.timestamp,
+    });
+
+    final result = (await ack)!;
+    await ref.remove();
+    return result;
+  }
 }
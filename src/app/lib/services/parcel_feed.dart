@@ -0,0 +1,167 @@
+import 'dart:async';
+import 'package:firebase_database/firebase_database.dart';
+import 'package:flutter/foundation.dart';
+import '../config/app_constants.dart';
+import '../models/parcel_model.dart';
+import 'database_service.dart';
+
+/// Keyed, incrementally updated view of /parcels, newest first.
+///
+/// Parcels are loaded a page at a time (orderByChild timestamp +
+/// limitToLast, see [DatabaseService.parcelsPage]). Every loaded page stays
+/// subscribed with child added / changed / removed listeners, so a change to
+/// one parcel moves one child instead of the whole tree. A child leaving a
+/// page's window is not necessarily deleted (a new parcel pushes the oldest
+/// one out of the first page): it is only dropped once a read confirms it
+/// is gone.
+class ParcelFeed extends ChangeNotifier {
+  final DatabaseService _db;
+  final int pageSize;
+
+  final Map<String, ParcelModel> _byKey = {};
+  final List<String> _order = []; // Keys, newest first
+  final List<StreamSubscription<DatabaseEvent>> _subs = [];
+  List<ParcelModel>? _view;
+
+  // Oldest child of the last page loaded; the next page ends before it
+  int? _cursorTimestamp;
+  String? _cursorKey;
+
+  bool _loading = false;
+  bool _hasMore = true;
+  bool _notifyScheduled = false;
+  bool _disposed = false;
+  Object? _error;
+
+  ParcelFeed({DatabaseService? db, this.pageSize = AppConstants.parcelPageSize})
+      : _db = db ?? DatabaseService();
+
+  List<ParcelModel> get parcels =>
+      _view ??= List.unmodifiable(_order.map((k) => _byKey[k]!));
+  bool get loading => _loading;
+  bool get hasMore => _hasMore;
+  Object? get error => _error;
+
+  /// Load the next (older) page. No-op while one is loading or at the end.
+  Future<void> loadMore() async {
+    if (_loading || !_hasMore || _disposed) return;
+    _loading = true;
+    _scheduleNotify();
+
+    final query = _db.parcelsPage(pageSize,
+        beforeTimestamp: _cursorTimestamp, beforeKey: _cursorKey);
+    final subs = _listen(query);
+    try {
+      // Shares the listen the child listeners just opened
+      final event = await query.onValue.first;
+      final children = event.snapshot.children.toList();
+      for (final child in children) {
+        _upsert(child);
+      }
+      if (children.isNotEmpty) {
+        _cursorKey = children.first.key;
+        _cursorTimestamp = _byKey[_cursorKey]?.timestamp;
+      }
+      _hasMore = children.length == pageSize;
+      _error = null;
+    } catch (e) {
+      for (final sub in subs) {
+        sub.cancel();
+        _subs.remove(sub);
+      }
+      _error = e;
+    } finally {
+      _loading = false;
+      _scheduleNotify();
+    }
+  }
+
+  List<StreamSubscription<DatabaseEvent>> _listen(Query query) {
+    final subs = [
+      query.onChildAdded.listen((e) => _upsert(e.snapshot)),
+      query.onChildChanged.listen((e) => _upsert(e.snapshot)),
+      query.onChildRemoved.listen((e) => _leftWindow(e.snapshot.key)),
+    ];
+    _subs.addAll(subs);
+    return subs;
+  }
+
+  void _upsert(DataSnapshot snapshot) {
+    final key = snapshot.key;
+    final value = snapshot.value;
+    if (key == null || value is! Map) return;
+    final parcel = ParcelModel.fromMap(key, value);
+
+    final old = _byKey[key];
+    if (old != null) {
+      _order.removeAt(_indexOf(old, key));
+    }
+    _byKey[key] = parcel;
+    _order.insert(_insertionPoint(parcel, key), key);
+    _view = null;
+    _scheduleNotify();
+  }
+
+  Future<void> _leftWindow(String? key) async {
+    if (key == null || !_byKey.containsKey(key)) return;
+    bool exists;
+    try {
+      exists = await _db.parcelExists(key);
+    } catch (_) {
+      return;
+    }
+    final parcel = _byKey[key];
+    if (exists || parcel == null || _disposed) return;
+    _order.removeAt(_indexOf(parcel, key));
+    _byKey.remove(key);
+    _view = null;
+    _scheduleNotify();
+  }
+
+  static bool _newer(ParcelModel a, String aKey, ParcelModel b, String bKey) {
+    if (a.timestamp != b.timestamp) return a.timestamp > b.timestamp;
+    return aKey.compareTo(bKey) > 0;
+  }
+
+  int _insertionPoint(ParcelModel parcel, String key) {
+    int lo = 0;
+    int hi = _order.length;
+    while (lo < hi) {
+      final mid = (lo + hi) >> 1;
+      if (_newer(parcel, key, _byKey[_order[mid]]!, _order[mid])) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+
+  // `parcel` is the model currently stored for `key`; it is not newer than
+  // itself, so the insertion point lands just after it
+  int _indexOf(ParcelModel parcel, String key) {
+    final i = _insertionPoint(parcel, key) - 1;
+    if (i >= 0 && _order[i] == key) return i;
+    return _order.indexOf(key);
+  }
+
+  // One rebuild for a burst of child events
+  void _scheduleNotify() {
+    if (_notifyScheduled || _disposed) return;
+    _notifyScheduled = true;
+    scheduleMicrotask(() {
+      _notifyScheduled = false;
+      if (!_disposed) notifyListeners();
+    });
+  }
+
+  @override
+  void dispose() {
+    _disposed = true;
+    for (final sub in _subs) {
+      sub.cancel();
+    }
+    _subs.clear();
+    super.dispose();
+  }
+}
@@ -0,0 +1,84 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:parcel_box_app/models/device_status_model.dart';
+
+/// Packs a word the way StatusWord::encode does in the firmware.
+String encodeWord({
+  int version = DeviceStatusModel.version,
+  int seq = 0,
+  int locksOpen = 0,
+  int doorsOpen = 0,
+  int flags = 0,
+  int rssi = 0,
+  int heapFreeKb = 0,
+  int uptimeS = 0,
+  int extra = 0,
+}) {
+  final data = ByteData(12 + extra);
+  data.setUint8(0, version);
+  data.setUint8(1, seq);
+  data.setUint8(2, locksOpen);
+  data.setUint8(3, doorsOpen);
+  data.setUint8(4, flags);
+  data.setInt8(5, rssi);
+  data.setUint16(6, heapFreeKb, Endian.little);
+  data.setUint32(8, uptimeS, Endian.little);
+  return base64.encode(data.buffer.asUint8List());
+}
+
+void main() {
+  test('decodes every field of a v1 word', () {
+    final status = DeviceStatusModel.decode(encodeWord(
+      seq: 200,
+      locksOpen: 0x05,
+      doorsOpen: 0x02,
+      flags: 0x0C,
+      rssi: -67,
+      heapFreeKb: 118,
+      uptimeS: 86400 * 40 + 7,
+    ))!;
+
+    expect(status.seq, 200);
+    expect(status.rssi, -67);
+    expect(status.heapFreeKb, 118);
+    expect(status.uptimeS, 86400 * 40 + 7);
+    expect(status.isLockOpen(1), isTrue);
+    expect(status.isLockOpen(2), isFalse);
+    expect(status.isLockOpen(3), isTrue);
+    expect(status.isDoorOpen(1), isFalse);
+    expect(status.isDoorOpen(2), isTrue);
+    expect(status.deliveryInProgress, isTrue);
+    expect(status.breach, isTrue);
+  });
+
+  test('matches a word encoded by the firmware', () {
+    // StatusWord{locks 0x03, doors 0x01, DELIVERY, -60 dBm, 120000 B, 3600 s}
+    // encoded with seq 7
+    final status = DeviceStatusModel.decode('AQcDAQTEdQAQDgAA')!;
+
+    expect(status.seq, 7);
+    expect(status.locksOpen, 0x03);
+    expect(status.doorsOpen, 0x01);
+    expect(status.deliveryInProgress, isTrue);
+    expect(status.breach, isFalse);
+    expect(status.rssi, -60);
+    expect(status.heapFreeKb, 117);
+    expect(status.uptimeS, 3600);
+  });
+
+  test('ignores bytes appended by newer firmware', () {
+    final status = DeviceStatusModel.decode(encodeWord(seq: 3, extra: 3));
+    expect(status?.seq, 3);
+  });
+
+  test('rejects missing, malformed, short and unknown-version words', () {
+    expect(DeviceStatusModel.decode(null), isNull);
+    expect(DeviceStatusModel.decode(42), isNull);
+    expect(DeviceStatusModel.decode('not base64!'), isNull);
+    expect(DeviceStatusModel.decode(base64.encode([1, 0, 0, 0])), isNull);
+    expect(DeviceStatusModel.decode(encodeWord(version: 2)), isNull);
+  });
+}
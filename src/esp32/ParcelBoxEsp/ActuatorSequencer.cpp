@@ -0,0 +1,279 @@
+#include "ActuatorSequencer.h"
+#include "PINS_CONFIG.h"
+
+// ============================================================================
+// ACTUATOR SEQUENCER IMPLEMENTATION
+// ============================================================================
+
+// ============================================================================
+// TONE TABLE
+// ============================================================================
+struct ToneStep {
+    uint16_t fromHz;        // 0 = silence
+    uint16_t toHz;          // != fromHz: linear sweep across the step
+    uint16_t ms;
+};
+
+struct TonePattern {
+    const ToneStep* steps;
+    uint8_t count;
+    uint8_t repeats;        // 0 = until stopTone()
+    uint8_t priority;       // Higher is never cut off by lower
+};
+
+static const ToneStep CLICK_STEPS[]   = { { 1500, 1500, 50 } };
+static const ToneStep STARTUP_STEPS[] = { { 1000, 1000, 100 }, { 0, 0, 50 } };
+static const ToneStep SUCCESS_STEPS[] = { { 800, 2000, 480 } };
+static const ToneStep ALERT_STEPS[]   = { { 2000, 2000, 50 }, { 0, 0, 50 } };
+static const ToneStep BREACH_STEPS[]  = { { 2000, 2000, 1000 } };
+
+#define TONE_STEPS(s) s, (uint8_t)(sizeof(s) / sizeof(s[0]))
+
+// Indexed by Tone
+static const TonePattern TONES[TONE_COUNT] = {
+    { TONE_STEPS(CLICK_STEPS),   1, 0 },
+    { TONE_STEPS(STARTUP_STEPS), 2, 0 },
+    { TONE_STEPS(SUCCESS_STEPS), 1, 0 },
+    { TONE_STEPS(ALERT_STEPS),   5, 1 },
+    { TONE_STEPS(BREACH_STEPS),  0, 2 },
+};
+
+static const char* COIL_STATE_NAMES[] = {
+    "locked", "pending", "pull-in", "hold", "released"
+};
+
+ActuatorSequencer::ActuatorSequencer()
+    : mutex(nullptr), timer(nullptr), running(false), buzzerPin(0), relayCount(0),
+      tone(-1), step(0), pass(0), stepStartUs(0), writtenHz(0),
+      tonesPlayed(0), tonesDropped(0), ticks(0) {
+    memset(relays, 0, sizeof(relays));
+}
+
+void ActuatorSequencer::begin(const uint8_t* relayPins, uint8_t count, uint8_t pin) {
+    if (!mutex) mutex = xSemaphoreCreateMutex();
+    buzzerPin = pin;
+    relayCount = count > SEQ_MAX_RELAYS ? SEQ_MAX_RELAYS : count;
+    for (uint8_t i = 0; i < relayCount; i++) {
+        relays[i].pin = relayPins[i];
+        relays[i].state = COIL_LOCKED;
+    }
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTick;
+    args.arg = this;
+    args.name = "actuators";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+        Serial.println("[SEQ] Timer create FAILED");
+        timer = nullptr;
+    }
+}
+
+// ============================================================================
+// TIMER (esp_timer task)
+// ============================================================================
+void ActuatorSequencer::onTick(void* arg) {
+    ActuatorSequencer* self = (ActuatorSequencer*)arg;
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    self->ticks++;
+    self->service(esp_timer_get_time());
+    xSemaphoreGive(self->mutex);
+}
+
+void ActuatorSequencer::service(int64_t now) {
+    bool busy = serviceTone(now);
+    for (uint8_t i = 0; i < relayCount; i++) {
+        if (serviceRelay(relays[i], now)) busy = true;
+    }
+    // Stopping a periodic timer from its own callback is allowed
+    if (!busy && running) {
+        esp_timer_stop(timer);
+        running = false;
+    }
+}
+
+void ActuatorSequencer::ensureRunning() {
+    if (running || !timer) return;
+    if (esp_timer_start_periodic(timer, SEQ_TICK_MS * 1000) == ESP_OK) running = true;
+}
+
+// ============================================================================
+// TONES
+// ============================================================================
+void ActuatorSequencer::writeTone(uint16_t hz) {
+    if (hz == writtenHz) return;
+    ledcWriteTone(buzzerPin, hz);
+    writtenHz = hz;
+}
+
+bool ActuatorSequencer::serviceTone(int64_t now) {
+    if (tone < 0) return false;
+    const TonePattern& p = TONES[tone];
+
+    // Catch up whole steps if a tick came late
+    while (true) {
+        const ToneStep& s = p.steps[step];
+        int64_t lenUs = (int64_t)s.ms * 1000;
+        int64_t elapsed = now - stepStartUs;
+        if (elapsed < lenUs) {
+            uint16_t hz = s.fromHz;
+            if (s.toHz != s.fromHz) {
+                hz = (uint16_t)(s.fromHz + ((int32_t)s.toHz - s.fromHz) * elapsed / lenUs);
+            }
+            writeTone(hz);
+            return true;
+        }
+        stepStartUs += lenUs;
+        if (++step < p.count) continue;
+        step = 0;
+        if (p.repeats && ++pass >= p.repeats) {
+            tone = -1;
+            writeTone(0);
+            return false;
+        }
+    }
+}
+
+void ActuatorSequencer::playTone(Tone t) {
+    if (!mutex || t >= TONE_COUNT) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (tone >= 0 && TONES[t].priority < TONES[tone].priority) {
+        tonesDropped++;
+    } else {
+        tone = t;
+        step = 0;
+        pass = 0;
+        stepStartUs = esp_timer_get_time();
+        tonesPlayed++;
+        serviceTone(stepStartUs);
+        ensureRunning();
+    }
+    xSemaphoreGive(mutex);
+}
+
+void ActuatorSequencer::stopTone(Tone t) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (tone == t) {
+        tone = -1;
+        writeTone(0);
+    }
+    xSemaphoreGive(mutex);
+}
+
+// ============================================================================
+// RELAYS
+// ============================================================================
+void ActuatorSequencer::setCoil(Relay& r, bool on, int64_t now) {
+    if (on == r.energised) return;
+    digitalWrite(r.pin, on ? LOW : HIGH);    // Active LOW
+    if (on) r.energisedAtUs = now;
+    else r.energisedUs += now - r.energisedAtUs;
+    r.energised = on;
+}
+
+void ActuatorSequencer::setUnlocked(Relay& r, bool unlocked, int64_t now) {
+    if (unlocked == r.unlocked) return;
+    if (unlocked) r.unlockedAtUs = now;
+    else r.unlockedUs += now - r.unlockedAtUs;
+    r.unlocked = unlocked;
+}
+
+bool ActuatorSequencer::serviceRelay(Relay& r, int64_t now) {
+    if (!r.nextUs || now < r.nextUs) return r.nextUs != 0;
+
+    switch (r.state) {
+        case COIL_PENDING_UNLOCK:
+            r.state = COIL_PULL_IN;
+            setCoil(r, true, now);
+            setUnlocked(r, true, now);
+            r.unlocks++;
+            r.nextUs = now + SOLENOID_PULL_IN_MS * 1000LL;
+            break;
+        case COIL_PULL_IN:
+            // The door may have opened during pull-in
+            if (r.doorOpen) {
+                r.state = COIL_RELEASED;
+                setCoil(r, false, now);
+                r.nextUs = 0;
+            } else {
+                r.state = COIL_HOLD;        // Until the door opens or lock()
+                r.nextUs = 0;
+            }
+            break;
+        default:
+            r.nextUs = 0;
+            break;
+    }
+    return r.nextUs != 0;
+}
+
+void ActuatorSequencer::unlock(uint8_t mask) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < relayCount; i++) {
+        if (!(mask & (1u << i))) continue;
+        Relay& r = relays[i];
+        if (r.state == COIL_PULL_IN || r.state == COIL_HOLD) continue;   // Already energised
+        r.state = COIL_PENDING_UNLOCK;
+        r.nextUs = now + (int64_t)slot * LOCK_OPERATION_DELAY * 1000;
+        slot++;
+    }
+    service(now);       // First slot switches before returning
+    ensureRunning();
+    xSemaphoreGive(mutex);
+}
+
+void ActuatorSequencer::lock(uint8_t mask) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < relayCount; i++) {
+        if (!(mask & (1u << i))) continue;
+        Relay& r = relays[i];
+        r.state = COIL_LOCKED;
+        r.nextUs = 0;
+        setCoil(r, false, now);
+        setUnlocked(r, false, now);
+    }
+    xSemaphoreGive(mutex);
+}
+
+void ActuatorSequencer::doorChanged(uint8_t id, bool open) {
+    if (!mutex || id < 1 || id > relayCount) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    Relay& r = relays[id - 1];
+    r.doorOpen = open;
+    if (open && r.state == COIL_HOLD) {
+        // Latch is clear of the strike; no coil needed until the door shuts
+        r.state = COIL_RELEASED;
+        r.nextUs = 0;
+        setCoil(r, false, now);
+    } else if (!open && r.state == COIL_RELEASED) {
+        // Spring latch caught the strike again
+        r.state = COIL_LOCKED;
+        setUnlocked(r, false, now);
+    }
+    xSemaphoreGive(mutex);
+}
+
+void ActuatorSequencer::printStats() {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    Serial.printf("[SEQ] %u tones played, %u dropped for priority, %u ticks, timer %s\n",
+                  (unsigned)tonesPlayed, (unsigned)tonesDropped, (unsigned)ticks,
+                  running ? "running" : "idle");
+    for (uint8_t i = 0; i < relayCount; i++) {
+        const Relay& r = relays[i];
+        uint64_t onUs = r.energisedUs + (r.energised ? now - r.energisedAtUs : 0);
+        uint64_t openUs = r.unlockedUs + (r.unlocked ? now - r.unlockedAtUs : 0);
+        Serial.printf("[SEQ] relay %u: %s, %u unlocks, coil %u ms of %u ms unlocked (%u%%)\n",
+                      (unsigned)(i + 1), COIL_STATE_NAMES[r.state], (unsigned)r.unlocks,
+                      (unsigned)(onUs / 1000), (unsigned)(openUs / 1000),
+                      openUs ? (unsigned)(onUs * 100 / openUs) : 0);
+    }
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,118 @@
+#ifndef ACTUATOR_SEQUENCER_H
+#define ACTUATOR_SEQUENCER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+// ============================================================================
+// ACTUATOR SEQUENCER - Smart Parcel Locker
+// ============================================================================
+// Buzzer tones and lock relay timing without delay() on the caller:
+// - Tones are declarative step tables (frequency or linear sweep, duration,
+//   repeats). A tone replaces one of equal or lower priority and is dropped
+//   while a higher one plays, so a click never silences the breach alarm.
+// - unlock() takes a compartment mask; the first relay switches at once,
+//   each further one LOCK_OPERATION_DELAY ms later (coil inrush on the
+//   supply). lock() drops every coil in the mask at once.
+// - Solenoid hold: pulled in and kept energised for as long as the door
+//   stays shut, then released as soon as it is open (the latch is not
+//   needed until it closes again) or on lock(). The relays are on/off
+//   modules driving spring-return latches, so the coil is never pulsed or
+//   dropped while waiting: the latch would re-extend in every off phase.
+// - One esp_timer at SEQ_TICK_MS moves everything along; it only runs while
+//   something is playing or pending
+//
+// The buzzer uses the LEDC channel from ledcAttach(); frequency sweeps are
+// stepped per tick (LEDC fades only the duty, not the frequency).
+
+#define SEQ_TICK_MS                 10
+#define SEQ_MAX_RELAYS              8
+#define SOLENOID_PULL_IN_MS         300     // Latch thrown before the door counts as released
+
+enum Tone {
+    TONE_CLICK = 0,
+    TONE_STARTUP,
+    TONE_SUCCESS,
+    TONE_ALERT,
+    TONE_BREACH,        // Until stopTone(TONE_BREACH)
+    TONE_COUNT
+};
+
+class ActuatorSequencer {
+public:
+    ActuatorSequencer();
+
+    // After the relay pins are outputs (HIGH = locked) and ledcAttach(buzzerPin).
+    // relayPins indexed by compartment ID - 1.
+    void begin(const uint8_t* relayPins, uint8_t count, uint8_t buzzerPin);
+
+    // Any task
+    void playTone(Tone tone);
+    void stopTone(Tone tone);           // Only if that tone is the one playing
+
+    // Any task: COMPARTMENT_BIT() masks
+    void unlock(uint8_t mask);
+    void lock(uint8_t mask);
+
+    // io task: debounced door state of compartment `id` (drives the hold)
+    void doorChanged(uint8_t id, bool open);
+
+    void printStats();
+
+private:
+    enum CoilState : uint8_t {
+        COIL_LOCKED = 0,
+        COIL_PENDING_UNLOCK,            // Waiting for its stagger slot
+        COIL_PULL_IN,
+        COIL_HOLD,                      // Energised, door still shut
+        COIL_RELEASED                   // Unlocked, door open, coil off
+    };
+
+    struct Relay {
+        uint8_t pin;
+        CoilState state;
+        bool energised;                 // Last level written (LOW)
+        bool unlocked;
+        bool doorOpen;
+        int64_t nextUs;                 // Next transition, 0 = none
+        int64_t energisedAtUs;
+
+        // Statistics
+        uint32_t unlocks;
+        uint64_t energisedUs;
+        uint64_t unlockedUs;
+        int64_t unlockedAtUs;
+    };
+
+    SemaphoreHandle_t mutex;
+    esp_timer_handle_t timer;
+    bool running;
+
+    uint8_t buzzerPin;
+    Relay relays[SEQ_MAX_RELAYS];
+    uint8_t relayCount;
+
+    // Tone in progress
+    int8_t tone;                        // -1 = silent
+    uint8_t step;
+    uint8_t pass;
+    int64_t stepStartUs;
+    uint16_t writtenHz;
+
+    // Statistics
+    uint32_t tonesPlayed;
+    uint32_t tonesDropped;
+    uint32_t ticks;
+
+    static void onTick(void* arg);
+    void service(int64_t now);          // Holding mutex
+    bool serviceTone(int64_t now);
+    bool serviceRelay(Relay& r, int64_t now);
+    void setCoil(Relay& r, bool on, int64_t now);
+    void setUnlocked(Relay& r, bool unlocked, int64_t now);
+    void writeTone(uint16_t hz);
+    void ensureRunning();
+};
+
+#endif // ACTUATOR_SEQUENCER_H
@@ -0,0 +1,77 @@
+#include "BootTimeline.h"
+#include "PINS_CONFIG.h"
+#include <esp_timer.h>
+#include <esp_system.h>
+
+// ============================================================================
+// BOOT TIMELINE IMPLEMENTATION
+// ============================================================================
+
+BootTimeline::BootTimeline() : mux(portMUX_INITIALIZER_UNLOCKED), reported(false) {
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) at[i] = 0;
+}
+
+const char* BootTimeline::phaseName(BootPhase phase) {
+    static const char* const names[BOOT_PHASE_COUNT] = {
+        "local", "storage", "espnow", "ready", "gsm", "wifi", "ntp", "firebase"
+    };
+    return phase < BOOT_PHASE_COUNT ? names[phase] : "?";
+}
+
+const char* BootTimeline::resetReason() {
+    switch (esp_reset_reason()) {
+        case ESP_RST_POWERON:   return "power_on";
+        case ESP_RST_EXT:       return "external";
+        case ESP_RST_SW:        return "software";
+        case ESP_RST_PANIC:     return "panic";
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:       return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep_sleep";
+        case ESP_RST_BROWNOUT:  return "brownout";
+        default:                return "other";
+    }
+}
+
+void BootTimeline::mark(BootPhase phase) {
+    if (phase >= BOOT_PHASE_COUNT || done(phase)) return;
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+    bool all = true;
+
+    portENTER_CRITICAL(&mux);
+    if (at[phase] == 0) {
+        at[phase] = now;
+        first = true;
+    }
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) all = all && at[i] != 0;
+    bool report = all && !reported;
+    if (report) reported = true;
+    portEXIT_CRITICAL(&mux);
+
+    if (first) Serial.printf("[BOOT] %s at %u ms\n", phaseName(phase), (unsigned)(now / 1000));
+    if (report) print();
+}
+
+void BootTimeline::print() {
+    Serial.printf("[BOOT] fw %s, reset %s\n", FIRMWARE_VERSION, resetReason());
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        int64_t t = at[i];
+        if (t) Serial.printf("[BOOT] %-9s %7u ms\n", phaseName((BootPhase)i), (unsigned)(t / 1000));
+        else Serial.printf("[BOOT] %-9s pending\n", phaseName((BootPhase)i));
+    }
+}
+
+void BootTimeline::addTo(FirebaseJson& json, const char* prefix) {
+    char key[40];
+    snprintf(key, sizeof(key), "%s/fw", prefix);
+    json.set(key, FIRMWARE_VERSION);
+    snprintf(key, sizeof(key), "%s/reset", prefix);
+    json.set(key, resetReason());
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        int64_t t = at[i];
+        if (!t) continue;
+        snprintf(key, sizeof(key), "%s/%s_ms", prefix, phaseName((BootPhase)i));
+        json.set(key, (int)(t / 1000));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+
+// ============================================================================
+// BOOT TIMELINE - Smart Parcel Locker
+// ============================================================================
+// Time from power-on (esp_timer start) to each boot phase. setup() only does
+// the local phases; the rest complete concurrently on their own tasks:
+//
+//   Phase        Depends on      Runs on
+//   local        -               setup()   GPIO, queues, LCD, device id
+//   storage      local           setup()   LittleFS parcel cache + journal
+//   espnow       local           setup()   CAM link accepting scans
+//   ready        storage         setup()   Doors + cached validation live
+//   gsm          local           gsm       Modem probed and configured
+//   wifi         local           cloud     Associated, IP assigned
+//   ntp          wifi            cloud     Wall clock valid
+//   firebase     wifi            cloud     Authenticated, streams started
+//
+// The first mark of a phase wins. Timings are printed once every phase is
+// done (and by the `boot` command) and published with the heartbeat metrics
+// so startup time can be compared across firmware releases.
+
+enum BootPhase {
+    BOOT_PHASE_LOCAL = 0,
+    BOOT_PHASE_STORAGE,
+    BOOT_PHASE_ESPNOW,
+    BOOT_PHASE_READY,
+    BOOT_PHASE_GSM,
+    BOOT_PHASE_WIFI,
+    BOOT_PHASE_NTP,
+    BOOT_PHASE_FIREBASE,
+    BOOT_PHASE_COUNT
+};
+
+class BootTimeline {
+public:
+    BootTimeline();
+
+    // Any task: record that a phase completed (later marks are ignored)
+    void mark(BootPhase phase);
+    bool done(BootPhase phase) const { return at[phase] != 0; }
+
+    // Any task: phase table
+    void print();
+
+    // Cloud task: fw, reset reason and <phase>_ms under `prefix`
+    void addTo(FirebaseJson& json, const char* prefix);
+
+    static const char* phaseName(BootPhase phase);
+    static const char* resetReason();
+
+private:
+    portMUX_TYPE mux;
+    volatile int64_t at[BOOT_PHASE_COUNT];      // esp_timer us, 0 = pending
+    bool reported;
+};
+
+#endif // BOOT_TIMELINE_H
@@ -0,0 +1,138 @@
+#include "CloudLink.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// CLOUD LINK IMPLEMENTATION
+// ============================================================================
+
+CloudLink::CloudLink()
+    : pool(nullptr), largestAtRelease(0), upAtUs(0), wasConnected(false), requests(0),
+      handshakes(0), failures(0), outages(0), lastRequestUs(0), lastHandshakeUs(0),
+      lastReusedUs(0), lastFirstWriteMs(0), maxFirstWriteMs(0) {
+    for (uint8_t i = 0; i < STREAM_COUNT; i++) streams[i] = { 0, STREAM_RETRY_MIN_MS, 0, 0 };
+}
+
+void CloudLink::reserve() {
+    if (pool) return;
+    pool = heap_caps_malloc(TLS_POOL_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!pool) Serial.printf("[TLS] Could not reserve %u bytes\n", (unsigned)TLS_POOL_BYTES);
+}
+
+void CloudLink::configure(FirebaseData& data, uint16_t responseSize, bool keepAlive) {
+    data.setBSSLBufferSize(TLS_RX_BUFFER_SIZE, TLS_TX_BUFFER_SIZE);
+    data.setResponseSize(responseSize);
+    if (keepAlive) data.keepAlive(TLS_KEEPALIVE_IDLE_S, TLS_KEEPALIVE_INTVL_S, TLS_KEEPALIVE_COUNT);
+}
+
+void CloudLink::releasePool() {
+    if (!pool) return;
+    heap_caps_free(pool);
+    pool = nullptr;
+    largestAtRelease = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    Serial.printf("[TLS] Released %u byte reservation, largest block %u\n",
+                  (unsigned)TLS_POOL_BYTES, (unsigned)largestAtRelease);
+}
+
+// ============================================================================
+// OUTAGES
+// ============================================================================
+void CloudLink::linkDown() {
+    outages++;
+    upAtUs = 0;
+}
+
+void CloudLink::linkUp() {
+    if (outages > 0) upAtUs = esp_timer_get_time();
+    // Streams failed because the link was down; try them straight away
+    for (uint8_t i = 0; i < STREAM_COUNT; i++) {
+        streams[i].at = 0;
+        streams[i].delay = STREAM_RETRY_MIN_MS;
+    }
+}
+
+// ============================================================================
+// STREAMS
+// ============================================================================
+bool CloudLink::streamDue(CloudStream stream) {
+    const StreamRetry& s = streams[stream];
+    return s.at == 0 || (long)(millis() - s.at) >= 0;
+}
+
+void CloudLink::streamStarted(CloudStream stream, bool ok) {
+    StreamRetry& s = streams[stream];
+    s.starts++;
+    if (ok) {
+        s.at = 0;
+        s.delay = STREAM_RETRY_MIN_MS;
+        return;
+    }
+    s.failures++;
+    s.at = millis() + s.delay;
+    s.delay = s.delay * 2 > STREAM_RETRY_MAX_MS ? STREAM_RETRY_MAX_MS : s.delay * 2;
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+int64_t CloudLink::request(FirebaseData& data) {
+    wasConnected = data.httpConnected();
+    return esp_timer_get_time();
+}
+
+void CloudLink::requestDone(int64_t startUs, bool ok) {
+    int64_t now = esp_timer_get_time();
+    lastRequestUs = (uint32_t)(now - startUs);
+    requests++;
+    if (!wasConnected) {
+        handshakes++;
+        lastHandshakeUs = lastRequestUs;
+    } else {
+        lastReusedUs = lastRequestUs;
+    }
+
+    if (!ok) {
+        failures++;
+        return;
+    }
+    if (upAtUs) {
+        lastFirstWriteMs = (uint32_t)((now - upAtUs) / 1000);
+        if (lastFirstWriteMs > maxFirstWriteMs) maxFirstWriteMs = lastFirstWriteMs;
+        upAtUs = 0;
+        Serial.printf("[TLS] First write %u ms after reconnect (%s)\n", (unsigned)lastFirstWriteMs,
+                      wasConnected ? "connection survived" : "new handshake");
+    }
+}
+
+void CloudLink::printStats() {
+    Serial.printf("[TLS] %u requests, %u handshakes (%u reused), %u failed\n",
+                  (unsigned)requests, (unsigned)handshakes, (unsigned)(requests - handshakes),
+                  (unsigned)failures);
+    Serial.printf("[TLS] last %u us; with handshake %u us, reused %u us\n",
+                  (unsigned)lastRequestUs, (unsigned)lastHandshakeUs, (unsigned)lastReusedUs);
+    Serial.printf("[TLS] %u outages; first write after reconnect %u ms last, %u ms max\n",
+                  (unsigned)outages, (unsigned)lastFirstWriteMs, (unsigned)maxFirstWriteMs);
+    Serial.printf("[TLS] reservation %s (%u bytes)\n", pool ? "held" : "released",
+                  (unsigned)TLS_POOL_BYTES);
+    Serial.printf("[TLS] stream starts: commands %u (%u failed), parcels %u (%u failed)\n",
+                  (unsigned)streams[STREAM_COMMANDS].starts, (unsigned)streams[STREAM_COMMANDS].failures,
+                  (unsigned)streams[STREAM_PARCELS].starts, (unsigned)streams[STREAM_PARCELS].failures);
+}
+
+void CloudLink::addTo(FirebaseJson& json, const char* prefix) {
+    char key[40];
+    snprintf(key, sizeof(key), "%s/req", prefix);
+    json.set(key, (int)requests);
+    snprintf(key, sizeof(key), "%s/hs", prefix);
+    json.set(key, (int)handshakes);
+    snprintf(key, sizeof(key), "%s/hs_us", prefix);
+    json.set(key, (int)lastHandshakeUs);
+    snprintf(key, sizeof(key), "%s/reuse_us", prefix);
+    json.set(key, (int)lastReusedUs);
+    snprintf(key, sizeof(key), "%s/outages", prefix);
+    json.set(key, (int)outages);
+    snprintf(key, sizeof(key), "%s/ttfw_ms", prefix);
+    json.set(key, (int)lastFirstWriteMs);
+    snprintf(key, sizeof(key), "%s/ttfw_max", prefix);
+    json.set(key, (int)maxFirstWriteMs);
+}
@@ -0,0 +1,103 @@
+#ifndef CLOUD_LINK_H
+#define CLOUD_LINK_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+
+// ============================================================================
+// CLOUD LINK - Smart Parcel Locker
+// ============================================================================
+// TLS connection policy for the three RTDB connections (fbdo for every
+// request/response, plus the command and parcel streams):
+// - SSL buffer sizes are set in one place, once per FirebaseData object
+// - reserve() takes one contiguous block for those buffers first thing at
+//   boot; releasePool() frees it right before the first handshake, so the
+//   long-lived TLS buffers land in unfragmented heap instead of between
+//   short-lived allocations
+// - fbdo is kept alive (TCP keep-alive, no close between requests): every
+//   write shares one session, and only the first request after an outage
+//   pays a handshake
+// - linkDown()/linkUp() bracket each WiFi outage; request()/requestDone()
+//   around each fbdo call measure handshakes vs reused connections and the
+//   time from re-association to the first successful request
+// - A dropped stream is restarted by the cloud task on its next pass, then
+//   with a doubling delay while it keeps failing (streamDue()/streamStarted()),
+//   instead of a blocking beginStream() on every pass
+//
+// Session tickets are not reachable through Firebase_ESP_Client's internal
+// client; keeping the connection up is what avoids repeat handshakes.
+
+#define TLS_RX_BUFFER_SIZE      2048
+#define TLS_TX_BUFFER_SIZE      1024
+#define TLS_CONNECTIONS         3       // fbdo, command stream, parcel stream
+#define TLS_ENGINE_OVERHEAD     6144    // Engine context, X.509 state, record scratch
+#define TLS_POOL_BYTES          (TLS_CONNECTIONS * (TLS_RX_BUFFER_SIZE + TLS_TX_BUFFER_SIZE + TLS_ENGINE_OVERHEAD))
+
+#define TLS_KEEPALIVE_IDLE_S    20      // Probe an idle socket after this long
+#define TLS_KEEPALIVE_INTVL_S   5
+#define TLS_KEEPALIVE_COUNT     3       // Unanswered probes before it is dropped
+
+#define STREAM_RETRY_MIN_MS     1000
+#define STREAM_RETRY_MAX_MS     30000
+
+enum CloudStream : uint8_t { STREAM_COMMANDS = 0, STREAM_PARCELS, STREAM_COUNT };
+
+class CloudLink {
+public:
+    CloudLink();
+
+    // setup(), before anything else allocates
+    void reserve();
+
+    // Before Firebase.begin(): buffer sizes (and keep-alive) for one connection
+    void configure(FirebaseData& data, uint16_t responseSize, bool keepAlive);
+
+    // Cloud task: hand the reserved block back just before the first handshake
+    void releasePool();
+
+    // Cloud task: WiFi lost / re-associated
+    void linkDown();
+    void linkUp();
+
+    // Cloud task: around every request on `data` (the shared fbdo connection)
+    int64_t request(FirebaseData& data);
+    void requestDone(int64_t startUs, bool ok);
+
+    // Cloud task: may a stream that is down be started again now?
+    bool streamDue(CloudStream stream);
+    // Cloud task: result of a beginStream() attempt (first start included)
+    void streamStarted(CloudStream stream, bool ok);
+
+    void printStats();
+
+    // Cloud task: tls/* counters for the heartbeat metrics
+    void addTo(FirebaseJson& json, const char* prefix);
+
+private:
+    void* pool;
+    uint32_t largestAtRelease;
+
+    int64_t upAtUs;             // Link came back; 0 = no outage being timed
+    bool wasConnected;          // Connection state when the current request began
+
+    // Statistics
+    uint32_t requests;
+    uint32_t handshakes;        // Requests that had to open the connection
+    uint32_t failures;
+    uint32_t outages;
+    uint32_t lastRequestUs;
+    uint32_t lastHandshakeUs;   // Request time including the handshake
+    uint32_t lastReusedUs;      // Request time on an open connection
+    uint32_t lastFirstWriteMs;  // Re-association → first successful request
+    uint32_t maxFirstWriteMs;
+
+    struct StreamRetry {
+        unsigned long at;       // millis() of the next attempt; 0 = now
+        unsigned long delay;
+        uint32_t starts;
+        uint32_t failures;
+    };
+    StreamRetry streams[STREAM_COUNT];
+};
+
+#endif // CLOUD_LINK_H
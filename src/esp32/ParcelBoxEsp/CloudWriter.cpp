@@ -0,0 +1,503 @@
+#include "CloudWriter.h"
+#include "FirebaseConfig.h"
+#include "LogRing.h"
+#include <time.h>
+#include <sys/time.h>
+
+// ============================================================================
+// CLOUD WRITER IMPLEMENTATION
+// ============================================================================
+
+CloudWriter::CloudWriter()
+    : historyQueue(nullptr), compartmentCount(0), journal(nullptr), metrics(nullptr), link(nullptr), commands(nullptr), batchCount(0), mux(portMUX_INITIALIZER_UNLOCKED),
+      statusPending(false), statusEverSent(false), heartbeatMs(0), heartbeatPending(false),
+      liveSeq(0), livePending(false),
+      firstPendingAt(0), retryAt(0), retryDelay(RETRY_MIN_MS), consecutiveFailures(0),
+      batchesSent(0), eventsSent(0), statusCoalesced(0), writeFailures(0), queueDrops(0),
+      eventsSpilled(0), eventsReplayed(0), liveSent(0), rollupWrites(0) {
+    memset(&latestStatus, 0, sizeof(latestStatus));
+    memset(&sentStatus, 0, sizeof(sentStatus));
+    memset(&liveWord, 0, sizeof(liveWord));
+    memset(&rollups, 0, sizeof(rollups));
+}
+
+void CloudWriter::begin(const char* id, uint8_t compartments) {
+    // Multi-path update keys are relative to the root (no leading '/')
+    compartmentCount = compartments > 8 ? 8 : compartments;
+    historyRoot.printf("%s/%s/", ParcelBoxFirebaseConfig::getHistoryPath() + 1, id);
+    rollupRoot.printf("%s_rollup/%s/", ParcelBoxFirebaseConfig::getHistoryPath() + 1, id);
+    locksStatusPath.printf("%s/%s", ParcelBoxFirebaseConfig::getLocksStatusPath() + 1, id);
+    heartbeatPath.printf("%s/%s/last_heartbeat", ParcelBoxFirebaseConfig::getDeviceStatusPath() + 1, id);
+    metricsPath.printf("%s/%s/metrics", ParcelBoxFirebaseConfig::getDeviceStatusPath() + 1, id);
+    livePath.printf("%s/%s/live", ParcelBoxFirebaseConfig::getDeviceStatusPath() + 1, id);
+    if (!historyQueue) historyQueue = xQueueCreate(QUEUE_LEN, sizeof(HistoryItem));
+}
+
+void CloudWriter::setJournal(EventJournal* j) {
+    journal = j;
+}
+
+void CloudWriter::setMetrics(SystemMetrics* m) {
+    metrics = m;
+}
+
+void CloudWriter::setLink(CloudLink* l) {
+    link = l;
+}
+
+void CloudWriter::setCommands(CommandChannel* c) {
+    commands = c;
+}
+
+void CloudWriter::linkRestored() {
+    retryAt = 0;
+    retryDelay = RETRY_MIN_MS;
+    consecutiveFailures = 0;
+}
+
+bool CloudWriter::queueHistory(const char* parcelId, const char* event) {
+    if (!historyQueue) return false;
+    HistoryItem item = {};
+    strlcpy(item.parcelId, parcelId, sizeof(item.parcelId));
+    strlcpy(item.event, event, sizeof(item.event));
+    syncedEpochMs(&item.epochMs);
+    if (xQueueSend(historyQueue, &item, 0) != pdTRUE) {
+        // Queue backed up (long replay or outage) — keep the event on flash
+        if (journal && journal->appendHistory(parcelId, event, item.epochMs, item.epochMs != 0)) {
+            eventsSpilled++;
+            return true;
+        }
+        queueDrops++;
+        return false;
+    }
+    portENTER_CRITICAL(&mux);
+    if (firstPendingAt == 0) firstPendingAt = millis();
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+void CloudWriter::setLockStatus(const LockStatus& status) {
+    portENTER_CRITICAL(&mux);
+    bool changed = memcmp(&status, &latestStatus, sizeof(LockStatus)) != 0;
+    if (changed) {
+        if (statusPending) statusCoalesced++;   // Previous value never hit the wire
+        latestStatus = status;
+        statusPending = !statusEverSent || memcmp(&status, &sentStatus, sizeof(LockStatus)) != 0;
+        if (statusPending && firstPendingAt == 0) firstPendingAt = millis();
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void CloudWriter::setLiveStatus(const StatusWord& word) {
+    portENTER_CRITICAL(&mux);
+    liveWord = word;
+    liveSeq++;
+    livePending = true;
+    if (firstPendingAt == 0) firstPendingAt = millis();
+    portEXIT_CRITICAL(&mux);
+}
+
+void CloudWriter::setHeartbeat(uint32_t uptimeMs) {
+    portENTER_CRITICAL(&mux);
+    heartbeatMs = uptimeMs;
+    heartbeatPending = true;
+    if (firstPendingAt == 0) firstPendingAt = millis();
+    portEXIT_CRITICAL(&mux);
+}
+
+bool CloudWriter::hasPending() {
+    portENTER_CRITICAL(&mux);
+    bool pending = statusPending || heartbeatPending || livePending;
+    portEXIT_CRITICAL(&mux);
+    return pending || batchCount > 0 || (historyQueue && uxQueueMessagesWaiting(historyQueue) > 0) ||
+           (commands && commands->hasAcks());
+}
+
+// Top up the batch from the queue; keys are assigned once so a retried
+// batch rewrites the same nodes instead of duplicating them
+void CloudWriter::fillBatch() {
+    HistoryItem item;
+    while (batchCount < MAX_BATCH && xQueueReceive(historyQueue, &item, 0) == pdTRUE) {
+        // Clock set in the moments since it was queued: close enough for the day
+        if (!item.epochMs) syncedEpochMs(&item.epochMs);
+        batch[batchCount] = item;
+        generatePushId(batchKeys[batchCount]);
+        batchCount++;
+    }
+}
+
+bool CloudWriter::flush(FirebaseData* fbdo) {
+    if (!historyQueue) return false;
+
+    // Journaled events go first so history stays in order
+    bool replay = journal && batchCount == 0 && journal->pendingCount() > 0;
+    if (!replay && !hasPending()) return false;
+
+    unsigned long now = millis();
+    if (retryAt != 0 && (long)(now - retryAt) < 0) return false;
+    if (replay) return replayJournal(fbdo);
+
+    // Give a burst (e.g. QR_SCANNED → PARCEL_FOUND → VALIDATION_SUCCESS) a
+    // moment to gather so it travels as one round-trip
+    // Someone is waiting on a command ack: no coalescing
+    bool full = uxQueueMessagesWaiting(historyQueue) + batchCount >= MAX_BATCH ||
+                (commands && commands->hasAcks());
+    if (!full && firstPendingAt != 0 && now - firstPendingAt < COALESCE_MS) return false;
+
+    fillBatch();
+
+    portENTER_CRITICAL(&mux);
+    LockStatus status = latestStatus;
+    bool sendStatus = statusPending;
+    uint8_t changed = !statusEverSent ? allCompartments()
+                      : (uint8_t)((status.locksOpen ^ sentStatus.locksOpen) |
+                                  (status.doorsOpen ^ sentStatus.doorsOpen));
+    uint32_t heartbeat = heartbeatMs;
+    bool sendHeartbeat = heartbeatPending;
+    StatusWord word = liveWord;
+    uint8_t wordSeq = liveSeq;
+    bool sendLive = livePending;
+    portEXIT_CRITICAL(&mux);
+
+    // Multi-path update at the root: keys are full paths, values replace
+    // only the node at that path
+    FirebaseJson update;
+    memset(&rollups, 0, sizeof(rollups));
+    for (size_t i = 0; i < batchCount; i++) {
+        addHistory(update, rollups, batchKeys[i], batch[i].parcelId, batch[i].event,
+                   batch[i].epochMs, false);
+    }
+    uint8_t rollupCount = addRollups(update, rollups);
+    if (sendStatus) {
+        addLockStatus(update, status, changed, nullptr);
+    }
+    if (sendHeartbeat) {
+        update.add(heartbeatPath.c_str(), (int)heartbeat);
+        if (metrics) metrics->addTo(update, metricsPath.c_str());
+    }
+    if (sendLive) {
+        char encoded[STATUS_WORD_B64_LEN + 1];
+        word.encode(wordSeq, encoded);
+        update.add(livePath.c_str(), encoded);
+    }
+    uint8_t acks = commands ? commands->addAcksTo(update) : 0;
+
+    if (!send(fbdo, update)) {
+        writeFailed(fbdo);
+        // Link is probably gone — don't hold events in RAM across an outage
+        if (consecutiveFailures >= SPILL_AFTER_FAILURES) spillToJournal();
+        return false;
+    }
+
+    if (acks) commands->acksSent();
+    rollupWrites += rollupCount;
+    batchesSent++;
+    eventsSent += batchCount;
+    batchCount = 0;
+    retryAt = 0;
+    retryDelay = RETRY_MIN_MS;
+    consecutiveFailures = 0;
+
+    portENTER_CRITICAL(&mux);
+    if (sendStatus) {
+        sentStatus = status;
+        statusEverSent = true;
+        statusPending = memcmp(&latestStatus, &sentStatus, sizeof(LockStatus)) != 0;
+    }
+    if (sendHeartbeat && heartbeatMs == heartbeat) heartbeatPending = false;
+    if (sendLive) {
+        liveSent++;
+        if (liveSeq == wordSeq) livePending = false;
+    }
+    firstPendingAt = (statusPending || heartbeatPending || livePending ||
+                      uxQueueMessagesWaiting(historyQueue) > 0) ? millis() : 0;
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+bool CloudWriter::send(FirebaseData* fbdo, FirebaseJson& update) {
+    int64_t t0 = link ? link->request(*fbdo) : 0;
+    bool ok = Firebase.RTDB.updateNode(fbdo, "/", &update);
+    if (link) link->requestDone(t0, ok);
+    return ok;
+}
+
+void CloudWriter::writeFailed(FirebaseData* fbdo) {
+    writeFailures++;
+    consecutiveFailures++;
+    retryAt = millis() + retryDelay;
+    LOG_W("FB", "Batch write failed (%s), retry in %lu ms", fbdo->errorReason().c_str(), retryDelay);
+    unsigned long doubled = retryDelay * 2;
+    retryDelay = (doubled > RETRY_MAX_MS) ? RETRY_MAX_MS : doubled;
+}
+
+// One leaf per field of each changed compartment, in the same updateNode as
+// everything else: the write grows with what changed, not with the box size
+void CloudWriter::addLockStatus(FirebaseJson& update, const LockStatus& status, uint8_t changed,
+                                const uint64_t* epochMs) {
+    FixedString<96> key;
+    for (uint8_t i = 0; i < compartmentCount; i++) {
+        uint8_t bit = 1u << i;
+        if (!(changed & bit)) continue;
+        key.printf("%s/lock%u", locksStatusPath.c_str(), (unsigned)(i + 1));
+        update.add(key.c_str(), (status.locksOpen & bit) ? "open" : "closed");
+        key.printf("%s/door%u", locksStatusPath.c_str(), (unsigned)(i + 1));
+        update.add(key.c_str(), (status.doorsOpen & bit) ? "open" : "closed");
+    }
+    key.printf("%s/timestamp", locksStatusPath.c_str());
+    if (epochMs) {
+        update.add(key.c_str(), *epochMs);
+    } else {
+        FirebaseJson serverTime;
+        serverTime.set(".sv", "timestamp");
+        update.add(key.c_str(), serverTime);
+    }
+}
+
+void CloudWriter::printStats() {
+    Serial.printf("Cloud writer: %u batches, %u events, %u status coalesced, %u failures, %u dropped, %u queued\n",
+                  (unsigned)batchesSent, (unsigned)eventsSent, (unsigned)statusCoalesced,
+                  (unsigned)writeFailures, (unsigned)queueDrops,
+                  (unsigned)(historyQueue ? uxQueueMessagesWaiting(historyQueue) + batchCount : 0));
+    Serial.printf("Cloud writer: %u spilled to journal, %u replayed, %u live words, %u rollup increments\n",
+                  (unsigned)eventsSpilled, (unsigned)eventsReplayed, (unsigned)liveSent,
+                  (unsigned)rollupWrites);
+    if (journal) journal->printStats();
+}
+
+// ============================================================================
+// HISTORY ENTRIES & DAILY ROLLUPS
+// ============================================================================
+static_assert(CloudWriter::MAX_BATCH <= CloudWriter::ROLLUP_DAYS &&
+              CloudWriter::REPLAY_BATCH <= CloudWriter::ROLLUP_DAYS,
+              "a batch could touch more days than the rollup table holds");
+
+// Events counted per day; the rest are only in the raw history
+static const struct {
+    const char* event;
+    RollupCounter counter;
+} ROLLUP_EVENTS[] = {
+    { "PARCEL_DELIVERED",  ROLLUP_DELIVERIES },
+    { "VALIDATION_FAILED", ROLLUP_FAILED_VALIDATIONS },
+    { "SMS_DOOR_BREACH",   ROLLUP_BREACHES },         // Once per breach
+    { "QR_SCANNED",        ROLLUP_SCANS },
+};
+
+static const char* ROLLUP_NAMES[ROLLUP_COUNTER_COUNT] = {
+    "deliveries", "failed_validations", "breaches", "scans"
+};
+
+// Local day (configTime offset) of an epoch time; "undated" without one
+void CloudWriter::dayKey(uint64_t epochMs, char out[11]) {
+    if (!epochMs) {
+        strlcpy(out, "undated", 11);
+        return;
+    }
+    time_t t = (time_t)(epochMs / 1000);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(out, 11, "%Y-%m-%d", &tm);
+}
+
+void CloudWriter::addHistory(FirebaseJson& update, Rollups& rollups, const char* key,
+                             const char* parcelId, const char* event, uint64_t epochMs,
+                             bool replayed) {
+    char day[11];
+    dayKey(epochMs, day);
+
+    // The device is in the path: entries carry only what varies
+    FirebaseJson entry;
+    entry.set("p", parcelId);
+    entry.set("e", event);
+    if (epochMs) entry.set("t", epochMs);
+    else entry.set("t/.sv", "timestamp");
+    if (replayed) entry.set("r", 1);
+    FixedString<112> path;
+    path.printf("%s%s/%s", historyRoot.c_str(), day, key);
+    update.add(path.c_str(), entry);
+
+    if (!epochMs) return;       // No day to count it under
+    for (size_t i = 0; i < sizeof(ROLLUP_EVENTS) / sizeof(ROLLUP_EVENTS[0]); i++) {
+        if (strcmp(event, ROLLUP_EVENTS[i].event) != 0) continue;
+        uint8_t d = 0;
+        while (d < rollups.dayCount && strcmp(rollups.days[d].day, day) != 0) d++;
+        if (d == rollups.dayCount) {
+            if (d == ROLLUP_DAYS) return;       // Ruled out by the static_assert above
+            strlcpy(rollups.days[d].day, day, sizeof(rollups.days[d].day));
+            rollups.dayCount++;
+        }
+        rollups.days[d].counts[ROLLUP_EVENTS[i].counter]++;
+        return;
+    }
+}
+
+uint8_t CloudWriter::addRollups(FirebaseJson& update, const Rollups& rollups) {
+    uint8_t n = 0;
+    FixedString<112> path;
+    for (uint8_t d = 0; d < rollups.dayCount; d++) {
+        for (uint8_t c = 0; c < ROLLUP_COUNTER_COUNT; c++) {
+            uint16_t count = rollups.days[d].counts[c];
+            if (!count) continue;
+            FirebaseJson inc;
+            inc.set(".sv/increment", (int)count);
+            path.printf("%s%s/%s", rollupRoot.c_str(), rollups.days[d].day, ROLLUP_NAMES[c]);
+            update.add(path.c_str(), inc);
+            n++;
+        }
+    }
+    return n;
+}
+
+// ============================================================================
+// OFFLINE JOURNAL — SPILL & REPLAY
+// ============================================================================
+void CloudWriter::spillToJournal() {
+    if (!journal || !historyQueue) return;
+
+    // Spilled events keep the time they were queued, not the time of the spill
+    for (size_t i = 0; i < batchCount; i++) {
+        const HistoryItem& b = batch[i];
+        if (journal->appendHistory(b.parcelId, b.event, b.epochMs, b.epochMs != 0)) eventsSpilled++;
+    }
+    batchCount = 0;
+
+    HistoryItem item;
+    while (xQueueReceive(historyQueue, &item, 0) == pdTRUE) {
+        if (journal->appendHistory(item.parcelId, item.event, item.epochMs, item.epochMs != 0)) eventsSpilled++;
+    }
+
+    // The journal now owns the newest status; replay will write it
+    portENTER_CRITICAL(&mux);
+    LockStatus status = latestStatus;
+    bool spillStatus = statusPending;
+    if (spillStatus) {
+        sentStatus = status;
+        statusEverSent = true;
+        statusPending = false;
+    }
+    livePending = false;            // Stale by the time the link is back
+    firstPendingAt = heartbeatPending ? firstPendingAt : 0;
+    portEXIT_CRITICAL(&mux);
+    if (spillStatus) journal->appendStatus(status.locksOpen, status.doorsOpen);
+
+    consecutiveFailures = 0;
+}
+
+bool CloudWriter::replayJournal(FirebaseData* fbdo) {
+    size_t n = journal->readBatch(replayBuf, REPLAY_BATCH);
+    if (n == 0) {
+        journal->commitBatch();     // Only corrupt records in this stretch — skip them
+        return false;
+    }
+
+    FirebaseJson update;
+    memset(&rollups, 0, sizeof(rollups));
+    int newestStatus = -1;
+    size_t events = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const JournalRecord& rec = replayBuf[i];
+        if (rec.type == JOURNAL_TYPE_STATUS) {
+            newestStatus = i;       // Only the last state matters
+            continue;
+        }
+        if (rec.type != JOURNAL_TYPE_HISTORY) continue;
+
+        uint64_t ms;
+        bool known = journal->recordEpochMs(rec, &ms);
+        char key[21];
+        replayKey(rec, known ? ms : rec.uptimeMs, key);
+
+        addHistory(update, rollups, key, rec.parcelId, rec.event, known ? ms : 0, true);
+        events++;
+    }
+    uint8_t rollupCount = addRollups(update, rollups);
+
+    if (newestStatus >= 0) {
+        const JournalRecord& rec = replayBuf[newestStatus];
+        LockStatus status = { rec.locksOpen, rec.doorsOpen };
+        uint64_t ms;
+        bool known = journal->recordEpochMs(rec, &ms);
+        // What the server last saw is unknown after an outage: write every compartment
+        addLockStatus(update, status, allCompartments(), known ? &ms : nullptr);
+    }
+
+    if (!send(fbdo, update)) {
+        writeFailed(fbdo);
+        return false;
+    }
+
+    journal->commitBatch();
+    batchesSent++;
+    eventsReplayed += events;
+    rollupWrites += rollupCount;
+    retryAt = 0;
+    retryDelay = RETRY_MIN_MS;
+    consecutiveFailures = 0;
+    return true;
+}
+
+// Deterministic key: time prefix keeps chronological order, the sequence
+// number makes it unique. Re-uploading a batch that landed but was reported
+// failed rewrites the same nodes instead of duplicating them (its rollup
+// increments do count again).
+void CloudWriter::replayKey(const JournalRecord& rec, uint64_t ms, char out[21]) {
+    static const char PUSH_CHARS[] =
+        "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+    for (int i = 7; i >= 0; i--) {
+        out[i] = PUSH_CHARS[ms % 64];
+        ms /= 64;
+    }
+    uint64_t tail = ((uint64_t)(rec.bootId & 0xFFFFFF) << 32) | rec.seq;
+    for (int i = 19; i >= 8; i--) {
+        out[i] = PUSH_CHARS[tail % 64];
+        tail /= 64;
+    }
+    out[20] = '\0';
+}
+
+// ============================================================================
+// PUSH ID GENERATION
+// ============================================================================
+// Same layout as Firebase client push IDs: 8 chars of millisecond timestamp
+// followed by 12 random chars, incremented when two IDs share a millisecond.
+bool CloudWriter::syncedEpochMs(uint64_t* out) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000) return false;     // NTP not synced yet
+    *out = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return true;
+}
+
+uint64_t CloudWriter::nowEpochMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec > 24 * 3600) return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return millis();    // NTP not synced yet — still monotonic per boot
+}
+
+void CloudWriter::generatePushId(char out[21]) {
+    static const char PUSH_CHARS[] =
+        "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+    static uint64_t lastMs = 0;
+    static uint8_t lastRand[12];
+
+    uint64_t ms = nowEpochMs();
+    bool duplicate = (ms == lastMs);
+    lastMs = ms;
+
+    for (int i = 7; i >= 0; i--) {
+        out[i] = PUSH_CHARS[ms % 64];
+        ms /= 64;
+    }
+
+    if (!duplicate) {
+        for (int i = 0; i < 12; i++) lastRand[i] = esp_random() % 64;
+    } else {
+        int i = 11;
+        while (i >= 0 && lastRand[i] == 63) lastRand[i--] = 0;
+        if (i >= 0) lastRand[i]++;
+    }
+    for (int i = 0; i < 12; i++) out[8 + i] = PUSH_CHARS[lastRand[i]];
+    out[20] = '\0';
+}
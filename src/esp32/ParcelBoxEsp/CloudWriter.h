@@ -0,0 +1,209 @@
+#ifndef CLOUD_WRITER_H
+#define CLOUD_WRITER_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "EventJournal.h"
+#include "FixedString.h"
+#include "SystemMetrics.h"
+#include "CloudLink.h"
+#include "StatusWord.h"
+#include "CommandChannel.h"
+
+// ============================================================================
+// CLOUD WRITER - Smart Parcel Locker
+// ============================================================================
+// Fire-and-forget outbound pipeline for RTDB writes:
+// - queueHistory() / setLockStatus() / setLiveStatus() / setHeartbeat() never
+//   block and may be called from any task
+// - The cloud task calls flush(), which sends everything pending as ONE
+//   multi-path updateNode at the database root:
+//     history/<device>/<yyyy-mm-dd>/<pushId>
+//                                 — one compact entry per queued event
+//                                   { p: parcel, e: event, t: epoch ms }, in
+//                                   the local day it happened ("undated" if
+//                                   the clock was never set)
+//     history_rollup/<device>/<yyyy-mm-dd>/<counter>
+//                                 — per-day deliveries / failed_validations /
+//                                   breaches / scans, server-side increments
+//                                   for the events in the same batch
+//     locks_status/<device>/lock<n>, door<n>, timestamp
+//                                 — latest state of the compartments that
+//                                   changed since the last write (coalesced)
+//     device_status/<device>/live    — packed StatusWord (newest only, online only)
+//     device_status/<device>/last_heartbeat
+//     device_status/<device>/metrics  — SystemMetrics snapshot, with the heartbeat
+//     device_status/<device>/commands/<pushId>/... — CommandChannel acks; a
+//                                   pending ack skips the coalescing delay
+// - History keys are generated locally in Firebase push-ID format so entries
+//   still sort chronologically
+// - A failed batch is kept and retried with backoff; nothing is re-ordered.
+//   History nodes are rewritten idempotently; a batch that landed but was
+//   reported failed counts its rollups twice (increments are not). Replay
+//   resumes after the last committed batch across reboots (EventJournal)
+// - Offline: pending history/status is spilled to the EventJournal and
+//   replayed oldest-first (REPLAY_BATCH records per updateNode) once the
+//   link is back, ahead of any new events
+// - Every updateNode is reported to the CloudLink (handshake / reuse timing)
+
+struct HistoryItem {
+    char parcelId[32];
+    char event[32];
+    uint64_t epochMs;       // 0 = clock not set when it was queued
+};
+
+enum RollupCounter {
+    ROLLUP_DELIVERIES = 0,
+    ROLLUP_FAILED_VALIDATIONS,
+    ROLLUP_BREACHES,
+    ROLLUP_SCANS,
+    ROLLUP_COUNTER_COUNT
+};
+
+// Bit n = compartment n+1 (LOCKER_CONFIG.h)
+struct LockStatus {
+    uint8_t locksOpen;
+    uint8_t doorsOpen;
+};
+
+class CloudWriter {
+public:
+    CloudWriter();
+
+    // Create the queue and precompute every path for this device.
+    // compartments: how many lock/door pairs LockStatus carries.
+    void begin(const char* deviceId, uint8_t compartments);
+
+    // Optional offline journal used for spill and replay
+    void setJournal(EventJournal* journal);
+
+    // Optional metrics published with each heartbeat
+    void setMetrics(SystemMetrics* metrics);
+
+    // Optional connection statistics for every updateNode
+    void setLink(CloudLink* link);
+
+    // Optional remote command acks
+    void setCommands(CommandChannel* commands);
+
+    // Cloud task: link is back — drop the outage backoff so pending work
+    // (journal replay first) goes out on the next flush
+    void linkRestored();
+
+    // Cloud task: move everything pending into the journal (link lost)
+    void spillToJournal();
+
+    // Any task: queue a history event. Returns false if the queue is full.
+    bool queueHistory(const char* parcelId, const char* event);
+
+    // Any task: record the latest lock/door state. Repeated calls collapse
+    // into a single write of the newest value; unchanged state is not sent.
+    void setLockStatus(const LockStatus& status);
+
+    // Any task: live status word for the next flush. Not journaled: while
+    // offline it is simply superseded by the next one.
+    void setLiveStatus(const StatusWord& word);
+
+    // Any task: heartbeat value sent with the next flush
+    void setHeartbeat(uint32_t uptimeMs);
+
+    // Cloud task only: send one batch if there is work and it is due.
+    // Returns true if a write was attempted and succeeded.
+    bool flush(FirebaseData* fbdo);
+
+    bool hasPending();
+    void printStats();
+
+    // Cloud task: push ID in Firebase client format (also keys snapshots)
+    static void generatePushId(char out[21]);
+
+    static const size_t QUEUE_LEN = 32;       // History events waiting for a batch
+    static const size_t MAX_BATCH = 16;       // History events per updateNode
+    static const unsigned long COALESCE_MS = 50;   // Let a scan's events gather
+    static const unsigned long RETRY_MIN_MS = 1000;
+    static const unsigned long RETRY_MAX_MS = 30000;
+    static const size_t REPLAY_BATCH = 32;          // Journal records per updateNode
+    static const uint8_t SPILL_AFTER_FAILURES = 3;  // Consecutive failures before spilling
+    static const size_t ROLLUP_DAYS = REPLAY_BATCH;  // One day per record at worst: none dropped
+
+private:
+    QueueHandle_t historyQueue;
+    FixedString<64> historyRoot;        // "history/<device>/"
+    FixedString<64> rollupRoot;         // "history_rollup/<device>/"
+    FixedString<64> locksStatusPath;    // "locks_status/<device>"
+    FixedString<80> heartbeatPath;      // "device_status/<device>/last_heartbeat"
+    FixedString<80> metricsPath;        // "device_status/<device>/metrics"
+    FixedString<80> livePath;           // "device_status/<device>/live"
+    uint8_t compartmentCount;
+    EventJournal* journal;
+    SystemMetrics* metrics;
+    CloudLink* link;
+    CommandChannel* commands;
+
+    // Batch being built / retried (owned by the cloud task)
+    HistoryItem batch[MAX_BATCH];
+    char batchKeys[MAX_BATCH][21];
+    size_t batchCount;
+
+    // Journal records being replayed (owned by the cloud task)
+    JournalRecord replayBuf[REPLAY_BATCH];
+
+    // Coalesced state (shared, guarded by mux)
+    portMUX_TYPE mux;
+    LockStatus latestStatus;
+    LockStatus sentStatus;
+    bool statusPending;
+    bool statusEverSent;
+    uint32_t heartbeatMs;
+    bool heartbeatPending;
+    StatusWord liveWord;
+    uint8_t liveSeq;                    // Bumped by every setLiveStatus()
+    bool livePending;
+
+    unsigned long firstPendingAt;
+    unsigned long retryAt;
+    unsigned long retryDelay;
+    uint8_t consecutiveFailures;
+
+    // Statistics
+    uint32_t batchesSent;
+    uint32_t eventsSent;
+    uint32_t statusCoalesced;
+    uint32_t writeFailures;
+    uint32_t queueDrops;
+    uint32_t eventsSpilled;
+    uint32_t eventsReplayed;
+    uint32_t liveSent;
+    uint32_t rollupWrites;
+
+    // Rollup increments for the history entries of one update
+    struct RollupDay {
+        char day[11];
+        uint16_t counts[ROLLUP_COUNTER_COUNT];
+    };
+    struct Rollups {
+        RollupDay days[ROLLUP_DAYS];
+        uint8_t dayCount;
+    };
+
+    Rollups rollups;                    // Of the update being built (cloud task)
+
+    void fillBatch();
+    void addHistory(FirebaseJson& update, Rollups& rollups, const char* key, const char* parcelId,
+                    const char* event, uint64_t epochMs, bool replayed);
+    uint8_t addRollups(FirebaseJson& update, const Rollups& rollups);
+    bool replayJournal(FirebaseData* fbdo);
+    void writeFailed(FirebaseData* fbdo);
+    bool send(FirebaseData* fbdo, FirebaseJson& update);
+    void addLockStatus(FirebaseJson& update, const LockStatus& status, uint8_t changed,
+                       const uint64_t* epochMs);
+    uint8_t allCompartments() const { return (uint8_t)((1u << compartmentCount) - 1); }
+    static void replayKey(const JournalRecord& rec, uint64_t ms, char out[21]);
+    static uint64_t nowEpochMs();
+    static bool syncedEpochMs(uint64_t* out);
+    static void dayKey(uint64_t epochMs, char out[11]);
+};
+
+#endif // CLOUD_WRITER_H
@@ -0,0 +1,391 @@
+#include "CommandChannel.h"
+#include "LogRing.h"
+#include <esp_timer.h>
+#include <sys/time.h>
+
+// ============================================================================
+// COMMAND CHANNEL IMPLEMENTATION
+// ============================================================================
+
+static const char* TYPE_NAMES[COMMAND_TYPE_COUNT] = { "unlock", "lock", "emergency" };
+
+CommandChannel::CommandChannel()
+    : lockCount(0), sink(nullptr), mux(portMUX_INITIALIZER_UNLOCKED), recentNext(0),
+      received(0), executedCount(0), duplicates(0), alreadyAcked(0), expired(0), unverified(0), rejected(0),
+      busy(0), acksWritten(0) {
+    memset(slots, 0, sizeof(slots));
+    memset(recent, 0, sizeof(recent));
+    memset(sampleCount, 0, sizeof(sampleCount));
+    memset(sampleNext, 0, sizeof(sampleNext));
+}
+
+void CommandChannel::begin(const char* commandsPath, uint8_t locks, CommandSink s) {
+    // Ack keys go into a multi-path update at the root: no leading '/'
+    root.printf("%s/", commandsPath[0] == '/' ? commandsPath + 1 : commandsPath);
+    lockCount = locks;
+    sink = s;
+}
+
+bool CommandChannel::parseType(const char* s, CommandType& out) {
+    for (uint8_t t = 0; t < COMMAND_TYPE_COUNT; t++) {
+        if (strcmp(s, TYPE_NAMES[t]) == 0) {
+            out = (CommandType)t;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t CommandChannel::nowEpochMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000) return 0;     // NTP not synced yet
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// ============================================================================
+// STREAM (Firebase stream callback)
+// ============================================================================
+void CommandChannel::onStream(FirebaseStream& data) {
+    int64_t nowUs = esp_timer_get_time();
+    FixedString<96> path = data.dataPath().c_str();
+    FixedString<12> type = data.dataType().c_str();
+    if (type != "json") return;     // Deletions and single-field echoes
+
+    // Root event: every queued command (first "put") or a set of them ("patch")
+    if (path == "/") {
+        FirebaseJson* json = data.jsonObjectPtr();
+        size_t count = json->iteratorBegin();
+        int topDepth = -1;
+        for (size_t i = 0; i < count; i++) {
+            FirebaseJson::IteratorValue node = json->valueAt(i);
+            if (topDepth < 0) topDepth = node.depth;
+            if (node.depth != topDepth || node.type != FirebaseJson::JSON_OBJECT) continue;
+            FirebaseJson child;
+            child.setJsonData(node.value);
+            handle(node.key.c_str(), &child, nowUs);
+        }
+        json->iteratorEnd();
+        return;
+    }
+
+    // "/<pushId>" put = a new command; a patch there is our own ack coming back
+    if (strchr(path.c_str() + 1, '/') || data.eventType() != "put") return;
+    handle(path.c_str() + 1, data.jsonObjectPtr(), nowUs);
+}
+
+void CommandChannel::handle(const char* id, FirebaseJson* json, int64_t nowUs) {
+    if (!json || strlen(id) >= COMMAND_ID_LEN) return;
+
+    FirebaseJsonData field;
+    if (json->get(field, "status")) {
+        alreadyAcked++;
+        return;
+    }
+    if (seen(id)) {
+        duplicates++;
+        return;
+    }
+    received++;
+
+    uint64_t issuedMs = 0;
+    if (json->get(field, "issued_at")) issuedMs = strtoull(field.stringValue.c_str(), nullptr, 10);
+
+    int8_t slot = claimSlot(id, nowUs, issuedMs);
+    if (slot < 0) {
+        // Not remembered as seen: the next reconnect's "put" offers it again
+        busy++;
+        LOG_W("CMD", "No free slot for %s", id);
+        return;
+    }
+
+    CommandType cmd = COMMAND_UNLOCK;
+    FixedString<16> typeName;
+    if (json->get(field, "type")) typeName = field.stringValue.c_str();
+    int lock = json->get(field, "lock") ? field.intValue : 0;
+    if (!parseType(typeName.c_str(), cmd) ||
+        (cmd != COMMAND_EMERGENCY && (lock < 1 || lock > lockCount))) {
+        rejected++;
+        LOG_W("CMD", "Rejected %s: type '%s', lock %d", id, typeName.c_str(), lock);
+        ackNow(slot, "rejected");
+        return;
+    }
+
+    uint64_t now = nowEpochMs();
+    if (issuedMs && now && now > issuedMs + COMMAND_MAX_AGE_MS) {
+        expired++;
+        LOG_W("CMD", "Expired %s: issued %u s ago", id, (unsigned)((now - issuedMs) / 1000));
+        ackNow(slot, "expired");
+        return;
+    }
+    // An old unlock must not fire just because the clock isn't set after a reboot
+    if (cmd == COMMAND_UNLOCK && (!issuedMs || !now)) {
+        unverified++;
+        LOG_W("CMD", "Unlock %s refused: %s", id, issuedMs ? "clock not set" : "no issued_at");
+        ackNow(slot, "unverified");
+        return;
+    }
+
+    LOG_I("CMD", "%s %s lock %d accepted", id, TYPE_NAMES[cmd], lock);
+    portENTER_CRITICAL(&mux);
+    slots[slot].type = cmd;
+    slots[slot].lock = (uint8_t)lock;
+    slots[slot].status = "accepted";
+    slots[slot].state = SLOT_ACCEPT;
+    portEXIT_CRITICAL(&mux);
+}
+
+// Cloud task: "accepted" is in the database, so a replay skips it from here
+// on; the age is checked again in case the write waited out an outage
+void CommandChannel::dispatch(uint8_t slot) {
+    portENTER_CRITICAL(&mux);
+    Slot& s = slots[slot];
+    CommandType type = s.type;
+    uint8_t lock = s.lock;
+    uint64_t issuedMs = s.issuedMs;
+    s.state = SLOT_QUEUED;
+    portEXIT_CRITICAL(&mux);
+
+    uint64_t now = nowEpochMs();
+    if (issuedMs && now && now > issuedMs + COMMAND_MAX_AGE_MS) {
+        expired++;
+        ackNow(slot, "expired");
+        return;
+    }
+    if (!sink || !sink(slot, type, lock)) {
+        busy++;
+        ackNow(slot, "busy");
+    }
+}
+
+// Written only by claimSlot(), on this same stream task
+bool CommandChannel::seen(const char* id) {
+    for (uint8_t i = 0; i < COMMAND_RECENT; i++) {
+        if (strcmp(recent[i], id) == 0) return true;
+    }
+    return false;
+}
+
+int8_t CommandChannel::claimSlot(const char* id, int64_t nowUs, uint64_t issuedMs) {
+    int8_t found = -1;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++) {
+        if (slots[i].state != SLOT_FREE) continue;
+        Slot& s = slots[i];
+        strlcpy(s.id, id, sizeof(s.id));
+        s.state = SLOT_QUEUED;
+        s.status = nullptr;
+        s.receivedUs = nowUs;
+        s.executedUs = 0;
+        s.issuedMs = issuedMs;
+        s.executedMs = 0;
+        strlcpy(recent[recentNext], id, COMMAND_ID_LEN);
+        recentNext = (recentNext + 1) % COMMAND_RECENT;
+        found = (int8_t)i;
+        break;
+    }
+    portEXIT_CRITICAL(&mux);
+    return found;
+}
+
+void CommandChannel::ackNow(int8_t slot, const char* status) {
+    portENTER_CRITICAL(&mux);
+    slots[slot].status = status;
+    slots[slot].state = SLOT_ACK;
+    portEXIT_CRITICAL(&mux);
+}
+
+// ============================================================================
+// EXECUTION (control task)
+// ============================================================================
+void CommandChannel::executed(uint8_t slot, bool ok) {
+    if (slot >= COMMAND_SLOTS) return;
+    int64_t nowUs = esp_timer_get_time();
+    uint64_t nowMs = nowEpochMs();
+
+    portENTER_CRITICAL(&mux);
+    Slot& s = slots[slot];
+    bool valid = s.state == SLOT_QUEUED;
+    if (valid) {
+        s.executedUs = nowUs;
+        s.executedMs = nowMs;
+        s.status = ok ? "done" : "rejected";
+        s.state = SLOT_ACK;
+    }
+    int64_t execUs = nowUs - s.receivedUs;
+    uint64_t issuedMs = s.issuedMs;
+    portEXIT_CRITICAL(&mux);
+    if (!valid) return;
+
+    executedCount++;
+    record(INTERVAL_EXEC, (uint64_t)execUs);
+    if (issuedMs && nowMs >= issuedMs) record(INTERVAL_E2E, nowMs - issuedMs);
+}
+
+// ============================================================================
+// ACKS (cloud task, via CloudWriter)
+// ============================================================================
+bool CommandChannel::hasAcks() {
+    bool pending = false;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < COMMAND_SLOTS && !pending; i++) {
+        SlotState st = slots[i].state;
+        pending = st == SLOT_ACCEPT || st == SLOT_ACCEPT_SENDING || st == SLOT_ACK || st == SLOT_SENDING;
+    }
+    portEXIT_CRITICAL(&mux);
+    return pending;
+}
+
+uint8_t CommandChannel::addAcksTo(FirebaseJson& update) {
+    Slot copy[COMMAND_SLOTS];
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++) {
+        // SENDING again: the batch that last carried it failed
+        if (slots[i].state == SLOT_ACK) slots[i].state = SLOT_SENDING;
+        if (slots[i].state == SLOT_ACCEPT) slots[i].state = SLOT_ACCEPT_SENDING;
+        copy[i] = slots[i];
+    }
+    portEXIT_CRITICAL(&mux);
+
+    uint8_t n = 0;
+    FixedString<128> key;
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++) {
+        const Slot& s = copy[i];
+        if (s.state == SLOT_ACCEPT_SENDING) {
+            key.printf("%s%s/status", root.c_str(), s.id);
+            update.add(key.c_str(), s.status);
+            n++;
+            continue;
+        }
+        if (s.state != SLOT_SENDING) continue;
+        key.printf("%s%s/status", root.c_str(), s.id);
+        update.add(key.c_str(), s.status);
+        if (s.executedUs) {
+            if (s.executedMs) {
+                key.printf("%s%s/executed_at", root.c_str(), s.id);
+                update.add(key.c_str(), (double)s.executedMs);
+            }
+            key.printf("%s%s/exec_us", root.c_str(), s.id);
+            update.add(key.c_str(), (int)(s.executedUs - s.receivedUs));
+        }
+        key.printf("%s%s/acked_at/.sv", root.c_str(), s.id);
+        update.add(key.c_str(), "timestamp");
+        n++;
+    }
+    return n;
+}
+
+void CommandChannel::acksSent() {
+    int64_t nowUs = esp_timer_get_time();
+    int64_t ackUs[COMMAND_SLOTS];
+    uint8_t accepted[COMMAND_SLOTS];
+    uint8_t n = 0;
+    uint8_t acceptedCount = 0;
+    uint8_t written = 0;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++) {
+        Slot& s = slots[i];
+        if (s.state == SLOT_ACCEPT_SENDING) accepted[acceptedCount++] = i;
+        if (s.state != SLOT_SENDING) continue;
+        if (s.executedUs) ackUs[n++] = nowUs - s.executedUs;
+        s.state = SLOT_FREE;
+        written++;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    acksWritten += written;
+    for (uint8_t i = 0; i < n; i++) record(INTERVAL_ACK, (uint64_t)(ackUs[i] / 1000));
+    for (uint8_t i = 0; i < acceptedCount; i++) dispatch(accepted[i]);
+}
+
+// ============================================================================
+// LATENCY WINDOWS
+// ============================================================================
+const char* CommandChannel::intervalName(int interval) {
+    switch (interval) {
+        case INTERVAL_EXEC: return "exec_us";
+        case INTERVAL_E2E:  return "e2e_ms";
+        case INTERVAL_ACK:  return "ack_ms";
+        default:            return "?";
+    }
+}
+
+void CommandChannel::record(int interval, uint64_t value) {
+    uint32_t v = value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+    portENTER_CRITICAL(&mux);
+    samples[interval][sampleNext[interval]] = v;
+    sampleNext[interval] = (sampleNext[interval] + 1) % WINDOW;
+    if (sampleCount[interval] < WINDOW) sampleCount[interval]++;
+    portEXIT_CRITICAL(&mux);
+}
+
+// Nearest-rank percentiles over a sorted copy of the window
+void CommandChannel::percentiles(int interval, Percentiles& out) {
+    uint32_t sorted[WINDOW];
+    portENTER_CRITICAL(&mux);
+    uint16_t n = sampleCount[interval];
+    memcpy(sorted, samples[interval], n * sizeof(uint32_t));
+    portEXIT_CRITICAL(&mux);
+
+    for (uint16_t i = 1; i < n; i++) {
+        uint32_t v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v) { sorted[j + 1] = sorted[j]; j--; }
+        sorted[j + 1] = v;
+    }
+
+    out.n = n;
+    if (n == 0) {
+        out.p50 = out.p90 = out.p99 = out.max = 0;
+        return;
+    }
+    out.p50 = sorted[(n * 50 + 99) / 100 - 1];
+    out.p90 = sorted[(n * 90 + 99) / 100 - 1];
+    out.p99 = sorted[(n * 99 + 99) / 100 - 1];
+    out.max = sorted[n - 1];
+}
+
+void CommandChannel::addTo(FirebaseJson& json, const char* prefix) {
+    char key[64];
+    snprintf(key, sizeof(key), "%s/executed", prefix);
+    json.set(key, (int)executedCount);
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        Percentiles p;
+        percentiles(i, p);
+        if (p.n == 0) continue;
+        snprintf(key, sizeof(key), "%s/%s/n", prefix, intervalName(i));
+        json.set(key, (int)p.n);
+        snprintf(key, sizeof(key), "%s/%s/p50", prefix, intervalName(i));
+        json.set(key, (int)p.p50);
+        snprintf(key, sizeof(key), "%s/%s/p90", prefix, intervalName(i));
+        json.set(key, (int)p.p90);
+        snprintf(key, sizeof(key), "%s/%s/p99", prefix, intervalName(i));
+        json.set(key, (int)p.p99);
+    }
+}
+
+void CommandChannel::print() {
+    Serial.printf("Command latency (last %d commands):\n", WINDOW);
+    Serial.println(F("Interval        n      p50      p90      p99      max"));
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        Percentiles p;
+        percentiles(i, p);
+        Serial.printf("%-10s %5u %8u %8u %8u %8u\n", intervalName(i), (unsigned)p.n,
+                      (unsigned)p.p50, (unsigned)p.p90, (unsigned)p.p99, (unsigned)p.max);
+    }
+}
+
+void CommandChannel::printStats() {
+    uint8_t inFlight = 0;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++) {
+        if (slots[i].state != SLOT_FREE) inFlight++;
+    }
+    portEXIT_CRITICAL(&mux);
+    Serial.printf("[CMD] %u received, %u executed, %u acks written, %u in flight\n",
+                  (unsigned)received, (unsigned)executedCount, (unsigned)acksWritten,
+                  (unsigned)inFlight);
+    Serial.printf("[CMD] skipped: %u already acked, %u duplicate; %u expired, %u unverified, %u rejected, %u busy\n",
+                  (unsigned)alreadyAcked, (unsigned)duplicates, (unsigned)expired,
+                  (unsigned)unverified, (unsigned)rejected, (unsigned)busy);
+}
@@ -0,0 +1,151 @@
+#ifndef COMMAND_CHANNEL_H
+#define COMMAND_CHANNEL_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include "FixedString.h"
+
+// ============================================================================
+// COMMAND CHANNEL - Smart Parcel Locker
+// ============================================================================
+// Remote commands queued by the app under /device_status/<id>/commands:
+//   <pushId>: { id, type: "unlock" | "lock" | "emergency", lock, issued_at }
+// - onStream() takes the command stream's events: the first "put" carries
+//   every queued command, later ones a single new child. Each command runs
+//   at most once:
+//     * a command that already has a status (even "accepted") was handled
+//       before (reboot, stream reconnect) and is skipped
+//     * the last COMMAND_RECENT accepted IDs are remembered, so a replay
+//       that arrives before its status is written is skipped too
+//     * one issued more than COMMAND_MAX_AGE_MS ago (NTP time) is acked
+//       "expired" and not run; an unlock whose age can't be checked (no
+//       issued_at, or the clock not set yet) is acked "unverified"
+//     * "accepted" is written first (CloudWriter's next batch, ahead of the
+//       coalescing delay); only once it is confirmed does the command go to
+//       the sink (the control queue). A reboot in between leaves it
+//       "accepted" and not run, never run twice.
+// - The control task calls executed() right after switching the relay;
+//   CloudWriter writes the final ack in its next batch:
+//     commands/<pushId>/status        "accepted", then "done" | "rejected" |
+//                                     "expired" | "unverified" | "busy"
+//     commands/<pushId>/executed_at   device epoch ms (NTP)
+//     commands/<pushId>/exec_us       stream event → relay, device clock
+//     commands/<pushId>/acked_at      server timestamp of the ack write
+// - Latency windows (last WINDOW commands) for the heartbeat metrics:
+//     exec    stream event → relay switched (us, includes the "accepted" write)
+//     e2e     issued_at (server) → executed_at (ms, includes NTP skew)
+//     ack     relay switched → ack write confirmed (ms)
+//
+// The app deletes a command once it has seen the ack.
+
+#define COMMAND_SLOTS           8       // Commands between stream event and ack
+#define COMMAND_RECENT          16      // Accepted IDs remembered for dedupe
+#define COMMAND_ID_LEN          21      // Push ID + NUL
+#define COMMAND_MAX_AGE_MS      60000   // Older ones are not executed
+
+enum CommandType : uint8_t {
+    COMMAND_UNLOCK = 0,
+    COMMAND_LOCK,
+    COMMAND_EMERGENCY,
+    COMMAND_TYPE_COUNT
+};
+
+// Cloud task, once "accepted" is written: run the command in slot `slot`
+// (control task); false = could not be queued
+typedef bool (*CommandSink)(uint8_t slot, CommandType type, uint8_t lock);
+
+class CommandChannel {
+public:
+    CommandChannel();
+
+    // commandsPath: "/device_status/<id>/commands"; locks: valid 1..locks
+    void begin(const char* commandsPath, uint8_t locks, CommandSink sink);
+
+    // Stream callback: parse one event
+    void onStream(FirebaseStream& data);
+
+    // Control task: the command in `slot` has been carried out (or refused)
+    void executed(uint8_t slot, bool ok);
+
+    // Cloud task (CloudWriter::flush): acks waiting for a write
+    bool hasAcks();
+    // Add every pending ack to a root multi-path update; returns how many
+    uint8_t addAcksTo(FirebaseJson& update);
+    // The update carrying them was written
+    void acksSent();
+
+    void print();
+    void printStats();
+
+    // Cloud task: latency windows under `prefix` of the metrics node
+    void addTo(FirebaseJson& json, const char* prefix);
+
+    static const int WINDOW = 32;
+
+private:
+    enum SlotState : uint8_t {
+        SLOT_FREE = 0,
+        SLOT_ACCEPT,                // "accepted" to write
+        SLOT_ACCEPT_SENDING,        // In a batch; the sink gets it once written
+        SLOT_QUEUED,                // With the control task
+        SLOT_ACK,                   // Final status to write
+        SLOT_SENDING
+    };
+
+    struct Slot {
+        char id[COMMAND_ID_LEN];
+        SlotState state;
+        CommandType type;
+        uint8_t lock;
+        const char* status;
+        int64_t receivedUs;
+        int64_t executedUs;
+        uint64_t issuedMs;          // Server epoch ms; 0 = not given
+        uint64_t executedMs;        // Device epoch ms; 0 = clock not set
+    };
+
+    enum Interval { INTERVAL_EXEC = 0, INTERVAL_E2E, INTERVAL_ACK, INTERVAL_COUNT };
+
+    struct Percentiles {
+        uint16_t n;
+        uint32_t p50, p90, p99, max;
+    };
+
+    FixedString<80> root;           // "device_status/<id>/commands/" (no leading '/')
+    uint8_t lockCount;
+    CommandSink sink;
+
+    // Shared by the stream, control and cloud tasks (guarded by mux)
+    portMUX_TYPE mux;
+    Slot slots[COMMAND_SLOTS];
+    char recent[COMMAND_RECENT][COMMAND_ID_LEN];
+    uint8_t recentNext;
+
+    uint32_t samples[INTERVAL_COUNT][WINDOW];
+    uint16_t sampleCount[INTERVAL_COUNT];
+    uint16_t sampleNext[INTERVAL_COUNT];
+
+    // Statistics
+    uint32_t received;
+    uint32_t executedCount;
+    uint32_t duplicates;
+    uint32_t alreadyAcked;
+    uint32_t expired;
+    uint32_t unverified;
+    uint32_t rejected;
+    uint32_t busy;
+    uint32_t acksWritten;
+
+    void handle(const char* id, FirebaseJson* json, int64_t nowUs);
+    bool seen(const char* id);
+    int8_t claimSlot(const char* id, int64_t nowUs, uint64_t issuedMs);
+    void ackNow(int8_t slot, const char* status);
+    void dispatch(uint8_t slot);
+    void record(int interval, uint64_t value);
+    void percentiles(int interval, Percentiles& out);
+    static bool parseType(const char* s, CommandType& out);
+    static uint64_t nowEpochMs();
+    static const char* intervalName(int interval);
+};
+
+#endif // COMMAND_CHANNEL_H
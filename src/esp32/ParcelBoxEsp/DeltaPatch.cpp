@@ -0,0 +1,163 @@
+#include "DeltaPatch.h"
+#include <string.h>
+
+// ============================================================================
+// DELTA PATCH IMPLEMENTATION
+// ============================================================================
+
+DeltaPatch::DeltaPatch()
+    : io(nullptr), state(STATE_HEADER), result(DELTA_OK), headerFill(0), varint(0),
+      varintShift(0), op(DELTA_OP_LITERAL), length(0), oldPos(0), outPos(0), outCrc(0) {
+    memset(&hdr, 0, sizeof(hdr));
+    memset(headerBuf, 0, sizeof(headerBuf));
+}
+
+void DeltaPatch::begin(DeltaIo* target) {
+    io = target;
+    state = STATE_HEADER;
+    result = DELTA_OK;
+    memset(&hdr, 0, sizeof(hdr));
+    headerFill = 0;
+    varint = 0;
+    varintShift = 0;
+    length = 0;
+    oldPos = 0;
+    outPos = 0;
+    outCrc = 0;
+}
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaResult DeltaPatch::feed(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        switch (state) {
+            case STATE_HEADER: {
+                size_t n = DELTA_HEADER_BYTES - headerFill;
+                if (n > len - i) n = len - i;
+                memcpy(headerBuf + headerFill, data + i, n);
+                headerFill += n;
+                i += n;
+                if (headerFill < DELTA_HEADER_BYTES) break;
+                hdr.magic = readU32(headerBuf);
+                hdr.oldSize = readU32(headerBuf + 4);
+                hdr.oldCrc = readU32(headerBuf + 8);
+                hdr.newSize = readU32(headerBuf + 12);
+                hdr.newCrc = readU32(headerBuf + 16);
+                if (hdr.magic != DELTA_MAGIC || hdr.newSize == 0) return fail(DELTA_BAD_HEADER);
+                state = STATE_OP;
+                break;
+            }
+            case STATE_OP:
+                if (!takeVarint(data[i++])) break;
+                if (varint >> 34) return fail(DELTA_BAD_OP);
+                op = (DeltaOp)(varint & 3);
+                length = (uint32_t)(varint >> 2);
+                varint = 0;
+                varintShift = 0;
+                if (op > DELTA_OP_COPY_NEW || length == 0) return fail(DELTA_BAD_OP);
+                if (length > hdr.newSize - outPos) return fail(DELTA_TOO_LONG);
+                state = op == DELTA_OP_LITERAL ? STATE_LITERAL : STATE_ARG;
+                break;
+            case STATE_ARG: {
+                if (!takeVarint(data[i++])) break;
+                uint64_t v = varint;
+                varint = 0;
+                varintShift = 0;
+                uint32_t start;
+                if (op == DELTA_OP_COPY_OLD) {
+                    int64_t rel = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);    // Zigzag
+                    int64_t s = (int64_t)oldPos + rel;
+                    if (s < 0 || s + length > hdr.oldSize) return fail(DELTA_BAD_OP);
+                    start = (uint32_t)s;
+                    oldPos = start + length;
+                } else {
+                    if (v == 0 || v > outPos) return fail(DELTA_BAD_OP);
+                    start = outPos - (uint32_t)v;
+                }
+                DeltaResult r = copy(op == DELTA_OP_COPY_OLD, start);
+                if (r != DELTA_OK) return fail(r);
+                state = STATE_OP;
+                break;
+            }
+            case STATE_LITERAL: {
+                size_t n = length;
+                if (n > len - i) n = len - i;
+                DeltaResult r = emit(data + i, n);
+                if (r != DELTA_OK) return fail(r);
+                i += n;
+                length -= n;
+                if (length == 0) state = STATE_OP;
+                break;
+            }
+            case STATE_FAILED:
+                return result;
+        }
+    }
+    return result;
+}
+
+DeltaResult DeltaPatch::finish() {
+    if (state == STATE_FAILED) return result;
+    if (state != STATE_OP || varintShift || outPos != hdr.newSize) return fail(DELTA_SHORT);
+    if (outCrc != hdr.newCrc) return fail(DELTA_CRC);
+    return DELTA_OK;
+}
+
+// LEB128, 7 bits per byte; true once the last byte is in
+bool DeltaPatch::takeVarint(uint8_t byte) {
+    if (varintShift < 64) varint |= (uint64_t)(byte & 0x7F) << varintShift;
+    varintShift += 7;
+    return !(byte & 0x80);
+}
+
+// COPY_NEW may overlap what it writes (distance < length repeats a run),
+// so it goes through scratch at most `distance` bytes at a time
+DeltaResult DeltaPatch::copy(bool fromOld, uint32_t start) {
+    while (length) {
+        size_t n = length < DELTA_SCRATCH_BYTES ? length : DELTA_SCRATCH_BYTES;
+        if (!fromOld && n > outPos - start) n = outPos - start;
+        bool ok = fromOld ? io->readOld(start, scratch, n) : io->readNew(start, scratch, n);
+        if (!ok) return DELTA_IO;
+        DeltaResult r = emit(scratch, n);
+        if (r != DELTA_OK) return r;
+        start += n;
+        length -= n;
+    }
+    return DELTA_OK;
+}
+
+DeltaResult DeltaPatch::emit(const uint8_t* data, size_t len) {
+    if (!io->write(data, len)) return DELTA_IO;
+    outCrc = crc32(outCrc, data, len);
+    outPos += len;
+    return DELTA_OK;
+}
+
+DeltaResult DeltaPatch::fail(DeltaResult r) {
+    state = STATE_FAILED;
+    result = r;
+    return r;
+}
+
+// Nibble table: 64 bytes, two steps per byte instead of eight
+uint32_t DeltaPatch::crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static const uint32_t TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ TABLE[crc & 15];
+        crc = (crc >> 4) ^ TABLE[crc & 15];
+    }
+    return ~crc;
+}
+
+const char* DeltaPatch::resultName(DeltaResult r) {
+    static const char* const NAMES[] = { "ok", "bad header", "bad op", "too long", "io", "short", "crc" };
+    return r < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[r] : "?";
+}
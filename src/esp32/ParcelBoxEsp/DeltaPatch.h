@@ -0,0 +1,115 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+// DELTA PATCH - Smart Parcel Locker
+// ============================================================================
+// Streaming decoder for firmware deltas, free of flash and FreeRTOS so the
+// host build (src/esp32/host, delta_pack) makes and checks them with the
+// same code. A delta rebuilds the new image from three sources:
+//   COPY_OLD  bytes of the running image (the base)
+//   COPY_NEW  bytes already rebuilt, further back (LZ back-reference)
+//   LITERAL   bytes carried in the delta
+// Both copy sources are read back through DeltaIo (flash on the boards),
+// so decoding needs no dictionary window and no image buffer in RAM:
+// feed() takes the download as it arrives, any split, and writes the image
+// out in order. A delta with oldSize 0 is a compressed full image.
+//
+// Layout (little-endian):
+//   header   u32 magic "PBD1", oldSize, oldCrc, newSize, newCrc
+//   ops      varint (length << 2 | op), then
+//              COPY_OLD: zigzag varint, start - end of the previous COPY_OLD
+//              COPY_NEW: varint distance back from the write position
+//              LITERAL:  length bytes
+// CRCs are CRC-32 (IEEE). The base CRC tells a device its running image
+// is the one the delta was made against; the image itself is checked by
+// SHA-256 on the boards (OtaFlash).
+
+#define DELTA_MAGIC             0x31444250u     // "PBD1"
+#define DELTA_HEADER_BYTES      20
+#define DELTA_SCRATCH_BYTES     256             // Copy granularity
+
+enum DeltaOp : uint8_t {
+    DELTA_OP_LITERAL = 0,
+    DELTA_OP_COPY_OLD,
+    DELTA_OP_COPY_NEW
+};
+
+enum DeltaResult : uint8_t {
+    DELTA_OK = 0,
+    DELTA_BAD_HEADER,
+    DELTA_BAD_OP,           // Unknown op or a copy outside its source
+    DELTA_TOO_LONG,         // More output than newSize
+    DELTA_IO,               // DeltaIo read or write failed
+    DELTA_SHORT,            // finish(): stream or image incomplete
+    DELTA_CRC               // finish(): image CRC mismatch
+};
+
+struct DeltaHeader {
+    uint32_t magic;
+    uint32_t oldSize;
+    uint32_t oldCrc;
+    uint32_t newSize;
+    uint32_t newCrc;
+};
+
+// Where the image comes from and goes to
+struct DeltaIo {
+    virtual bool readOld(uint32_t offset, uint8_t* out, size_t len) = 0;
+    // Bytes already passed to write()
+    virtual bool readNew(uint32_t offset, uint8_t* out, size_t len) = 0;
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+    virtual ~DeltaIo() {}
+};
+
+class DeltaPatch {
+public:
+    DeltaPatch();
+
+    void begin(DeltaIo* io);
+
+    // Any split of the delta stream; the first call(s) carry the header.
+    // Stops at the first error and keeps returning it.
+    DeltaResult feed(const uint8_t* data, size_t len);
+
+    // Stream ended: whole image written and its CRC matches
+    DeltaResult finish();
+
+    bool haveHeader() const { return headerFill == DELTA_HEADER_BYTES; }
+    const DeltaHeader& header() const { return hdr; }
+    uint32_t written() const { return outPos; }
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
+    static const char* resultName(DeltaResult r);
+
+private:
+    enum State : uint8_t { STATE_HEADER = 0, STATE_OP, STATE_ARG, STATE_LITERAL, STATE_FAILED };
+
+    DeltaIo* io;
+    State state;
+    DeltaResult result;
+    DeltaHeader hdr;
+    uint8_t headerBuf[DELTA_HEADER_BYTES];
+    uint8_t headerFill;
+
+    // Varint being read (op word or argument)
+    uint64_t varint;
+    uint8_t varintShift;
+
+    DeltaOp op;
+    uint32_t length;            // Of the current op
+    uint32_t oldPos;            // End of the previous COPY_OLD
+    uint32_t outPos;
+    uint32_t outCrc;
+    uint8_t scratch[DELTA_SCRATCH_BYTES];
+
+    bool takeVarint(uint8_t byte);
+    DeltaResult copy(bool fromOld, uint32_t start);
+    DeltaResult emit(const uint8_t* data, size_t len);
+    DeltaResult fail(DeltaResult r);
+};
+
+#endif // DELTA_PATCH_H
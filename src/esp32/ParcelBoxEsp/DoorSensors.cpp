@@ -0,0 +1,140 @@
+#include "DoorSensors.h"
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+
+// ============================================================================
+// DOOR SENSOR ENGINE IMPLEMENTATION
+// ============================================================================
+
+DoorSensorEngine::DoorSensorEngine()
+    : doorCount(0), debounceUs(0), bounceCount(0), notifyTask(nullptr), mux(portMUX_INITIALIZER_UNLOCKED),
+      wakeArmed(false) {
+    memset(doors, 0, sizeof(doors));
+}
+
+void DoorSensorEngine::begin(const uint8_t* pins, uint8_t count, uint32_t debounceMs,
+                             TaskHandle_t task) {
+    doorCount = count > MAX_DOORS ? MAX_DOORS : count;
+    notifyTask = task;
+    setDebounceMs(debounceMs);
+
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < doorCount; i++) {
+        Door& d = doors[i];
+        d.engine = this;
+        d.number = i + 1;
+        d.pin = pins[i];
+        pinMode(d.pin, INPUT_PULLUP);
+        // Start from "closed" so a door already open at boot is reported by
+        // the first settle(), as the old polling loop did
+        d.open = false;
+        d.lastAcceptUs = now;
+        attachInterruptArg(d.pin, onEdge, &d, CHANGE);
+    }
+    Serial.printf("[DOOR] ISR engine ready, %u doors, debounce %u ms\n",
+                  (unsigned)doorCount, (unsigned)debounceMs);
+}
+
+void DoorSensorEngine::setDebounceMs(uint32_t ms) {
+    debounceUs = (int64_t)ms * 1000;
+}
+
+bool IRAM_ATTR DoorSensorEngine::readLevel(uint8_t pin) {
+    return gpio_ll_get_level(&GPIO, (gpio_num_t)pin) != 0;
+}
+
+bool DoorSensorEngine::isOpen(uint8_t door) const {
+    if (door < 1 || door > doorCount) return false;
+    return doors[door - 1].open;
+}
+
+// Caller holds mux
+void IRAM_ATTR DoorSensorEngine::accept(Door& d, bool level, int64_t nowUs) {
+    d.open = level;
+    d.lastAcceptUs = nowUs;
+    DoorEvent ev = { d.number, level, nowUs };
+    events.push(ev);
+}
+
+void IRAM_ATTR DoorSensorEngine::onEdge(void* arg) {
+    Door& d = *(Door*)arg;
+    DoorSensorEngine* self = d.engine;
+    int64_t now = esp_timer_get_time();
+    bool level = readLevel(d.pin);
+    bool accepted = false;
+
+    portENTER_CRITICAL_ISR(&self->mux);
+    if (self->wakeArmed) self->restoreEdges();  // Level wake-up fired: edges again
+    if (level != d.open) {
+        if (now - d.lastAcceptUs >= self->debounceUs) {
+            self->accept(d, level, now);
+            accepted = true;
+        } else {
+            self->bounceCount++;
+        }
+    }
+    portEXIT_CRITICAL_ISR(&self->mux);
+
+    if (accepted && self->notifyTask) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->notifyTask, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+}
+
+void DoorSensorEngine::settle() {
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < doorCount; i++) {
+        Door& d = doors[i];
+        bool level = readLevel(d.pin);
+        // Masking interrupts on this core keeps the ISR as the only other
+        // producer from interleaving, so the ring stays single-producer
+        portENTER_CRITICAL(&mux);
+        if (level != d.open && now - d.lastAcceptUs >= debounceUs) {
+            accept(d, level, now);
+        }
+        portEXIT_CRITICAL(&mux);
+    }
+}
+
+// ============================================================================
+// LIGHT-SLEEP WAKE
+// ============================================================================
+// The GPIO wake-up of light sleep is level-only and shares the pin's
+// interrupt type, so it cannot coexist with CHANGE: switch while armed.
+void DoorSensorEngine::armWake() {
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < doorCount; i++) {
+        const Door& d = doors[i];
+        gpio_ll_set_intr_type(&GPIO, d.pin, d.open ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+        gpio_ll_wakeup_enable(&GPIO, d.pin);
+    }
+    wakeArmed = doorCount > 0;
+    portEXIT_CRITICAL(&mux);
+}
+
+void DoorSensorEngine::disarmWake() {
+    portENTER_CRITICAL(&mux);
+    if (wakeArmed) restoreEdges();
+    portEXIT_CRITICAL(&mux);
+}
+
+// Caller holds mux
+void IRAM_ATTR DoorSensorEngine::restoreEdges() {
+    for (uint8_t i = 0; i < doorCount; i++) {
+        gpio_ll_wakeup_disable(&GPIO, doors[i].pin);
+        gpio_ll_set_intr_type(&GPIO, doors[i].pin, GPIO_INTR_ANYEDGE);
+    }
+    wakeArmed = false;
+}
+
+void DoorSensorEngine::printStats() {
+    Serial.print("Doors:");
+    for (uint8_t i = 0; i < doorCount; i++) {
+        Serial.printf(" D%u %s", (unsigned)doors[i].number, doors[i].open ? "OPEN" : "CLOSED");
+    }
+    Serial.printf(" | debounce %u ms | bounces %u | dropped %u | peak %u\n",
+                  (unsigned)getDebounceMs(), (unsigned)bounceCount,
+                  (unsigned)events.dropped(), (unsigned)events.peak());
+}
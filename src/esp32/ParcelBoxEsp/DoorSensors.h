@@ -0,0 +1,93 @@
+#ifndef DOOR_SENSORS_H
+#define DOOR_SENSORS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "SpscRing.h"
+
+// ============================================================================
+// DOOR SENSOR ENGINE - Smart Parcel Locker
+// ============================================================================
+// Interrupt-driven reed switch handling:
+// - GPIO ISR on both edges, timestamped with esp_timer (microseconds)
+// - Leading-edge software debounce: the first edge is reported at once,
+//   further edges inside the debounce window are treated as bounce
+// - settle() re-reads each pin after the window so a glitch that ended in
+//   the opposite state is still corrected
+// - Debounced open/close events go into a lock-free SPSC ring consumed by the
+//   door state machine; the ISR wakes the consumer task directly
+// - Light-sleep wake (PowerManager): armWake() turns each pin's interrupt
+//   into a level wake-up at the level opposite its debounced state; the
+//   first hit puts every pin back on both edges, so no change is missed
+//
+// Reed switch wiring: INPUT_PULLUP, HIGH = door open, LOW = door closed.
+
+struct DoorEvent {
+    uint8_t door;         // 1-based door number
+    bool open;
+    int64_t timestampUs;  // esp_timer_get_time() at the accepted edge
+};
+
+class DoorSensorEngine {
+public:
+    DoorSensorEngine();
+
+    // Configure pins (pins[0] is door 1), read initial state and attach ISRs.
+    // notifyTask receives a task notification on every accepted event.
+    void begin(const uint8_t* pins, uint8_t count, uint32_t debounceMs,
+               TaskHandle_t notifyTask);
+
+    // Change the debounce window at runtime
+    void setDebounceMs(uint32_t ms);
+    uint32_t getDebounceMs() const { return (uint32_t)(debounceUs / 1000); }
+
+    // Correct doors whose level changed without a trailing edge being
+    // accepted. Call from the consumer task at least once per debounce window.
+    void settle();
+
+    // Consumer side: next debounced event, false when none pending
+    bool nextEvent(DoorEvent& ev) { return events.pop(ev); }
+
+    // Idle profile: wake from light sleep on any change. Disarmed by the
+    // first change or by disarmWake().
+    void armWake();
+    void disarmWake();
+
+    // Debounced state (1-based door index)
+    bool isOpen(uint8_t door) const;
+
+    // Diagnostics
+    uint32_t getBounceCount() const { return bounceCount; }
+    uint32_t getDroppedCount() const { return events.dropped(); }
+    void printStats();
+
+    uint8_t count() const { return doorCount; }
+
+    static const uint8_t MAX_DOORS = 8;
+
+private:
+    struct Door {
+        DoorSensorEngine* engine;
+        uint8_t number;
+        uint8_t pin;
+        volatile bool open;             // Debounced state
+        volatile int64_t lastAcceptUs;  // Time of last accepted edge
+    };
+
+    Door doors[MAX_DOORS];
+    uint8_t doorCount;
+    SpscRing<DoorEvent, 32> events;
+    volatile int64_t debounceUs;
+    volatile uint32_t bounceCount;
+    TaskHandle_t notifyTask;
+    portMUX_TYPE mux;
+    volatile bool wakeArmed;
+
+    static void IRAM_ATTR onEdge(void* arg);
+    void IRAM_ATTR accept(Door& d, bool level, int64_t nowUs);
+    static bool IRAM_ATTR readLevel(uint8_t pin);
+    void IRAM_ATTR restoreEdges();
+};
+
+#endif // DOOR_SENSORS_H
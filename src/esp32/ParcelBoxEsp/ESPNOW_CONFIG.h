@@ -13,19 +13,231 @@ typedef struct __attribute__((packed)) {
   char qrData[32];        // QR payload (parcelId)
   uint32_t timestamp;     // Scan timestamp (millis)
   uint8_t camMac[6];      // ESP32-CAM MAC address
+  int64_t decodeUs;       // CAM esp_timer time the QR was decoded
+  int64_t txUs;           // CAM esp_timer time of this transmission
 } ESPNOW_QRPacket_t;
 
+// ============================================================================
+// ESP-NOW FRAMING (sequenced, end-to-end ACKed)
+// ============================================================================
+// Every frame starts with ESPNOW_Header_t. The CAM sends one QR frame at a
+// time and retransmits it until the Main ESP32 ACKs that sequence number.
+// MUST match EspNowCamera.h on the ESP32-CAM.
+#define ESPNOW_MAGIC            0xB7
+
+#define MSG_TYPE_QR_SCAN        0
+#define MSG_TYPE_LOCK_CMD       1
+#define MSG_TYPE_STATUS         2
+#define MSG_TYPE_CONFIG         3
+#define MSG_TYPE_ACK            4
+#define MSG_TYPE_TIME_SYNC      5
+#define MSG_TYPE_BENCH          6
+#define MSG_TYPE_SNAPSHOT       7
+#define MSG_TYPE_OTA            8
+
+// ACK status codes
+#define ESPNOW_ACK_ACCEPTED     0   // Handed to scan validation
+#define ESPNOW_ACK_DUPLICATE    1   // Retransmit of a seq already processed
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic;          // ESPNOW_MAGIC
+  uint8_t type;           // MSG_TYPE_*
+  uint16_t seq;           // Per-sender sequence number (ACK echoes it)
+  uint32_t session;       // Random per sender boot — resets duplicate tracking
+  uint8_t attempt;        // 0 = first transmission
+  uint8_t status;         // ACK only: ESPNOW_ACK_*
+} ESPNOW_Header_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  ESPNOW_QRPacket_t qr;
+} ESPNOW_QRFrame_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+} ESPNOW_AckFrame_t;
+
+// Clock alignment for scan tracing (NTP-style, Main ESP32 initiates):
+// request carries t1 (main TX); the CAM answers with t2 (CAM RX) and t3
+// (CAM TX); the main stamps t4 on arrival.
+//   offset (CAM - main) = ((t2 - t1) + (t3 - t4)) / 2
+//   rtt                 = (t4 - t1) - (t3 - t2)
+#define ESPNOW_SYNC_REQUEST     0   // hdr.status
+#define ESPNOW_SYNC_RESPONSE    1
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;    // seq matches request to response
+  int64_t t1;
+  int64_t t2;
+  int64_t t3;
+} ESPNOW_TimeSyncFrame_t;
+
+// Channel discovery (MSG_TYPE_CONFIG). The main board's channel follows its
+// AP. A CAM that stops hearing it probes channel by channel; the main board
+// answers each probe on the channel it is on. It also announces its channel
+// once associated at boot, for a CAM scanning meanwhile; after an AP channel
+// change it cannot (the radio has already moved), so probing is the recovery.
+#define ESPNOW_CONFIG_PROBE     0   // hdr.status: CAM → main
+#define ESPNOW_CONFIG_CHANNEL   1   // hdr.status: main → CAM
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t channel;        // Main board's primary channel (0 in probes)
+} ESPNOW_ChannelFrame_t;
+
+// CAM health snapshot, sent unacknowledged (MSG_TYPE_STATUS) every 30 s.
+// The Main ESP32 publishes the newest one with its own metrics. Fields are
+// only appended; one missing from an older CAM's frame reads as 0.
+#define ESPNOW_METRICS_HIST_BUCKETS 5   // Loop pass time: <100us, <1ms, <10ms, <100ms, more
+
+typedef struct __attribute__((packed)) {
+  uint32_t uptimeS;
+  uint32_t heapFree;       // Internal heap, bytes
+  uint32_t heapMinFree;    // Lowest free heap since boot
+  uint32_t heapLargest;    // Largest allocatable block
+  uint32_t psramFree;      // 0 without PSRAM
+  uint32_t psramLargest;
+  uint16_t loopStackFree;  // Stack high-water marks, bytes
+  uint16_t qrStackFree;
+  uint32_t loopMaxUs;      // Longest loop pass since boot
+  uint32_t loopHist[ESPNOW_METRICS_HIST_BUCKETS];
+  uint16_t pipelineStackFree;  // QR capture/decode task (quirc)
+  uint16_t snapshotStackFree;  // On-demand tasks: lowest of the runs that
+  uint16_t otaStackFree;       // ended, 0 = none since boot
+} ESPNOW_BoardMetrics_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  ESPNOW_BoardMetrics_t metrics;
+} ESPNOW_StatusFrame_t;
+
+// Link bench (MSG_TYPE_BENCH), driven from the main board console. A run
+// opens with START/READY and closes with END/REPORT (both retried); in
+// between come the data frames, padded to the run's size. hdr.session is
+// the run id, hdr.seq the data frame number.
+#define ESPNOW_BENCH_START      0   // hdr.status: main → CAM, run parameters
+#define ESPNOW_BENCH_READY      1   // CAM → main
+#define ESPNOW_BENCH_PING       2   // main → CAM, echoed at once as PONG
+#define ESPNOW_BENCH_PONG       3
+#define ESPNOW_BENCH_FLOOD      4   // Either way, unanswered
+#define ESPNOW_BENCH_END        5   // main → CAM
+#define ESPNOW_BENCH_REPORT     6   // CAM → main: its side of the run
+
+#define ESPNOW_BENCH_MODE_PING      0   // Stop-and-wait round trips
+#define ESPNOW_BENCH_MODE_FLOOD_TX  1   // main → CAM, back to back
+#define ESPNOW_BENCH_MODE_FLOOD_RX  2   // CAM → main, back to back
+
+#define ESPNOW_BENCH_MAX_LEN    250 // ESP_NOW_MAX_DATA_LEN
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t mode;           // START: ESPNOW_BENCH_MODE_*
+  uint8_t size;           // START: data frame length, bytes
+  uint16_t count;         // START: data frames; REPORT: FLOOD frames received (TX) / sent (RX)
+  uint32_t spanUs;        // PONG: CAM turnaround; REPORT: first → last FLOOD arrival
+  int64_t txUs;           // PING: main send time, echoed in the PONG
+  int8_t rssi;            // PONG: dBm the PING arrived at; REPORT: mean of the FLOOD
+  int8_t rssiMin;         // REPORT
+  uint8_t channel;        // READY / REPORT: the CAM's channel
+} ESPNOW_BenchFrame_t;
+
+// Breach snapshot (MSG_TYPE_SNAPSHOT). The main board asks for the frame
+// nearest the moment a door opened; the CAM JPEG-encodes it out of its
+// pre-trigger ring straight into CHUNK frames (hdr.seq = chunk number,
+// ESPNOW_SNAP_CHUNK_BYTES each but the last) and closes with END. The main
+// board ACKs the next chunk it expects at every ESPNOW_SNAP_WINDOW boundary,
+// at a gap and after END; an ACK behind what was sent makes the CAM encode
+// again and resend from there. Chunk 0 always starts the image over.
+// hdr.session is the snapshot id; a new one replaces the snapshot in flight.
+#define ESPNOW_SNAP_REQUEST     0   // hdr.status: main → CAM
+#define ESPNOW_SNAP_CHUNK       1   // CAM → main, JPEG bytes after the header
+#define ESPNOW_SNAP_END         2   // CAM → main: result and size
+#define ESPNOW_SNAP_ACK         3   // main → CAM: hdr.seq = next chunk expected
+
+#define ESPNOW_SNAP_OK          0   // END result
+#define ESPNOW_SNAP_NO_FRAME    1   // Nothing in the ring (no PSRAM, camera down)
+#define ESPNOW_SNAP_TOO_BIG     2   // Over maxBytes even at the lowest quality
+
+#define ESPNOW_SNAP_WINDOW      8   // Chunks per ACK
+#define ESPNOW_SNAP_CHUNK_BYTES (ESPNOW_BENCH_MAX_LEN - sizeof(ESPNOW_Header_t))
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t door;           // REQUEST: compartment ID, echoed in END
+  uint8_t result;         // END: ESPNOW_SNAP_*
+  uint16_t maxBytes;      // REQUEST: JPEG size the main board can take
+  uint32_t ageMs;         // REQUEST: the door opened this long ago
+  int32_t offsetMs;       // END: frame capture time - door opening
+  uint32_t bytes;         // END: JPEG size
+  uint16_t width;         // END
+  uint16_t height;
+} ESPNOW_SnapFrame_t;
+
+// CAM firmware update (MSG_TYPE_OTA), relayed by the main board while it
+// downloads it. QUERY / INFO: the version the CAM runs. START: the delta's
+// base (DeltaPatch.h) and the SHA-256 of the new image; READY says whether
+// the running image is that base. CHUNK frames carry the delta from its
+// first byte (hdr.seq = chunk number, ESPNOW_OTA_CHUNK_BYTES each but the
+// last); the CAM ACKs the next chunk it expects at every ESPNOW_OTA_WINDOW
+// boundary once it is in flash, and with result ESPNOW_OTA_RESEND at a gap
+// or a window it already had. The main board keeps at most
+// ESPNOW_OTA_INFLIGHT chunks past the last ACK, resends from a RESEND and,
+// after ESPNOW_OTA_ACK_MS of silence, from the last ACK. END (repeated
+// until answered) gets DONE after the image is checked and set to boot;
+// the CAM restarts once its pipeline is idle. hdr.session is the update id.
+// START is tagged (auth) with an HMAC under the secret OTA key (OtaKey.h),
+// so the SHA-256 the CAM checks the image against is the main board's; an
+// untagged or mistagged START is dropped. A replayed START can only bring back a
+// genuine image, and only onto the base it was made against.
+#define ESPNOW_OTA_QUERY        0   // hdr.status: main → CAM
+#define ESPNOW_OTA_INFO         1   // CAM → main: running version
+#define ESPNOW_OTA_START        2   // main → CAM
+#define ESPNOW_OTA_READY        3   // CAM → main: result
+#define ESPNOW_OTA_CHUNK        4   // main → CAM, delta bytes
+#define ESPNOW_OTA_ACK          5   // CAM → main: hdr.seq = next chunk expected
+#define ESPNOW_OTA_END          6   // main → CAM: bytes = delta size
+#define ESPNOW_OTA_DONE         7   // CAM → main: result
+
+#define ESPNOW_OTA_OK           0   // READY / DONE result
+#define ESPNOW_OTA_BASE         1   // Running image is not the delta's base
+#define ESPNOW_OTA_FLASH        2   // No update partition, or a write failed
+#define ESPNOW_OTA_VERIFY       3   // Delta, CRC, SHA-256 or image check failed
+#define ESPNOW_OTA_RESEND       1   // ACK result: resend from hdr.seq
+
+#define ESPNOW_OTA_WINDOW       8   // Chunks per ACK
+#define ESPNOW_OTA_INFLIGHT     (2 * ESPNOW_OTA_WINDOW)
+#define ESPNOW_OTA_ACK_MS       300
+#define ESPNOW_OTA_CHUNK_BYTES  ESPNOW_SNAP_CHUNK_BYTES
+#define ESPNOW_OTA_VERSION_LEN  16
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t result;         // READY / DONE: ESPNOW_OTA_*; ACK: 0 or RESEND
+  char version[ESPNOW_OTA_VERSION_LEN];   // INFO: running; START: the update's
+  uint32_t oldSize;       // START: delta base, 0 = full image
+  uint32_t oldCrc;
+  uint32_t newSize;       // START: image size
+  uint32_t bytes;         // START / END: delta size
+  uint8_t sha256[32];     // START: of the new image
+  uint8_t auth[32];       // START: HMAC-SHA256 of the bytes before it
+} ESPNOW_OtaFrame_t;
+
 // ============================================================================
 // ESP-NOW SETTINGS
 // ============================================================================
-#define ESPNOW_DUPLICATE_COOLDOWN 2000     // 2 sec cooldown for duplicate scans
 #define ESPNOW_MAX_PAYLOAD 32              // Max QR code length
-#define ESPNOW_RETRY_COUNT      2          // Number of send retries
-#define ESPNOW_ACK_TIMEOUT_MS   500        // Wait for ACK before retry
+#define ESPNOW_RETRY_COUNT      4          // Retransmissions after the first send
+#define ESPNOW_ACK_TIMEOUT_MS   250        // First ACK wait; doubles on each retry
+#define ESPNOW_RX_RING_LEN      8          // Received frames awaiting the control task (power of 2)
+#define ESPNOW_TIME_SYNC_MS     5000       // Time-sync exchange period once locked
+#define ESPNOW_TIME_SYNC_FAST_MS 1000      // Period until the first good sample
+#define ESPNOW_TIME_SYNC_WINDOW 4          // Offset = lowest-RTT sample of the last N
+#define ESPNOW_MAX_PEERS        4          // Cameras one main board can serve
 
 // ============================================================================
 // CAMERA MAC ADDRESS (ESP32-CAM)
 // ============================================================================
+// Camera 1; the camera table is in LOCKER_CONFIG.h
 #define CAM_MAC_0 0xA0
 #define CAM_MAC_1 0xDD
 #define CAM_MAC_2 0x6C
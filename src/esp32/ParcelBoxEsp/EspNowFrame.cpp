@@ -0,0 +1,66 @@
+#include "EspNowFrame.h"
+
+// ============================================================================
+// ESP-NOW FRAME PARSING IMPLEMENTATION
+// ============================================================================
+
+EspNowFrameKind espNowFrameKind(const uint8_t* data, int len) {
+    if (len < (int)sizeof(ESPNOW_Header_t)) return ESPNOW_FRAME_MALFORMED;
+    const ESPNOW_Header_t* hdr = (const ESPNOW_Header_t*)data;
+    if (hdr->magic != ESPNOW_MAGIC) return ESPNOW_FRAME_MALFORMED;
+
+    switch (hdr->type) {
+        case MSG_TYPE_QR_SCAN:
+            if (len == sizeof(ESPNOW_QRFrame_t)) return ESPNOW_FRAME_QR;
+            break;
+        case MSG_TYPE_TIME_SYNC:
+            if (len == sizeof(ESPNOW_TimeSyncFrame_t) && hdr->status == ESPNOW_SYNC_RESPONSE) {
+                return ESPNOW_FRAME_TIME_SYNC;
+            }
+            break;
+        case MSG_TYPE_CONFIG:
+            if (len == sizeof(ESPNOW_ChannelFrame_t) && hdr->status == ESPNOW_CONFIG_PROBE) {
+                return ESPNOW_FRAME_CHANNEL_PROBE;
+            }
+            break;
+        case MSG_TYPE_STATUS:
+            // Older CAM firmware sends the frame without the appended fields
+            if (len >= (int)offsetof(ESPNOW_StatusFrame_t, metrics.pipelineStackFree) &&
+                len <= (int)sizeof(ESPNOW_StatusFrame_t)) {
+                return ESPNOW_FRAME_STATUS;
+            }
+            break;
+        case MSG_TYPE_BENCH:
+            if (len >= (int)sizeof(ESPNOW_BenchFrame_t) && len <= ESPNOW_BENCH_MAX_LEN) {
+                return ESPNOW_FRAME_BENCH;
+            }
+            break;
+        case MSG_TYPE_SNAPSHOT:
+            if ((hdr->status == ESPNOW_SNAP_CHUNK && len > (int)sizeof(ESPNOW_Header_t) &&
+                 len <= ESPNOW_BENCH_MAX_LEN) ||
+                (hdr->status == ESPNOW_SNAP_END && len == sizeof(ESPNOW_SnapFrame_t))) {
+                return ESPNOW_FRAME_SNAPSHOT;
+            }
+            break;
+        case MSG_TYPE_OTA:
+            if (len == sizeof(ESPNOW_OtaFrame_t) &&
+                (hdr->status == ESPNOW_OTA_INFO || hdr->status == ESPNOW_OTA_READY ||
+                 hdr->status == ESPNOW_OTA_ACK || hdr->status == ESPNOW_OTA_DONE)) {
+                return ESPNOW_FRAME_OTA;
+            }
+            break;
+    }
+    return ESPNOW_FRAME_MALFORMED;
+}
+
+void espNowCopyQr(const ESPNOW_QRPacket_t& qr, char* out, size_t len) {
+    const char* start = qr.qrData;
+    const char* end = qr.qrData + strnlen(qr.qrData, sizeof(qr.qrData));
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+
+    size_t n = (size_t)(end - start);
+    if (n > len - 1) n = len - 1;
+    memcpy(out, start, n);
+    out[n] = '\0';
+}
@@ -0,0 +1,69 @@
+#ifndef ESPNOW_FRAME_H
+#define ESPNOW_FRAME_H
+
+#include "ESPNOW_CONFIG.h"
+
+// ============================================================================
+// ESP-NOW FRAME PARSING - Smart Parcel Locker (Main ESP32)
+// ============================================================================
+// The byte-level half of EspNowManager, free of the radio and FreeRTOS so
+// the host build (src/esp32/host) replays traces through the same code:
+// - espNowFrameKind(): what a received buffer is. Length, magic and type
+//   (plus the status field where it tells request from response) must all
+//   match; anything else is malformed.
+// - EspNowSeqState: per-camera duplicate suppression. One outstanding frame
+//   per CAM session (stop-and-wait), so anything at or behind the last
+//   accepted seq of the same session is a retransmit. A new session (CAM
+//   reboot) starts over.
+// - espNowCopyQr(): the QR payload NUL-terminated and trimmed of whitespace
+//   and line endings
+
+enum EspNowFrameKind : uint8_t {
+    ESPNOW_FRAME_MALFORMED = 0,
+    ESPNOW_FRAME_QR,
+    ESPNOW_FRAME_TIME_SYNC,         // Response to our request
+    ESPNOW_FRAME_CHANNEL_PROBE,
+    ESPNOW_FRAME_STATUS,
+    ESPNOW_FRAME_BENCH,             // Any op; data frames are padded
+    ESPNOW_FRAME_SNAPSHOT,          // CHUNK or END from a camera
+    ESPNOW_FRAME_OTA                // INFO, READY, ACK or DONE from a camera
+};
+
+// One new scan as the control task sees it
+struct EspNowQrScan {
+    char qrData[ESPNOW_MAX_PAYLOAD];
+    uint16_t seq;
+    uint32_t session;
+    uint32_t camTimestamp;
+    uint8_t attempt;
+    uint8_t camera;         // Peer index (CAMERAS[] in LOCKER_CONFIG.h)
+    int8_t rssi;            // dBm of the received frame
+    int64_t rxUs;           // esp_timer time of arrival
+    int64_t camDecodeUs;    // CAM clock: QR decoded
+    int64_t camTxUs;        // CAM clock: this transmission sent
+    uint8_t mac[6];
+};
+
+struct EspNowSeqState {
+    uint32_t session;
+    uint16_t lastSeq;
+    bool haveSeq;
+
+    bool isDuplicate(uint32_t frameSession, uint16_t seq) const {
+        if (!haveSeq || frameSession != session) return false;
+        return (int16_t)(seq - lastSeq) <= 0;
+    }
+
+    void accept(uint32_t frameSession, uint16_t seq) {
+        session = frameSession;
+        lastSeq = seq;
+        haveSeq = true;
+    }
+};
+
+EspNowFrameKind espNowFrameKind(const uint8_t* data, int len);
+
+// out gets at most len - 1 characters
+void espNowCopyQr(const ESPNOW_QRPacket_t& qr, char* out, size_t len);
+
+#endif // ESPNOW_FRAME_H
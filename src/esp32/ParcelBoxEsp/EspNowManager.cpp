@@ -1,33 +1,362 @@
+#include "EspNowManager.h"
+#include "LinkBench.h"
+#include "SnapshotRelay.h"
+#include "OtaUpdater.h"
+#include "LogRing.h"
+#include <esp_timer.h>
+
 // ============================================================================
-// EspNowManager.cpp — DEPRECATED
-// All ESP-NOW logic is now inline in ParcelBoxEsp.ino
-// Kept to avoid compilation errors.
-// Remove from project when fully migrated.
+// ESP-NOW MANAGER IMPLEMENTATION
 // ============================================================================
-#include "EspNowManager.h"
 
-EspNowManager::EspNowManager() {
-    memset(deviceId, 0, sizeof(deviceId));
-    newMessageAvailable = false;
-    messagesSent = 0;
-    messagesReceived = 0;
-    messagesFailed = 0;
-}
-
-void EspNowManager::begin(const char* id) {}
-void EspNowManager::addPeer(const uint8_t*) {}
-void EspNowManager::removePeer(const uint8_t*) {}
-void EspNowManager::sendQrCode(const char*) {}
-void EspNowManager::sendLockCommand(uint8_t, uint8_t, uint16_t) {}
-void EspNowManager::sendStatus(uint8_t, uint8_t, uint32_t) {}
-void EspNowManager::sendConfigUpdate(const char*) {}
-void EspNowManager::sendAck(uint32_t) {}
-bool EspNowManager::hasNewMessage() { return false; }
-EspNowMessage EspNowManager::getLastMessage() { EspNowMessage m = {}; return m; }
-void EspNowManager::clearMessageBuffer() {}
-void EspNowManager::onQrScanReceived(const char*) {}
-void EspNowManager::onLockCommandReceived(uint8_t, uint8_t, uint16_t) {}
-void EspNowManager::onStatusReceived(uint8_t, uint8_t, uint32_t) {}
-void EspNowManager::onConfigReceived(const char*) {}
-bool EspNowManager::isPeerConnected(const uint8_t*) { return false; }
-void EspNowManager::printPeerInfo() {}
\ No newline at end of file
+EspNowManager* EspNowManager::instance = nullptr;
+
+EspNowManager::EspNowManager()
+    : started(false), bench(nullptr), snapshots(nullptr), ota(nullptr), consumer(nullptr), peerTotal(0), mux(portMUX_INITIALIZER_UNLOCKED),
+      framesReceived(0), framesMalformed(0), framesUnknownPeer(0), retransmitsFolded(0),
+      ackSendFailures(0), scansAccepted(0), duplicates(0), acksSent(0),
+      probesReceived(0), channelAnnouncements(0) {
+    memset(peers, 0, sizeof(peers));
+}
+
+bool EspNowManager::begin() {
+    instance = this;    // Callbacks are static; the initialized manager owns them
+
+    // Already up (e.g. after the setup portal): ESP-NOW survives STA
+    // reconnects and mode changes
+    if (started) return true;
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK) {
+        LOG_E("ESPNOW", "Init failed: %d", err);
+        return false;
+    }
+    esp_now_register_send_cb(onSent);
+    esp_now_register_recv_cb(onReceive);
+    started = true;
+    return true;
+}
+
+bool EspNowManager::addPeer(const uint8_t* mac) {
+    if (findPeer(mac) < 0) {
+        if (peerTotal >= ESPNOW_MAX_PEERS) {
+            LOG_E("ESPNOW", "Peer table full (%u)", (unsigned)ESPNOW_MAX_PEERS);
+            return false;
+        }
+        memcpy(peers[peerTotal].mac, mac, sizeof(peers[peerTotal].mac));
+        peerTotal++;    // Published last: the receive callback reads the table
+    }
+    if (esp_now_is_peer_exist(mac)) return true;
+
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, sizeof(peer.peer_addr));
+    peer.channel = 0;       // Follows the channel set via esp_wifi_set_channel()
+    peer.encrypt = false;
+    peer.ifidx = WIFI_IF_STA;
+    esp_err_t err = esp_now_add_peer(&peer);
+    if (err != ESP_OK) {
+        LOG_E("ESPNOW", "Peer add failed: %d", err);
+        return false;
+    }
+    return true;
+}
+
+int EspNowManager::findPeer(const uint8_t* mac) const {
+    for (uint8_t i = 0; i < peerTotal; i++) {
+        if (memcmp(peers[i].mac, mac, sizeof(peers[i].mac)) == 0) return i;
+    }
+    return -1;
+}
+
+// ============================================================================
+// RECEIVE (WiFi task)
+// ============================================================================
+void EspNowManager::onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+    EspNowManager* self = instance;
+    if (!self) return;
+
+    int index = self->findPeer(info->src_addr);
+    if (index < 0) {
+        self->framesUnknownPeer++;
+        return;
+    }
+    Peer& p = self->peers[index];
+
+    EspNowFrameKind kind = espNowFrameKind(data, len);
+    const ESPNOW_Header_t* hdr = (const ESPNOW_Header_t*)data;
+    if (kind == ESPNOW_FRAME_TIME_SYNC) {
+        int64_t t4 = esp_timer_get_time();
+        portENTER_CRITICAL(&self->mux);
+        memcpy(&p.syncResponse, data, sizeof(ESPNOW_TimeSyncFrame_t));
+        p.syncT4 = t4;
+        p.syncReceived = true;
+        portEXIT_CRITICAL(&self->mux);
+        return;
+    }
+    if (kind == ESPNOW_FRAME_CHANNEL_PROBE) {
+        portENTER_CRITICAL(&self->mux);
+        p.probeSession = hdr->session;
+        p.probeSeq = hdr->seq;
+        p.probePending = true;
+        portEXIT_CRITICAL(&self->mux);
+        self->probesReceived++;
+        return;
+    }
+    if (kind == ESPNOW_FRAME_BENCH) {
+        if (self->bench) {
+            self->bench->onFrame((uint8_t)index, data, len, info->rx_ctrl ? info->rx_ctrl->rssi : 0,
+                                 esp_timer_get_time());
+        }
+        return;
+    }
+    if (kind == ESPNOW_FRAME_SNAPSHOT) {
+        if (self->snapshots && self->snapshots->onFrame((uint8_t)index, data, len) && self->consumer) {
+            xTaskNotifyGive(self->consumer);
+        }
+        return;
+    }
+    if (kind == ESPNOW_FRAME_OTA) {
+        if (self->ota) self->ota->onFrame((uint8_t)index, data, len);
+        return;
+    }
+    if (kind == ESPNOW_FRAME_STATUS) {
+        portENTER_CRITICAL(&self->mux);
+        memset(&p.metrics, 0, sizeof(p.metrics));     // Fields older CAMs don't send read 0
+        memcpy(&p.metrics, &((const ESPNOW_StatusFrame_t*)data)->metrics, len - sizeof(ESPNOW_Header_t));
+        p.metricsAt = millis() | 1;     // Never 0 once received
+        portEXIT_CRITICAL(&self->mux);
+        return;
+    }
+    if (kind != ESPNOW_FRAME_QR) {
+        self->framesMalformed++;
+        return;
+    }
+
+    self->framesReceived++;
+
+    // Retransmit of this camera's newest frame while it is still queued:
+    // nothing new. If it was consumed already, let it through and the
+    // control task re-ACKs it (the first ACK may have been lost).
+    if (p.pushed != p.popped && hdr->session == p.lastPushedSession &&
+        hdr->seq == p.lastPushedSeq) {
+        self->retransmitsFolded++;
+        return;
+    }
+
+    RxSlot slot;
+    memcpy(&slot.frame, data, sizeof(ESPNOW_QRFrame_t));
+    slot.peer = (uint8_t)index;
+    slot.rssi = info->rx_ctrl ? info->rx_ctrl->rssi : 0;
+    slot.rxUs = esp_timer_get_time();
+    if (self->rxRing.push(slot)) {      // Full: dropped and counted by the ring
+        p.lastPushedSession = hdr->session;
+        p.lastPushedSeq = hdr->seq;
+        p.pushed++;
+        if (self->consumer) xTaskNotifyGive(self->consumer);
+    }
+}
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+void EspNowManager::onSent(const wifi_tx_info_t* info, esp_now_send_status_t status) {
+#else
+void EspNowManager::onSent(const uint8_t* mac, esp_now_send_status_t status) {
+#endif
+    // Only ACKs are sent from here; a lost ACK is repaired by the CAM's retry.
+    // During a link bench run its data frames dominate, so it takes them all.
+    if (!instance) return;
+    if (instance->bench && instance->bench->onSent(status == ESP_NOW_SEND_SUCCESS)) return;
+    if (status != ESP_NOW_SEND_SUCCESS) instance->ackSendFailures++;
+}
+
+// ============================================================================
+// CONTROL TASK
+// ============================================================================
+bool EspNowManager::receiveQr(EspNowQrScan& out) {
+    RxSlot slot;
+    ESPNOW_QRFrame_t& frame = slot.frame;
+
+    // Skip past duplicates so one call yields the next new scan, if any
+    while (true) {
+        if (!rxRing.pop(slot)) return false;
+        Peer& p = peers[slot.peer];
+        p.popped++;
+        if (!p.seq.isDuplicate(frame.hdr.session, frame.hdr.seq)) break;
+        duplicates++;
+        sendAck(p.mac, frame.hdr.session, frame.hdr.seq, ESPNOW_ACK_DUPLICATE);
+    }
+    Peer& p = peers[slot.peer];
+    p.seq.accept(frame.hdr.session, frame.hdr.seq);
+
+    espNowCopyQr(frame.qr, out.qrData, sizeof(out.qrData));
+    out.seq = frame.hdr.seq;
+    out.session = frame.hdr.session;
+    out.camTimestamp = frame.qr.timestamp;
+    out.attempt = frame.hdr.attempt;
+    out.camera = slot.peer;
+    out.rssi = slot.rssi;
+    out.rxUs = slot.rxUs;
+    out.camDecodeUs = frame.qr.decodeUs;
+    out.camTxUs = frame.qr.txUs;
+    memcpy(out.mac, p.mac, sizeof(out.mac));
+    p.lastRssi = slot.rssi;
+    p.scans++;
+    scansAccepted++;
+    return true;
+}
+
+void EspNowManager::ack(const EspNowQrScan& scan, uint8_t status) {
+    sendAck(scan.mac, scan.session, scan.seq, status);
+}
+
+void EspNowManager::sendAck(const uint8_t* mac, uint32_t session, uint16_t seq, uint8_t status) {
+    ESPNOW_AckFrame_t ackFrame = {};
+    ackFrame.hdr.magic = ESPNOW_MAGIC;
+    ackFrame.hdr.type = MSG_TYPE_ACK;
+    ackFrame.hdr.seq = seq;
+    ackFrame.hdr.session = session;
+    ackFrame.hdr.status = status;
+    if (esp_now_send(mac, (const uint8_t*)&ackFrame, sizeof(ackFrame)) == ESP_OK) {
+        acksSent++;
+    } else {
+        ackSendFailures++;
+    }
+}
+
+bool EspNowManager::camMetrics(uint8_t camera, ESPNOW_BoardMetrics_t& out, uint32_t* ageMs) {
+    if (camera >= peerTotal) return false;
+    const Peer& p = peers[camera];
+    portENTER_CRITICAL(&mux);
+    uint32_t at = p.metricsAt;
+    if (at) memcpy(&out, &p.metrics, sizeof(out));
+    portEXIT_CRITICAL(&mux);
+    if (!at) return false;
+    if (ageMs) *ageMs = millis() - at;
+    return true;
+}
+
+// ============================================================================
+// TIME SYNC (control task)
+// ============================================================================
+void EspNowManager::serviceTimeSync() {
+    for (uint8_t i = 0; i < peerTotal; i++) serviceTimeSync(peers[i]);
+}
+
+void EspNowManager::serviceTimeSync(Peer& p) {
+    portENTER_CRITICAL(&mux);
+    bool got = p.syncReceived;
+    ESPNOW_TimeSyncFrame_t resp = p.syncResponse;
+    int64_t t4 = p.syncT4;
+    p.syncReceived = false;
+    portEXIT_CRITICAL(&mux);
+
+    if (got && resp.hdr.seq == p.syncSeq) {
+        if (resp.hdr.session != p.syncSession) {
+            // CAM rebooted: its clock restarted, old samples are meaningless
+            p.syncSession = resp.hdr.session;
+            p.syncSampleCount = 0;
+            p.syncSampleNext = 0;
+        }
+        int64_t rtt = (t4 - resp.t1) - (resp.t3 - resp.t2);
+        if (rtt >= 0) {
+            p.syncSamples[p.syncSampleNext].offsetUs = ((resp.t2 - resp.t1) + (resp.t3 - t4)) / 2;
+            p.syncSamples[p.syncSampleNext].rttUs = rtt;
+            p.syncSampleNext = (p.syncSampleNext + 1) % ESPNOW_TIME_SYNC_WINDOW;
+            if (p.syncSampleCount < ESPNOW_TIME_SYNC_WINDOW) p.syncSampleCount++;
+            p.syncResponses++;
+
+            // Lowest RTT = least queueing asymmetry = best offset estimate
+            const SyncSample* best = &p.syncSamples[0];
+            for (uint8_t i = 1; i < p.syncSampleCount; i++) {
+                if (p.syncSamples[i].rttUs < best->rttUs) best = &p.syncSamples[i];
+            }
+            p.offsetUs = best->offsetUs;
+            p.offsetRttUs = best->rttUs;
+            p.timeSynced = true;
+        }
+    }
+
+    unsigned long period = p.timeSynced ? ESPNOW_TIME_SYNC_MS : ESPNOW_TIME_SYNC_FAST_MS;
+    if (p.lastSyncAt != 0 && millis() - p.lastSyncAt < period) return;
+    p.lastSyncAt = millis();
+
+    ESPNOW_TimeSyncFrame_t req = {};
+    req.hdr.magic = ESPNOW_MAGIC;
+    req.hdr.type = MSG_TYPE_TIME_SYNC;
+    req.hdr.seq = ++p.syncSeq;
+    req.hdr.status = ESPNOW_SYNC_REQUEST;
+    req.t1 = esp_timer_get_time();
+    if (esp_now_send(p.mac, (const uint8_t*)&req, sizeof(req)) == ESP_OK) p.syncRequests++;
+}
+
+bool EspNowManager::camToLocalUs(uint8_t camera, int64_t camUs, int64_t& localUs) {
+    if (camera >= peerTotal || !peers[camera].timeSynced) return false;
+    localUs = camUs - peers[camera].offsetUs;
+    return true;
+}
+
+// ============================================================================
+// CHANNEL DISCOVERY
+// ============================================================================
+// The CAM dwells only briefly on each channel while it scans, so the reply
+// goes out on the next control pass rather than waiting for the sync period
+void EspNowManager::serviceChannel() {
+    for (uint8_t i = 0; i < peerTotal; i++) {
+        Peer& p = peers[i];
+        portENTER_CRITICAL(&mux);
+        bool pending = p.probePending;
+        uint32_t session = p.probeSession;
+        uint16_t seq = p.probeSeq;
+        p.probePending = false;
+        portEXIT_CRITICAL(&mux);
+        if (!pending) continue;
+
+        ESPNOW_ChannelFrame_t frame = {};
+        frame.hdr.magic = ESPNOW_MAGIC;
+        frame.hdr.type = MSG_TYPE_CONFIG;
+        frame.hdr.seq = seq;
+        frame.hdr.session = session;
+        frame.hdr.status = ESPNOW_CONFIG_CHANNEL;
+        frame.channel = WiFi.channel();
+        esp_now_send(p.mac, (const uint8_t*)&frame, sizeof(frame));
+
+        // The CAM may be back after a long silence; lock the clock offset again soon
+        p.lastSyncAt = 0;
+    }
+}
+
+void EspNowManager::announceChannel(uint8_t channel) {
+    ESPNOW_ChannelFrame_t frame = {};
+    frame.hdr.magic = ESPNOW_MAGIC;
+    frame.hdr.type = MSG_TYPE_CONFIG;
+    frame.hdr.status = ESPNOW_CONFIG_CHANNEL;
+    frame.channel = channel;
+    for (uint8_t i = 0; i < peerTotal; i++) {
+        if (esp_now_send(peers[i].mac, (const uint8_t*)&frame, sizeof(frame)) == ESP_OK) {
+            channelAnnouncements++;
+        }
+    }
+}
+
+void EspNowManager::printStats() {
+    Serial.printf("ESP-NOW: %u frames, %u scans, %u duplicates, %u folded, %u acks (%u failed), %u malformed, %u unknown MAC\n",
+                  (unsigned)framesReceived, (unsigned)scansAccepted, (unsigned)duplicates,
+                  (unsigned)retransmitsFolded, (unsigned)acksSent, (unsigned)ackSendFailures,
+                  (unsigned)framesMalformed, (unsigned)framesUnknownPeer);
+    Serial.printf("ESP-NOW RX ring: %u/%u queued, peak %u, %u dropped\n",
+                  (unsigned)rxRing.size(), (unsigned)rxRing.capacity(), (unsigned)rxRing.peak(),
+                  (unsigned)rxRing.dropped());
+    for (uint8_t i = 0; i < peerTotal; i++) {
+        const Peer& p = peers[i];
+        Serial.printf("ESP-NOW CAM %u %02X:%02X:%02X:%02X:%02X:%02X: %u scans, last RSSI %d dBm, ",
+                      (unsigned)(i + 1), p.mac[0], p.mac[1], p.mac[2], p.mac[3], p.mac[4], p.mac[5],
+                      (unsigned)p.scans, p.lastRssi);
+        if (p.timeSynced) {
+            Serial.printf("offset %lld us (rtt %lld us), %u/%u syncs answered\n",
+                          (long long)p.offsetUs, (long long)p.offsetRttUs,
+                          (unsigned)p.syncResponses, (unsigned)p.syncRequests);
+        } else {
+            Serial.printf("time sync not locked, %u requests sent\n", (unsigned)p.syncRequests);
+        }
+    }
+    Serial.printf("ESP-NOW channel %d: %u CAM probes answered, %u announcements\n",
+                  WiFi.channel(), (unsigned)probesReceived, (unsigned)channelAnnouncements);
+}
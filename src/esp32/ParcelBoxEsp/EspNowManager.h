@@ -1,98 +1,184 @@
-#ifndef ESPNOW_MANAGER_H
-#define ESPNOW_MANAGER_H
-
-#include <Arduino.h>
-#include <esp_now.h>
-#include <WiFi.h>
-
-// ============================================================================
-// ESP-NOW MESSAGE STRUCTURE
-// ============================================================================
-// All ESP-NOW messages follow this struct for type safety
-typedef struct {
-  uint8_t type;           // Message type (0=QR_SCAN, 1=LOCK_CMD, 2=STATUS, 3=CONFIG)
-  char deviceId[32];      // Source device ID
-  uint32_t timestamp;     // Milliseconds timestamp
-  uint8_t retries;        // Number of retries for reliability
-  
-  // Payload (max 200 bytes for data)
-  union {
-    char qrCode[64];          // For QR scans
-    struct {
-      uint8_t lock;           // Lock number (1-2)
-      uint8_t command;        // 0=close, 1=open
-      uint16_t duration;      // Duration in milliseconds
-    } lockCmd;
-    struct {
-      uint8_t battery;        // Battery percentage
-      uint8_t signalStrength; // WiFi/ESP-NOW signal
-      uint32_t uptime;        // System uptime
-    } status;
-    char configData[128];     // Config JSON or text
-  } payload;
-} EspNowMessage;
-
-// Message types
-#define MSG_TYPE_QR_SCAN        0
-#define MSG_TYPE_LOCK_CMD       1
-#define MSG_TYPE_STATUS         2
-#define MSG_TYPE_CONFIG         3
-#define MSG_TYPE_ACK            4
-
-// ============================================================================
-// ESP-NOW MANAGER CLASS
-// ============================================================================
-class EspNowManager {
-public:
-  EspNowManager();
-  
-  // Initialization
-  void begin(const char* deviceId);
-  void addPeer(const uint8_t* peerMac);
-  void removePeer(const uint8_t* peerMac);
-  
-  // Sending data
-  void sendQrCode(const char* qrCode);
-  void sendLockCommand(uint8_t lockNum, uint8_t command, uint16_t duration = 0);
-  void sendStatus(uint8_t battery, uint8_t signal, uint32_t uptime);
-  void sendConfigUpdate(const char* configJson);
-  void sendAck(uint32_t messageId);
-  
-  // Receiving data (non-blocking)
-  bool hasNewMessage();
-  EspNowMessage getLastMessage();
-  void clearMessageBuffer();
-  
-  // Callbacks (user implements these)
-  void onQrScanReceived(const char* qrCode);
-  void onLockCommandReceived(uint8_t lock, uint8_t command, uint16_t duration);
-  void onStatusReceived(uint8_t battery, uint8_t signal, uint32_t uptime);
-  void onConfigReceived(const char* configJson);
-  
-  // Health check
-  bool isPeerConnected(const uint8_t* peerMac);
-  void printPeerInfo();
-  
-  // Reliability
-  uint32_t getMessagesSent() { return messagesSent; }
-  uint32_t getMessagesReceived() { return messagesReceived; }
-  uint32_t getMessagesFailed() { return messagesFailed; }
-
-private:
-  char deviceId[32];
-  bool newMessageAvailable;
-
-  // Helper
-  void sendMessage(EspNowMessage& msg);
-
-public:
-  EspNowMessage lastMessage;
-
-  // Statistics
-  uint32_t messagesSent;
-  uint32_t messagesReceived;
-  uint32_t messagesFailed;
-  
-  };
-
-#endif // ESPNOW_MANAGER_H
+#ifndef ESPNOW_MANAGER_H
+#define ESPNOW_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <WiFi.h>
+#include "ESPNOW_CONFIG.h"
+#include "EspNowFrame.h"
+#include "SpscRing.h"
+
+class LinkBench;
+class SnapshotRelay;
+class OtaUpdater;
+
+// ============================================================================
+// ESP-NOW MANAGER - Smart Parcel Locker (Main ESP32)
+// ============================================================================
+// Receiving end of the CAM → Main protocol (frames in ESPNOW_CONFIG.h) for
+// up to ESPNOW_MAX_PEERS cameras, kept in a peer table indexed by camera:
+// - The WiFi-task receive callback only validates the frame and pushes it,
+//   tagged with RSSI and arrival time, into a lock-free ring (no heap, no
+//   Serial). A full ring drops and counts instead of overwriting. Frames
+//   from MACs not in the table are dropped.
+// - Retransmits of a frame still waiting in the ring are folded in the
+//   callback so a blocked control task can't fill the ring with copies
+// - The control task takes scans with receiveQr(); retransmits of an already
+//   processed sequence number are re-ACKed as duplicates and never returned.
+//   Sessions, sequence numbers, metrics and clock offsets are per camera.
+// - ack() is the end-to-end acknowledgement: the CAM keeps retransmitting
+//   until it arrives, so a scan is never lost to a dropped radio frame
+// - CAM status frames (health metrics) are not ACKed; only the newest is kept
+// - serviceTimeSync() runs a periodic NTP-style exchange with each CAM so scan
+//   trace stamps taken on the CAM clock map onto this board's esp_timer
+// - ESP-NOW stays initialized across WiFi drops; the peer follows whatever
+//   channel the STA is on. serviceChannel() answers the CAM's channel probes,
+//   which is how a camera follows the AP to a new channel; announceChannel()
+//   is only sent once associated at boot, for a camera already scanning
+// - Link bench frames go straight from the callback to LinkBench, if set,
+//   snapshot frames to SnapshotRelay and update frames to OtaUpdater
+// Frame checks and duplicate tracking are in EspNowFrame.h.
+
+class EspNowManager {
+public:
+    EspNowManager();
+
+    // esp_now_init and callbacks, once. Later calls are no-ops: no deinit,
+    // frames in flight are kept.
+    bool begin();
+
+    // Register a camera; its index is the order of the first call. Calling
+    // again for a known MAC only re-adds the ESP-NOW peer if it went missing.
+    bool addPeer(const uint8_t* mac);
+    uint8_t peerCount() const { return peerTotal; }
+    const uint8_t* peerMac(uint8_t camera) const { return peers[camera].mac; }
+
+    // Optional: receiver of MSG_TYPE_BENCH frames and, while it runs, of send results
+    void setBench(LinkBench* linkBench) { bench = linkBench; }
+
+    // Optional: receiver of MSG_TYPE_SNAPSHOT frames
+    void setSnapshots(SnapshotRelay* relay) { snapshots = relay; }
+
+    // Optional: receiver of MSG_TYPE_OTA frames (camera updates)
+    void setOta(OtaUpdater* updater) { ota = updater; }
+
+    // Optional: task notified when a scan is queued (cuts its wait short)
+    void setConsumer(TaskHandle_t task) { consumer = task; }
+
+    // Control task: next new scan. Duplicates are ACKed here and skipped.
+    bool receiveQr(EspNowQrScan& out);
+
+    // Control task: tell the CAM the scan was processed
+    void ack(const EspNowQrScan& scan, uint8_t status);
+
+    void printStats();
+
+    // Any task: newest metrics of one camera and their age. False if none received yet.
+    bool camMetrics(uint8_t camera, ESPNOW_BoardMetrics_t& out, uint32_t* ageMs);
+
+    // Control task: send sync requests and fold in responses
+    void serviceTimeSync();
+
+    // Control task: CAM esp_timer time → local esp_timer time. False until synced.
+    bool camToLocalUs(uint8_t camera, int64_t camUs, int64_t& localUs);
+
+    // Control task: answer pending CAM channel probes
+    void serviceChannel();
+
+    // Any task: tell every camera which channel this board is on now. Goes
+    // out on that channel, so only a camera already there (or scanning) hears it.
+    void announceChannel(uint8_t channel);
+
+private:
+    static EspNowManager* instance;
+
+    bool started;
+    LinkBench* bench;
+    SnapshotRelay* snapshots;
+    OtaUpdater* ota;
+    TaskHandle_t consumer;
+
+    struct SyncSample {
+        int64_t offsetUs;       // CAM - main
+        int64_t rttUs;
+    };
+
+    // One camera. The WiFi task writes the hand-off fields under mux; the
+    // rest belongs to one side only, as marked.
+    struct Peer {
+        uint8_t mac[6];
+
+        // Producer side (WiFi task only)
+        uint32_t lastPushedSession;
+        uint16_t lastPushedSeq;
+        volatile uint32_t pushed;       // Frames put in the ring
+        volatile uint32_t popped;       // ...and taken out (control task)
+
+        // Duplicate suppression (control task only)
+        EspNowSeqState seq;
+
+        // Hand-offs from the WiFi task (guarded by mux)
+        ESPNOW_BoardMetrics_t metrics;
+        uint32_t metricsAt;             // millis() of arrival, 0 = none yet
+        ESPNOW_TimeSyncFrame_t syncResponse;
+        int64_t syncT4;
+        bool syncReceived;
+        uint32_t probeSession;
+        uint16_t probeSeq;
+        bool probePending;
+
+        // Time-sync state (control task only)
+        SyncSample syncSamples[ESPNOW_TIME_SYNC_WINDOW];
+        uint8_t syncSampleCount;
+        uint8_t syncSampleNext;
+        uint16_t syncSeq;
+        uint32_t syncSession;           // CAM boot the samples belong to
+        unsigned long lastSyncAt;
+        int64_t offsetUs;
+        int64_t offsetRttUs;
+        bool timeSynced;
+
+        // Statistics
+        uint32_t scans;
+        uint32_t syncRequests;
+        uint32_t syncResponses;
+        int8_t lastRssi;
+    };
+    Peer peers[ESPNOW_MAX_PEERS];
+    uint8_t peerTotal;
+    portMUX_TYPE mux;
+
+    // Frames handed from the WiFi task (producer) to the control task (consumer)
+    struct RxSlot {
+        ESPNOW_QRFrame_t frame;
+        uint8_t peer;
+        int8_t rssi;
+        int64_t rxUs;
+    };
+    SpscRing<RxSlot, ESPNOW_RX_RING_LEN> rxRing;
+
+    // Statistics
+    volatile uint32_t framesReceived;
+    volatile uint32_t framesMalformed;
+    volatile uint32_t framesUnknownPeer;
+    volatile uint32_t retransmitsFolded;
+    volatile uint32_t ackSendFailures;
+    uint32_t scansAccepted;
+    uint32_t duplicates;
+    uint32_t acksSent;
+    volatile uint32_t probesReceived;
+    uint32_t channelAnnouncements;
+
+    int findPeer(const uint8_t* mac) const;
+    void serviceTimeSync(Peer& p);
+    void sendAck(const uint8_t* mac, uint32_t session, uint16_t seq, uint8_t status);
+
+    static void onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int len);
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    static void onSent(const wifi_tx_info_t* info, esp_now_send_status_t status);
+#else
+    static void onSent(const uint8_t* mac, esp_now_send_status_t status);
+#endif
+};
+
+#endif // ESPNOW_MANAGER_H
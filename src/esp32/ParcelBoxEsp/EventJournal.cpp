@@ -0,0 +1,348 @@
+#include "EventJournal.h"
+#include "LogRing.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <sys/time.h>
+
+// ============================================================================
+// EVENT JOURNAL IMPLEMENTATION
+// ============================================================================
+
+static const char* JOURNAL_DIR = "/journal";
+static const char* CURSOR_FILE = "/journal/cursor.bin";
+static const uint16_t RECORD_MAGIC = 0x4A50;   // "PJ"
+static const uint32_t CURSOR_MAGIC = 0x4A435052;   // "RPCJ"
+
+// Replay position: records of `segment` already committed
+struct __attribute__((packed)) JournalCursor {
+    uint32_t magic;
+    uint32_t segment;
+    uint32_t offset;
+    uint32_t crc;       // CRC32 over the preceding fields
+};
+
+EventJournal::EventJournal()
+    : mutex(nullptr), mounted(false), bufferCount(0), bufferOldestAt(0),
+      nextSeq(0), bootId(0), firstSegment(0), lastSegment(0), lastSegmentRecords(0),
+      readOffset(0), flashRecords(0), batchConsumed(0), batchFromBuffer(false),
+      recordsWritten(0), recordsReplayed(0), recordsDropped(0), corruptRecords(0), flashWrites(0) {
+}
+
+void EventJournal::segmentPath(uint32_t segment, char* out, size_t len) {
+    snprintf(out, len, "%s/seg_%08lu.bin", JOURNAL_DIR, (unsigned long)segment);
+}
+
+uint32_t EventJournal::recordCrc(const JournalRecord& rec) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&rec, offsetof(JournalRecord, crc));
+}
+
+bool EventJournal::currentEpochMs(uint64_t* out) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 24 * 3600) return false;   // NTP not synced
+    *out = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return true;
+}
+
+size_t EventJournal::segmentRecordCount(uint32_t segment) {
+    char path[40];
+    segmentPath(segment, path, sizeof(path));
+    File f = LittleFS.open(path, "r");
+    if (!f) return 0;
+    size_t n = f.size() / sizeof(JournalRecord);
+    f.close();
+    return n;
+}
+
+bool EventJournal::begin() {
+    if (!mutex) mutex = xSemaphoreCreateMutex();
+    bootId = esp_random();
+
+    mounted = LittleFS.begin(true);
+    if (!mounted) {
+        Serial.println("[JOURNAL] LittleFS mount FAILED - RAM only");
+        return false;
+    }
+    if (!LittleFS.exists(JOURNAL_DIR)) LittleFS.mkdir(JOURNAL_DIR);
+
+    // Segment numbers only grow; find the live range
+    bool any = false;
+    File dir = LittleFS.open(JOURNAL_DIR);
+    File entry = dir.openNextFile();
+    while (entry) {
+        unsigned long n;
+        if (sscanf(entry.name(), "seg_%08lu.bin", &n) == 1) {
+            if (!any || n < firstSegment) firstSegment = n;
+            if (!any || n > lastSegment) lastSegment = n;
+            any = true;
+            flashRecords += entry.size() / sizeof(JournalRecord);
+        }
+        entry = dir.openNextFile();
+    }
+    dir.close();
+
+    if (any) {
+        lastSegmentRecords = segmentRecordCount(lastSegment);
+
+        // Continue the sequence from the newest valid record
+        char path[40];
+        segmentPath(lastSegment, path, sizeof(path));
+        File f = LittleFS.open(path, "r");
+        if (f && lastSegmentRecords > 0) {
+            JournalRecord rec;
+            f.seek((lastSegmentRecords - 1) * sizeof(JournalRecord));
+            if (f.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec) &&
+                rec.magic == RECORD_MAGIC && rec.crc == recordCrc(rec)) {
+                nextSeq = rec.seq + 1;
+            }
+        }
+        if (f) f.close();
+        loadCursor();
+    }
+
+    Serial.printf("[JOURNAL] %u events pending replay\n", (unsigned)flashRecords);
+    return true;
+}
+
+// ============================================================================
+// APPEND (any task)
+// ============================================================================
+bool EventJournal::append(JournalRecord& rec) {
+    rec.magic = RECORD_MAGIC;
+    rec.bootId = bootId;
+    rec.uptimeMs = millis();
+    if (!(rec.flags & JOURNAL_FLAG_EPOCH_VALID) && currentEpochMs(&rec.epochMs)) {
+        rec.flags |= JOURNAL_FLAG_EPOCH_VALID;
+    }
+
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = bufferCount < BUFFER_RECORDS;
+    if (ok) {
+        rec.seq = nextSeq++;
+        rec.crc = recordCrc(rec);
+        if (bufferCount == 0) bufferOldestAt = millis();
+        buffer[bufferCount++] = rec;
+    } else {
+        recordsDropped++;
+    }
+    if (mutex) xSemaphoreGive(mutex);
+    return ok;
+}
+
+bool EventJournal::appendHistory(const char* parcelId, const char* event) {
+    return appendHistory(parcelId, event, 0, false);
+}
+
+bool EventJournal::appendHistory(const char* parcelId, const char* event, uint64_t epochMs, bool valid) {
+    JournalRecord rec = {};
+    rec.type = JOURNAL_TYPE_HISTORY;
+    strlcpy(rec.parcelId, parcelId, sizeof(rec.parcelId));
+    strlcpy(rec.event, event, sizeof(rec.event));
+    if (valid) {
+        rec.epochMs = epochMs;
+        rec.flags = JOURNAL_FLAG_EPOCH_VALID;
+    }
+    return append(rec);
+}
+
+bool EventJournal::appendStatus(uint8_t locksOpen, uint8_t doorsOpen) {
+    JournalRecord rec = {};
+    rec.type = JOURNAL_TYPE_STATUS;
+    rec.locksOpen = locksOpen;
+    rec.doorsOpen = doorsOpen;
+    return append(rec);
+}
+
+// ============================================================================
+// FLASH (cloud task)
+// ============================================================================
+void EventJournal::service() {
+    if (!mounted || bufferCount == 0) return;
+    if (bufferCount >= FLUSH_THRESHOLD || millis() - bufferOldestAt >= FLUSH_MAX_AGE_MS) {
+        flushBuffer();
+    }
+}
+
+void EventJournal::dropOldestSegment() {
+    size_t lost = segmentRecordCount(firstSegment);
+    lost = (lost > readOffset) ? lost - readOffset : 0;
+    char path[40];
+    segmentPath(firstSegment, path, sizeof(path));
+    LittleFS.remove(path);
+    recordsDropped += lost;
+    flashRecords -= (lost > flashRecords) ? flashRecords : lost;
+    firstSegment++;
+    readOffset = 0;
+    LOG_W("JOURNAL", "Full - dropped %u oldest events", (unsigned)lost);
+}
+
+void EventJournal::flushBuffer() {
+    JournalRecord staged[BUFFER_RECORDS];
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    size_t count = bufferCount;
+    memcpy(staged, buffer, count * sizeof(JournalRecord));
+    bufferCount = 0;
+    xSemaphoreGive(mutex);
+
+    size_t done = 0;
+    while (done < count) {
+        if (lastSegmentRecords >= SEGMENT_RECORDS) {
+            lastSegment++;
+            lastSegmentRecords = 0;
+            if (lastSegment - firstSegment + 1 > SEGMENT_COUNT) dropOldestSegment();
+        }
+
+        size_t chunk = SEGMENT_RECORDS - lastSegmentRecords;
+        if (chunk > count - done) chunk = count - done;
+
+        char path[40];
+        segmentPath(lastSegment, path, sizeof(path));
+        File f = LittleFS.open(path, "a");
+        if (!f) {
+            recordsDropped += count - done;
+            return;
+        }
+        size_t bytes = f.write((const uint8_t*)&staged[done], chunk * sizeof(JournalRecord));
+        f.close();
+        flashWrites++;
+
+        size_t written = bytes / sizeof(JournalRecord);
+        lastSegmentRecords += written;
+        flashRecords += written;
+        recordsWritten += written;
+        if (written < chunk) {
+            recordsDropped += count - done - written;
+            return;
+        }
+        done += chunk;
+    }
+}
+
+// ============================================================================
+// REPLAY (cloud task)
+// ============================================================================
+size_t EventJournal::readBatch(JournalRecord* out, size_t max) {
+    batchConsumed = 0;
+    batchFromBuffer = false;
+
+    if (!mounted) {
+        // RAM-only fallback: replay straight from the staging buffer
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        size_t n = (bufferCount < max) ? bufferCount : max;
+        memcpy(out, buffer, n * sizeof(JournalRecord));
+        xSemaphoreGive(mutex);
+        batchConsumed = n;
+        batchFromBuffer = true;
+        return n;
+    }
+
+    if (bufferCount > 0) flushBuffer();
+    if (flashRecords == 0) return 0;
+
+    char path[40];
+    segmentPath(firstSegment, path, sizeof(path));
+    File f = LittleFS.open(path, "r");
+    if (!f) return 0;
+    f.seek(readOffset * sizeof(JournalRecord));
+
+    size_t valid = 0;
+    JournalRecord rec;
+    while (valid < max && f.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec)) {
+        batchConsumed++;
+        if (rec.magic != RECORD_MAGIC || rec.crc != recordCrc(rec)) {
+            corruptRecords++;
+            continue;
+        }
+        out[valid++] = rec;
+    }
+    f.close();
+    return valid;
+}
+
+void EventJournal::commitBatch() {
+    if (batchConsumed == 0) return;
+
+    if (batchFromBuffer) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        size_t n = (batchConsumed < bufferCount) ? batchConsumed : bufferCount;
+        memmove(buffer, buffer + n, (bufferCount - n) * sizeof(JournalRecord));
+        bufferCount -= n;
+        xSemaphoreGive(mutex);
+        recordsReplayed += n;
+        batchConsumed = 0;
+        return;
+    }
+
+    readOffset += batchConsumed;
+    recordsReplayed += batchConsumed;
+    flashRecords -= (batchConsumed > flashRecords) ? flashRecords : batchConsumed;
+    batchConsumed = 0;
+
+    // Segment fully replayed → delete it (keeps the journal bounded)
+    if (readOffset >= segmentRecordCount(firstSegment)) {
+        char path[40];
+        segmentPath(firstSegment, path, sizeof(path));
+        LittleFS.remove(path);
+        if (firstSegment == lastSegment) {
+            lastSegment++;
+            lastSegmentRecords = 0;
+        }
+        firstSegment++;
+        readOffset = 0;
+        LittleFS.remove(CURSOR_FILE);
+    } else {
+        saveCursor();
+    }
+}
+
+// A torn or stale cursor (segment since replayed or dropped) is ignored:
+// the worst case is resending that segment, as before the cursor existed
+void EventJournal::saveCursor() {
+    JournalCursor c = { CURSOR_MAGIC, firstSegment, (uint32_t)readOffset, 0 };
+    c.crc = esp_rom_crc32_le(0, (const uint8_t*)&c, offsetof(JournalCursor, crc));
+    File f = LittleFS.open(CURSOR_FILE, "w");
+    if (!f) return;
+    f.write((const uint8_t*)&c, sizeof(c));
+    f.close();
+    flashWrites++;
+}
+
+void EventJournal::loadCursor() {
+    File f = LittleFS.open(CURSOR_FILE, "r");
+    if (!f) return;
+    JournalCursor c;
+    bool ok = f.read((uint8_t*)&c, sizeof(c)) == sizeof(c);
+    f.close();
+    if (!ok || c.magic != CURSOR_MAGIC ||
+        c.crc != esp_rom_crc32_le(0, (const uint8_t*)&c, offsetof(JournalCursor, crc))) {
+        return;
+    }
+    if (c.segment != firstSegment || c.offset > segmentRecordCount(firstSegment)) return;
+    readOffset = c.offset;
+    flashRecords -= (readOffset > flashRecords) ? flashRecords : readOffset;
+}
+
+size_t EventJournal::pendingCount() {
+    return flashRecords + bufferCount;
+}
+
+bool EventJournal::recordEpochMs(const JournalRecord& rec, uint64_t* out) {
+    if (rec.flags & JOURNAL_FLAG_EPOCH_VALID) {
+        *out = rec.epochMs;
+        return true;
+    }
+    // Same boot and NTP synced since: back-date from the current uptime
+    uint64_t now;
+    if (rec.bootId == bootId && currentEpochMs(&now)) {
+        *out = now - (millis() - rec.uptimeMs);
+        return true;
+    }
+    return false;
+}
+
+void EventJournal::printStats() {
+    Serial.printf("Journal: %u pending, %u written, %u replayed, %u dropped, %u corrupt, %u flash writes, segs %lu-%lu\n",
+                  (unsigned)pendingCount(), (unsigned)recordsWritten, (unsigned)recordsReplayed,
+                  (unsigned)recordsDropped, (unsigned)corruptRecords, (unsigned)flashWrites,
+                  (unsigned long)firstSegment, (unsigned long)lastSegment);
+}
@@ -0,0 +1,124 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// ============================================================================
+// EVENT JOURNAL - Smart Parcel Locker
+// ============================================================================
+// Append-only offline journal on LittleFS for events that could not be sent:
+// - Fixed-size, CRC-checked records (history events and lock/door status)
+// - append() only touches a RAM buffer and is safe from any task
+// - service() writes buffered records in groups (wear: no one-record writes)
+// - Bounded: at most SEGMENT_COUNT files of SEGMENT_RECORDS records; when full
+//   the oldest segment is discarded and counted as dropped
+// - Replay: readBatch()/commitBatch() hand the oldest records to CloudWriter, which
+//   uploads them as large multi-path updates once Firebase is back. The read
+//   position in the oldest segment is saved with every commit, so a reboot
+//   mid-replay never resends a committed batch (its rollups are increments)
+//
+// Timestamps: epoch ms from NTP when synced. Records made before NTP sync keep
+// boot id + uptime so the epoch can still be derived later in the same boot.
+
+#define JOURNAL_TYPE_HISTORY  1
+#define JOURNAL_TYPE_STATUS   2
+
+#define JOURNAL_FLAG_EPOCH_VALID  0x01
+
+struct __attribute__((packed)) JournalRecord {
+    uint16_t magic;
+    uint8_t type;           // JOURNAL_TYPE_*
+    uint8_t flags;          // JOURNAL_FLAG_*
+    uint32_t seq;           // Monotonic; continues across reboots while records
+                            // are pending, restarts once the journal is empty
+    uint32_t bootId;
+    uint32_t uptimeMs;
+    uint64_t epochMs;
+    union {
+        struct {            // JOURNAL_TYPE_HISTORY
+            char parcelId[32];
+            char event[32];
+        };
+        struct {            // JOURNAL_TYPE_STATUS: bit n = compartment n+1
+            uint8_t locksOpen;
+            uint8_t doorsOpen;
+        };
+    };
+    uint32_t crc;           // CRC32 over all preceding bytes
+};
+
+class EventJournal {
+public:
+    EventJournal();
+
+    // Mount LittleFS, scan existing segments, restore the sequence counter
+    bool begin();
+
+    // Any task: record an event (RAM only, flushed by service())
+    bool appendHistory(const char* parcelId, const char* event);
+    // Same, keeping the time the event happened (valid: epochMs is set)
+    bool appendHistory(const char* parcelId, const char* event, uint64_t epochMs, bool valid);
+    bool appendStatus(uint8_t locksOpen, uint8_t doorsOpen);
+
+    // Cloud task: write buffered records to flash when due
+    void service();
+
+    // Cloud task: oldest unsent records (buffer is flushed first). Corrupt
+    // records are skipped. Returns number of valid records copied into out.
+    size_t readBatch(JournalRecord* out, size_t max);
+
+    // Cloud task: the last readBatch() was uploaded — release its records
+    void commitBatch();
+
+    // Records waiting for replay (flash + RAM)
+    size_t pendingCount();
+
+    // Epoch ms for a record; false if it can no longer be derived
+    bool recordEpochMs(const JournalRecord& rec, uint64_t* out);
+
+    void printStats();
+
+    static const size_t SEGMENT_RECORDS = 64;      // ~5.9 KB per segment
+    static const size_t SEGMENT_COUNT = 8;         // ~47 KB flash worst case
+    static const size_t BUFFER_RECORDS = 32;       // RAM staging before flash
+    static const size_t FLUSH_THRESHOLD = 8;       // Group size for one write
+    static const unsigned long FLUSH_MAX_AGE_MS = 2000;
+
+private:
+    SemaphoreHandle_t mutex;
+    bool mounted;
+
+    JournalRecord buffer[BUFFER_RECORDS];
+    size_t bufferCount;
+    unsigned long bufferOldestAt;
+
+    uint32_t nextSeq;
+    uint32_t bootId;
+    uint32_t firstSegment;      // Oldest segment number on flash
+    uint32_t lastSegment;       // Segment currently appended to
+    size_t lastSegmentRecords;  // Records already in lastSegment
+    size_t readOffset;          // Records of firstSegment already replayed
+    size_t flashRecords;        // Unreplayed records on flash
+    size_t batchConsumed;       // Raw records covered by the last readBatch()
+    bool batchFromBuffer;       // Last batch came from RAM (flash unavailable)
+
+    uint32_t recordsWritten;
+    uint32_t recordsReplayed;
+    uint32_t recordsDropped;
+    uint32_t corruptRecords;
+    uint32_t flashWrites;
+
+    bool append(JournalRecord& rec);
+    void flushBuffer();
+    void dropOldestSegment();
+    void saveCursor();
+    void loadCursor();
+    size_t segmentRecordCount(uint32_t segment);
+    static void segmentPath(uint32_t segment, char* out, size_t len);
+    static uint32_t recordCrc(const JournalRecord& rec);
+    static bool currentEpochMs(uint64_t* out);
+};
+
+#endif // EVENT_JOURNAL_H
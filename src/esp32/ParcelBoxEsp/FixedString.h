@@ -0,0 +1,91 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// ============================================================================
+// FIXED STRING - Smart Parcel Locker
+// ============================================================================
+// Fixed-capacity, NUL-terminated string stored inline (stack, struct member
+// or global). Drop-in for the Arduino String uses on long-running paths:
+// - Never allocates: no heap fragmentation over months of uptime
+// - Writes are truncated to N-1 characters, never overflow
+// - printf()/appendf() replace "a" + String(b) + "c" concatenation
+//
+// N is the buffer size including the terminator.
+
+template <size_t N>
+class FixedString {
+    static_assert(N > 1, "FixedString needs room for at least one character");
+
+public:
+    FixedString() { buf[0] = '\0'; }
+    FixedString(const char* s) { set(s); }
+
+    FixedString& operator=(const char* s) { set(s); return *this; }
+
+    void set(const char* s) { strlcpy(buf, s ? s : "", N); }
+    void clear() { buf[0] = '\0'; }
+
+    FixedString& append(const char* s) {
+        strlcat(buf, s ? s : "", N);
+        return *this;
+    }
+
+    int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, N, fmt, args);
+        va_end(args);
+        return n;
+    }
+
+    int appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        size_t len = length();
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, N - len, fmt, args);
+        va_end(args);
+        return n;
+    }
+
+    void trim() {
+        char* start = buf;
+        while (*start && isspace((unsigned char)*start)) start++;
+        char* end = start + strlen(start);
+        while (end > start && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+        if (start != buf) memmove(buf, start, end - start + 1);
+    }
+
+    void toLowerCase() {
+        for (char* p = buf; *p; p++) *p = tolower((unsigned char)*p);
+    }
+
+    // Remove every occurrence of c (e.g. quotes around RTDB string values)
+    void remove(char c) {
+        char* out = buf;
+        for (const char* in = buf; *in; in++) {
+            if (*in != c) *out++ = *in;
+        }
+        *out = '\0';
+    }
+
+    bool startsWith(const char* prefix) const {
+        return strncmp(buf, prefix, strlen(prefix)) == 0;
+    }
+
+    bool operator==(const char* s) const { return strcmp(buf, s ? s : "") == 0; }
+    bool operator!=(const char* s) const { return !(*this == s); }
+
+    const char* c_str() const { return buf; }
+    size_t length() const { return strlen(buf); }
+    bool empty() const { return buf[0] == '\0'; }
+    static constexpr size_t capacity() { return N - 1; }
+
+private:
+    char buf[N];
+};
+
+#endif // FIXED_STRING_H
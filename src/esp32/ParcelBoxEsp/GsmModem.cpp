@@ -0,0 +1,504 @@
+#include "GsmModem.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// GSM MODEM DRIVER IMPLEMENTATION
+// ============================================================================
+
+// Sent once per boot, in order. A failing step is logged and skipped: the
+// modem still sends SMS in text mode with the rest of the defaults.
+static const char* const CONFIG_SCRIPT[] = {
+    "ATE0",                 // No echo: every line is a response or URC
+    "AT+CMEE=1",            // Numeric +CME/+CMS error codes
+    "AT+CMGF=1",            // SMS text mode
+    "AT+CSCS=\"GSM\"",
+    "AT+CNMI=2,1,0,0,0",    // +CMTI URC for incoming SMS
+    "AT+CSCLK=2",           // Sleep on UART silence, wake on the next byte
+};
+static const uint8_t CONFIG_STEPS = sizeof(CONFIG_SCRIPT) / sizeof(CONFIG_SCRIPT[0]);
+
+static const char CTRL_Z = 0x1A;    // Ends the SMS body
+static const char ESC = 0x1B;       // Abandons SMS input
+
+GsmModem::GsmModem()
+    : port(nullptr), rstPin(-1), state(GSM_STATE_RESET), stateAt(0), deadline(0), cmdSentUs(0),
+      configStep(0), timeouts(0), lastActivity(0), lastSubmitEnd(0), lastUartAt(0), wakeTries(0),
+      wakeStartUs(0), resetRequested(false),
+      monitor(false), smsReady(false), lineLen(0), pending(0), nextOrder(0), active(-1),
+      lastMessageRef(-1), mux(portMUX_INITIALIZER_UNLOCKED), rawPending(false), rawInFlight(false),
+      sent(0), failed(0), retries(0), dropped(0), resets(0), cmdTimeouts(0), smsReceived(0),
+      rings(0), wakes(0), maxPending(0) {
+    memset(table, 0, sizeof(table));
+    memset(latency, 0, sizeof(latency));
+    rawCmd[0] = '\0';
+    line[0] = '\0';
+}
+
+void GsmModem::begin(HardwareSerial& serial, uint32_t baud, int8_t rxPin, int8_t txPin, int8_t resetPin) {
+    port = &serial;
+    rstPin = resetPin;
+    // A TX buffer larger than the FIFO lets a 160-char body go out without
+    // blocking the gsm task (~170 ms at 9600 baud)
+    port->setRxBufferSize(512);
+    port->setTxBufferSize(256);
+    port->begin(baud, SERIAL_8N1, rxPin, txPin);
+    if (rstPin >= 0) {
+        // Pulse here rather than in poll(): the modem can then boot while
+        // setup() is still bringing up WiFi, before the gsm task starts
+        pinMode(rstPin, OUTPUT);
+        digitalWrite(rstPin, LOW);
+        delay(GSM_RESET_PULSE_MS);
+        digitalWrite(rstPin, HIGH);
+    }
+    enter(GSM_STATE_BOOTING);
+}
+
+void GsmModem::enter(GsmState s) {
+    state = s;
+    stateAt = millis();
+}
+
+void GsmModem::startReset() {
+    requeueActive();
+    rawInFlight = false;
+    smsReady = false;
+    timeouts = 0;
+    lineLen = 0;
+    resets++;
+    if (rstPin >= 0) digitalWrite(rstPin, LOW);
+    enter(GSM_STATE_RESET);
+}
+
+void GsmModem::sendCommand(const char* cmd, uint32_t timeoutMs) {
+    port->print(cmd);
+    port->print('\r');
+    cmdSentUs = esp_timer_get_time();
+    deadline = millis() + timeoutMs;
+    lastUartAt = millis();
+}
+
+void GsmModem::record(GsmLatency which, int64_t startUs) {
+    uint32_t us = (uint32_t)(esp_timer_get_time() - startUs);
+    portENTER_CRITICAL(&mux);
+    LatencyStat& l = latency[which];
+    l.count++;
+    l.lastUs = us;
+    l.totalUs += us;
+    if (us > l.maxUs) l.maxUs = us;
+    portEXIT_CRITICAL(&mux);
+}
+
+// ============================================================================
+// STATE MACHINE
+// ============================================================================
+void GsmModem::poll() {
+    if (!port) return;
+    if (resetRequested) {
+        resetRequested = false;
+        Serial.println(F("[GSM] Reset requested"));
+        startReset();
+    }
+
+    readLines();
+
+    unsigned long now = millis();
+    switch (state) {
+    case GSM_STATE_RESET:
+        if (now - stateAt >= GSM_RESET_PULSE_MS) {
+            if (rstPin >= 0) digitalWrite(rstPin, HIGH);
+            enter(GSM_STATE_BOOTING);
+        }
+        break;
+
+    case GSM_STATE_BOOTING:
+        if (smsReady || now - stateAt >= GSM_BOOT_MS) {
+            enter(GSM_STATE_PROBE);
+            sendCommand("AT", GSM_CMD_TIMEOUT_MS);
+        }
+        break;
+
+    case GSM_STATE_IDLE: {
+        if (now - lastUartAt >= GSM_SLEEP_IDLE_MS && workDue(now)) {
+            startWake();
+            break;
+        }
+        char cmd[GSM_RAW_CMD_MAX];
+        bool haveRaw = false;
+        portENTER_CRITICAL(&mux);
+        if (rawPending) {
+            strlcpy(cmd, rawCmd, sizeof(cmd));
+            rawPending = false;
+            haveRaw = true;
+        }
+        portEXIT_CRITICAL(&mux);
+
+        if (haveRaw) {
+            Serial.printf("[GSM] Sending: %s\n", cmd);
+            rawInFlight = true;
+            enter(GSM_STATE_COMMAND);
+            sendCommand(cmd, GSM_CMD_TIMEOUT_MS);
+        } else {
+            startNextSms();
+            if (state == GSM_STATE_IDLE && now - lastActivity >= GSM_PING_MS) {
+                // Asleep by now: the wake-up AT is the ping
+                lastActivity = now;
+                startWake();
+            }
+        }
+        break;
+    }
+
+    default:
+        // Command in flight
+        if ((long)(now - deadline) >= 0) onTimeout();
+        break;
+    }
+}
+
+void GsmModem::readLines() {
+    while (port->available()) {
+        char c = (char)port->read();
+        if (c == '\r') continue;
+        if (c == '\n') {
+            if (lineLen) {
+                line[lineLen] = '\0';
+                lineLen = 0;
+                handleLine(line);
+            }
+            continue;
+        }
+        if (lineLen < GSM_LINE_MAX - 1) line[lineLen++] = c;
+
+        // The message prompt ("> ") is not newline-terminated
+        if (state == GSM_STATE_SMS_PROMPT && lineLen == 1 && line[0] == '>') {
+            lineLen = 0;
+            onPrompt();
+        }
+    }
+}
+
+void GsmModem::handleLine(char* text) {
+    while (*text == ' ') text++;
+    if (!*text) return;
+    lastActivity = millis();
+    lastUartAt = lastActivity;
+    if (monitor || rawInFlight) Serial.printf("[GSM] %s\n", text);
+
+    if (handleUrc(text)) return;
+
+    if (strcmp(text, "OK") == 0) {
+        onFinal(true, text);
+    } else if (strcmp(text, "ERROR") == 0 || strncmp(text, "+CMS ERROR", 10) == 0 ||
+               strncmp(text, "+CME ERROR", 10) == 0) {
+        onFinal(false, text);
+    } else if (strncmp(text, "+CMGS:", 6) == 0) {
+        lastMessageRef = (int16_t)atoi(text + 6);
+    }
+    // Anything else is an intermediate response (or echo before ATE0)
+}
+
+bool GsmModem::handleUrc(const char* text) {
+    if (strcmp(text, "RDY") == 0) {
+        // Modem rebooted on its own (brown-out, watchdog): configure again
+        if (state > GSM_STATE_BOOTING) {
+            Serial.println(F("[GSM] Modem restarted - reconfiguring"));
+            requeueActive();
+            rawInFlight = false;
+            smsReady = false;
+            enter(GSM_STATE_BOOTING);
+        }
+        return true;
+    }
+    if (strcmp(text, "SMS Ready") == 0) { smsReady = true; return true; }
+    if (strcmp(text, "Call Ready") == 0) return true;
+    if (strncmp(text, "+CMTI:", 6) == 0) { smsReceived++; return true; }
+    if (strcmp(text, "RING") == 0) { rings++; return true; }
+    if (strncmp(text, "+CPIN:", 6) == 0 || strncmp(text, "+CFUN:", 6) == 0) {
+        if (strstr(text, "NOT")) Serial.printf("[GSM] %s\n", text);
+        return true;
+    }
+    if (strstr(text, "POWER DOWN")) {
+        Serial.printf("[GSM] %s - resetting modem\n", text);
+        startReset();
+        return true;
+    }
+    if (strstr(text, "VOLTAGE WARNNING")) {     // Sic: SIM800 firmware spelling
+        Serial.printf("[GSM] %s\n", text);
+        return true;
+    }
+    return false;
+}
+
+void GsmModem::onFinal(bool ok, const char* text) {
+    if (ok && state != GSM_STATE_SMS_SUBMIT && state != GSM_STATE_SMS_PROMPT) {
+        record(GSM_LAT_COMMAND, cmdSentUs);
+    }
+    timeouts = 0;
+
+    switch (state) {
+    case GSM_STATE_PROBE:
+        if (!ok) {
+            sendCommand("AT", GSM_CMD_TIMEOUT_MS);
+            break;
+        }
+        configStep = 0;
+        enter(GSM_STATE_CONFIG);
+        sendCommand(CONFIG_SCRIPT[0], GSM_CMD_TIMEOUT_MS);
+        break;
+
+    case GSM_STATE_CONFIG:
+        if (!ok) Serial.printf("[GSM] %s -> %s\n", CONFIG_SCRIPT[configStep], text);
+        if (++configStep < CONFIG_STEPS) {
+            sendCommand(CONFIG_SCRIPT[configStep], GSM_CMD_TIMEOUT_MS);
+        } else {
+            enter(GSM_STATE_IDLE);
+            Serial.printf("[GSM] Modem ready, %u SMS pending\n", (unsigned)pending);
+        }
+        break;
+
+    case GSM_STATE_COMMAND:
+        rawInFlight = false;
+        enter(GSM_STATE_IDLE);
+        break;
+
+    case GSM_STATE_WAKING:
+        // ERROR is an answer too: the modem is awake
+        record(GSM_LAT_WAKE, wakeStartUs);
+        enter(GSM_STATE_IDLE);
+        break;
+
+    case GSM_STATE_SMS_PROMPT:
+        // Rejected before the prompt (bad number, SIM not registered)
+        finishSms(false, text);
+        enter(GSM_STATE_IDLE);
+        break;
+
+    case GSM_STATE_SMS_SUBMIT:
+        record(GSM_LAT_SUBMIT, cmdSentUs);
+        finishSms(ok, text);
+        enter(GSM_STATE_IDLE);
+        break;
+
+    default:
+        break;      // Stray result code (e.g. after a timeout)
+    }
+}
+
+void GsmModem::onPrompt() {
+    record(GSM_LAT_PROMPT, cmdSentUs);
+    if (active < 0) {
+        port->write(ESC);
+        enter(GSM_STATE_IDLE);
+        return;
+    }
+    port->print(table[active].msg.message);
+    port->write(CTRL_Z);
+    lastUartAt = millis();
+    cmdSentUs = esp_timer_get_time();
+    deadline = millis() + GSM_SUBMIT_TIMEOUT_MS;
+    enter(GSM_STATE_SMS_SUBMIT);
+}
+
+void GsmModem::onTimeout() {
+    // The wake-up byte is usually lost: only the last try counts as a timeout
+    if (state == GSM_STATE_WAKING && ++wakeTries < GSM_WAKE_TRIES) {
+        sendCommand("AT", GSM_WAKE_TIMEOUT_MS);
+        return;
+    }
+    cmdTimeouts++;
+    Serial.printf("[GSM] Timeout in %s\n", stateName(state));
+
+    if (state == GSM_STATE_SMS_PROMPT || state == GSM_STATE_SMS_SUBMIT) port->write(ESC);
+
+    if (++timeouts >= GSM_MAX_TIMEOUTS) {
+        Serial.println(F("[GSM] Modem not responding - hardware reset"));
+        startReset();
+        return;
+    }
+
+    switch (state) {
+    case GSM_STATE_PROBE:
+        sendCommand("AT", GSM_CMD_TIMEOUT_MS);
+        break;
+    case GSM_STATE_CONFIG:
+        onFinal(false, "timeout");
+        break;
+    case GSM_STATE_SMS_PROMPT:
+        finishSms(false, "no prompt");
+        enter(GSM_STATE_IDLE);
+        break;
+    case GSM_STATE_SMS_SUBMIT:
+        // May still have gone out; a retry can duplicate, a drop loses an alert
+        finishSms(false, "no submit result");
+        enter(GSM_STATE_IDLE);
+        break;
+    default:
+        rawInFlight = false;
+        enter(GSM_STATE_IDLE);
+        break;
+    }
+}
+
+// ============================================================================
+// OUTBOUND SMS TABLE
+// ============================================================================
+bool GsmModem::enqueue(const SmsMsg_t& sms) {
+    int slot = -1;
+    for (int i = 0; i < SMS_PENDING_MAX; i++) {
+        if (!table[i].used) { slot = i; break; }
+    }
+
+    if (slot < 0) {
+        // Full: evict the newest entry of the lowest priority below this one
+        int victim = -1;
+        for (int i = 0; i < SMS_PENDING_MAX; i++) {
+            const PendingSms& p = table[i];
+            if (i == active || p.msg.priority <= sms.priority) continue;
+            if (victim < 0 || p.msg.priority > table[victim].msg.priority ||
+                (p.msg.priority == table[victim].msg.priority && p.order > table[victim].order)) {
+                victim = i;
+            }
+        }
+        dropped++;
+        if (victim < 0) {
+            Serial.printf("[GSM] SMS table full - dropped SMS to %s\n", sms.phone);
+            return false;
+        }
+        Serial.printf("[GSM] SMS table full - evicted SMS to %s\n", table[victim].msg.phone);
+        table[victim].used = false;
+        pending--;
+        slot = victim;
+    }
+
+    PendingSms& p = table[slot];
+    p.msg = sms;
+    p.order = nextOrder++;
+    p.attempts = 0;
+    p.notBefore = millis();
+    p.used = true;
+    pending++;
+    if (pending > maxPending) maxPending = pending;
+    return true;
+}
+
+// Something for the UART: passthrough waiting or an SMS ready to go
+bool GsmModem::workDue(unsigned long now) {
+    portENTER_CRITICAL(&mux);
+    bool raw = rawPending;
+    portEXIT_CRITICAL(&mux);
+    if (raw) return true;
+    return active < 0 && now - lastSubmitEnd >= SMS_SEND_GAP_MS && pickNext(now) >= 0;
+}
+
+void GsmModem::startWake() {
+    wakes++;
+    wakeTries = 0;
+    wakeStartUs = esp_timer_get_time();
+    enter(GSM_STATE_WAKING);
+    sendCommand("AT", GSM_WAKE_TIMEOUT_MS);
+}
+
+int GsmModem::pickNext(unsigned long now) {
+    int best = -1;
+    for (int i = 0; i < SMS_PENDING_MAX; i++) {
+        const PendingSms& p = table[i];
+        if (!p.used || (long)(now - p.notBefore) < 0) continue;
+        if (best < 0 || p.msg.priority < table[best].msg.priority ||
+            (p.msg.priority == table[best].msg.priority && p.order < table[best].order)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void GsmModem::startNextSms() {
+    unsigned long now = millis();
+    if (active >= 0 || now - lastSubmitEnd < SMS_SEND_GAP_MS) return;
+    int i = pickNext(now);
+    if (i < 0) return;
+
+    active = (int8_t)i;
+    lastMessageRef = -1;
+    char cmd[40];
+    snprintf(cmd, sizeof(cmd), "AT+CMGS=\"%s\"", table[i].msg.phone);
+    enter(GSM_STATE_SMS_PROMPT);
+    sendCommand(cmd, GSM_PROMPT_TIMEOUT_MS);
+}
+
+void GsmModem::finishSms(bool ok, const char* reason) {
+    if (active < 0) return;
+    PendingSms& p = table[active];
+    active = -1;
+    lastSubmitEnd = millis();
+
+    if (ok) {
+        sent++;
+        record(GSM_LAT_DELIVERY, p.msg.queuedUs);
+        Serial.printf("[GSM] SMS to %s sent (ref %d, attempt %u)\n",
+                      p.msg.phone, (int)lastMessageRef, (unsigned)p.attempts + 1);
+    } else if (++p.attempts < SMS_MAX_ATTEMPTS) {
+        retries++;
+        uint32_t backoff = SMS_RETRY_BACKOFF_MS * p.attempts;
+        p.notBefore = millis() + backoff;
+        Serial.printf("[GSM] SMS to %s failed (%s), retry in %u s\n",
+                      p.msg.phone, reason, (unsigned)(backoff / 1000));
+        return;
+    } else {
+        failed++;
+        Serial.printf("[GSM] SMS to %s failed after %u attempts (%s)\n",
+                      p.msg.phone, (unsigned)p.attempts, reason);
+    }
+    p.used = false;
+    pending--;
+}
+
+// Modem went away mid-send: not the message's fault, so no attempt is used
+void GsmModem::requeueActive() {
+    if (active < 0) return;
+    table[active].notBefore = millis();
+    active = -1;
+}
+
+// ============================================================================
+// PASSTHROUGH & DIAGNOSTICS
+// ============================================================================
+bool GsmModem::queueRaw(const char* cmd) {
+    bool ok = false;
+    portENTER_CRITICAL(&mux);
+    if (!rawPending) {
+        strlcpy(rawCmd, cmd, sizeof(rawCmd));
+        rawPending = true;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&mux);
+    return ok;
+}
+
+const char* GsmModem::stateName(GsmState s) {
+    static const char* const names[GSM_STATE_COUNT] = {
+        "reset", "booting", "probe", "config", "idle", "command", "waking", "sms-prompt", "sms-submit"
+    };
+    return s < GSM_STATE_COUNT ? names[s] : "?";
+}
+
+void GsmModem::printStats() {
+    static const char* const phase[GSM_LAT_COUNT] = { "command", "prompt", "submit", "delivery", "wake" };
+    LatencyStat copy[GSM_LAT_COUNT];
+    portENTER_CRITICAL(&mux);
+    memcpy(copy, latency, sizeof(copy));
+    portEXIT_CRITICAL(&mux);
+
+    Serial.printf("[GSM] State %s, %u pending (max %u) | sent %u, failed %u, retries %u, dropped %u\n",
+                  stateName(state), (unsigned)pending, (unsigned)maxPending, (unsigned)sent,
+                  (unsigned)failed, (unsigned)retries, (unsigned)dropped);
+    Serial.printf("[GSM] Resets %u, timeouts %u, wakes %u, SMS received %u, rings %u\n",
+                  (unsigned)resets, (unsigned)cmdTimeouts, (unsigned)wakes, (unsigned)smsReceived,
+                  (unsigned)rings);
+    Serial.println(F("[GSM] Phase       Count  Last(ms)   Avg(ms)   Max(ms)"));
+    for (int i = 0; i < GSM_LAT_COUNT; i++) {
+        const LatencyStat& l = copy[i];
+        Serial.printf("[GSM] %-10s %6u %9.1f %9.1f %9.1f\n", phase[i], (unsigned)l.count,
+                      l.lastUs / 1000.0f, l.count ? (float)(l.totalUs / l.count) / 1000.0f : 0.0f,
+                      l.maxUs / 1000.0f);
+    }
+}
@@ -0,0 +1,174 @@
+#ifndef GSM_MODEM_H
+#define GSM_MODEM_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include "TASKS_CONFIG.h"
+
+// ============================================================================
+// GSM MODEM DRIVER - Smart Parcel Locker
+// ============================================================================
+// Non-blocking SIM800L driver, owned by the gsm task (poll() every pass):
+// - AT-command state machine: every command waits for its final result code
+//   (OK / ERROR / +CMS ERROR) or the `>` prompt instead of fixed delays
+// - Boot (hardware reset → probe → config script) runs inside the same state
+//   machine; consecutive timeouts or a power-down URC restart it
+// - URCs (RDY, SMS Ready, +CMTI, RING, power-down) are parsed on any line
+// - Outbound SMS are held in a priority table (alerts first, then FIFO) and
+//   retried with backoff; sends are spaced, never dropped for being close
+// - Round-trip latency per phase (AT, CMGS prompt, network submit, queue to
+//   delivery) for `gsm:stats`
+// The serial `gsm:<AT>` passthrough is queued here too, so the UART has a
+// single writer.
+// - Sleep: AT+CSCLK=2 lets the modem sleep once the UART has been quiet for
+//   a few seconds (incoming SMS / calls still wake it). Work after such a
+//   pause starts with a wake state that sends AT until it answers; the first
+//   one is usually swallowed by the wake-up
+
+#define SMS_PENDING_MAX         12      // Outbound SMS held by the driver
+#define SMS_MAX_ATTEMPTS        3       // Definitive failures before giving up
+#define SMS_RETRY_BACKOFF_MS    5000    // × attempt number
+#define SMS_SEND_GAP_MS         1000    // Spacing between two submissions
+
+#define GSM_LINE_MAX            128
+#define GSM_RAW_CMD_MAX         96
+#define GSM_RESET_PULSE_MS      100
+#define GSM_BOOT_MS             4000    // Reset → first AT (earlier on "SMS Ready")
+#define GSM_CMD_TIMEOUT_MS      2000    // Plain AT command
+#define GSM_PROMPT_TIMEOUT_MS   5000    // AT+CMGS → '>'
+#define GSM_SUBMIT_TIMEOUT_MS   60000   // Body → +CMGS (network dependent)
+#define GSM_PING_MS             600000  // Idle liveness probe (wakes the modem)
+#define GSM_MAX_TIMEOUTS        3       // Consecutive timeouts → hardware reset
+#define GSM_SLEEP_IDLE_MS       5000    // UART quiet time after which the modem may be asleep
+#define GSM_WAKE_TIMEOUT_MS     200     // Per wake-up AT
+#define GSM_WAKE_TRIES          3
+
+enum GsmState : uint8_t {
+    GSM_STATE_RESET = 0,    // RST held low
+    GSM_STATE_BOOTING,      // Waiting for the modem firmware
+    GSM_STATE_PROBE,        // AT until OK
+    GSM_STATE_CONFIG,       // Init script
+    GSM_STATE_IDLE,
+    GSM_STATE_COMMAND,      // Ping / passthrough in flight
+    GSM_STATE_WAKING,       // AT after sleep, until the modem answers
+    GSM_STATE_SMS_PROMPT,   // AT+CMGS sent, waiting for '>'
+    GSM_STATE_SMS_SUBMIT,   // Body + Ctrl-Z sent, waiting for +CMGS / OK
+    GSM_STATE_COUNT
+};
+
+enum GsmLatency : uint8_t {
+    GSM_LAT_COMMAND = 0,    // AT command → OK
+    GSM_LAT_PROMPT,         // AT+CMGS → '>'
+    GSM_LAT_SUBMIT,         // Ctrl-Z → OK (network round trip)
+    GSM_LAT_DELIVERY,       // sendSMS() → OK, including queueing and retries
+    GSM_LAT_WAKE,           // First wake-up AT → OK
+    GSM_LAT_COUNT
+};
+
+class GsmModem {
+public:
+    GsmModem();
+
+    // Configure the UART and pulse reset; boot completes in poll()
+    void begin(HardwareSerial& port, uint32_t baud, int8_t rxPin, int8_t txPin, int8_t rstPin);
+
+    // gsm task: read modem output, advance the state machine
+    void poll();
+
+    // gsm task: add an outbound SMS to the priority table
+    bool enqueue(const SmsMsg_t& sms);
+
+    // Any task: raw AT passthrough (responses printed until the final code)
+    bool queueRaw(const char* cmd);
+    void setMonitor(bool on) { monitor = on; }
+
+    // Any task: hardware reset on the next poll()
+    void requestReset() { resetRequested = true; }
+
+    bool isReady() const { return state >= GSM_STATE_IDLE; }
+    uint8_t pendingCount() const { return pending; }
+    void printStats();
+
+private:
+    struct PendingSms {
+        SmsMsg_t msg;
+        uint32_t order;             // Enqueue order (FIFO within a priority)
+        uint8_t attempts;
+        unsigned long notBefore;    // millis() of the next allowed attempt
+        bool used;
+    };
+
+    struct LatencyStat {
+        uint32_t count;
+        uint32_t lastUs;
+        uint32_t maxUs;
+        uint64_t totalUs;
+    };
+
+    HardwareSerial* port;
+    int8_t rstPin;
+
+    volatile GsmState state;
+    unsigned long stateAt;          // millis() the state was entered
+    unsigned long deadline;         // millis() the in-flight command times out
+    int64_t cmdSentUs;              // esp_timer time of the last command write
+    uint8_t configStep;
+    uint8_t timeouts;               // Consecutive
+    unsigned long lastActivity;     // Last line from the modem
+    unsigned long lastSubmitEnd;
+    unsigned long lastUartAt;       // Last byte either way (modem sleep)
+    uint8_t wakeTries;
+    int64_t wakeStartUs;
+    volatile bool resetRequested;
+    volatile bool monitor;
+    bool smsReady;                  // "SMS Ready" URC seen since boot
+
+    char line[GSM_LINE_MAX];
+    uint8_t lineLen;
+
+    PendingSms table[SMS_PENDING_MAX];
+    uint8_t pending;
+    uint32_t nextOrder;
+    int8_t active;                  // Table index being sent, -1 when none
+    int16_t lastMessageRef;         // From +CMGS: <mr>
+
+    // Passthrough slot (written by any task, guarded by mux)
+    portMUX_TYPE mux;
+    char rawCmd[GSM_RAW_CMD_MAX];
+    bool rawPending;
+    bool rawInFlight;
+
+    // Statistics
+    volatile uint32_t sent;
+    volatile uint32_t failed;
+    volatile uint32_t retries;
+    volatile uint32_t dropped;
+    volatile uint32_t resets;
+    volatile uint32_t cmdTimeouts;
+    volatile uint32_t smsReceived;
+    volatile uint32_t rings;
+    volatile uint32_t wakes;
+    volatile uint8_t maxPending;
+    LatencyStat latency[GSM_LAT_COUNT];
+
+    void enter(GsmState s);
+    void startReset();
+    void sendCommand(const char* cmd, uint32_t timeoutMs);
+    void readLines();
+    void handleLine(char* text);
+    bool handleUrc(const char* text);
+    void onFinal(bool ok, const char* text);
+    void onPrompt();
+    void onTimeout();
+    void startNextSms();
+    bool workDue(unsigned long now);
+    void startWake();
+    int pickNext(unsigned long now);
+    void finishSms(bool ok, const char* reason);
+    void requeueActive();
+    void record(GsmLatency which, int64_t startUs);
+
+    static const char* stateName(GsmState s);
+};
+
+#endif // GSM_MODEM_H
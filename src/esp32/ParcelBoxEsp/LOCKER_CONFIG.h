@@ -0,0 +1,50 @@
+#ifndef LOCKER_CONFIG_H
+#define LOCKER_CONFIG_H
+
+#include <Arduino.h>
+#include "PINS_CONFIG.h"
+#include "ESPNOW_CONFIG.h"
+
+// ============================================================================
+// LOCKER LAYOUT - Smart Parcel Locker
+// ============================================================================
+// What one main board serves, as two tables indexed by ID:
+// - Compartments: one solenoid lock relay + one reed switch each. Compartment
+//   IDs are 1-based (relay-<n>, reed-<n>, /lock<n>, locks_status/.../lock<n>)
+// - Cameras: one ESP32-CAM scanner each. A valid scan from a camera opens the
+//   compartments in its `opens` mask; closing its delivery door completes
+//   the delivery. Each camera runs its own delivery workflow, so scans from
+//   different cameras are handled side by side.
+//
+// Adding a compartment or camera is a table row here, nothing else.
+
+#define COMPARTMENT_COUNT   2       // Max 8 (status bit masks are 8 bits)
+#define CAMERA_COUNT        1       // Max ESPNOW_MAX_PEERS
+
+#define COMPARTMENT_BIT(id) (1u << ((id) - 1))
+
+typedef struct {
+  uint8_t relayPin;       // LOW = unlocked
+  uint8_t doorPin;        // Reed switch, HIGH = open (INPUT_PULLUP)
+  const char* label;      // LCD / log / SMS name
+} CompartmentConfig_t;
+
+typedef struct {
+  uint8_t mac[6];
+  uint8_t opens;          // COMPARTMENT_BIT() mask opened by a valid scan
+  uint8_t deliveryDoor;   // Compartment ID whose closing completes the delivery
+} CameraConfig_t;
+
+// Indexed by compartment ID - 1
+static const CompartmentConfig_t COMPARTMENTS[COMPARTMENT_COUNT] = {
+  { RELAY_1_PIN, DOOR_SENSOR_1_PIN, "Parcel door" },
+  { RELAY_2_PIN, DOOR_SENSOR_2_PIN, "Payment box" },
+};
+
+// Indexed by camera number - 1 (EspNowManager peer index)
+static const CameraConfig_t CAMERAS[CAMERA_COUNT] = {
+  { { CAM_MAC_0, CAM_MAC_1, CAM_MAC_2, CAM_MAC_3, CAM_MAC_4, CAM_MAC_5 },
+    COMPARTMENT_BIT(1) | COMPARTMENT_BIT(2), 1 },
+};
+
+#endif // LOCKER_CONFIG_H
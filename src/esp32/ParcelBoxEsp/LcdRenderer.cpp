@@ -0,0 +1,133 @@
+#include "LcdRenderer.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// LCD RENDERER IMPLEMENTATION
+// ============================================================================
+
+LcdRenderer::LcdRenderer()
+    : lcd(nullptr), dirty(false), cursorRow(-1), cursorCol(-1), haveScheduled(false),
+      scheduledAt(0), lastFlush(0), screens(0), flushes(0), unchanged(0), cancelled(0),
+      charsWritten(0), cursorMoves(0), lastFlushUs(0), maxFlushUs(0) {
+    memset(glass, ' ', sizeof(glass));
+    memset(target, ' ', sizeof(target));
+    memset(&scheduled, 0, sizeof(scheduled));
+}
+
+void LcdRenderer::begin(LiquidCrystal_I2C& display) {
+    lcd = &display;
+    memset(glass, ' ', sizeof(glass));
+    cursorRow = -1;
+    cursorCol = -1;
+    dirty = memcmp(glass, target, sizeof(glass)) != 0;
+}
+
+void LcdRenderer::invalidate() {
+    memset(glass, 0, sizeof(glass));    // Never equal to a padded target cell
+    cursorRow = -1;
+    dirty = true;
+}
+
+// ============================================================================
+// SCREENS
+// ============================================================================
+void LcdRenderer::submit(const UiMsg_t& msg) {
+    if (haveScheduled) {
+        // Any newer screen supersedes a pending timed transition
+        haveScheduled = false;
+        cancelled++;
+    }
+    if (msg.delayMs) {
+        scheduled = msg;
+        scheduledAt = millis() + msg.delayMs;
+        haveScheduled = true;
+        return;
+    }
+    apply(msg);
+}
+
+void LcdRenderer::apply(const UiMsg_t& msg) {
+    screens++;
+    for (int row = 0; row < LCD_ROWS; row++) {
+        const char* text = msg.lines[row];
+        int col = 0;
+        for (; col < LCD_COLS && text[col]; col++) target[row][col] = text[col];
+        for (; col < LCD_COLS; col++) target[row][col] = ' ';
+    }
+    dirty = memcmp(glass, target, sizeof(glass)) != 0;
+    if (!dirty) unchanged++;
+}
+
+TickType_t LcdRenderer::service() {
+    unsigned long now = millis();
+    if (haveScheduled && (long)(now - scheduledAt) >= 0) {
+        haveScheduled = false;
+        apply(scheduled);
+    }
+
+    uint32_t waitMs = UINT32_MAX;
+    if (dirty && lcd) {
+        unsigned long since = now - lastFlush;
+        if (since >= LCD_FRAME_MS) flush();
+        else waitMs = LCD_FRAME_MS - since;
+    }
+    if (haveScheduled) {
+        long left = (long)(scheduledAt - now);
+        waitMs = min(waitMs, (uint32_t)max(left, 0L));
+    }
+    // +1 tick so the wake-up lands after the deadline, not just before it
+    return waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs) + 1;
+}
+
+// ============================================================================
+// FLUSH
+// ============================================================================
+void LcdRenderer::writeRun(int row, int from, int to) {
+    if (cursorRow != row || cursorCol != from) {
+        lcd->setCursor(from, row);
+        cursorMoves++;
+    }
+    for (int col = from; col <= to; col++) {
+        lcd->write((uint8_t)target[row][col]);
+        glass[row][col] = target[row][col];
+    }
+    charsWritten += to - from + 1;
+    cursorRow = row;
+    cursorCol = to + 1;     // Past the last column the HD44780 wraps oddly; never matches
+}
+
+void LcdRenderer::flush() {
+    int64_t t0 = esp_timer_get_time();
+
+    for (int row = 0; row < LCD_ROWS; row++) {
+        int col = 0;
+        while (col < LCD_COLS) {
+            if (glass[row][col] == target[row][col]) { col++; continue; }
+
+            // Extend the run over short unchanged gaps: rewriting a cell costs
+            // about as much I2C traffic as the setCursor it saves
+            int last = col;
+            for (int c = col + 1; c < LCD_COLS; c++) {
+                if (glass[row][c] != target[row][c]) last = c;
+                else if (c - last > LCD_RUN_MERGE_GAP) break;
+            }
+            writeRun(row, col, last);
+            col = last + 1;
+        }
+    }
+
+    dirty = false;
+    lastFlush = millis();
+    flushes++;
+    lastFlushUs = (uint32_t)(esp_timer_get_time() - t0);
+    if (lastFlushUs > maxFlushUs) maxFlushUs = lastFlushUs;
+}
+
+void LcdRenderer::printStats() {
+    Serial.printf("[LCD] %u screens (%u unchanged, %u timed cancelled), %u flushes\n",
+                  (unsigned)screens, (unsigned)unchanged, (unsigned)cancelled, (unsigned)flushes);
+    Serial.printf("[LCD] %u chars, %u cursor moves (clear+redraw would be %u chars); flush %u us last, %u us max\n",
+                  (unsigned)charsWritten, (unsigned)cursorMoves,
+                  (unsigned)(flushes * LCD_ROWS * LCD_COLS),
+                  (unsigned)lastFlushUs, (unsigned)maxFlushUs);
+}
@@ -0,0 +1,72 @@
+#ifndef LCD_RENDERER_H
+#define LCD_RENDERER_H
+
+#include <Arduino.h>
+#include <LiquidCrystal_I2C.h>
+#include "PINS_CONFIG.h"
+#include "TASKS_CONFIG.h"
+
+// ============================================================================
+// LCD RENDERER - Smart Parcel Locker
+// ============================================================================
+// Shadow framebuffer for the 20x4 HD44780 (owned by the ui task):
+// - Screens are padded to full rows and compared with what is on the glass;
+//   only changed runs are written, no lcd.clear() (≈1.6 ms + full redraw)
+// - Cursor position is tracked so consecutive runs skip setCursor()
+// - Flushes are rate-capped (LCD_FRAME_MS); screens arriving in between
+//   coalesce into one flush
+// - A screen with delayMs is scheduled: it replaces the display after the
+//   delay unless another screen arrives first (timed "Denied → READY" screens
+//   without delay() on the caller)
+
+#define LCD_FRAME_MS            50      // Max ~20 flushes/s
+#define LCD_RUN_MERGE_GAP       1       // Unchanged chars rewritten to save a setCursor
+
+class LcdRenderer {
+public:
+    LcdRenderer();
+
+    // After lcd.init()/clear(): glass is blank, cursor unknown
+    void begin(LiquidCrystal_I2C& lcd);
+
+    // ui task: accept a screen (immediate or scheduled)
+    void submit(const UiMsg_t& msg);
+
+    // ui task: apply due screens and flush if allowed.
+    // Returns: ticks until the next scheduled screen or allowed flush
+    TickType_t service();
+
+    // Rewrite every cell on the next flush (e.g. after an I2C glitch)
+    void invalidate();
+
+    void printStats();
+
+private:
+    LiquidCrystal_I2C* lcd;
+    char glass[LCD_ROWS][LCD_COLS];     // What the display shows
+    char target[LCD_ROWS][LCD_COLS];    // What it should show
+    bool dirty;
+    int8_t cursorRow;                   // -1 = unknown
+    int8_t cursorCol;
+
+    UiMsg_t scheduled;
+    bool haveScheduled;
+    unsigned long scheduledAt;          // millis() it becomes due
+    unsigned long lastFlush;
+
+    // Statistics
+    uint32_t screens;
+    uint32_t flushes;
+    uint32_t unchanged;                 // Screens identical to the glass
+    uint32_t cancelled;                 // Scheduled screens superseded
+    uint32_t charsWritten;
+    uint32_t cursorMoves;
+    uint32_t lastFlushUs;
+    uint32_t maxFlushUs;
+
+    void apply(const UiMsg_t& msg);
+    void flush();
+    void writeRun(int row, int from, int to);
+};
+
+#endif // LCD_RENDERER_H
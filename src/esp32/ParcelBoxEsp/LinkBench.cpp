@@ -0,0 +1,371 @@
+#include "LinkBench.h"
+#include "EspNowManager.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// LINK BENCH IMPLEMENTATION
+// ============================================================================
+
+static const char* const MODE_NAMES[] = { "ping", "tx", "rx" };
+
+LinkBench::LinkBench()
+    : espNow(nullptr), task(nullptr), active(false), runId(0), runMode(0), runSize(0),
+      mux(portMUX_INITIALIZER_UNLOCKED), waitOp(0xFF), replyReceived(false), waitSeq(0xFFFF),
+      pongRxUs(0), pongTurnaroundUs(0), pongRssiHere(0), pongRssiCam(0), pongReceived(false),
+      floodReceived(0), floodFirstUs(0), floodLastUs(0), floodRssiSum(0), floodRssiMin(0),
+      macFailures(0), runs(0), unanswered(0) {
+    memset(&config, 0, sizeof(config));
+    memset(&reply, 0, sizeof(reply));
+    memset(frame, 0, sizeof(frame));
+    memset(&last, 0, sizeof(last));
+}
+
+void LinkBench::begin(EspNowManager* manager) {
+    espNow = manager;
+}
+
+bool LinkBench::start(const LinkBenchConfig& request) {
+    if (active || !espNow || request.camera >= espNow->peerCount()) return false;
+    config = request;
+    if (config.size < sizeof(ESPNOW_BenchFrame_t)) config.size = sizeof(ESPNOW_BenchFrame_t);
+    if (config.count == 0) config.count = 1;
+    if (config.count > LINKBENCH_MAX_COUNT) config.count = LINKBENCH_MAX_COUNT;
+    if (runId == 0) runId = esp_random();
+
+    active = true;
+    if (xTaskCreatePinnedToCore(taskEntry, "linkbench", LINKBENCH_TASK_STACK, this,
+                                LINKBENCH_TASK_PRIORITY, &task, LINKBENCH_TASK_CORE) != pdPASS) {
+        active = false;
+        return false;
+    }
+    return true;
+}
+
+void LinkBench::taskEntry(void* arg) {
+    static_cast<LinkBench*>(arg)->runAll();
+    vTaskDelete(nullptr);
+}
+
+void LinkBench::runAll() {
+    LinkBenchResult result;
+    if (config.survey) {
+        static const uint8_t SIZES[] = LINKBENCH_SURVEY_SIZES;
+        for (uint8_t mode = ESPNOW_BENCH_MODE_PING; mode <= ESPNOW_BENCH_MODE_FLOOD_RX; mode++) {
+            for (uint8_t size : SIZES) {
+                run(mode, size, result);
+                print(result);
+                if (!result.camChannel) break;  // Nobody there: skip the rest of the survey
+            }
+            if (!result.camChannel) break;
+        }
+    } else {
+        run(config.mode, config.size, result);
+        print(result);
+    }
+    task = nullptr;
+    active = false;
+}
+
+// ============================================================================
+// ONE RUN (bench task)
+// ============================================================================
+void LinkBench::run(uint8_t mode, uint8_t size, LinkBenchResult& out) {
+    memset(&out, 0, sizeof(out));
+    out.mode = mode;
+    out.size = size;
+    out.channel = WiFi.channel();
+
+    runId++;    // Stragglers of the previous run no longer match
+    runMode = mode;
+    runSize = size;
+    portENTER_CRITICAL(&mux);
+    waitOp = 0xFF;
+    replyReceived = false;
+    waitSeq = 0xFFFF;
+    pongReceived = false;
+    floodReceived = 0;
+    floodRssiSum = 0;
+    floodRssiMin = 0;
+    portEXIT_CRITICAL(&mux);
+    macFailures = 0;
+
+    ESPNOW_BenchFrame_t answer;
+    if (!exchange(ESPNOW_BENCH_START, ESPNOW_BENCH_READY, answer)) {
+        runs++;
+        unanswered++;
+        last = out;
+        return;
+    }
+    out.camChannel = answer.channel;
+
+    if (mode == ESPNOW_BENCH_MODE_PING) runPing(out);
+    else if (mode == ESPNOW_BENCH_MODE_FLOOD_TX) runFloodTx(out);
+    else runFloodRx(out);
+
+    // The CAM's half: what it received (tx) or sent (rx)
+    if (exchange(ESPNOW_BENCH_END, ESPNOW_BENCH_REPORT, answer)) {
+        out.answered = true;
+        out.camChannel = answer.channel;
+        if (mode == ESPNOW_BENCH_MODE_FLOOD_TX) {
+            out.received = answer.count;
+            out.elapsedUs = answer.spanUs;
+            out.rssiCam = answer.rssi;
+            out.rssiCamMin = answer.rssiMin;
+        } else if (mode == ESPNOW_BENCH_MODE_FLOOD_RX) {
+            out.sent = answer.count;
+        }
+    }
+    if (mode != ESPNOW_BENCH_MODE_PING && out.received > 1 && out.elapsedUs > 0) {
+        // Flood: first → last arrival spans received - 1 gaps
+        out.packetsPerS = (uint32_t)((uint64_t)(out.received - 1) * 1000000 / out.elapsedUs);
+    }
+    out.macFailures = macFailures;
+    runs++;
+    last = out;
+}
+
+// One PING in flight; RTT percentiles are nearest-rank over the run's
+// samples, sorted in place
+void LinkBench::runPing(LinkBenchResult& out) {
+    uint16_t n = 0;
+    int64_t firstTx = 0;
+    int64_t lastRx = 0;
+    uint64_t turnaroundSum = 0;
+    int32_t hereSum = 0;
+    int32_t camSum = 0;
+
+    for (uint16_t i = 0; i < config.count; i++) {
+        portENTER_CRITICAL(&mux);
+        waitSeq = i;
+        pongReceived = false;
+        portEXIT_CRITICAL(&mux);
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        ESPNOW_BenchFrame_t& f = header(ESPNOW_BENCH_PING, i);
+        int64_t txUs = esp_timer_get_time();
+        f.txUs = txUs;
+        if (i == 0) firstTx = txUs;
+        if (!send(runSize)) continue;
+        out.sent++;
+
+        bool got = false;
+        int64_t rxUs = 0;
+        uint32_t turnaround = 0;
+        int8_t here = 0, cam = 0;
+        unsigned long until = millis() + LINKBENCH_PING_TIMEOUT_MS;
+        long left;
+        while (!got && (left = (long)(until - millis())) > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(left) + 1);
+            portENTER_CRITICAL(&mux);
+            got = pongReceived;
+            rxUs = pongRxUs;
+            turnaround = pongTurnaroundUs;
+            here = pongRssiHere;
+            cam = pongRssiCam;
+            portEXIT_CRITICAL(&mux);
+        }
+        if (!got) continue;
+
+        if (n == 0 || here < out.rssiHereMin) out.rssiHereMin = here;
+        if (n == 0 || cam < out.rssiCamMin) out.rssiCamMin = cam;
+        rtt[n++] = (uint32_t)(rxUs - txUs);
+        turnaroundSum += turnaround;
+        hereSum += here;
+        camSum += cam;
+        lastRx = rxUs;
+    }
+    portENTER_CRITICAL(&mux);
+    waitSeq = 0xFFFF;
+    portEXIT_CRITICAL(&mux);
+
+    out.received = n;
+    if (n == 0) return;
+    out.elapsedUs = (uint32_t)(lastRx - firstTx);
+    if (out.elapsedUs) out.packetsPerS = (uint32_t)((uint64_t)n * 1000000 / out.elapsedUs);
+    out.turnaroundUs = (uint32_t)(turnaroundSum / n);
+    out.rssiHere = (int8_t)(hereSum / n);
+    out.rssiCam = (int8_t)(camSum / n);
+
+    for (uint16_t i = 1; i < n; i++) {
+        uint32_t v = rtt[i];
+        int j = i - 1;
+        while (j >= 0 && rtt[j] > v) { rtt[j + 1] = rtt[j]; j--; }
+        rtt[j + 1] = v;
+    }
+    out.rttP50 = rtt[(n * 50 + 99) / 100 - 1];
+    out.rttP90 = rtt[(n * 90 + 99) / 100 - 1];
+    out.rttP99 = rtt[(n * 99 + 99) / 100 - 1];
+    out.rttMax = rtt[n - 1];
+}
+
+void LinkBench::runFloodTx(LinkBenchResult& out) {
+    for (uint16_t i = 0; i < config.count; i++) {
+        ESPNOW_BenchFrame_t& f = header(ESPNOW_BENCH_FLOOD, i);
+        f.txUs = esp_timer_get_time();
+        if (send(runSize)) out.sent++;
+    }
+    vTaskDelay(pdMS_TO_TICKS(LINKBENCH_DRAIN_MS));     // Last frames still in the air
+}
+
+// The CAM starts as soon as it has sent READY. Done when every frame is in
+// or the flood goes quiet.
+void LinkBench::runFloodRx(LinkBenchResult& out) {
+    uint16_t seen = 0;
+    unsigned long quietSince = millis();
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        portENTER_CRITICAL(&mux);
+        uint16_t n = floodReceived;
+        portEXIT_CRITICAL(&mux);
+        if (n >= config.count) break;
+        if (n != seen) {
+            seen = n;
+            quietSince = millis();
+            continue;
+        }
+        if (millis() - quietSince >= (seen ? LINKBENCH_DRAIN_MS : LINKBENCH_HANDSHAKE_MS)) break;
+    }
+
+    portENTER_CRITICAL(&mux);
+    out.received = floodReceived;
+    out.elapsedUs = (uint32_t)(floodLastUs - floodFirstUs);
+    int32_t sum = floodRssiSum;
+    out.rssiHereMin = floodRssiMin;
+    portEXIT_CRITICAL(&mux);
+    if (out.received) out.rssiHere = (int8_t)(sum / out.received);
+}
+
+// START / END, retried until the CAM answers with answerOp for this run
+bool LinkBench::exchange(uint8_t op, uint8_t answerOp, ESPNOW_BenchFrame_t& answer) {
+    for (uint8_t attempt = 0; attempt < LINKBENCH_HANDSHAKE_TRIES; attempt++) {
+        portENTER_CRITICAL(&mux);
+        waitOp = answerOp;
+        replyReceived = false;
+        portEXIT_CRITICAL(&mux);
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        ESPNOW_BenchFrame_t& f = header(op, 0);
+        f.hdr.attempt = attempt;
+        f.mode = runMode;
+        f.size = runSize;
+        f.count = config.count;
+        send(sizeof(ESPNOW_BenchFrame_t));
+
+        unsigned long until = millis() + LINKBENCH_HANDSHAKE_MS;
+        long left;
+        while ((left = (long)(until - millis())) > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(left) + 1);
+            portENTER_CRITICAL(&mux);
+            bool got = replyReceived;
+            if (got) answer = reply;
+            portEXIT_CRITICAL(&mux);
+            if (got) return true;
+        }
+    }
+    return false;
+}
+
+// Header of the next frame; padding past it is left as is
+ESPNOW_BenchFrame_t& LinkBench::header(uint8_t op, uint16_t seq) {
+    ESPNOW_BenchFrame_t& f = *(ESPNOW_BenchFrame_t*)frame;
+    memset(&f, 0, sizeof(f));
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_BENCH;
+    f.hdr.seq = seq;
+    f.hdr.session = runId;
+    f.hdr.status = op;
+    return f;
+}
+
+// A full radio queue is waited out rather than counted as loss
+bool LinkBench::send(size_t len) {
+    const uint8_t* mac = espNow->peerMac(config.camera);
+    esp_err_t err;
+    while ((err = esp_now_send(mac, frame, len)) == ESP_ERR_ESPNOW_NO_MEM) vTaskDelay(1);
+    return err == ESP_OK;
+}
+
+// ============================================================================
+// CALLBACKS (WiFi task)
+// ============================================================================
+void LinkBench::onFrame(uint8_t camera, const uint8_t* data, int len, int8_t rssi, int64_t rxUs) {
+    if (!active || camera != config.camera) return;
+    const ESPNOW_BenchFrame_t* f = (const ESPNOW_BenchFrame_t*)data;
+    if (f->hdr.session != runId) return;
+
+    bool wake = false;
+    portENTER_CRITICAL(&mux);
+    switch (f->hdr.status) {
+        case ESPNOW_BENCH_PONG:
+            if (f->hdr.seq == waitSeq && !pongReceived) {
+                pongRxUs = rxUs;
+                pongTurnaroundUs = f->spanUs;
+                pongRssiHere = rssi;
+                pongRssiCam = f->rssi;
+                pongReceived = true;
+                wake = true;
+            }
+            break;
+        case ESPNOW_BENCH_FLOOD:
+            if (floodReceived == 0 || rssi < floodRssiMin) floodRssiMin = rssi;
+            if (floodReceived == 0) floodFirstUs = rxUs;
+            floodLastUs = rxUs;
+            floodRssiSum += rssi;
+            floodReceived++;
+            break;
+        case ESPNOW_BENCH_READY:
+        case ESPNOW_BENCH_REPORT:
+            if (f->hdr.status == waitOp) {
+                reply = *f;
+                replyReceived = true;
+                wake = true;
+            }
+            break;
+    }
+    portEXIT_CRITICAL(&mux);
+    if (wake && task) xTaskNotifyGive(task);
+}
+
+bool LinkBench::onSent(bool delivered) {
+    if (!active) return false;
+    if (!delivered) macFailures++;
+    return true;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+void LinkBench::print(const LinkBenchResult& r) {
+    const char* name = MODE_NAMES[r.mode];
+    if (!r.camChannel) {
+        Serial.printf("[LINKBENCH] %-4s %3u B: CAM %u not answering on channel %u\n",
+                      name, r.size, (unsigned)(config.camera + 1), r.channel);
+        return;
+    }
+    float loss = r.sent ? 100.0f * (r.sent - r.received) / r.sent : 0.0f;
+    Serial.printf("[LINKBENCH] %-4s %3u B: %u/%u delivered (%.1f%% loss)%s, %u pkt/s, %u kbit/s, %u MAC fails\n",
+                  name, r.size, r.received, r.sent, loss, r.answered ? "" : " [no CAM report]",
+                  (unsigned)r.packetsPerS, (unsigned)(r.packetsPerS * r.size * 8 / 1000),
+                  (unsigned)r.macFailures);
+    if (r.mode == ESPNOW_BENCH_MODE_PING && r.received) {
+        Serial.printf("[LINKBENCH]   RTT p50 %u / p90 %u / p99 %u / max %u us, CAM turnaround %u us\n",
+                      (unsigned)r.rttP50, (unsigned)r.rttP90, (unsigned)r.rttP99,
+                      (unsigned)r.rttMax, (unsigned)r.turnaroundUs);
+    }
+    // Only the receiving end of a flood has RSSI
+    bool here = r.mode != ESPNOW_BENCH_MODE_FLOOD_TX && r.received;
+    bool cam = r.mode != ESPNOW_BENCH_MODE_FLOOD_RX && r.received;
+    Serial.printf("[LINKBENCH]   RSSI here ");
+    if (here) Serial.printf("%d (min %d)", r.rssiHere, r.rssiHereMin);
+    else Serial.print("-");
+    Serial.print(", CAM ");
+    if (cam) Serial.printf("%d (min %d)", r.rssiCam, r.rssiCamMin);
+    else Serial.print("-");
+    Serial.printf(" dBm, channel %u, CAM %u\n", r.channel, r.camChannel);
+}
+
+void LinkBench::printStats() {
+    Serial.printf("[LINKBENCH] %u runs, %u unanswered%s\n",
+                  (unsigned)runs, (unsigned)unanswered, active ? ", running" : "");
+    if (runs) print(last);
+}
@@ -0,0 +1,134 @@
+#ifndef LINK_BENCH_H
+#define LINK_BENCH_H
+
+#include <Arduino.h>
+#include "ESPNOW_CONFIG.h"
+
+class EspNowManager;
+
+// ============================================================================
+// LINK BENCH - Smart Parcel Locker
+// ============================================================================
+// ESP-NOW throughput, loss and latency against one camera, for site surveys
+// and before/after checks of firmware changes. The console starts a run on
+// a throwaway task; the CAM answers from its own bench task (EspNowCamera).
+// - ping:  stop-and-wait PING → PONG. RTT percentiles are main TX → PONG
+//          arrival; the CAM's turnaround comes back in the PONG and is
+//          reported on its own
+// - tx:    FLOOD main → CAM back to back; the CAM reports what arrived
+// - rx:    FLOOD CAM → main back to back, counted in the receive callback
+//          (ahead of the scan ring, so this is the radio alone)
+// - survey: all three at every LINKBENCH_SURVEY_SIZES size
+// Each run prints packets/s, loss, RSSI on both ends and both channels. A
+// CAM that never answers START is reported with this board's channel: it is
+// most likely on another one.
+//
+// Scans keep flowing while a run is on; expect them to see its latency.
+
+#define LINKBENCH_MAX_COUNT         1000    // Data frames per run (one RTT sample each)
+#define LINKBENCH_DEFAULT_SIZE      64
+#define LINKBENCH_DEFAULT_COUNT     200
+#define LINKBENCH_SURVEY_SIZES      { 32, 64, 128, ESPNOW_BENCH_MAX_LEN }
+#define LINKBENCH_HANDSHAKE_MS      300     // START → READY and END → REPORT wait
+#define LINKBENCH_HANDSHAKE_TRIES   4
+#define LINKBENCH_PING_TIMEOUT_MS   100     // No PONG by then = lost
+#define LINKBENCH_DRAIN_MS          200     // Quiet time that ends a flood
+#define LINKBENCH_TASK_STACK        4096
+#define LINKBENCH_TASK_PRIORITY     4       // Above cloud: stamps not delayed by TLS
+#define LINKBENCH_TASK_CORE         0
+
+struct LinkBenchConfig {
+    uint8_t camera;         // Peer index (CAMERAS[] in LOCKER_CONFIG.h)
+    uint8_t mode;           // ESPNOW_BENCH_MODE_*
+    uint8_t size;           // Data frame bytes, clamped to the bench frame .. ESPNOW_BENCH_MAX_LEN
+    uint16_t count;         // 1 .. LINKBENCH_MAX_COUNT
+    bool survey;            // Every mode at every survey size; mode / size ignored
+};
+
+struct LinkBenchResult {
+    uint8_t mode;
+    uint8_t size;
+    bool answered;          // CAM completed both handshakes
+    uint16_t sent;
+    uint16_t received;
+    uint32_t elapsedUs;     // First send → last arrival
+    uint32_t packetsPerS;   // Frames delivered per second over elapsedUs
+    uint32_t rttP50;        // Ping only, us
+    uint32_t rttP90;
+    uint32_t rttP99;
+    uint32_t rttMax;
+    uint32_t turnaroundUs;  // Ping only: mean CAM PING → PONG time
+    int8_t rssiHere;        // Mean / lowest dBm of the frames this board heard
+    int8_t rssiHereMin;
+    int8_t rssiCam;         // ...and of those the CAM heard
+    int8_t rssiCamMin;
+    uint8_t channel;
+    uint8_t camChannel;     // 0 = CAM never answered
+    uint32_t macFailures;   // Sends the radio reported undelivered
+};
+
+class LinkBench {
+public:
+    LinkBench();
+
+    void begin(EspNowManager* espNow);
+
+    // Console: start a run in the background. False if one is running.
+    bool start(const LinkBenchConfig& config);
+    bool running() const { return active; }
+
+    // WiFi task: a MSG_TYPE_BENCH frame from camera
+    void onFrame(uint8_t camera, const uint8_t* data, int len, int8_t rssi, int64_t rxUs);
+    // WiFi task: MAC-layer send result. True = taken (a run is on).
+    bool onSent(bool delivered);
+
+    // Any task: last result and totals
+    void printStats();
+
+private:
+    EspNowManager* espNow;
+    TaskHandle_t task;
+    volatile bool active;
+    LinkBenchConfig config;
+    uint32_t runId;
+    uint8_t runMode;
+    uint8_t runSize;
+
+    // Hand-offs from the WiFi task (guarded by mux)
+    portMUX_TYPE mux;
+    uint8_t waitOp;                 // READY / REPORT we are waiting for
+    ESPNOW_BenchFrame_t reply;
+    bool replyReceived;
+    uint16_t waitSeq;               // PING awaiting its PONG
+    int64_t pongRxUs;
+    uint32_t pongTurnaroundUs;
+    int8_t pongRssiHere;
+    int8_t pongRssiCam;
+    bool pongReceived;
+    uint16_t floodReceived;         // CAM → main FLOOD of this run
+    int64_t floodFirstUs;
+    int64_t floodLastUs;
+    int32_t floodRssiSum;
+    int8_t floodRssiMin;
+    volatile uint32_t macFailures;
+
+    uint32_t rtt[LINKBENCH_MAX_COUNT];
+    uint8_t frame[ESPNOW_BENCH_MAX_LEN];
+
+    LinkBenchResult last;
+    uint32_t runs;
+    uint32_t unanswered;
+
+    static void taskEntry(void* arg);
+    void runAll();
+    void run(uint8_t mode, uint8_t size, LinkBenchResult& out);
+    void runPing(LinkBenchResult& out);
+    void runFloodTx(LinkBenchResult& out);
+    void runFloodRx(LinkBenchResult& out);
+    bool exchange(uint8_t op, uint8_t answerOp, ESPNOW_BenchFrame_t& answer);
+    bool send(size_t len);
+    ESPNOW_BenchFrame_t& header(uint8_t op, uint16_t seq);
+    void print(const LinkBenchResult& r);
+};
+
+#endif // LINK_BENCH_H
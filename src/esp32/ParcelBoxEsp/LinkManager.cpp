@@ -0,0 +1,124 @@
+#include "LinkManager.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// LINK MANAGER IMPLEMENTATION
+// ============================================================================
+
+LinkManager* LinkManager::instance = nullptr;
+
+LinkManager::LinkManager()
+    : owner(nullptr), mux(portMUX_INITIALIZER_UNLOCKED), up(false), drops(0), downAtUs(0),
+      apChannel(0), disconnectReason(0), reportedUp(false), reportedDrops(0),
+      reportedChannel(0), nextRetryAt(0), retryDelay(LINK_RETRY_MIN_MS), reconnectCalls(0),
+      channelChanges(0), lastOutageMs(0), maxOutageMs(0) {}
+
+void LinkManager::begin() {
+    instance = this;
+    WiFi.setAutoReconnect(true);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+}
+
+// ============================================================================
+// WIFI EVENTS (WiFi event task)
+// ============================================================================
+void LinkManager::onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    LinkManager* self = instance;
+    if (!self) return;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&self->mux);
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+            self->apChannel = info.wifi_sta_connected.channel;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            if (!self->up && self->downAtUs) {
+                uint32_t ms = (uint32_t)((now - self->downAtUs) / 1000);
+                self->lastOutageMs = ms;
+                if (ms > self->maxOutageMs) self->maxOutageMs = ms;
+            }
+            self->up = true;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+                self->disconnectReason = info.wifi_sta_disconnected.reason;
+            }
+            // Failed reconnect attempts repeat this event; only the first counts
+            if (self->up) {
+                self->up = false;
+                self->drops++;
+                self->downAtUs = now;
+            }
+            break;
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&self->mux);
+    self->notifyOwner();
+}
+
+void LinkManager::notifyOwner() {
+    if (owner) xTaskNotifyGive(owner);
+}
+
+// ============================================================================
+// OWNER TASK
+// ============================================================================
+LinkEvent LinkManager::service() {
+    portENTER_CRITICAL(&mux);
+    bool isUpNow = up;
+    uint32_t dropCount = drops;
+    portEXIT_CRITICAL(&mux);
+
+    // Report a drop first, even if the link already came back
+    if (reportedUp && (dropCount != reportedDrops || !isUpNow)) {
+        reportedUp = false;
+        reportedDrops = dropCount;
+        retryDelay = LINK_RETRY_MIN_MS;
+        nextRetryAt = millis() + retryDelay;
+        return LINK_EVENT_DOWN;
+    }
+    if (!reportedUp && isUpNow) {
+        reportedUp = true;
+        reportedDrops = dropCount;
+        return LINK_EVENT_UP;
+    }
+
+    // Still down (or never came up after boot): back up the core's auto-reconnect
+    if (reportedUp) return LINK_EVENT_NONE;
+    if (nextRetryAt == 0) nextRetryAt = millis() + retryDelay;
+    if ((long)(millis() - nextRetryAt) >= 0) {
+        WiFi.reconnect();
+        reconnectCalls++;
+        unsigned long doubled = retryDelay * 2;
+        retryDelay = doubled > LINK_RETRY_MAX_MS ? LINK_RETRY_MAX_MS : doubled;
+        nextRetryAt = millis() + retryDelay;
+    }
+    return LINK_EVENT_NONE;
+}
+
+bool LinkManager::channelChanged(uint8_t* channel) {
+    portENTER_CRITICAL(&mux);
+    uint8_t ch = apChannel;
+    portEXIT_CRITICAL(&mux);
+    if (ch == 0 || ch == reportedChannel) return false;
+
+    bool moved = reportedChannel != 0;
+    reportedChannel = ch;
+    if (moved) channelChanges++;
+    if (channel) *channel = ch;
+    return moved;
+}
+
+void LinkManager::printStats() {
+    Serial.printf("[LINK] %s, channel %u, %u drops (last reason %u), %u backstop reconnects\n",
+                  up ? "up" : "down", (unsigned)apChannel, (unsigned)drops,
+                  (unsigned)disconnectReason, (unsigned)reconnectCalls);
+    Serial.printf("[LINK] outage %u ms last, %u ms max; %u channel changes\n",
+                  (unsigned)lastOutageMs, (unsigned)maxOutageMs, (unsigned)channelChanges);
+}
@@ -0,0 +1,80 @@
+#ifndef LINK_MANAGER_H
+#define LINK_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// ============================================================================
+// LINK MANAGER - Smart Parcel Locker
+// ============================================================================
+// Event-driven WiFi STA link state (replaces the 10 s reconnect poll):
+// - WiFi.onEvent callbacks (WiFi event task) only record the transition and
+//   timestamps, then wake the owner task (cloud task) with a notification
+// - service() on the owner task turns those into DOWN / UP events in order;
+//   a drop and recovery between two passes still yields DOWN then UP
+// - The core's auto-reconnect makes the first attempt at once; service()
+//   backs it up with WiFi.reconnect() at LINK_RETRY_MIN_MS, doubling to
+//   LINK_RETRY_MAX_MS while the link stays down
+// - The AP channel comes with the connect event; channelChanged() reports a
+//   move (logged and counted; the CAM finds the new channel by probing).
+//   ESP-NOW itself is never touched.
+
+#define LINK_RETRY_MIN_MS       1000    // First backstop reconnect after a drop
+#define LINK_RETRY_MAX_MS       8000
+
+enum LinkEvent {
+    LINK_EVENT_NONE = 0,
+    LINK_EVENT_DOWN,
+    LINK_EVENT_UP
+};
+
+class LinkManager {
+public:
+    LinkManager();
+
+    // Register the WiFi event handlers (before the first WiFi.begin)
+    void begin();
+
+    // Owner task to wake on link events (its own handle)
+    void setOwner(TaskHandle_t task) { owner = task; }
+
+    // Owner task: next link transition and reconnect backstop.
+    // Call until it returns LINK_EVENT_NONE.
+    LinkEvent service();
+
+    // Owner task: true once after the AP moved to another channel
+    bool channelChanged(uint8_t* channel);
+
+    bool isUp() const { return up; }
+    void printStats();
+
+private:
+    static LinkManager* instance;
+    TaskHandle_t owner;
+
+    // Written by the WiFi event task, guarded by mux
+    portMUX_TYPE mux;
+    volatile bool up;                   // Has an IP
+    uint32_t drops;                     // UP → DOWN transitions seen
+    int64_t downAtUs;
+    uint8_t apChannel;
+    uint8_t disconnectReason;
+
+    // Owner task only
+    bool reportedUp;
+    uint32_t reportedDrops;
+    uint8_t reportedChannel;
+    unsigned long nextRetryAt;
+    unsigned long retryDelay;
+
+    // Statistics
+    uint32_t reconnectCalls;
+    uint32_t channelChanges;
+    uint32_t lastOutageMs;              // Disconnect → IP again
+    uint32_t maxOutageMs;
+
+    static void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info);
+    void notifyOwner();
+};
+
+#endif // LINK_MANAGER_H
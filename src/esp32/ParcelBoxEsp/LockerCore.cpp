@@ -0,0 +1,377 @@
+#include "LockerCore.h"
+
+#ifdef ARDUINO
+#include "LogRing.h"
+#else
+// Host build: no log ring (arguments still type-checked against the format)
+#define LOG_I(tag, fmt, ...)    do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+#endif
+
+#define coreLog(...) LOG_I("ESP32", __VA_ARGS__)
+
+// ============================================================================
+// LOCKER CORE IMPLEMENTATION
+// ============================================================================
+
+LockerCore::LockerCore() : hal(), deviceId("") {
+    memset(&counters, 0, sizeof(counters));
+}
+
+void LockerCore::begin(const LockerHal& boardHal, const char* id) {
+    hal = boardHal;
+    deviceId = id;
+}
+
+// ============================================================================
+// PARCEL QR WORKFLOW
+// ============================================================================
+void LockerCore::onScan(const EspNowQrScan& scan) {
+    // ACK on receipt: the outcome may wait on a cloud lookup (onParcelResult)
+    // and the CAM would otherwise retransmit a scan that is already handled
+    hal.espNow->ack(scan, ESPNOW_ACK_ACCEPTED);
+
+    if (scan.qrData[0] == '\0') return;
+    if (scan.camera >= CAMERA_COUNT) return;
+    LOG_I("QR RX", "CAM %u seq %u (attempt %u, %d dBm): %s",
+          (unsigned)(scan.camera + 1), scan.seq, scan.attempt, scan.rssi, scan.qrData);
+    FixedString<21> title;
+    title.printf("QR via CAM %u", (unsigned)(scan.camera + 1));
+    hal.lcd->show(title.c_str(), scan.qrData, "Validating...", "");
+    handleParcelScanned(scan.camera, scan.qrData, (unsigned long)(scan.rxUs / 1000));
+}
+
+void LockerCore::handleParcelScanned(uint8_t camera, const char* qr_code, unsigned long scanTime) {
+    Delivery& d = deliveries[camera];
+    d.qr_code = qr_code;
+    d.scan_time = scanTime;
+    counters.scans++;
+
+    hal.lcd->show("QR SCANNED", qr_code, "Validating...", "");
+
+    hal.firebase->logHistory(qr_code, "QR_SCANNED");
+
+    validateAndOpenLocks(camera, qr_code);
+}
+
+void LockerCore::validateAndOpenLocks(uint8_t camera, const char* qr_code) {
+    Delivery& d = deliveries[camera];
+    hal.gpio->mark(LOCKER_MARK_VALIDATE_START);
+    coreLog("Validating QR: %s (CAM %u)", qr_code, (unsigned)(camera + 1));
+
+    // Fast path: answer from the local parcel index (no network round-trip).
+    // The cloud task re-checks the hit against RTDB in the background.
+    if (lookupCachedParcel(qr_code, d)) {
+        hal.firebase->confirmParcel(qr_code);
+        finishValidation(camera, qr_code, true);
+        return;
+    }
+
+    if (!hal.firebase->indexAuthoritative() && hal.firebase->online()) {
+        // Cache may be stale (stream not synced/down) — ask the cloud task for a
+        // direct lookup; finishValidation() runs when its answer arrives in
+        // onParcelResult(). Other cameras keep scanning meanwhile.
+        d.stage = DELIVERY_VALIDATING;
+        counters.fetches++;
+        hal.firebase->fetchParcel(camera, qr_code);
+        return;
+    }
+
+    // Offline with a cache miss: reject. Only parcels known to the cache may open.
+    finishValidation(camera, qr_code, false);
+}
+
+void LockerCore::onParcelResult(uint8_t camera, const char* parcelId, bool found) {
+    // Stale if that camera has moved on to another scan since
+    if (camera >= CAMERA_COUNT) return;
+    const Delivery& d = deliveries[camera];
+    if (d.stage != DELIVERY_VALIDATING || d.qr_code != parcelId) {
+        counters.staleResults++;
+        return;
+    }
+    finishValidation(camera, parcelId, found);
+}
+
+void LockerCore::finishValidation(uint8_t camera, const char* qr_code, bool is_valid) {
+    Delivery& d = deliveries[camera];
+    hal.gpio->mark(LOCKER_MARK_VALIDATE_END);
+
+    // Fetched parcels land in the cache; pick up the receiver details from there
+    if (is_valid) {
+        lookupCachedParcel(qr_code, d);
+    }
+
+    if (is_valid) {
+        d.parcel_id = qr_code;
+        d.invalid_scan_count = 0;
+    }
+
+    if (is_valid) {
+        coreLog("QR Validation: SUCCESS");
+        counters.granted++;
+        d.stage = DELIVERY_OPEN;
+        d.sms_sent = false;
+        hal.lcd->show("Access Granted", "Opening locks...", "", "");
+        hal.firebase->logHistory(qr_code, "VALIDATION_SUCCESS");
+
+        // Claim before unlocking so the door opening is never taken for a breach
+        for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+            if (CAMERAS[camera].opens & COMPARTMENT_BIT(id)) compartments[id - 1].owner = camera;
+        }
+        openLocks(CAMERAS[camera].opens);
+        hal.gpio->mark(LOCKER_MARK_DONE);
+
+        hal.gpio->playTone(LOCKER_TONE_SUCCESS);
+        hal.lcd->show("DOORS OPEN", "Place parcel in box", "Complete payment", "Door closes auto");
+        LOG_I("AUTH", "Valid parcel - CAM %u locks opened", (unsigned)(camera + 1));
+    } else {
+        hal.gpio->mark(LOCKER_MARK_DONE);
+        coreLog("QR Validation: FAILED");
+        counters.denied++;
+        d.stage = DELIVERY_IDLE;
+        releaseCompartments(camera);
+        hal.gpio->playTone(LOCKER_TONE_ALERT);
+        hal.lcd->show("Access Denied", "Invalid QR Code", "Try again", "");
+
+        // — SMS: invalid count (3 consecutive failures at this camera) —
+        d.invalid_scan_count++;
+        coreLog("Invalid scan count: %d", d.invalid_scan_count);
+        if (d.invalid_scan_count >= LOCKER_INVALID_SCANS) {
+            smsSendInvalidAttempt();
+            d.invalid_scan_count = 0;  // reset after alert sent
+        }
+
+        hal.firebase->logHistory(qr_code, "VALIDATION_FAILED");
+        hal.lcd->showReady("READY", "Scan parcel QR", 3000);
+    }
+}
+
+// Compartments opened for `camera` count as unauthorized again
+void LockerCore::releaseCompartments(uint8_t camera) {
+    for (Compartment& c : compartments) {
+        if (c.owner == camera) c.owner = -1;
+    }
+}
+
+bool LockerCore::idle() const {
+    for (const Delivery& d : deliveries) {
+        if (d.stage != DELIVERY_IDLE || !d.qr_code.empty()) return false;
+    }
+    return true;
+}
+
+bool LockerCore::lookupCachedParcel(const char* qr_code, Delivery& delivery) {
+    LockerParcel parcel;
+    if (!hal.firebase->lookupParcel(qr_code, parcel)) return false;
+    if (parcel.delivered) {
+        coreLog("Cache: parcel already delivered");
+        return false;
+    }
+    delivery.receiver_phone = parcel.contactNumber;
+    delivery.receiver_name = parcel.receiverName;
+    coreLog("Parcel found in cache");
+    return true;
+}
+
+// ============================================================================
+// LOCKS
+// ============================================================================
+// mask = COMPARTMENT_BIT() of each lock. The first relay switches before this
+// returns; the sequencer staggers the rest and handles the coil hold.
+void LockerCore::openLocks(uint8_t mask) {
+    for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+        if (!(mask & COMPARTMENT_BIT(id))) continue;
+        compartments[id - 1].lock_open = true;
+        coreLog("Lock %d OPENED", id);
+    }
+    hal.gpio->unlock(mask);
+    hal.gpio->mark(LOCKER_MARK_ACTUATE);
+    hal.gpio->playTone(LOCKER_TONE_CLICK);
+}
+
+void LockerCore::closeLocks(uint8_t mask) {
+    hal.gpio->lock(mask);
+    for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+        if (!(mask & COMPARTMENT_BIT(id))) continue;
+        compartments[id - 1].lock_open = false;
+        coreLog("Lock %d CLOSED", id);
+    }
+}
+
+void LockerCore::remoteLock(uint8_t id, bool open) {
+    if (id < 1 || id > COMPARTMENT_COUNT) return;
+    FixedString<21> title;
+    FixedString<32> event;
+    title.printf("Remote: Lock %u", (unsigned)id);
+    event.printf("REMOTE_LOCK_%u_%s", (unsigned)id, open ? "OPEN" : "CLOSE");
+    if (open) {
+        openLocks(COMPARTMENT_BIT(id));
+        hal.lcd->show(title.c_str(), "Opening...", "", "");
+    } else {
+        closeLocks(COMPARTMENT_BIT(id));
+        hal.lcd->show(title.c_str(), "Closing...", "", "");
+    }
+    hal.firebase->logHistory("remote", event.c_str());
+}
+
+void LockerCore::emergencyLockdown() {
+    coreLog("EMERGENCY LOCKDOWN!");
+    hal.lcd->show("LOCKDOWN", "System Secured", "Contact Admin", "");
+    closeLocks((uint8_t)((1u << COMPARTMENT_COUNT) - 1));
+    hal.gpio->playTone(LOCKER_TONE_ALERT);
+    hal.firebase->logHistory("SYSTEM", "EMERGENCY_LOCKDOWN");
+}
+
+void LockerCore::reset() {
+    for (Delivery& d : deliveries) d = Delivery();
+    for (Compartment& c : compartments) {
+        c.owner = -1;
+        c.breach_alerted = false;
+    }
+    closeLocks((uint8_t)((1u << COMPARTMENT_COUNT) - 1));
+    hal.lcd->show("SYSTEM RESET", "Ready for next parcel", "", "");
+}
+
+// ============================================================================
+// DOORS
+// ============================================================================
+bool LockerCore::onDoorChanged(uint8_t id, bool open, int64_t atUs) {
+    if (id < 1 || id > COMPARTMENT_COUNT) return false;
+    Compartment& c = compartments[id - 1];
+    if (open == c.door_open) return false;
+    c.door_open = open;
+
+    const char* label = COMPARTMENTS[id - 1].label;
+    if (open) {
+        coreLog("%s OPENED", label);
+        // Door opened WITHOUT a valid scan — possible break-in
+        if (c.owner < 0) {
+            smsSendDoorBreach(id, atUs);
+        }
+    } else {
+        coreLog("%s CLOSED", label);
+    }
+    return true;
+}
+
+// Reset a compartment's breach alert once its door is closed and no delivery holds it
+void LockerCore::settle() {
+    for (Compartment& c : compartments) {
+        if (!c.door_open && c.owner < 0) c.breach_alerted = false;
+    }
+}
+
+bool LockerCore::breachActive() const {
+    for (const Compartment& c : compartments) {
+        if (c.door_open && c.owner < 0) return true;
+    }
+    return false;
+}
+
+void LockerCore::onDoorClosed(uint8_t id) {
+    if (id < 1 || id > COMPARTMENT_COUNT) return;
+    compartments[id - 1].lock_open = false;
+
+    for (uint8_t cam = 0; cam < CAMERA_COUNT; cam++) {
+        if (CAMERAS[cam].deliveryDoor == id) {
+            completeDelivery(cam);
+            return;
+        }
+    }
+    coreLog("%s closed", COMPARTMENTS[id - 1].label);
+}
+
+// Delivery door of `camera` closed: relock its compartments and start over
+void LockerCore::completeDelivery(uint8_t camera) {
+    Delivery& d = deliveries[camera];
+    uint8_t door = CAMERAS[camera].deliveryDoor;
+    coreLog("%s closed - marking as delivered", COMPARTMENTS[door - 1].label);
+    hal.lcd->show("Parcel Locked", "Delivery complete", "", "");
+
+    // Send SMS for valid delivery (locks opened via valid QR, door closed)
+    if (compartments[door - 1].owner == camera && !d.sms_sent) {
+        smsSendValidDelivery(d);
+    }
+
+    if (!d.parcel_id.empty()) {
+        counters.deliveries++;
+        hal.firebase->logHistory(d.parcel_id.c_str(), "PARCEL_DELIVERED");
+        closeLocks(CAMERAS[camera].opens);
+    }
+
+    hal.lcd->showReady("READY", "Scan parcel QR", 2000);
+    releaseCompartments(camera);
+    d.stage = DELIVERY_IDLE;
+    d.parcel_id.clear();
+    d.qr_code.clear();
+    d.receiver_phone.clear();
+    d.receiver_name.clear();
+    d.sms_sent = false;
+}
+
+// ============================================================================
+// SMS TRIGGERS
+// ============================================================================
+void LockerCore::sendSms(const char* phone, const char* message, uint8_t priority) {
+    counters.sms++;
+    hal.uart->sendSms(phone, message, priority);
+}
+
+/**
+ * smsSendValidDelivery() — triggered when:
+ *   - QR scan was VALID
+ *   - Locks were opened
+ *   - The camera's delivery door (parcel door) closes
+ * Sends to: receiver's contact number (from Firebase)
+ */
+void LockerCore::smsSendValidDelivery(Delivery& delivery) {
+    // Background confirmation may have refreshed the receiver number since the scan
+    LockerParcel parcel;
+    if (hal.firebase->lookupParcel(delivery.parcel_id.c_str(), parcel) && parcel.contactNumber[0]) {
+        delivery.receiver_phone = parcel.contactNumber;
+    }
+    if (delivery.receiver_phone.empty()) {
+        coreLog("[SMS] No receiver phone — skipping delivery SMS");
+        return;
+    }
+    FixedString<sizeof(SmsMsg_t::message)> msg;
+    msg.printf("ParcelBox: Your parcel %s has been delivered successfully. "
+               "Please check locker %s. - ParcelBox System",
+               delivery.parcel_id.c_str(), delivery.qr_code.c_str());
+    sendSms(delivery.receiver_phone.c_str(), msg.c_str(), SMS_PRIORITY_NOTICE);
+    delivery.sms_sent = true;
+    hal.firebase->logHistory(delivery.parcel_id.c_str(), "SMS_DELIVERY_SENT");
+}
+
+/**
+ * smsSendInvalidAttempt() — triggered when:
+ *   - Invalid QR scanned 3 times in a row (consecutive)
+ * Sends to: admin/monitoring number (device owner)
+ */
+void LockerCore::smsSendInvalidAttempt() {
+    FixedString<sizeof(SmsMsg_t::message)> msg;
+    msg.printf("[ALERT] ParcelBox %s: 3 invalid QR attempts detected. Possible tampering. - ParcelBox System",
+               deviceId);
+    sendSms(LOCKER_ADMIN_PHONE, msg.c_str(), SMS_PRIORITY_ALERT);
+    hal.firebase->logHistory("SYSTEM", "SMS_INVALID_ATTEMPT_3X");
+}
+
+/**
+ * smsSendDoorBreach() — triggered when:
+ *   - ANY door opens WITHOUT a valid scan (no valid delivery holds it)
+ *   - Only sends once per breach event (breach_alerted flag of that compartment)
+ * Sends to: admin/monitoring number. A camera snapshot of the opening rides
+ * along (uploaded under snapshots/, linked from history).
+ */
+void LockerCore::smsSendDoorBreach(uint8_t id, int64_t openedUs) {
+    Compartment& c = compartments[id - 1];
+    if (c.breach_alerted) return;  // already alerted for this breach
+    c.breach_alerted = true;
+    counters.breaches++;
+
+    FixedString<sizeof(SmsMsg_t::message)> msg;
+    msg.printf("[BREACH ALERT] ParcelBox %s: %s (compartment %u) opened without authorization! - ParcelBox System",
+               deviceId, COMPARTMENTS[id - 1].label, (unsigned)id);
+    sendSms(LOCKER_ADMIN_PHONE, msg.c_str(), SMS_PRIORITY_ALERT);
+    hal.firebase->logHistory("SYSTEM", "SMS_DOOR_BREACH");
+    hal.espNow->requestSnapshot(id, openedUs);
+}
@@ -0,0 +1,135 @@
+#ifndef LOCKER_CORE_H
+#define LOCKER_CORE_H
+
+#include <Arduino.h>
+#include "LOCKER_CONFIG.h"
+#include "TASKS_CONFIG.h"
+#include "FixedString.h"
+#include "LockerHal.h"
+
+// ============================================================================
+// LOCKER CORE - Smart Parcel Locker
+// ============================================================================
+// The parcel workflow, with the board behind LockerHal.h:
+// - Scan validation: index hit → open at once (re-checked in the
+//   background); miss with a stale index while online → background lookup,
+//   the camera waits in VALIDATING; miss otherwise → denied
+// - Door state machine per compartment (lock / door / owning camera) and the
+//   delivery of each camera: IDLE → [VALIDATING] → OPEN → IDLE when its
+//   delivery door closes
+// - SMS triggers: delivery to the receiver, 3 consecutive invalid scans at
+//   a camera and a door opened without a valid scan (once per breach) to
+//   the admin number
+// No FreeRTOS, no Arduino I/O: the same source builds on the host for the
+// trace-replay bench. Fixed-size state, no heap.
+//
+// Tasks: the io task calls onDoorChanged() / settle() / breachActive(); the
+// rest is the control task. State is plain fields read by both (as before
+// the split), so readers from other tasks see a recent, not atomic, view.
+
+// Replace with the real monitoring number
+#define LOCKER_ADMIN_PHONE      "+639123456789"
+#define LOCKER_INVALID_SCANS    3       // In a row at one camera → tamper SMS
+
+// Text fields are fixed-capacity (no heap): sizes match ParcelCacheEntry
+
+// Lock/door state of one compartment (COMPARTMENTS[] in LOCKER_CONFIG.h)
+struct Compartment {
+    bool lock_open = false;
+    bool door_open = false;
+    int8_t owner = -1;                  // Camera whose valid scan opened it, -1 = none
+    bool breach_alerted = false;        // already sent breach SMS for this breach event
+};
+
+// Delivery workflow of one camera (CAMERAS[] in LOCKER_CONFIG.h):
+//   IDLE → VALIDATING (cache miss, cloud lookup) → OPEN → IDLE
+// A cache hit goes straight to OPEN; OPEN ends when the camera's delivery
+// door closes. Each camera has its own, so scans at different cameras are
+// handled side by side.
+enum DeliveryStage : uint8_t {
+    DELIVERY_IDLE = 0,
+    DELIVERY_VALIDATING,
+    DELIVERY_OPEN
+};
+
+struct Delivery {
+    DeliveryStage stage = DELIVERY_IDLE;
+    FixedString<32> parcel_id;
+    FixedString<32> qr_code;
+    FixedString<20> receiver_phone;
+    FixedString<32> receiver_name;
+    unsigned long scan_time = 0;        // ms, esp_timer time of arrival
+
+    // SMS trigger counters & flags
+    int invalid_scan_count = 0;
+    bool sms_sent = false;              // already sent delivery-success SMS for this parcel
+};
+
+struct LockerStats {
+    uint32_t scans;
+    uint32_t granted;
+    uint32_t denied;
+    uint32_t fetches;                   // Background lookups requested
+    uint32_t staleResults;              // Lookup answers for a scan that has moved on
+    uint32_t deliveries;
+    uint32_t breaches;
+    uint32_t sms;
+};
+
+class LockerCore {
+public:
+    LockerCore();
+
+    // deviceId must outlive the core (quoted in alert SMS)
+    void begin(const LockerHal& hal, const char* deviceId);
+
+    // Control task: a new scan from EspNowManager::receiveQr (ACKed here)
+    void onScan(const EspNowQrScan& scan);
+    // Control task: answer to LockerFirebase::fetchParcel()
+    void onParcelResult(uint8_t camera, const char* parcelId, bool found);
+    // Control task: door `id` reported closed by the io task
+    void onDoorClosed(uint8_t id);
+
+    // Control task: remote and console commands
+    void remoteLock(uint8_t id, bool open);
+    void openLocks(uint8_t mask);
+    void closeLocks(uint8_t mask);
+    void emergencyLockdown();
+    void reset();
+
+    // io task: debounced door state at esp_timer time atUs; false = no change
+    bool onDoorChanged(uint8_t id, bool open, int64_t atUs);
+    // io task: re-arm the breach alert of closed, unclaimed compartments
+    void settle();
+    // A door open without a valid scan
+    bool breachActive() const;
+
+    // Any task
+    const Compartment& compartment(uint8_t id) const { return compartments[id - 1]; }
+    const Delivery& delivery(uint8_t camera) const { return deliveries[camera]; }
+    bool idle() const;
+    const LockerStats& stats() const { return counters; }
+
+private:
+    LockerHal hal;
+    const char* deviceId;
+
+    Compartment compartments[COMPARTMENT_COUNT];    // Index = compartment ID - 1
+    Delivery deliveries[CAMERA_COUNT];              // Index = camera
+
+    LockerStats counters;
+
+    void handleParcelScanned(uint8_t camera, const char* qr_code, unsigned long scanTime);
+    void validateAndOpenLocks(uint8_t camera, const char* qr_code);
+    void finishValidation(uint8_t camera, const char* qr_code, bool is_valid);
+    void completeDelivery(uint8_t camera);
+    void releaseCompartments(uint8_t camera);
+    bool lookupCachedParcel(const char* qr_code, Delivery& delivery);
+
+    void sendSms(const char* phone, const char* message, uint8_t priority);
+    void smsSendValidDelivery(Delivery& delivery);
+    void smsSendInvalidAttempt();
+    void smsSendDoorBreach(uint8_t id, int64_t openedUs);
+};
+
+#endif // LOCKER_CORE_H
@@ -0,0 +1,101 @@
+#ifndef LOCKER_HAL_H
+#define LOCKER_HAL_H
+
+#include <stdint.h>
+#include "EspNowFrame.h"
+
+// ============================================================================
+// LOCKER HAL - Smart Parcel Locker
+// ============================================================================
+// Everything LockerCore needs from the board, as five small interfaces:
+//   GPIO      lock relays and buzzer (ActuatorSequencer)
+//   LCD       screens (uiQueue → LcdRenderer)
+//   UART      outbound SMS (smsQueue → GsmModem on the SIM800L UART)
+//   ESP-NOW   end-to-end scan ACKs (EspNowManager), breach snapshots
+//             (SnapshotRelay)
+//   Firebase  parcel cache, background lookups and history (ParcelCache,
+//             cloudQueue, CloudWriter)
+// ParcelBoxEsp.ino implements them over the real drivers; the host build
+// (src/esp32/host) has mocks that record what was asked for.
+//
+// Every call must return at once: implementations queue, never wait.
+
+enum LockerTone : uint8_t {
+    LOCKER_TONE_CLICK = 0,
+    LOCKER_TONE_SUCCESS,
+    LOCKER_TONE_ALERT
+};
+
+// Scan trace points (ScanTrace on the board; no-ops unless a scan is traced)
+enum LockerMark : uint8_t {
+    LOCKER_MARK_VALIDATE_START = 0,
+    LOCKER_MARK_VALIDATE_END,
+    LOCKER_MARK_ACTUATE,
+    LOCKER_MARK_DONE                // Scan granted or denied
+};
+
+// What the Firebase side knows about one parcel
+struct LockerParcel {
+    char receiverName[32];
+    char contactNumber[20];
+    bool delivered;
+};
+
+class LockerGpio {
+public:
+    virtual ~LockerGpio() {}
+    // COMPARTMENT_BIT() masks
+    virtual void unlock(uint8_t mask) = 0;
+    virtual void lock(uint8_t mask) = 0;
+    virtual void playTone(LockerTone tone) = 0;
+    virtual void mark(LockerMark mark) = 0;
+};
+
+class LockerLcd {
+public:
+    virtual ~LockerLcd() {}
+    virtual void show(const char* line1, const char* line2, const char* line3, const char* line4) = 0;
+    // Idle screen (link status on the bottom lines), afterMs > 0 = timed
+    virtual void showReady(const char* line1, const char* line2, uint32_t afterMs) = 0;
+};
+
+class LockerUart {
+public:
+    virtual ~LockerUart() {}
+    // SMS_PRIORITY_* (TASKS_CONFIG.h)
+    virtual void sendSms(const char* phone, const char* message, uint8_t priority) = 0;
+};
+
+class LockerEspNow {
+public:
+    virtual ~LockerEspNow() {}
+    // ESPNOW_ACK_*
+    virtual void ack(const EspNowQrScan& scan, uint8_t status) = 0;
+    // Camera picture of compartment `door` as it was at esp_timer time openedUs
+    virtual void requestSnapshot(uint8_t door, int64_t openedUs) = 0;
+};
+
+class LockerFirebase {
+public:
+    virtual ~LockerFirebase() {}
+    // Local parcel index; false = not known
+    virtual bool lookupParcel(const char* parcelId, LockerParcel& out) = 0;
+    // A miss in the index means "no such parcel" (synced and streaming)
+    virtual bool indexAuthoritative() = 0;
+    virtual bool online() = 0;
+    // Background lookup; the answer comes back through LockerCore::onParcelResult()
+    virtual void fetchParcel(uint8_t camera, const char* parcelId) = 0;
+    // Background re-check of an index hit (the locks are already open)
+    virtual void confirmParcel(const char* parcelId) = 0;
+    virtual void logHistory(const char* parcelId, const char* event) = 0;
+};
+
+struct LockerHal {
+    LockerGpio* gpio;
+    LockerLcd* lcd;
+    LockerUart* uart;
+    LockerEspNow* espNow;
+    LockerFirebase* firebase;
+};
+
+#endif // LOCKER_HAL_H
@@ -0,0 +1,304 @@
+#include "LogRing.h"
+#include <LittleFS.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_memory_utils.h>
+
+// ============================================================================
+// LOG RING IMPLEMENTATION
+// ============================================================================
+
+#define LOG_MAGIC 0x4C4F4752    // "LOGR"
+
+// Survive panic / watchdog resets (not power-on, which leaves them random)
+RTC_NOINIT_ATTR static uint32_t storeMagic;
+RTC_NOINIT_ATTR static uint32_t storeHead;                  // Records ever written
+RTC_NOINIT_ATTR static LogRecord storeRecords[LOG_RING_LEN];
+
+static_assert(sizeof(LogRecord) == 64, "LogRecord layout changed; check LOG_RING_LEN RTC budget");
+
+LogRing logRing;
+
+LogRing::LogRing()
+    : mux(portMUX_INITIALIZER_UNLOCKED), readIdx(0), lost(0), crashCopy(nullptr),
+      crashCount(0), crashReason(0) {}
+
+void LogRing::begin() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool crashed = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+                   reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT;
+    if (crashed && storeMagic == LOG_MAGIC && storeHead > 0) {
+        uint32_t n = storeHead < LOG_CRASH_RECORDS ? storeHead : LOG_CRASH_RECORDS;
+        crashCopy = (LogRecord*)malloc(n * sizeof(LogRecord));
+        if (crashCopy) {
+            for (uint32_t i = 0; i < n; i++) {
+                crashCopy[i] = storeRecords[(storeHead - n + i) & (LOG_RING_LEN - 1)];
+                crashCopy[i].strings[LOG_STR_BYTES - 1] = '\0';   // Torn by the reset?
+            }
+            crashCount = (uint8_t)n;
+            crashReason = (int)reason;
+        }
+    }
+    storeMagic = LOG_MAGIC;
+    storeHead = 0;
+    readIdx = 0;
+}
+
+// ============================================================================
+// FORMAT SPECS
+// ============================================================================
+struct LogSpec {
+    const char* start;      // The '%'
+    const char* conv;       // Conversion character
+    uint8_t stars;          // '*' width / precision arguments
+    bool wide;              // ll
+};
+
+static bool parseSpec(const char* p, LogSpec& s) {
+    s.start = p++;
+    s.stars = 0;
+    s.wide = false;
+    while (*p && strchr("-+ #0", *p)) p++;
+    if (*p == '*') { s.stars++; p++; } else while (isdigit((unsigned char)*p)) p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { s.stars++; p++; } else while (isdigit((unsigned char)*p)) p++;
+    }
+    while (*p && strchr("hlLqjzt", *p)) {
+        if (p[0] == 'l' && p[1] == 'l') s.wide = true;
+        p++;
+    }
+    s.conv = p;
+    return *p != '\0';
+}
+
+static bool isFloatConv(char c) {
+    return c && strchr("fFeEgGaA", c);
+}
+
+static bool pushArg(LogRecord& rec, uint32_t word) {
+    if (rec.argc >= LOG_MAX_ARGS) {
+        rec.truncated = 1;
+        return false;
+    }
+    rec.args[rec.argc++] = word;
+    return true;
+}
+
+// ============================================================================
+// WRITE (any task or callback)
+// ============================================================================
+void LogRing::capture(LogRecord& rec, const char* fmt, va_list ap) {
+    rec.argc = 0;
+    rec.strUsed = 0;
+    rec.truncated = 0;
+
+    for (const char* p = strchr(fmt, '%'); p; p = strchr(p, '%')) {
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+        LogSpec s;
+        if (!parseSpec(p, s)) return;
+        p = s.conv + 1;
+
+        for (uint8_t i = 0; i < s.stars; i++) {
+            if (!pushArg(rec, (uint32_t)va_arg(ap, int))) return;
+        }
+        char c = *s.conv;
+        if (c == 's') {
+            const char* str = va_arg(ap, const char*);
+            if (!str) str = "(null)";
+            size_t room = LOG_STR_BYTES - rec.strUsed;
+            if (room == 0) {
+                rec.truncated = 1;
+                return;
+            }
+            size_t n = strnlen(str, room - 1);
+            if (str[n]) rec.truncated = 1;
+            memcpy(rec.strings + rec.strUsed, str, n);
+            rec.strings[rec.strUsed + n] = '\0';
+            rec.strUsed += n + 1;
+        } else if (isFloatConv(c)) {
+            float f = (float)va_arg(ap, double);
+            uint32_t word;
+            memcpy(&word, &f, sizeof(word));
+            if (!pushArg(rec, word)) return;
+        } else if (s.wide) {
+            uint64_t v = va_arg(ap, uint64_t);
+            if (!pushArg(rec, (uint32_t)v) || !pushArg(rec, (uint32_t)(v >> 32))) return;
+        } else {
+            // int, unsigned, char, long and pointers are all 32-bit here
+            if (!pushArg(rec, va_arg(ap, uint32_t))) return;
+        }
+    }
+}
+
+void LogRing::write(uint8_t level, const char* tag, const char* fmt, ...) {
+    LogRecord rec;
+    rec.timeMs = (uint32_t)(esp_timer_get_time() / 1000);
+    rec.tag = tag;
+    rec.fmt = fmt;
+    rec.level = level;
+    va_list ap;
+    va_start(ap, fmt);
+    capture(rec, fmt, ap);
+    va_end(ap);
+
+    portENTER_CRITICAL_SAFE(&mux);
+    uint32_t h = storeHead;
+    storeRecords[h & (LOG_RING_LEN - 1)] = rec;
+    storeHead = h + 1;
+    portEXIT_CRITICAL_SAFE(&mux);
+}
+
+// ============================================================================
+// FORMAT (log task / boot)
+// ============================================================================
+// Replays the format over the captured words; stops where capture stopped
+size_t LogRing::format(const LogRecord& rec, char* out, size_t len) {
+    size_t pos = 0;
+    uint8_t arg = 0;
+    size_t str = 0;
+    uint8_t argc = rec.argc <= LOG_MAX_ARGS ? rec.argc : 0;
+    size_t strUsed = rec.strUsed <= LOG_STR_BYTES ? rec.strUsed : 0;
+
+    const char* p = rec.fmt;
+    while (*p && pos < len - 1) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+        LogSpec s;
+        if (!parseSpec(p, s)) break;
+
+        // Spec with each '*' replaced by its captured value
+        char spec[24];
+        size_t sn = 0;
+        bool ok = true;
+        for (const char* q = s.start; q <= s.conv && sn < sizeof(spec) - 12; q++) {
+            if (*q != '*') {
+                spec[sn++] = *q;
+            } else if (arg < argc) {
+                sn += snprintf(spec + sn, sizeof(spec) - sn, "%d", (int)rec.args[arg++]);
+            } else {
+                ok = false;
+            }
+        }
+        spec[sn] = '\0';
+        if (!ok) break;
+
+        char c = *s.conv;
+        int n;
+        if (c == 's') {
+            if (str >= strUsed) break;
+            n = snprintf(out + pos, len - pos, spec, rec.strings + str);
+            str += strnlen(rec.strings + str, LOG_STR_BYTES - str) + 1;
+        } else if (isFloatConv(c)) {
+            if (arg >= argc) break;
+            float f;
+            memcpy(&f, &rec.args[arg++], sizeof(f));
+            n = snprintf(out + pos, len - pos, spec, (double)f);
+        } else if (s.wide) {
+            if (arg + 1 >= argc) break;
+            uint64_t v = rec.args[arg] | ((uint64_t)rec.args[arg + 1] << 32);
+            arg += 2;
+            n = snprintf(out + pos, len - pos, spec, v);
+        } else if (c == 'p') {
+            if (arg >= argc) break;
+            n = snprintf(out + pos, len - pos, spec, (void*)(uintptr_t)rec.args[arg++]);
+        } else {
+            if (arg >= argc) break;
+            n = snprintf(out + pos, len - pos, spec, rec.args[arg++]);
+        }
+        if (n > 0) pos = (pos + n < len - 1) ? pos + n : len - 1;
+        p = s.conv + 1;
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+static const char* levelPrefix(uint8_t level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR: return "ERROR: ";
+        case LOG_LEVEL_WARN:  return "WARN: ";
+        default:              return "";
+    }
+}
+
+void LogRing::drain() {
+    char line[LOG_LINE_MAX];
+    while (true) {
+        LogRecord rec;
+        portENTER_CRITICAL_SAFE(&mux);
+        uint32_t h = storeHead;
+        if (readIdx == h) {
+            portEXIT_CRITICAL_SAFE(&mux);
+            return;
+        }
+        if (h - readIdx > LOG_RING_LEN) {
+            lost += h - readIdx - LOG_RING_LEN;
+            readIdx = h - LOG_RING_LEN;
+        }
+        rec = storeRecords[readIdx & (LOG_RING_LEN - 1)];
+        readIdx++;
+        portEXIT_CRITICAL_SAFE(&mux);
+
+        int n = snprintf(line, sizeof(line), "[%s] %s", rec.tag, levelPrefix(rec.level));
+        format(rec, line + n, sizeof(line) - n);
+        Serial.print(line);
+        Serial.println(rec.truncated ? " [...]" : "");
+    }
+}
+
+// ============================================================================
+// CRASH DUMP
+// ============================================================================
+void LogRing::saveCrashDump() {
+    if (!crashCopy) return;
+    File f = LittleFS.open(LOG_CRASH_PATH, "w");
+    if (f) {
+        f.printf("Reset reason %d, last %u log records:\n", crashReason, (unsigned)crashCount);
+        char line[LOG_LINE_MAX];
+        for (uint8_t i = 0; i < crashCount; i++) {
+            const LogRecord& rec = crashCopy[i];
+            // Same firmware after a crash, but a torn record must not take the boot down
+            if (!esp_ptr_in_drom(rec.fmt) || !esp_ptr_in_drom(rec.tag)) {
+                f.println("<unreadable record>");
+                continue;
+            }
+            format(rec, line, sizeof(line));
+            f.printf("%7lu.%03lu [%s] %s%s%s\n", (unsigned long)(rec.timeMs / 1000),
+                     (unsigned long)(rec.timeMs % 1000), rec.tag, levelPrefix(rec.level), line,
+                     rec.truncated ? " [...]" : "");
+        }
+        f.close();
+        LOG_W("LOG", "Reset reason %d: last %u log records saved to %s", crashReason,
+              (unsigned)crashCount, LOG_CRASH_PATH);
+    } else {
+        LOG_E("LOG", "Could not write %s", LOG_CRASH_PATH);
+    }
+    free(crashCopy);
+    crashCopy = nullptr;
+}
+
+void LogRing::printCrashDump() {
+    File f = LittleFS.open(LOG_CRASH_PATH, "r");
+    if (!f) {
+        Serial.println(F("[LOG] No crash dump"));
+        return;
+    }
+    while (f.available()) Serial.write(f.read());
+    f.close();
+}
+
+void LogRing::printStats() {
+    Serial.printf("[LOG] %u records written, %u lost before printing, ring %u x %u bytes, level %d\n",
+                  (unsigned)storeHead, (unsigned)lost, (unsigned)LOG_RING_LEN,
+                  (unsigned)sizeof(LogRecord), LOG_LEVEL);
+}
@@ -0,0 +1,110 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// LOG RING - Smart Parcel Locker
+// ============================================================================
+// Deferred, levelled logging in place of synchronous Serial prints:
+// - LOG_E/W/I/D compile to nothing above LOG_LEVEL (arguments not evaluated)
+// - A call only captures its arguments into a fixed 64-byte record: the
+//   format and tag pointers (string literals, in flash), up to LOG_MAX_ARGS
+//   32-bit words, and a copy of any %s strings. No formatting, no UART.
+// - Records go into a ring any task or WiFi / ESP-NOW callback may write
+//   (short critical section, oldest overwritten; not from IRAM ISRs). The
+//   log task formats and prints them.
+// - The ring lives in RTC_NOINIT memory, which survives a panic or
+//   watchdog reset. After one of those, begin() keeps the last
+//   LOG_CRASH_RECORDS records and saveCrashDump() writes them to
+//   LOG_CRASH_PATH as text once LittleFS is mounted (`crash` command).
+//
+// Formats must be literals. %s arguments are copied (truncated to what
+// is left of LOG_STR_BYTES); floats are stored as float.
+
+#define LOG_LEVEL_NONE          0
+#define LOG_LEVEL_ERROR         1
+#define LOG_LEVEL_WARN          2
+#define LOG_LEVEL_INFO          3
+#define LOG_LEVEL_DEBUG         4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL               LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_LEN            64      // Records, power of two (64 B each, RTC slow memory)
+#define LOG_MAX_ARGS            4
+#define LOG_STR_BYTES           32      // Fits a whole parcel ID
+#define LOG_LINE_MAX            192
+#define LOG_CRASH_RECORDS       32
+#define LOG_CRASH_PATH          "/crash.log"
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(tag, fmt, ...)    logRing.write(LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(tag, fmt, ...)    do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(tag, fmt, ...)    logRing.write(LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(tag, fmt, ...)    do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(tag, fmt, ...)    logRing.write(LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(tag, fmt, ...)    do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(tag, fmt, ...)    logRing.write(LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(tag, fmt, ...)    do {} while (0)
+#endif
+
+struct LogRecord {
+    uint32_t timeMs;
+    const char* tag;
+    const char* fmt;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t strUsed;
+    uint8_t truncated;              // Ran out of argument or string space
+    uint32_t args[LOG_MAX_ARGS];
+    char strings[LOG_STR_BYTES];    // %s copies, NUL-separated, in order
+};
+
+class LogRing {
+public:
+    LogRing();
+
+    // First thing in setup(): adopt or reset the RTC ring
+    void begin();
+
+    // Any task or callback (through the LOG_* macros)
+    void write(uint8_t level, const char* tag, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    // Log task: format and print everything written since the last call
+    void drain();
+
+    // After LittleFS is mounted: write the pre-reset records, if any
+    void saveCrashDump();
+    void printCrashDump();
+
+    void printStats();
+
+private:
+    portMUX_TYPE mux;
+    uint32_t readIdx;               // Log task
+    uint32_t lost;                  // Overwritten before they were printed
+
+    LogRecord* crashCopy;           // Pre-reset records until saved
+    uint8_t crashCount;
+    int crashReason;
+
+    static void capture(LogRecord& rec, const char* fmt, va_list ap);
+    static size_t format(const LogRecord& rec, char* out, size_t len);
+};
+
+extern LogRing logRing;
+
+#endif // LOG_RING_H
@@ -0,0 +1,550 @@
+#include "OtaUpdater.h"
+#include "EspNowManager.h"
+#include "FixedString.h"
+#include "LogRing.h"
+#include <esp_now.h>
+#include <esp_ota_ops.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// OTA UPDATER IMPLEMENTATION
+// ============================================================================
+
+static const char* const RESULT_NAMES[] = {
+    "ok", "not the delta's base", "flash error", "image check failed"
+};
+
+static const char* camResultName(uint8_t r) {
+    return r < sizeof(RESULT_NAMES) / sizeof(RESULT_NAMES[0]) ? RESULT_NAMES[r] : "?";
+}
+
+static bool parseSha256(const char* hex, uint8_t out[32]) {
+    if (strlen(hex) != 64) return false;
+    for (int i = 0; i < 32; i++) {
+        char pair[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        if (!isxdigit((unsigned char)pair[0]) || !isxdigit((unsigned char)pair[1])) return false;
+        out[i] = (uint8_t)strtoul(pair, nullptr, 16);
+    }
+    return true;
+}
+
+OtaUpdater::OtaUpdater()
+    : espNow(nullptr), link(nullptr), version(""), state(OTA_IDLE), task(nullptr), bootConfirmed(false),
+      checkRequested(false), nextCheckAt(0), camSkip(0), jobCamera(-1), jobId(0), total(0),
+      downloaded(0), reconnects(0), ring(nullptr), mux(portMUX_INITIALIZER_UNLOCKED), readyResult(0xFF),
+      doneResult(0xFF), ackNext(0), resendFrom(0), resendPending(false), lastQueryAt(0), checks(0),
+      checkFailures(0), updates(0), failures(0), resumes(0), chunksSent(0), chunksResent(0),
+      lastBytes(0), lastMs(0), lastError("") {
+    memset(&job, 0, sizeof(job));
+    memset(header, 0, sizeof(header));
+    memset(camVersion, 0, sizeof(camVersion));
+}
+
+void OtaUpdater::begin(EspNowManager* manager, const char* running) {
+    espNow = manager;
+    version = running;
+    // First check once the cameras have had time to answer a QUERY
+    nextCheckAt = millis() + 2 * OTA_QUERY_MS;
+}
+
+void OtaUpdater::confirmBoot() {
+    if (bootConfirmed) return;
+    bootConfirmed = true;
+    esp_ota_img_states_t imgState;
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &imgState) == ESP_OK &&
+        imgState == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        LOG_I("OTA", "Firmware %s confirmed", version);
+    }
+}
+
+// ============================================================================
+// MANIFEST (cloud task)
+// ============================================================================
+void OtaUpdater::check(FirebaseData* fbdo) {
+    if (state != OTA_IDLE) return;
+    if (!checkRequested && (long)(millis() - nextCheckAt) < 0) return;
+    checkRequested = false;
+    nextCheckAt = millis() + OTA_RETRY_MS;
+    checks++;
+
+    int64_t t0 = link ? link->request(*fbdo) : 0;
+    bool ok = Firebase.RTDB.getJSON(fbdo, OTA_PATH);
+    if (link) link->requestDone(t0, ok);
+    if (!ok) {
+        checkFailures++;
+        LOG_W("OTA", "Manifest read failed: %s", fbdo->errorReason().c_str());
+        return;
+    }
+    if (fbdo->dataType() != "json") {
+        nextCheckAt = millis() + OTA_CHECK_MS;     // Nothing published
+        return;
+    }
+    FirebaseJson* json = fbdo->to<FirebaseJson*>();
+
+    OtaEntry entry;
+    if (espNow && ParcelBoxOtaKey::isSet() && parseEntry(json, "cam", entry)) {
+        for (uint8_t cam = 0; cam < espNow->peerCount(); cam++) {
+            char running[ESPNOW_OTA_VERSION_LEN];
+            portENTER_CRITICAL(&mux);
+            memcpy(running, camVersion[cam], sizeof(running));
+            portEXIT_CRITICAL(&mux);
+            if (!running[0] || strcmp(running, entry.version) == 0) continue;
+            if (entry.from[0] && strcmp(running, entry.from) != 0) continue;    // Delta for another base
+            if (camSkip & (1u << cam)) {    // Failed last time: the others and this board go first
+                camSkip &= ~(1u << cam);
+                continue;
+            }
+            start(entry, (int8_t)cam);
+            return;
+        }
+    }
+    if (parseEntry(json, "main", entry) && strcmp(version, entry.version) != 0 &&
+        (!entry.from[0] || strcmp(version, entry.from) == 0)) {
+        start(entry, -1);
+        return;
+    }
+    nextCheckAt = millis() + OTA_CHECK_MS;
+}
+
+bool OtaUpdater::parseEntry(FirebaseJson* json, const char* key, OtaEntry& out) {
+    memset(&out, 0, sizeof(out));
+    FirebaseJsonData field;
+    FixedString<24> path;
+    path.printf("%s/version", key);
+    if (!json->get(field, path.c_str())) return false;      // No update for this board
+    if (field.stringValue.length() == 0 || field.stringValue.length() >= sizeof(out.version)) return false;
+    strlcpy(out.version, field.stringValue.c_str(), sizeof(out.version));
+
+    path.printf("%s/from", key);
+    if (json->get(field, path.c_str())) strlcpy(out.from, field.stringValue.c_str(), sizeof(out.from));
+
+    path.printf("%s/url", key);
+    if (!json->get(field, path.c_str()) || field.stringValue.length() == 0 ||
+        field.stringValue.length() >= sizeof(out.url)) {
+        LOG_W("OTA", "Manifest %s: no usable url", key);
+        return false;
+    }
+    strlcpy(out.url, field.stringValue.c_str(), sizeof(out.url));
+
+    path.printf("%s/sha256", key);
+    if (!json->get(field, path.c_str()) || !parseSha256(field.stringValue.c_str(), out.sha256)) {
+        LOG_W("OTA", "Manifest %s: no valid sha256", key);
+        return false;
+    }
+    return true;
+}
+
+bool OtaUpdater::start(const OtaEntry& entry, int8_t camera) {
+    if (ESP.getFreeHeap() < OTA_MIN_HEAP) {
+        failures++;
+        lastError = "low heap";
+        LOG_W("OTA", "Update to %s postponed: %u bytes free", entry.version, (unsigned)ESP.getFreeHeap());
+        return false;
+    }
+    job = entry;
+    jobCamera = camera;
+    jobId = esp_random() | 1;
+    total = 0;
+    downloaded = 0;
+    reconnects = 0;
+    portENTER_CRITICAL(&mux);
+    readyResult = 0xFF;
+    doneResult = 0xFF;
+    ackNext = 0;
+    resendPending = false;
+    state = camera < 0 ? OTA_DOWNLOADING : OTA_RELAYING;
+    portEXIT_CRITICAL(&mux);
+
+    if (xTaskCreatePinnedToCore(taskEntry, "ota", OTA_TASK_STACK, this, OTA_TASK_PRIORITY, &task,
+                                OTA_TASK_CORE) != pdPASS) {
+        state = OTA_IDLE;
+        failures++;
+        lastError = "no task";
+        return false;
+    }
+    if (camera < 0) {
+        LOG_I("OTA", "Updating %s -> %s", version, job.version);
+    } else {
+        LOG_I("OTA", "Updating CAM %u -> %s", (unsigned)(camera + 1), job.version);
+    }
+    return true;
+}
+
+void OtaUpdater::finish(bool ok) {
+    flash.abort();      // No-op once finished
+    free(ring);
+    ring = nullptr;
+    if (!ok) {
+        failures++;
+        LOG_W("OTA", "Update to %s failed: %s", job.version, lastError);
+        if (jobCamera >= 0) camSkip |= 1u << jobCamera;
+        state = OTA_IDLE;
+        return;
+    }
+    updates++;
+    lastBytes = total;
+    if (jobCamera < 0) {
+        LOG_I("OTA", "%s written (%u byte delta), restart when idle", job.version, (unsigned)total);
+        state = OTA_REBOOT_DUE;
+        return;
+    }
+    LOG_I("OTA", "CAM %u took %s (%u byte delta)", (unsigned)(jobCamera + 1), job.version, (unsigned)total);
+    portENTER_CRITICAL(&mux);
+    camVersion[jobCamera][0] = '\0';    // Learned again after its restart
+    portEXIT_CRITICAL(&mux);
+    state = OTA_IDLE;
+}
+
+// ============================================================================
+// DOWNLOAD (OTA task)
+// ============================================================================
+void OtaUpdater::taskEntry(void* arg) {
+    static_cast<OtaUpdater*>(arg)->run();
+    vTaskDelete(nullptr);
+}
+
+void OtaUpdater::run() {
+    int64_t t0 = esp_timer_get_time();
+    bool ok;
+    {
+        WiFiClientSecure client;
+        HTTPClient http;
+        client.setInsecure();       // The image is checked against the manifest's SHA-256
+        ok = connect(http, client) && (jobCamera < 0 ? updateSelf(http, client) : relay(http, client));
+        http.end();
+    }
+    if (ok) lastMs = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    task = nullptr;
+    finish(ok);
+}
+
+bool OtaUpdater::connect(HTTPClient& http, WiFiClientSecure& client) {
+    http.setReuse(false);
+    http.setTimeout(OTA_HTTP_TIMEOUT_MS);
+    if (!http.begin(client, job.url)) {
+        lastError = "bad url";
+        return false;
+    }
+    if (downloaded) {
+        char range[24];
+        snprintf(range, sizeof(range), "bytes=%u-", (unsigned)downloaded);
+        http.addHeader("Range", range);
+    }
+    int code = http.GET();
+    if (code != (downloaded ? HTTP_CODE_PARTIAL_CONTENT : HTTP_CODE_OK)) {
+        LOG_W("OTA", "GET at %u bytes: HTTP %d", (unsigned)downloaded, code);
+        lastError = downloaded ? "resume refused" : "download failed";
+        http.end();
+        return false;
+    }
+    int size = http.getSize();
+    if (!downloaded) {
+        if (size <= DELTA_HEADER_BYTES) {
+            lastError = "no content length";
+            http.end();
+            return false;
+        }
+        total = (uint32_t)size;
+    } else if (size >= 0 && (uint32_t)size != total - downloaded) {
+        lastError = "resume size mismatch";     // File changed under us
+        http.end();
+        return false;
+    }
+    return true;
+}
+
+// Exactly len bytes of the body; a dropped connection resumes where it stopped
+bool OtaUpdater::readExact(HTTPClient& http, WiFiClientSecure& client, uint8_t* out, size_t len) {
+    if (len > total - downloaded) {
+        lastError = "read past end";
+        return false;
+    }
+    unsigned long heardAt = millis();
+    while (len) {
+        int avail = client.available();
+        if (avail > 0) {
+            int n = client.read(out, len < (size_t)avail ? len : (size_t)avail);
+            if (n > 0) {
+                out += n;
+                len -= n;
+                downloaded += n;
+                heardAt = millis();
+                continue;
+            }
+        }
+        if (client.connected() && millis() - heardAt < OTA_HTTP_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        http.end();
+        if (++reconnects > OTA_RECONNECTS) {
+            lastError = "connection lost";
+            return false;
+        }
+        resumes++;
+        LOG_W("OTA", "Connection lost at %u/%u bytes, resuming", (unsigned)downloaded, (unsigned)total);
+        if (!connect(http, client)) return false;
+        heardAt = millis();
+    }
+    return true;
+}
+
+// This board: delta → DeltaPatch → inactive partition
+bool OtaUpdater::updateSelf(HTTPClient& http, WiFiClientSecure& client) {
+    if (!readExact(http, client, header, sizeof(header))) return false;
+    patch.begin(&flash);
+    if (patch.feed(header, sizeof(header)) != DELTA_OK) {
+        lastError = "bad delta header";
+        return false;
+    }
+    const DeltaHeader& hdr = patch.header();
+    if (!OtaFlash::baseMatches(hdr.oldSize, hdr.oldCrc)) {
+        lastError = "not the delta's base";
+        return false;
+    }
+    if (!flash.begin(hdr.newSize)) {
+        lastError = flash.error();
+        return false;
+    }
+
+    uint8_t buf[OTA_READ_BYTES];
+    while (downloaded < total) {
+        size_t n = total - downloaded < sizeof(buf) ? total - downloaded : sizeof(buf);
+        if (!readExact(http, client, buf, n)) return false;
+        DeltaResult r = patch.feed(buf, n);
+        if (r != DELTA_OK) {
+            lastError = r == DELTA_IO && flash.error()[0] ? flash.error() : DeltaPatch::resultName(r);
+            return false;
+        }
+    }
+    DeltaResult r = patch.finish();
+    if (r != DELTA_OK) {
+        lastError = DeltaPatch::resultName(r);
+        return false;
+    }
+    if (!flash.finish(job.sha256)) {
+        lastError = flash.error();
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// CAMERA RELAY (OTA task)
+// ============================================================================
+size_t OtaUpdater::chunkLength(uint16_t seq) const {
+    uint32_t offset = (uint32_t)seq * ESPNOW_OTA_CHUNK_BYTES;
+    return total - offset < ESPNOW_OTA_CHUNK_BYTES ? total - offset : ESPNOW_OTA_CHUNK_BYTES;
+}
+
+bool OtaUpdater::fillChunk(HTTPClient& http, WiFiClientSecure& client, uint16_t seq) {
+    uint8_t* slot = ring + (seq % ESPNOW_OTA_INFLIGHT) * ESPNOW_OTA_CHUNK_BYTES;
+    size_t len = chunkLength(seq);
+    size_t have = 0;
+    if (seq == 0) {         // Header was read ahead for START
+        memcpy(slot, header, sizeof(header));
+        have = sizeof(header);
+    }
+    return readExact(http, client, slot + have, len - have);
+}
+
+// Chunks in flight are the window [base, next); ring holds [filled - INFLIGHT, filled)
+bool OtaUpdater::relay(HTTPClient& http, WiFiClientSecure& client) {
+    if (!readExact(http, client, header, sizeof(header))) return false;
+    patch.begin(nullptr);   // Header only: nothing is written
+    if (patch.feed(header, sizeof(header)) != DELTA_OK) {
+        lastError = "bad delta header";
+        return false;
+    }
+    uint32_t chunkCount = (total + ESPNOW_OTA_CHUNK_BYTES - 1) / ESPNOW_OTA_CHUNK_BYTES;
+    if (chunkCount > 0xFFFF) {
+        lastError = "delta too big for relay";
+        return false;
+    }
+    uint16_t chunks = (uint16_t)chunkCount;
+    ring = (uint8_t*)malloc(ESPNOW_OTA_INFLIGHT * ESPNOW_OTA_CHUNK_BYTES);
+    if (!ring) {
+        lastError = "no relay buffer";
+        return false;
+    }
+
+    uint8_t result = 0xFF;
+    for (uint8_t tries = 0; tries < OTA_START_TRIES && result == 0xFF; tries++) {
+        sendFrame(ESPNOW_OTA_START, 0, &patch.header());
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPNOW_OTA_ACK_MS));
+        result = readyResult;
+    }
+    if (result != ESPNOW_OTA_OK) {
+        lastError = result == 0xFF ? "camera not answering" : camResultName(result);
+        return false;
+    }
+
+    uint16_t base = 0, next = 0, filled = 0, sentUpTo = 0;
+    uint8_t stalls = 0, endTries = 0;
+    while (true) {
+        while (next < chunks && next < base + ESPNOW_OTA_INFLIGHT) {
+            if (next == filled) {
+                if (!fillChunk(http, client, filled)) return false;
+                filled++;
+            }
+            sendChunk(next);
+            if (next < sentUpTo) {
+                chunksResent++;
+            } else {
+                chunksSent++;
+                sentUpTo = next + 1;
+            }
+            next++;
+        }
+        if (base == chunks) {
+            if (endTries++ >= OTA_DONE_TRIES) {
+                lastError = "no DONE from camera";
+                return false;
+            }
+            sendFrame(ESPNOW_OTA_END, chunks, nullptr);
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPNOW_OTA_ACK_MS));
+        portENTER_CRITICAL(&mux);
+        uint8_t done = doneResult;
+        uint16_t acked = ackNext;
+        bool resend = resendPending;
+        uint16_t from = resendFrom;
+        resendPending = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (done != 0xFF) {
+            if (done == ESPNOW_OTA_OK) return true;
+            lastError = camResultName(done);
+            return false;
+        }
+        bool progress = acked > base;
+        if (progress) {
+            base = acked;
+            stalls = 0;
+            if (next < base) next = base;
+        }
+        if (resend && from >= base && from <= filled) {
+            next = from;
+        } else if (!progress && base < chunks) {
+            if (++stalls > OTA_STALLS) {
+                lastError = "camera stalled";
+                return false;
+            }
+            next = base;    // Silence: the window or its ACK was lost
+        }
+    }
+}
+
+void OtaUpdater::sendFrame(uint8_t status, uint16_t seq, const DeltaHeader* hdr) {
+    ESPNOW_OtaFrame_t f = {};
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_OTA;
+    f.hdr.seq = seq;
+    f.hdr.session = jobId;
+    f.hdr.status = status;
+    strlcpy(f.version, job.version, sizeof(f.version));
+    if (hdr) {
+        f.oldSize = hdr->oldSize;
+        f.oldCrc = hdr->oldCrc;
+        f.newSize = hdr->newSize;
+        memcpy(f.sha256, job.sha256, sizeof(f.sha256));
+    }
+    f.bytes = total;
+    if (status == ESPNOW_OTA_START) {
+        OtaFlash::hmac(ParcelBoxOtaKey::getKey(), (const uint8_t*)&f, offsetof(ESPNOW_OtaFrame_t, auth), f.auth);
+    }
+    esp_now_send(espNow->peerMac(jobCamera), (const uint8_t*)&f, sizeof(f));
+}
+
+void OtaUpdater::sendChunk(uint16_t seq) {
+    uint8_t frame[ESPNOW_BENCH_MAX_LEN];
+    ESPNOW_Header_t* hdr = (ESPNOW_Header_t*)frame;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = ESPNOW_MAGIC;
+    hdr->type = MSG_TYPE_OTA;
+    hdr->seq = seq;
+    hdr->session = jobId;
+    hdr->status = ESPNOW_OTA_CHUNK;
+    size_t len = chunkLength(seq);
+    memcpy(frame + sizeof(*hdr), ring + (seq % ESPNOW_OTA_INFLIGHT) * ESPNOW_OTA_CHUNK_BYTES, len);
+    // Back to back: wait out a full ESP-NOW TX queue instead of dropping
+    while (esp_now_send(espNow->peerMac(jobCamera), frame, sizeof(*hdr) + len) == ESP_ERR_ESPNOW_NO_MEM) {
+        vTaskDelay(1);
+    }
+}
+
+// ============================================================================
+// CAMERA FRAMES
+// ============================================================================
+void OtaUpdater::onFrame(uint8_t camera, const uint8_t* data, int len) {
+    const ESPNOW_OtaFrame_t* f = (const ESPNOW_OtaFrame_t*)data;
+    if (camera >= ESPNOW_MAX_PEERS || len != sizeof(*f)) return;
+    bool wake = false;
+    portENTER_CRITICAL(&mux);
+    if (f->hdr.status == ESPNOW_OTA_INFO) {
+        memcpy(camVersion[camera], f->version, ESPNOW_OTA_VERSION_LEN);
+        camVersion[camera][ESPNOW_OTA_VERSION_LEN - 1] = '\0';
+    } else if (state == OTA_RELAYING && camera == jobCamera && f->hdr.session == jobId) {
+        if (f->hdr.status == ESPNOW_OTA_READY) {
+            readyResult = f->result;
+        } else if (f->hdr.status == ESPNOW_OTA_DONE) {
+            doneResult = f->result;
+        } else if (f->hdr.status == ESPNOW_OTA_ACK) {
+            if (f->hdr.seq > ackNext) ackNext = f->hdr.seq;
+            if (f->result == ESPNOW_OTA_RESEND) {
+                resendFrom = f->hdr.seq;
+                resendPending = true;
+            }
+        }
+        wake = true;
+    }
+    TaskHandle_t waiting = task;
+    portEXIT_CRITICAL(&mux);
+    if (wake && waiting) xTaskNotifyGive(waiting);
+}
+
+// Control task: cameras that haven't told us their version yet
+void OtaUpdater::service() {
+    if (!espNow || running()) return;
+    unsigned long now = millis();
+    if (lastQueryAt && now - lastQueryAt < OTA_QUERY_MS) return;
+    lastQueryAt = now | 1;
+    for (uint8_t cam = 0; cam < espNow->peerCount(); cam++) {
+        portENTER_CRITICAL(&mux);
+        bool known = camVersion[cam][0] != '\0';
+        portEXIT_CRITICAL(&mux);
+        if (known) continue;
+        ESPNOW_OtaFrame_t f = {};
+        f.hdr.magic = ESPNOW_MAGIC;
+        f.hdr.type = MSG_TYPE_OTA;
+        f.hdr.status = ESPNOW_OTA_QUERY;
+        strlcpy(f.version, version, sizeof(f.version));
+        esp_now_send(espNow->peerMac(cam), (const uint8_t*)&f, sizeof(f));
+    }
+}
+
+void OtaUpdater::printStats() {
+    static const char* const STATE_NAMES[] = { "idle", "downloading", "relaying", "restart due" };
+    Serial.printf("[OTA] %s %s | checks %u (%u failed), updates %u, failed %u, resumes %u\n",
+                  version, STATE_NAMES[state], (unsigned)checks, (unsigned)checkFailures,
+                  (unsigned)updates, (unsigned)failures, (unsigned)resumes);
+    if (running()) {
+        Serial.printf("[OTA] %s -> %s: %u/%u bytes\n", jobCamera < 0 ? "main" : "CAM", job.version,
+                      (unsigned)downloaded, (unsigned)total);
+    }
+    if (chunksSent) {
+        Serial.printf("[OTA] Relay: %u chunks, %u resent\n", (unsigned)chunksSent, (unsigned)chunksResent);
+    }
+    if (updates) Serial.printf("[OTA] Last: %u byte delta in %u ms\n", (unsigned)lastBytes, (unsigned)lastMs);
+    if (failures) Serial.printf("[OTA] Last failure: %s\n", lastError);
+    if (!ParcelBoxOtaKey::isSet()) Serial.println(F("[OTA] No OTA key (OtaKey.cpp) - cameras not updated"));
+    for (uint8_t cam = 0; espNow && cam < espNow->peerCount(); cam++) {
+        portENTER_CRITICAL(&mux);
+        char running[ESPNOW_OTA_VERSION_LEN];
+        memcpy(running, camVersion[cam], sizeof(running));
+        portEXIT_CRITICAL(&mux);
+        Serial.printf("[OTA] CAM %u: %s\n", (unsigned)(cam + 1), running[0] ? running : "unknown");
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include "ESPNOW_CONFIG.h"
+#include "CloudLink.h"
+#include "DeltaPatch.h"
+#include "OtaFlash.h"
+#include "OtaKey.h"
+
+class EspNowManager;
+
+// ============================================================================
+// OTA UPDATER - Smart Parcel Locker
+// ============================================================================
+// Firmware updates for this board and the cameras, as deltas against the
+// image they run (DeltaPatch.h; made with host/delta_pack):
+// - check() (cloud task) reads the manifest at config/ota, which clients
+//   can't write:
+//     { main: { version, from, url, sha256 }, cam: { ... } }
+//   `from` is the version the delta was made against ("" for a full image),
+//   sha256 the hex digest of the new image. Every OTA_CHECK_MS, or at once
+//   after requestCheck(). Cameras go first, one at a time: their version is
+//   learned from QUERY / INFO over ESP-NOW.
+// - A short-lived task on core 0, below the cloud task, downloads the delta
+//   over HTTPS and never holds more of it than one read: for this board it
+//   goes through DeltaPatch into OtaFlash (the inactive partition), for a
+//   camera it is relayed in ESP-NOW chunks (ESPNOW_CONFIG.h) with at most
+//   ESPNOW_OTA_INFLIGHT of them kept for resends. A dropped connection
+//   resumes with a Range request where it stopped.
+// - Integrity is the manifest's SHA-256, which arrives over the Firebase
+//   TLS session; the download itself is not pinned. A camera gets that
+//   digest in a START tagged under the OTA key (OtaKey.h); without a key
+//   set, cameras are not updated.
+// - Scans keep being served throughout (control loop on core 1). A finished
+//   update only sets rebootDue(); the sketch restarts once nothing is busy.
+//   The camera restarts itself once its pipeline is idle.
+// - confirmBoot() marks a fresh image valid the first time Firebase is
+//   reached, so with rollback enabled in the bootloader a build that can't
+//   get online goes back to the previous one on the next reset.
+
+#define OTA_PATH                "/config/ota"
+#define OTA_CHECK_MS            (6UL * 3600 * 1000)
+#define OTA_RETRY_MS            (10UL * 60 * 1000)  // After a failed check or update
+#define OTA_QUERY_MS            60000   // Camera version query until it answers
+#define OTA_READ_BYTES          1024    // HTTP read size
+#define OTA_HTTP_TIMEOUT_MS     15000
+#define OTA_RECONNECTS          5       // Range resumes per update
+#define OTA_MIN_HEAP            60000   // Second TLS session next to Firebase's
+#define OTA_URL_LEN             160
+#define OTA_START_TRIES         5       // START → READY, ESPNOW_OTA_ACK_MS apart
+#define OTA_STALLS              20      // ACK timeouts in a row before giving up
+#define OTA_DONE_TRIES          40      // END → DONE (the CAM checks its image first)
+#define OTA_TASK_STACK          8192
+#define OTA_TASK_PRIORITY       1       // Below cloud (3): its queue and writes go first
+#define OTA_TASK_CORE           0
+
+enum OtaState : uint8_t {
+    OTA_IDLE = 0,
+    OTA_DOWNLOADING,        // This board
+    OTA_RELAYING,           // A camera
+    OTA_REBOOT_DUE
+};
+
+struct OtaEntry {
+    char version[ESPNOW_OTA_VERSION_LEN];
+    char from[ESPNOW_OTA_VERSION_LEN];
+    char url[OTA_URL_LEN];
+    uint8_t sha256[32];
+};
+
+class OtaUpdater {
+public:
+    OtaUpdater();
+
+    void begin(EspNowManager* espNow, const char* version);
+    void setLink(CloudLink* cloudLink) { link = cloudLink; }
+
+    // Cloud task, online: read the manifest when due and start an update
+    void check(FirebaseData* fbdo);
+    void requestCheck() { checkRequested = true; }
+
+    // Cloud task, once Firebase is reached: keep this image
+    void confirmBoot();
+
+    // WiFi task: a MSG_TYPE_OTA frame from camera
+    void onFrame(uint8_t camera, const uint8_t* data, int len);
+
+    // Control task, every pass: camera version queries
+    void service();
+
+    bool running() const { return state == OTA_DOWNLOADING || state == OTA_RELAYING; }
+    bool rebootDue() const { return state == OTA_REBOOT_DUE; }
+    void printStats();
+
+private:
+    EspNowManager* espNow;
+    CloudLink* link;
+    const char* version;
+    volatile OtaState state;
+    TaskHandle_t task;
+    bool bootConfirmed;
+
+    // Cloud task
+    bool checkRequested;
+    unsigned long nextCheckAt;
+    uint8_t camSkip;                // Cameras whose last update failed, passed over once
+
+    // Update in flight (task), set up by check()
+    OtaEntry job;
+    int8_t jobCamera;               // -1 = this board
+    uint32_t jobId;
+    uint32_t total;                 // Delta bytes, from Content-Length
+    uint32_t downloaded;
+    uint8_t reconnects;
+    uint8_t header[DELTA_HEADER_BYTES];
+    uint8_t* ring;                  // Relay: ESPNOW_OTA_INFLIGHT chunks
+    DeltaPatch patch;
+    OtaFlash flash;
+
+    // Camera versions and replies from the WiFi task (guarded by mux).
+    // Replies are folded, not queued: a later ACK never hides a RESEND.
+    portMUX_TYPE mux;
+    char camVersion[ESPNOW_MAX_PEERS][ESPNOW_OTA_VERSION_LEN];
+    uint8_t readyResult;            // 0xFF = none yet
+    uint8_t doneResult;
+    uint16_t ackNext;               // Furthest chunk the CAM asked for
+    uint16_t resendFrom;
+    bool resendPending;
+
+    // Control task
+    unsigned long lastQueryAt;
+
+    // Statistics
+    uint32_t checks;
+    uint32_t checkFailures;
+    uint32_t updates;
+    uint32_t failures;
+    uint32_t resumes;               // Range reconnects
+    uint32_t chunksSent;
+    uint32_t chunksResent;
+    uint32_t lastBytes;             // Delta size of the last update
+    uint32_t lastMs;
+    const char* lastError;
+
+    bool parseEntry(FirebaseJson* json, const char* key, OtaEntry& out);
+    bool start(const OtaEntry& entry, int8_t camera);
+    void finish(bool ok);
+
+    static void taskEntry(void* arg);
+    void run();
+    bool updateSelf(HTTPClient& http, WiFiClientSecure& client);
+    bool relay(HTTPClient& http, WiFiClientSecure& client);
+    bool connect(HTTPClient& http, WiFiClientSecure& client);
+    bool readExact(HTTPClient& http, WiFiClientSecure& client, uint8_t* out, size_t len);
+    size_t chunkLength(uint16_t seq) const;
+    bool fillChunk(HTTPClient& http, WiFiClientSecure& client, uint16_t seq);
+
+    void sendFrame(uint8_t status, uint16_t seq, const DeltaHeader* hdr);
+    void sendChunk(uint16_t seq);
+};
+
+#endif // OTA_UPDATER_H
@@ -51,11 +51,16 @@
 // ============================================================================
 #define BAUD_SERIAL 115200       // USB Serial debug + test commands
 
+// ============================================================================
+// FIRMWARE
+// ============================================================================
+#define FIRMWARE_VERSION "2.0.0"      // Reported with the device record and boot timings
+
 // ============================================================================
 // TIMING CONSTANTS (milliseconds)
 // ============================================================================
 #define LOCK_OPERATION_DELAY 500      // Delay between lock operations
-#define SMS_COOLDOWN 3000             // Prevent SMS spam (3s)
 #define QR_SCAN_DEBOUNCE 500
+#define DOOR_DEBOUNCE_MS 30           // Reed switch bounce window (runtime: door:debounce:<ms>)
 
 #endif // PINS_CONFIG_H
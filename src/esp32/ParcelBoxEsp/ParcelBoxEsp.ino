@@ -17,10 +17,40 @@
 #include "FirebaseConfig.h"
 #include "WiFiManagerCustom.h"
 #include "ESPNOW_CONFIG.h"
+#include "LOCKER_CONFIG.h"
+#include "FixedString.h"
+#include "EspNowManager.h"
+#include "ParcelCache.h"
+#include "TASKS_CONFIG.h"
+#include "TaskRuntime.h"
+#include "DoorSensors.h"
+#include "CloudWriter.h"
+#include "StatusWord.h"
+#include "EventJournal.h"
+#include "SystemMetrics.h"
+#include "ScanTrace.h"
+#include "GsmModem.h"
+#include "LcdRenderer.h"
+#include "BootTimeline.h"
+#include "CloudLink.h"
+#include "LinkManager.h"
+#include "ActuatorSequencer.h"
+#include "SerialConsole.h"
+#include "LogRing.h"
+#include "CommandChannel.h"
+#include "LockerCore.h"
+#include "LinkBench.h"
+#include "PowerManager.h"
+#include "SnapshotRelay.h"
+#include "OtaUpdater.h"
 
 // ESP-NOW library
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <esp_timer.h>
+
+// Workflow messages: deferred through the log ring, printed by the log task
+#define debugPrint(...) LOG_I("ESP32", __VA_ARGS__)
 
 // ============================================================================
 // HARDWARE SERIAL PORTS
@@ -38,54 +68,56 @@ Preferences preferences;
 // I2C LCD INITIALIZATION
 // ============================================================================
 LiquidCrystal_I2C lcd(LCD_I2C_ADDRESS, LCD_COLS, LCD_ROWS);
+LcdRenderer lcdRenderer;    // Shadow framebuffer, flushed by the ui task
 
 // ============================================================================
 // SYSTEM STATE STRUCTURE
 // ============================================================================
+// Compartments and deliveries live in lockerCore (LockerCore.h)
 struct SystemState {
-  String device_id = "";
-  String current_parcel_id = "";
-  String current_qr_code = "";
-  String current_receiver_phone = "";
-  String current_receiver_name = "";
-
-  bool lock1_open = false;
-  bool lock2_open = false;
-  bool door1_open = false;
-  bool door2_open = false;
-
-  unsigned long last_scan_time = 0;
+  FixedString<24> device_id;                // "PARCELBOX_" + 12 hex MAC digits
+
   unsigned long last_firebase_update = 0;
   unsigned long last_health_check = 0;
-  unsigned long last_sms_time = 0;
 
   bool wifi_connected = false;
   bool firebase_connected = false;
-  bool valid_scan = false;
-
-  // SMS trigger counters & flags
-  int invalid_scan_count = 0;
-  bool door_breach_alerted = false;     // already sent breach SMS for this breach event
-  bool valid_delivery_sms_sent = false; // already sent delivery-success SMS for this parcel
 } system_state;
 
+// RTDB paths that depend only on the device id — built once in generateDeviceId()
+struct DevicePaths {
+  FixedString<64> deviceStatus;   // /device_status/<id>
+  FixedString<80> commands;       // /device_status/<id>/commands
+} device_paths;
+
 // ============================================================================
 // FIREBASE CONNECTION STATE
 // ============================================================================
 bool firebaseInitialized = false;
 bool firebaseStreamReady = false;  // Tracks that streams were started
 
+// Cloud task bring-up of WiFi (see serviceNetworkBoot)
+enum { NET_BOOT_START, NET_BOOT_JOINING, NET_BOOT_PORTAL, NET_BOOT_DONE };
+uint8_t netBootStage = NET_BOOT_START;
+
 // ============================================================================
 // ESP-NOW — SINGLE MANAGER
 // ============================================================================
-// Single callback-based ESP-NOW. No EspNowManager conflicts.
-volatile bool espNowQrAvailable = false;
-ESPNOW_QRPacket_t espNowPacket;
-esp_now_peer_info_t camPeerInfo;
+// Sequenced CAM → Main protocol: duplicate suppression by seq, end-to-end ACKs.
+// One peer per CAMERAS[] row, in table order.
+EspNowManager espNow;
+
+// ESP-NOW throughput / loss / RTT against a camera (console `linkbench:`)
+LinkBench linkBench;
 
-// Duplicate scan protection
-static String lastProcessedEspNowQR = "";
-static unsigned long lastEspNowProcessTime = 0;
+// Breach pictures: CAM pre-trigger frame over ESP-NOW, uploaded by the cloud task
+SnapshotRelay snapshotRelay;
+
+// Delta firmware updates from config/ota, for this board and (relayed) the cameras
+OtaUpdater ota;
+
+// Light sleep / modem sleep while nothing is happening; every wake source calls power.wake()
+PowerManager power;
 
 // Firebase singleton objects (global for callback access)
 FirebaseData fbdo;
@@ -93,17 +125,73 @@ FirebaseData commandStream;
 FirebaseAuth auth;
 FirebaseConfig fbConfig;
 
+// TLS buffers, keep-alive on fbdo, handshake / reconnect timing
+CloudLink cloudLink;
+
+// WiFi STA state from WiFi.onEvent; wakes the cloud task on drops/recovery
+LinkManager linkManager;
+
 // Stream state
 bool commandStreamActive = false;
 
+// /commands/<pushId> queue: run once, acked through cloudWriter
+CommandChannel commandChannel;
+
+// Batched, coalescing outbound writes (history, lock status, heartbeat)
+CloudWriter cloudWriter;
+
+// Offline journal on LittleFS: events made while Firebase is unreachable
+EventJournal journal;
+
+// ============================================================================
+// PARCEL CACHE — local /parcels index for instant scan validation
+// ============================================================================
+ParcelCache parcelCache;
+FirebaseData parcelStream;
+bool parcelStreamActive = false;
+
+// ============================================================================
+// TASKS & QUEUES (see TASKS_CONFIG.h for the layout)
+// ============================================================================
+TaskRuntime taskRuntime;
+TaskInfo* controlTaskInfo = nullptr;
+
+// Heap / stack / loop-time telemetry, published with the heartbeat
+SystemMetrics systemMetrics;
+
+// Decode → actuation latency of the scan being handled (control task)
+ScanTrace scanTrace;
+
+// Power-on → phase timings (setup, gsm and cloud tasks)
+BootTimeline bootTimeline;
+
+QueueHandle_t doorEventQueue = nullptr;   // io → control
+QueueHandle_t controlQueue = nullptr;     // cloud → control
+QueueHandle_t cloudQueue = nullptr;       // any → cloud
+QueueHandle_t smsQueue = nullptr;         // any → gsm
+QueueHandle_t uiQueue = nullptr;          // any → ui
+
+// SIM800L driver, polled by the gsm task only
+GsmModem gsmModem;
+
+// Reed switches: GPIO ISR + debounce, events consumed by the io task
+DoorSensorEngine doorSensors;
+
+// Buzzer tones and lock relay timing (esp_timer, never blocks the caller)
+ActuatorSequencer actuators;
+
+bool breachBuzzerOn = false;
+
+// Scan validation, door state machine and SMS triggers (LockerCore.h),
+// driven through the board HAL below
+LockerCore lockerCore;
+
 // ============================================================================
 // SERIAL MONITOR FLAGS
 // ============================================================================
-bool reed1_monitor = false;
-bool reed2_monitor = false;
+SerialConsole console;        // Command table in SERIAL COMMANDS below
+uint8_t reed_monitor = 0;     // COMPARTMENT_BIT() of each reed switch being printed
 bool qr_monitor = false;
-bool gsm_monitor = false;
-unsigned long gsmRespTimeout = 0;
 unsigned long lastReedPrint = 0;
 
 // ============================================================================
@@ -111,20 +199,13 @@ unsigned long lastReedPrint = 0;
 // ============================================================================
 const unsigned long FIREBASE_UPDATE_INTERVAL = 5000;       // 5 seconds
 const unsigned long HEALTH_CHECK_INTERVAL = 30000;          // 30 seconds
-const unsigned long RECONNECT_CHECK_INTERVAL = 10000;       // 10 seconds
+const unsigned long LIVE_STATUS_INTERVAL = 1000;            // Packed status word, 1 second
 const unsigned long QR_SCAN_TIMEOUT = 30000;                // 30 seconds
+const unsigned long WIFI_FAST_JOIN_TIMEOUT = 15000;         // Saved network → portal fallback
 
 unsigned long lastFirebaseUpdate = 0;
 unsigned long lastHealthCheck = 0;
-unsigned long lastReconnectCheck = 0;
-
-// ============================================================================
-// STATE TRACKING FOR DIRTY-CHECK (prevents redundant Firebase writes)
-// ============================================================================
-bool prev_lock1 = false;
-bool prev_lock2 = false;
-bool prev_door1 = false;
-bool prev_door2 = false;
+unsigned long lastLiveStatus = 0;
 
 // ============================================================================
 // FUNCTION DECLARATIONS
@@ -132,533 +213,851 @@ bool prev_door2 = false;
 void setup();
 void loop();
 
+// Tasks
+void ioTask(void *pvParameters);
+void cloudTask(void *pvParameters);
+void gsmTask(void *pvParameters);
+void uiTask(void *pvParameters);
+void logTask(void *pvParameters);
+void processDoorEvents();
+void processControlQueue();
+void processCloudQueue();
+void updateCloudStatus();
+void postCloud(uint8_t type, const char* parcel_id, const char* event, uint8_t camera = 0);
+
 void setupWiFi();
 void initializeNTP();
-void checkWiFiConnection();
-void reconnectWiFi();
+void serviceNetworkBoot();
+void serviceCloudBoot();
+void onWiFiUp();
+void refreshIdleScreen();
+void serviceLink();
+void onWiFiRestored();
 
 void setupI2C_LCD();
-void displayLCD(String line1, String line2 = "", String line3 = "", String line4 = "");
+void displayLCD(const char* line1, const char* line2 = "", const char* line3 = "", const char* line4 = "");
+void displayReady(const char* line1, const char* line2, uint32_t afterMs = 0);
+void postScreen(uint32_t delayMs, const char* line1, const char* line2, const char* line3, const char* line4);
 
-void openLock(int lockNum);
-void closeLock(int lockNum);
-void playBuzzer(String tone_type);
+void playBuzzer(Tone tone);
 void playBreachBuzzer();
 void stopBreachBuzzer();
 void checkDoorSensors();
-void handleDoorClosed(int doorNum);
-void initSIM800L();
-void resetSIM800L();
-void sendSMS(String phone, String message);
-
-void processGSM();
-void handleParcelScanned(String qr_code);
-void validateAndOpenLocks(String qr_code);
-void closeLocksAfterDelivery();
-void emergencyLockdown();
-void resetSystem();
+void onDoorEvent(const DoorEvent& ev);
+void sendSMS(const char* phone, const char* message, uint8_t priority);
 
-void processSerialCommands();
-void printHelp();
+void setupConsole();
+void startBench();
+void printSubsystemStats();
+bool powerBusy();
+void restartForUpdate();
 
 // ESP-NOW — SINGLE PATH
 void setupEspNow();
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-void onEspNowSent(const wifi_tx_info_t *wifi_tx_info, esp_now_send_status_t status);
-#else
-void onEspNowSent(const uint8_t *mac_addr, esp_now_send_status_t status);
-#endif
-void onEspNowReceived(const esp_now_recv_info_t *info, const uint8_t *data, int len);
 void processEspNowQR();
-void syncEspNowChannel();
 
 // Firebase — SINGLE PATH
 void initializeFirebase();
 void registerDeviceInFirebase();
-void updateFirebaseStatus();
-void logParcelHistory(String parcel_id, String event);
+void logParcelHistory(const char* parcel_id, const char* event);
 
 // Firebase stream callbacks (static)
-void commandStreamCallback(MultiPathStream stream);
+void commandStreamCallback(FirebaseStream data);
 void commandStreamTimeoutCallback(bool timeout);
+bool queueRemoteCommand(uint8_t slot, CommandType type, uint8_t lock);
 void initCommandStream();
 void handleFirebaseStream();
 
-// Lock command callbacks
-void onLockCommandFromFirebase(int lockNum, bool open);
-void onEmergencyFromFirebase();
+// Parcel cache stream (/parcels → ParcelCache)
+void initParcelStream();
+void parcelStreamCallback(FirebaseStream data);
+void parcelStreamTimeoutCallback(bool timeout);
+void cacheParcelFromJson(const char* parcelId, FirebaseJson* json);
+bool fetchParcelFromFirebase(const char* qr_code);
+void confirmParcelInFirebase(const char* qr_code);
 
 void generateDeviceId();
 void checkSystemHealth();
-void debugPrint(String msg);
 
 // ============================================================================
-// SMS TRIGGER FUNCTIONS
+// LOCKER CORE — BOARD HAL
 // ============================================================================
-void smsSendValidDelivery();
-void smsSendInvalidAttempt();
-void smsSendDoorBreach();
+// LockerCore asks for hardware through these (LockerHal.h); each hands the
+// request to a driver or task queue and returns at once.
+struct BoardGpio : LockerGpio {
+  void unlock(uint8_t mask) override {
+    actuators.unlock(mask);
+    power.onUnlock();
+  }
+  void lock(uint8_t mask) override { actuators.lock(mask); }
+  void playTone(LockerTone tone) override {
+    static const Tone TONES[] = { TONE_CLICK, TONE_SUCCESS, TONE_ALERT };
+    playBuzzer(TONES[tone]);
+  }
+  // No-ops unless a scan is being traced
+  void mark(LockerMark mark) override {
+    switch (mark) {
+      case LOCKER_MARK_VALIDATE_START: scanTrace.mark(SCAN_STAGE_VALIDATE_START); break;
+      case LOCKER_MARK_VALIDATE_END:   scanTrace.mark(SCAN_STAGE_VALIDATE_END); break;
+      case LOCKER_MARK_ACTUATE:        scanTrace.mark(SCAN_STAGE_ACTUATE); break;
+      case LOCKER_MARK_DONE:           scanTrace.finish(); break;
+    }
+  }
+} boardGpio;
+
+struct BoardLcd : LockerLcd {
+  void show(const char* line1, const char* line2, const char* line3, const char* line4) override {
+    displayLCD(line1, line2, line3, line4);
+  }
+  void showReady(const char* line1, const char* line2, uint32_t afterMs) override {
+    displayReady(line1, line2, afterMs);
+  }
+} boardLcd;
+
+struct BoardUart : LockerUart {
+  void sendSms(const char* phone, const char* message, uint8_t priority) override {
+    sendSMS(phone, message, priority);
+  }
+} boardUart;
+
+struct BoardEspNow : LockerEspNow {
+  void ack(const EspNowQrScan& scan, uint8_t status) override { espNow.ack(scan, status); }
+  void requestSnapshot(uint8_t door, int64_t openedUs) override {
+    // The camera whose scans open this compartment looks at its door
+    uint8_t camera = 0;
+    for (uint8_t i = 0; i < CAMERA_COUNT; i++) {
+      if (CAMERAS[i].opens & COMPARTMENT_BIT(door)) {
+        camera = i;
+        break;
+      }
+    }
+    snapshotRelay.request(camera, door, openedUs);
+  }
+} boardEspNow;
+
+struct BoardFirebase : LockerFirebase {
+  bool lookupParcel(const char* parcelId, LockerParcel& out) override {
+    ParcelCacheEntry entry;
+    if (!parcelCache.lookup(parcelId, &entry)) return false;
+    strlcpy(out.receiverName, entry.receiverName, sizeof(out.receiverName));
+    strlcpy(out.contactNumber, entry.contactNumber, sizeof(out.contactNumber));
+    out.delivered = entry.status == PARCEL_STATUS_DELIVERED;
+    return true;
+  }
+  bool indexAuthoritative() override { return parcelCache.isSynced() && parcelStreamActive; }
+  bool online() override { return system_state.firebase_connected; }
+  void fetchParcel(uint8_t camera, const char* parcelId) override {
+    postCloud(CLOUD_MSG_FETCH_PARCEL, parcelId, "", camera);
+  }
+  void confirmParcel(const char* parcelId) override {
+    postCloud(CLOUD_MSG_CONFIRM_PARCEL, parcelId, "");
+  }
+  void logHistory(const char* parcelId, const char* event) override {
+    logParcelHistory(parcelId, event);
+  }
+} boardFirebase;
 
 // ============================================================================
 // SETUP FUNCTION
 // ============================================================================
 void setup() {
+  logRing.begin();             // Before anything logs: keeps pre-crash records
+  Serial.setTxBufferSize(CONSOLE_TX_BUFFER);
   Serial.begin(BAUD_SERIAL);
-  Serial.setTimeout(50);
-  delay(500);
+  setupConsole();
 
   Serial.println(F("================================================\n"
                    "Smart Parcel Locker - ESP32 Startup\n"
                    "================================================"));
 
-  // ── Step 1: GPIO ──────────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 1/7] Initializing GPIO pins..."));
-  pinMode(DOOR_SENSOR_1_PIN, INPUT_PULLUP);
-  pinMode(DOOR_SENSOR_2_PIN, INPUT_PULLUP);
-  pinMode(SIM800L_RST_PIN, OUTPUT);
-  pinMode(RELAY_1_PIN, OUTPUT);
-  pinMode(RELAY_2_PIN, OUTPUT);
-  digitalWrite(RELAY_1_PIN, HIGH);
-  digitalWrite(RELAY_2_PIN, HIGH);
-  digitalWrite(SIM800L_RST_PIN, HIGH);
+  // TLS buffer reservation before anything else touches the heap
+  cloudLink.reserve();
+
+  // Queues first: every subsystem below posts to them
+  doorEventQueue = xQueueCreate(DOOR_QUEUE_LEN, sizeof(DoorEventMsg_t));
+  controlQueue = xQueueCreate(CONTROL_QUEUE_LEN, sizeof(ControlMsg_t));
+  cloudQueue = xQueueCreate(CLOUD_QUEUE_LEN, sizeof(CloudMsg_t));
+  smsQueue = xQueueCreate(SMS_QUEUE_LEN, sizeof(SmsMsg_t));
+  uiQueue = xQueueCreate(UI_QUEUE_LEN, sizeof(UiMsg_t));
+
+  // Stages 1-3 never wait on the network or the modem; stage 4 brings those
+  // up on their own tasks while the box is already serving (BootTimeline.h)
+
+  // ── Stage 1: local hardware ──────────────────────────────────────────────
+  Serial.println(F("[BOOT 1/4] GPIO, UARTs, LCD, device ID..."));
+  for (const CompartmentConfig_t& c : COMPARTMENTS) {
+    pinMode(c.doorPin, INPUT_PULLUP);
+    pinMode(c.relayPin, OUTPUT);
+    digitalWrite(c.relayPin, HIGH);
+  }
   ledcAttach(BUZZER_PIN, 1000, BUZZER_RESOLUTION);
-  Serial.println(F("[SETUP 1/7] GPIO OK"));
-
-  // ── Step 2: UARTs ─────────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 2/7] Initializing UARTs..."));
-  sim800l.begin(BAUD_SIM800L, SERIAL_8N1, SIM800L_RX_PIN, SIM800L_TX_PIN);
-  sim800l.setTimeout(50);
+  uint8_t relayPins[COMPARTMENT_COUNT];
+  for (uint8_t i = 0; i < COMPARTMENT_COUNT; i++) relayPins[i] = COMPARTMENTS[i].relayPin;
+  actuators.begin(relayPins, COMPARTMENT_COUNT, BUZZER_PIN);
   qrScanner.setTimeout(100);
-  Serial.println(F("[SETUP 2/7] UARTs OK"));
 
-  // ── Step 3: I2C + LCD ────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 3/7] Initializing I2C + LCD..."));
   Wire.begin(LCD_SDA_PIN, LCD_SCL_PIN);
   setupI2C_LCD();
+  taskRuntime.start("ui", uiTask, UI_TASK_STACK, UI_TASK_PRIORITY, UI_TASK_CORE);
+  taskRuntime.start("log", logTask, LOG_TASK_STACK, LOG_TASK_PRIORITY, LOG_TASK_CORE);
   displayLCD("PARCEL LOCKER", "Initializing...", "v2.0 (ESP32)", "");
-  delay(1000);
-  Serial.println(F("[SETUP 3/7] LCD OK"));
 
-  // ── Step 4: Device ID ────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 4/7] Generating Device ID..."));
   generateDeviceId();
-  Serial.println("[SETUP 4/7] Device ID: " + system_state.device_id);
-
-  // ── Step 5: SIM800L ──────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 5/7] Initializing SIM800L..."));
-  initSIM800L();
-  Serial.println(F("[SETUP 5/7] SIM800L OK"));
-  playBuzzer("startup");
-
-  // ── Step 6: WiFi ─────────────────────────────────────────────────────────
-  Serial.println(F("[SETUP 6/7] Starting WiFi..."));
-  displayLCD("Setting up WiFi", "Join: ParcelBox", "_Setup or wait...", "pw: password123");
-  setupWiFi();
-  Serial.println("[SETUP 6/7] WiFi result: " + String(system_state.wifi_connected ? "CONNECTED" : "OFFLINE"));
-
-  // ── Step 7: ESP-NOW + Firebase ──────────────────────────────────────────
-  if (system_state.wifi_connected) {
-    Serial.println(F("[SETUP 7/7] Initializing Communication System..."));
-    displayLCD("Initializing", "Communications", "", "");
-
-    // STEP 7a: ESP-NOW first (needs WiFi in STA mode)
-    setupEspNow();
-
-    // STEP 7b: Firebase second
-    initializeFirebase();
-
-    Serial.println("[SETUP 7/7] Communication result: " +
-      String(firebaseInitialized ? "CONNECTED" : "FAILED"));
-  } else {
-    Serial.println(F("[SETUP 7/7] Communication SKIPPED (no WiFi)"));
-  }
-
-  // ── Ready ─────────────────────────────────────────────────────────────────
-  displayLCD("SYSTEM READY", "Waiting for parcel",
-             "WiFi: " + String(system_state.wifi_connected ? "OK" : "---"),
-             "FB: " + String(system_state.firebase_connected ? "OK" : "---"));
+  Serial.printf("[BOOT 1/4] Device ID: %s\n", system_state.device_id.c_str());
+  lockerCore.begin({ &boardGpio, &boardLcd, &boardUart, &boardEspNow, &boardFirebase },
+                   system_state.device_id.c_str());
+  bootTimeline.mark(BOOT_PHASE_LOCAL);
+
+  // ── Stage 2: storage ─────────────────────────────────────────────────────
+  // The LittleFS parcel cache lets scans validate before (or without) Firebase
+  Serial.println(F("[BOOT 2/4] Parcel cache + journal..."));
+  cloudWriter.begin(system_state.device_id.c_str(), COMPARTMENT_COUNT);
+  parcelCache.begin();
+  journal.begin();
+  logRing.saveCrashDump();    // LittleFS is mounted now
+  cloudWriter.setJournal(&journal);
+  systemMetrics.begin(&taskRuntime, &espNow, &scanTrace);
+  systemMetrics.setBootTimeline(&bootTimeline);
+  cloudWriter.setMetrics(&systemMetrics);
+  cloudWriter.setLink(&cloudLink);
+  snapshotRelay.setLink(&cloudLink);
+  snapshotRelay.setWriter(&cloudWriter);
+  ota.setLink(&cloudLink);
+  systemMetrics.setCloudLink(&cloudLink);
+  commandChannel.begin(device_paths.commands.c_str(), COMPARTMENT_COUNT, queueRemoteCommand);
+  cloudWriter.setCommands(&commandChannel);
+  systemMetrics.setCommandChannel(&commandChannel);
+  bootTimeline.mark(BOOT_PHASE_STORAGE);
+
+  // ── Stage 3: local service ───────────────────────────────────────────────
+  // Doors, CAM link and the control loop. The modem only gets its reset
+  // pulse here; probe and configuration run in the gsm task, and SMS raised
+  // before it is ready wait in its queue.
+  Serial.println(F("[BOOT 3/4] Doors, ESP-NOW, SIM800L..."));
+  gsmModem.begin(sim800l, BAUD_SIM800L, SIM800L_RX_PIN, SIM800L_TX_PIN, SIM800L_RST_PIN);
+  controlTaskInfo = taskRuntime.adoptCurrent("control", getArduinoLoopTaskStackSize());
+  power.begin(xTaskGetCurrentTaskHandle(), &doorSensors);
+  taskRuntime.start("io", ioTask, IO_TASK_STACK, IO_TASK_PRIORITY, IO_TASK_CORE);
+  taskRuntime.start("gsm", gsmTask, GSM_TASK_STACK, GSM_TASK_PRIORITY, GSM_TASK_CORE);
+  linkManager.begin();
+  setupEspNow();    // STA mode now; the channel follows the AP once associated
+  displayReady("SYSTEM READY", "Waiting for parcel");
+  bootTimeline.mark(BOOT_PHASE_READY);
+
+  // ── Stage 4: network (cloud task, core 0) ────────────────────────────────
+  // WiFi join → NTP + Firebase auth, concurrently with the GSM boot
+  Serial.println(F("[BOOT 4/4] Network joining in background"));
+  taskRuntime.start("cloud", cloudTask, CLOUD_TASK_STACK, CLOUD_TASK_PRIORITY, CLOUD_TASK_CORE);
+  playBuzzer(TONE_STARTUP);
 
   Serial.println();
   Serial.println("============================================");
   Serial.println("  PARCEL BOX READY - Type 'help' for cmds");
-  Serial.println("  WiFi: " + String(system_state.wifi_connected ? "Connected" : "Offline"));
-  Serial.println("  FB:   " + String(system_state.firebase_connected ? "Connected" : "Offline"));
+  Serial.println("  Network status: 'boot' / 'status'");
   Serial.println("============================================");
 }
 
 // ============================================================================
-// MAIN LOOP
+// MAIN LOOP — CONTROL (Arduino loopTask, core 1)
 // ============================================================================
+// Owns the parcel workflow. Never touches Firebase or the modem directly:
+// cloud work goes to cloudQueue, SMS to smsQueue, LCD updates to uiQueue.
 void loop() {
-  processSerialCommands();
-  checkWiFiConnection();
+  TaskRuntime::workBegin(controlTaskInfo);
+
+  if (power.idle() && Serial.available()) power.wake(POWER_WAKE_CONSOLE);
+  console.poll();
 
   // ESP-NOW QR from ESP32-CAM (highest priority)
   processEspNowQR();
+  espNow.serviceTimeSync();
+  espNow.serviceChannel();
+  snapshotRelay.service();
+  ota.service();
 
-  // Process GSM responses
-  processGSM();
+  // Door transitions detected by the io task
+  processDoorEvents();
 
-  // Monitor door sensors
-  checkDoorSensors();
+  // Remote commands and parcel lookups answered by the cloud task
+  processControlQueue();
 
-  // Breach Buzzer Alert: Non-stop buzzing if any door is open without a valid scan
-  if ((system_state.door1_open || system_state.door2_open) && !system_state.valid_scan) {
-    playBreachBuzzer();
-  } else {
-    stopBreachBuzzer();
+  // Continuous reed switch monitoring output (only when enabled)
+  if (reed_monitor && millis() - lastReedPrint >= 500) {
+    lastReedPrint = millis();
+    for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+      if (!(reed_monitor & COMPARTMENT_BIT(id))) continue;
+      Serial.printf("[REED-%u] %s\n", (unsigned)id,
+                    digitalRead(COMPARTMENTS[id - 1].doorPin) == HIGH ? "OPEN" : "CLOSED");
+    }
   }
 
+  power.service(powerBusy());
 
-  // Continuous reed switch monitoring output (only when enabled)
-  if (reed1_monitor || reed2_monitor) {
-    if (millis() - lastReedPrint >= 500) {
-      lastReedPrint = millis();
-      if (reed1_monitor) {
-        Serial.println("[REED-1] " + String(digitalRead(DOOR_SENSOR_1_PIN) == HIGH ? "OPEN" : "CLOSED"));
-      }
-      if (reed2_monitor) {
-        Serial.println("[REED-2] " + String(digitalRead(DOOR_SENSOR_2_PIN) == HIGH ? "OPEN" : "CLOSED"));
-      }
+  TaskRuntime::workEnd(controlTaskInfo);
+  // A queued scan or a wake from idle cuts the wait short
+  ulTaskNotifyTake(pdTRUE, power.period(CONTROL_PERIOD_MS));
+}
+
+void processDoorEvents() {
+  DoorEventMsg_t ev;
+  while (xQueueReceive(doorEventQueue, &ev, 0) == pdTRUE) {
+    if (!ev.open) lockerCore.onDoorClosed(ev.door);
+  }
+}
+
+void processControlQueue() {
+  ControlMsg_t msg;
+  while (xQueueReceive(controlQueue, &msg, 0) == pdTRUE) {
+    switch (msg.type) {
+      case CONTROL_MSG_REMOTE_LOCK:
+        lockerCore.remoteLock(msg.lockNum, msg.flag);
+        commandChannel.executed(msg.command, true);
+        break;
+      case CONTROL_MSG_EMERGENCY:
+        lockerCore.emergencyLockdown();
+        commandChannel.executed(msg.command, true);
+        break;
+      case CONTROL_MSG_PARCEL_RESULT:
+        lockerCore.onParcelResult(msg.camera, msg.parcelId, msg.flag);
+        break;
     }
   }
+}
 
-  // ── Firebase: handle streaming command channel ──────────────────────────
-  if (system_state.firebase_connected) {
-    handleFirebaseStream();
+// ============================================================================
+// IO TASK — door sensors + breach buzzer (core 1, highest priority)
+// ============================================================================
+void ioTask(void *pvParameters) {
+  TaskInfo* self = (TaskInfo*)pvParameters;
+
+  // ISRs are attached from here so they run on this core and wake this task
+  uint8_t doorPins[COMPARTMENT_COUNT];
+  for (uint8_t i = 0; i < COMPARTMENT_COUNT; i++) doorPins[i] = COMPARTMENTS[i].doorPin;
+  doorSensors.begin(doorPins, COMPARTMENT_COUNT, DOOR_DEBOUNCE_MS, xTaskGetCurrentTaskHandle());
+
+  while (true) {
+    // Woken immediately by a door edge; the timeout drives debounce settling
+    ulTaskNotifyTake(pdTRUE, power.period(IO_TASK_PERIOD_MS));
+
+    TaskRuntime::workBegin(self);
+    checkDoorSensors();
+
+    // Breach Buzzer Alert: Non-stop buzzing if any door is open without a valid scan
+    bool breach = lockerCore.breachActive();
+    if (breach != breachBuzzerOn) {
+      breachBuzzerOn = breach;
+      if (breach) playBreachBuzzer(); else stopBreachBuzzer();
+    }
+    TaskRuntime::workEnd(self);
   }
+}
+
+// ============================================================================
+// CLOUD TASK — WiFi, Firebase streams and writes (core 0)
+// ============================================================================
+void cloudTask(void *pvParameters) {
+  TaskInfo* self = (TaskInfo*)pvParameters;
+  linkManager.setOwner(xTaskGetCurrentTaskHandle());
+
+  while (true) {
+    // Outside the pass timing: the setup portal may block this task for minutes
+    if (netBootStage != NET_BOOT_DONE) serviceNetworkBoot();
+
+    TaskRuntime::workBegin(self);
+    if (netBootStage == NET_BOOT_DONE) serviceLink();
+    serviceCloudBoot();
 
-  // ── Firebase: update lock status (THROTTLED + DIRTY-CHECKED) ────────────
-  if (system_state.firebase_connected && firebaseInitialized) {
-    system_state.firebase_connected = Firebase.ready();
     if (system_state.firebase_connected) {
-      bool lock1 = system_state.lock1_open;
-      bool lock2 = system_state.lock2_open;
-      bool door1 = system_state.door1_open;
-      bool door2 = system_state.door2_open;
-
-      // Only write to Firebase when state actually changes
-      if (lock1 != prev_lock1 || lock2 != prev_lock2 ||
-          door1 != prev_door1 || door2 != prev_door2) {
-        updateFirebaseStatus();
-        prev_lock1 = lock1;
-        prev_lock2 = lock2;
-        prev_door1 = door1;
-        prev_door2 = door2;
-      }
+      handleFirebaseStream();
+    }
 
-      // Periodic heartbeat (every 30s)
-      if (millis() - lastHealthCheck > HEALTH_CHECK_INTERVAL) {
-        lastHealthCheck = millis();
-        if (firebaseInitialized && Firebase.ready()) {
-          String devPath = ParcelBoxFirebaseConfig::getDeviceStatusPath();
-          Firebase.RTDB.setInt(&fbdo, (devPath + "/" + system_state.device_id + "/last_heartbeat").c_str(), millis());
-        }
-        checkSystemHealth();
+    processCloudQueue();
+    updateCloudStatus();
+
+    // Parcel cache / journal: write back to flash in groups
+    parcelCache.flushIfDirty();
+    journal.service();
+
+    // New firmware written: restart once nothing is in progress and the
+    // journal is out
+    if (ota.rebootDue() && !powerBusy() && !journal.pendingCount()) restartForUpdate();
+    TaskRuntime::workEnd(self);
+
+    // Link events cut the wait short
+    ulTaskNotifyTake(pdTRUE, power.period(CLOUD_TASK_PERIOD_MS));
+  }
+}
+
+void processCloudQueue() {
+  CloudMsg_t msg;
+  while (xQueueReceive(cloudQueue, &msg, 0) == pdTRUE) {
+    switch (msg.type) {
+      case CLOUD_MSG_CONFIRM_PARCEL:
+        confirmParcelInFirebase(msg.parcelId);
+        break;
+      case CLOUD_MSG_FETCH_PARCEL: {
+        ControlMsg_t reply = {};
+        reply.type = CONTROL_MSG_PARCEL_RESULT;
+        reply.camera = msg.camera;
+        strlcpy(reply.parcelId, msg.parcelId, sizeof(reply.parcelId));
+        reply.flag = system_state.firebase_connected && Firebase.ready() &&
+                     fetchParcelFromFirebase(msg.parcelId);
+        xQueueSend(controlQueue, &reply, pdMS_TO_TICKS(100));
+        break;
       }
     }
   }
+}
+
+void updateCloudStatus() {
+  // Latest state only — CloudWriter skips it when nothing changed
+  LockStatus status = {};
+  for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+    const Compartment& c = lockerCore.compartment(id);
+    if (c.lock_open) status.locksOpen |= COMPARTMENT_BIT(id);
+    if (c.door_open) status.doorsOpen |= COMPARTMENT_BIT(id);
+  }
+  cloudWriter.setLockStatus(status);
+
+  // Re-evaluated every pass so the flag recovers after an outage
+  system_state.firebase_connected = firebaseInitialized && system_state.wifi_connected &&
+                                    Firebase.ready();
+  if (!system_state.firebase_connected) {
+    // Offline: history and status changes go to the journal for replay
+    cloudWriter.spillToJournal();
+    return;
+  }
+
+  // Live status word (every 1s): a 16-character string, rides the next batch
+  if (millis() - lastLiveStatus >= LIVE_STATUS_INTERVAL) {
+    lastLiveStatus = millis();
+    StatusWord word = {};
+    word.locksOpen = status.locksOpen;
+    word.doorsOpen = status.doorsOpen;
+    if (!lockerCore.idle()) word.flags |= STATUS_FLAG_DELIVERY;
+    if (breachBuzzerOn) word.flags |= STATUS_FLAG_BREACH;
+    word.rssi = (int8_t)WiFi.RSSI();
+    word.heapFree = ESP.getFreeHeap();
+    word.uptimeS = (uint32_t)(esp_timer_get_time() / 1000000);
+    cloudWriter.setLiveStatus(word);
+  }
+
+  // Periodic heartbeat (every 30s), sent in the next batch
+  if (millis() - lastHealthCheck > HEALTH_CHECK_INTERVAL) {
+    lastHealthCheck = millis();
+    systemMetrics.sample();
+    cloudWriter.setHeartbeat(millis());
+    checkSystemHealth();
+  }
 
-  delay(10);  // Reduced from 50ms — watchdog-friendly, better responsiveness
+  // One multi-path updateNode for everything pending
+  cloudWriter.flush(&fbdo);
+
+  // Breach snapshot: one part per pass, between the batches
+  snapshotRelay.upload(&fbdo);
+
+  // Firmware manifest when due; the download runs on its own task
+  ota.check(&fbdo);
 }
 
-// ============================================================================
-// SERIAL COMMAND PROCESSING
-// ============================================================================
-void processSerialCommands() {
-  if (!Serial.available()) return;
-
-  String rawLine = Serial.readStringUntil('\n');
-  rawLine.trim();
-  if (rawLine.length() == 0) return;
-
-  String cmd = rawLine;
-  cmd.toLowerCase();
-
-  Serial.print("[Serial] Cmd: "); Serial.println(rawLine);
-
-  if (cmd == "relay-1:on") { openLock(1); Serial.println(F("[RELAY-1] ON")); }
-  else if (cmd == "relay-1:off") { closeLock(1); Serial.println(F("[RELAY-1] OFF")); }
-  else if (cmd == "relay-2:on") { openLock(2); Serial.println(F("[RELAY-2] ON")); }
-  else if (cmd == "relay-2:off") { closeLock(2); Serial.println(F("[RELAY-2] OFF")); }
-  else if (cmd == "buzzer:on") { ledcWriteTone(BUZZER_PIN, 1000); Serial.println(F("[BUZZER] ON")); }
-  else if (cmd == "buzzer:off") { ledcWriteTone(BUZZER_PIN, 0); Serial.println(F("[BUZZER] OFF")); }
-  else if (cmd == "lcd:test") { displayLCD("LCD TEST", "Line 2 OK", "Line 3 OK", "Line 4 OK"); }
-  else if (cmd == "reed-1:read") { Serial.println("[REED-1] " + String(digitalRead(DOOR_SENSOR_1_PIN) == HIGH ? "OPEN" : "CLOSED")); }
-  else if (cmd == "reed-1:mon:on") { reed1_monitor = true; Serial.println(F("[REED-1] Monitor ON")); }
-  else if (cmd == "reed-1:mon:off") { reed1_monitor = false; Serial.println(F("[REED-1] Monitor OFF")); }
-  else if (cmd == "reed-2:read") { Serial.println("[REED-2] " + String(digitalRead(DOOR_SENSOR_2_PIN) == HIGH ? "OPEN" : "CLOSED")); }
-  else if (cmd == "reed-2:mon:on") { reed2_monitor = true; Serial.println(F("[REED-2] Monitor ON")); }
-  else if (cmd == "reed-2:mon:off") { reed2_monitor = false; Serial.println(F("[REED-2] Monitor OFF")); }
-  else if (cmd == "qr:mon:on") { qr_monitor = true; Serial.println(F("[QR] Monitor ON")); }
-  else if (cmd == "qr:mon:off") { qr_monitor = false; Serial.println(F("[QR] Monitor OFF")); }
-  else if (cmd == "gsm:mon:on") { gsm_monitor = true; Serial.println(F("[GSM] Monitor ON")); }
-  else if (cmd == "gsm:mon:off") { gsm_monitor = false; Serial.println(F("[GSM] Monitor OFF")); }
-  else if (cmd.startsWith("gsm:")) {
-    String atCmd = rawLine.substring(4);
-    atCmd.trim();
-    Serial.print("[GSM] Sending: "); Serial.println(atCmd);
-    sim800l.println(atCmd);
-    gsmRespTimeout = millis() + 2000;
-  }
-  else if (cmd == "status") { checkSystemHealth(); }
-  else if (cmd == "help") { printHelp(); }
-  else { Serial.println("[ERR] Unknown: '" + cmd + "' | Type help"); }
+void postCloud(uint8_t type, const char* parcel_id, const char* event, uint8_t camera) {
+  CloudMsg_t msg = {};
+  msg.type = type;
+  msg.camera = camera;
+  strlcpy(msg.parcelId, parcel_id, sizeof(msg.parcelId));
+  strlcpy(msg.event, event, sizeof(msg.event));
+  if (xQueueSend(cloudQueue, &msg, 0) != pdTRUE) {
+    LOG_W("TASK", "Cloud queue full - event dropped");
+  }
 }
 
-void printHelp() {
-  Serial.println(F("======= PARCEL LOCKER COMMANDS ======="
-                   "\nrelay-1:on/off         Control lock 1"
-                   "\nrelay-2:on/off         Control lock 2"
-                   "\nbuzzer:on/off          Buzzer control"
-                   "\nlcd:test               LCD test display"
-                   "\nreed-1:read            Read reed switch 1"
-                   "\nreed-1:mon:on/off      Continuous reed-1 monitor"
-                   "\nreed-2:read            Read reed switch 2"
-                   "\nreed-2:mon:on/off      Continuous reed-2 monitor"
-                   "\nqr:mon:on/off          Print raw QR scanner data"
-                   "\ngsm:<AT CMD>           Send AT command to SIM800L"
-                   "\ngsm:mon:on/off         Forward GSM responses"
-                   "\nstatus                 System health check"
-                   "\nhelp                   Show this help"
-                   "\n======================================"));
+// ============================================================================
+// GSM TASK — SIM800L state machine + outbound SMS (core 1)
+// ============================================================================
+void gsmTask(void *pvParameters) {
+  TaskInfo* self = (TaskInfo*)pvParameters;
+  SmsMsg_t sms;
+
+  while (true) {
+    // Wait briefly for outbound SMS; the modem is polled every pass regardless
+    bool got = xQueueReceive(smsQueue, &sms, power.period(20)) == pdTRUE;
+    TaskRuntime::workBegin(self);
+    while (got) {
+      gsmModem.enqueue(sms);
+      got = xQueueReceive(smsQueue, &sms, 0) == pdTRUE;
+    }
+    gsmModem.poll();
+    if (!bootTimeline.done(BOOT_PHASE_GSM) && gsmModem.isReady()) bootTimeline.mark(BOOT_PHASE_GSM);
+    TaskRuntime::workEnd(self);
+  }
 }
 
 // ============================================================================
-// LOCK CONTROL
+// UI TASK — LCD rendering (core 1, lowest priority)
 // ============================================================================
-void openLock(int lockNum) {
-  int pin = (lockNum == 1) ? RELAY_1_PIN : RELAY_2_PIN;
-  digitalWrite(pin, LOW);
-  if (lockNum == 1) system_state.lock1_open = true;
-  else system_state.lock2_open = true;
-  debugPrint("Lock " + String(lockNum) + " OPENED");
-  playBuzzer("click");
+void uiTask(void *pvParameters) {
+  TaskInfo* self = (TaskInfo*)pvParameters;
+  UiMsg_t msg;
+  TickType_t wait = portMAX_DELAY;
+
+  while (true) {
+    // Sleeps until a screen arrives, a timed screen is due or a capped flush may run
+    bool got = xQueueReceive(uiQueue, &msg, wait) == pdTRUE;
+    TaskRuntime::workBegin(self);
+    while (got) {
+      lcdRenderer.submit(msg);    // Screens queued together coalesce into one flush
+      got = xQueueReceive(uiQueue, &msg, 0) == pdTRUE;
+    }
+    wait = lcdRenderer.service();
+    TaskRuntime::workEnd(self);
+  }
 }
 
-void closeLock(int lockNum) {
-  int pin = (lockNum == 1) ? RELAY_1_PIN : RELAY_2_PIN;
-  digitalWrite(pin, HIGH);
-  if (lockNum == 1) system_state.lock1_open = false;
-  else system_state.lock2_open = false;
-  debugPrint("Lock " + String(lockNum) + " CLOSED");
+// ============================================================================
+// LOG TASK — deferred log output (core 0, lowest priority)
+// ============================================================================
+void logTask(void *pvParameters) {
+  TaskInfo* self = (TaskInfo*)pvParameters;
+  while (true) {
+    vTaskDelay(power.period(LOG_TASK_PERIOD_MS));
+    TaskRuntime::workBegin(self);
+    logRing.drain();
+    TaskRuntime::workEnd(self);
+  }
 }
 
 // ============================================================================
-// BUZZER
+// SERIAL COMMANDS
 // ============================================================================
-void playBuzzer(String tone_type) {
-  if (tone_type == "startup") {
-    for (int i = 0; i < 2; i++) { ledcWriteTone(BUZZER_PIN, 1000); delay(100); ledcWriteTone(BUZZER_PIN, 0); delay(50); }
-  } else if (tone_type == "success") {
-    for (int freq = 800; freq < 2000; freq += 50) { ledcWriteTone(BUZZER_PIN, freq); delay(20); }
-  } else if (tone_type == "alert") {
-    for (int i = 0; i < 5; i++) { ledcWriteTone(BUZZER_PIN, 2000); delay(50); ledcWriteTone(BUZZER_PIN, 0); delay(50); }
-  } else if (tone_type == "click") {
-    ledcWriteTone(BUZZER_PIN, 1500); delay(50);
-  }
-  ledcWriteTone(BUZZER_PIN, 0);
+// Table-dispatched by SerialConsole from the control loop; handlers get the
+// lowercased remainder of prefix commands (raw for the AT passthrough).
+
+// relay-<n>:on/off, reed-<n>:read, reed-<n>:mon:on/off (args = "<n>:<action>")
+void cmdCompartment(bool relay, const char* args) {
+  char* action;
+  long id = strtol(args, &action, 10);
+  if (id < 1 || id > COMPARTMENT_COUNT) {
+    Serial.printf("[ERR] No compartment %ld (1-%u)\n", id, (unsigned)COMPARTMENT_COUNT);
+  } else if (relay && strcmp(action, ":on") == 0) {
+    lockerCore.openLocks(COMPARTMENT_BIT(id)); Serial.printf("[RELAY-%ld] ON\n", id);
+  } else if (relay && strcmp(action, ":off") == 0) {
+    lockerCore.closeLocks(COMPARTMENT_BIT(id)); Serial.printf("[RELAY-%ld] OFF\n", id);
+  } else if (!relay && strcmp(action, ":read") == 0) {
+    Serial.printf("[REED-%ld] %s\n", id,
+                  digitalRead(COMPARTMENTS[id - 1].doorPin) == HIGH ? "OPEN" : "CLOSED");
+  } else if (!relay && strcmp(action, ":mon:on") == 0) {
+    reed_monitor |= COMPARTMENT_BIT(id); Serial.printf("[REED-%ld] Monitor ON\n", id);
+  } else if (!relay && strcmp(action, ":mon:off") == 0) {
+    reed_monitor &= ~COMPARTMENT_BIT(id); Serial.printf("[REED-%ld] Monitor OFF\n", id);
+  } else {
+    Serial.printf("[ERR] Unknown action '%s' | Type help\n", action);
+  }
 }
 
-void playBreachBuzzer() {
-  ledcWriteTone(BUZZER_PIN, 2000); // High pitch alert for breach
+void cmdGsmRaw(const char* args) {
+  FixedString<96> atCmd = args;
+  atCmd.trim();
+  if (!gsmModem.queueRaw(atCmd.c_str())) Serial.println(F("[GSM] Previous command still queued"));
 }
 
-void stopBreachBuzzer() {
-  ledcWriteTone(BUZZER_PIN, 0);
+void cmdDebounce(const char* args) {
+  uint32_t ms = strtoul(args, nullptr, 10);
+  doorSensors.setDebounceMs(ms);
+  Serial.printf("[DOOR] Debounce set to %u ms\n", (unsigned)ms);
 }
 
-// ============================================================================
-// DOOR SENSORS
-// ============================================================================
-void checkDoorSensors() {
-  bool nd1 = digitalRead(DOOR_SENSOR_1_PIN) == HIGH;
-  bool nd2 = digitalRead(DOOR_SENSOR_2_PIN) == HIGH;
-
-  // — Door 1 (parcel door) —
-  if (nd1 != system_state.door1_open) {
-    system_state.door1_open = nd1;
-    if (system_state.door1_open) {
-      debugPrint("Parcel door OPENED");
-      // Door opened WITHOUT a valid scan — possible break-in
-      if (!system_state.valid_scan) {
-        smsSendDoorBreach();
-      }
-    } else {
-      debugPrint("Parcel door CLOSED");
-      handleDoorClosed(1);
-    }
-  }
+void cmdStats(const char*) {
+  taskRuntime.printStats();
+  printSubsystemStats();
+  lcdRenderer.printStats();
+  console.printStats();
+}
 
-  // — Door 2 (payment box door) —
-  if (nd2 != system_state.door2_open) {
-    system_state.door2_open = nd2;
-    if (system_state.door2_open) {
-      debugPrint("Payment box door OPENED");
-      // Door opened WITHOUT a valid scan — possible break-in
-      if (!system_state.valid_scan) {
-        smsSendDoorBreach();
-      }
-    } else {
-      debugPrint("Payment box door CLOSED");
-      handleDoorClosed(2);
-    }
+// linkbench:<mode>[:<size>[:<count>[:<cam>]]], cam 1-based like CAMERAS[]
+void cmdLinkBench(const char* args) {
+  LinkBenchConfig cfg = { 0, ESPNOW_BENCH_MODE_PING, LINKBENCH_DEFAULT_SIZE, LINKBENCH_DEFAULT_COUNT, false };
+  const char* rest = strchr(args, ':');
+  size_t modeLen = rest ? (size_t)(rest - args) : strlen(args);
+  if (modeLen == 4 && strncmp(args, "ping", 4) == 0) cfg.mode = ESPNOW_BENCH_MODE_PING;
+  else if (modeLen == 2 && strncmp(args, "tx", 2) == 0) cfg.mode = ESPNOW_BENCH_MODE_FLOOD_TX;
+  else if (modeLen == 2 && strncmp(args, "rx", 2) == 0) cfg.mode = ESPNOW_BENCH_MODE_FLOOD_RX;
+  else if (modeLen == 6 && strncmp(args, "survey", 6) == 0) cfg.survey = true;
+  else {
+    Serial.printf("[ERR] Unknown bench mode '%s' | Type help\n", args);
+    return;
   }
 
-  // Reset breach alert flag when BOTH doors fully close & system resets to ready state
-  if (!nd1 && !nd2 && system_state.current_parcel_id == "") {
-    system_state.door_breach_alerted = false;
+  unsigned long size = cfg.size, count = cfg.count, cam = 1;
+  if (rest) sscanf(rest, ":%lu:%lu:%lu", &size, &count, &cam);
+  if (size > ESPNOW_BENCH_MAX_LEN) size = ESPNOW_BENCH_MAX_LEN;
+  cfg.size = (uint8_t)size;
+  cfg.count = (uint16_t)(count > LINKBENCH_MAX_COUNT ? LINKBENCH_MAX_COUNT : count);
+  cfg.camera = (uint8_t)(cam - 1);
+  if (cam < 1 || cam > espNow.peerCount()) {
+    Serial.printf("[ERR] No camera %lu\n", cam);
+    return;
   }
+  if (!linkBench.start(cfg)) Serial.println(F("[LINKBENCH] Already running"));
 }
 
-void handleDoorClosed(int doorNum) {
-  if (doorNum == 1) {
-    system_state.lock1_open = false;
-    debugPrint("Parcel door closed - marking as delivered");
-    displayLCD("Parcel Locked", "Delivery complete", "", "");
+void cmdTrace(const char*) {
+  scanTrace.print();
+  bootTimeline.print();
+}
 
-    // Send SMS for valid delivery (locks opened via valid QR, door closed)
-    if (system_state.valid_scan && !system_state.valid_delivery_sms_sent) {
-      smsSendValidDelivery();
-    }
+// First match wins: exact gsm:* commands come before the gsm: passthrough
+static const ConsoleCommand CONSOLE_COMMANDS[] = {
+  { "relay-", CONSOLE_PREFIX, [](const char* a) { cmdCompartment(true, a); },
+    "relay-<n>:on/off", "Control lock of compartment n" },
+  { "buzzer:on", CONSOLE_EXACT, [](const char*) { ledcWriteTone(BUZZER_PIN, 1000); Serial.println(F("[BUZZER] ON")); },
+    "buzzer:on/off", "Buzzer control" },
+  { "buzzer:off", CONSOLE_EXACT, [](const char*) { ledcWriteTone(BUZZER_PIN, 0); Serial.println(F("[BUZZER] OFF")); },
+    nullptr, nullptr },
+  { "lcd:test", CONSOLE_EXACT, [](const char*) { displayLCD("LCD TEST", "Line 2 OK", "Line 3 OK", "Line 4 OK"); },
+    "lcd:test", "LCD test display" },
+  { "lcd:stats", CONSOLE_EXACT, [](const char*) { lcdRenderer.printStats(); },
+    "lcd:stats", "LCD flush / I2C traffic stats" },
+  { "reed-", CONSOLE_PREFIX, [](const char* a) { cmdCompartment(false, a); },
+    "reed-<n>:read", "Read reed switch of compartment n" },
+  { nullptr, CONSOLE_EXACT, nullptr, "reed-<n>:mon:on/off", "Continuous reed-n monitor" },
+  { "qr:mon:on", CONSOLE_EXACT, [](const char*) { qr_monitor = true; Serial.println(F("[QR] Monitor ON")); },
+    "qr:mon:on/off", "Print raw QR scanner data" },
+  { "qr:mon:off", CONSOLE_EXACT, [](const char*) { qr_monitor = false; Serial.println(F("[QR] Monitor OFF")); },
+    nullptr, nullptr },
+  { "gsm:mon:on", CONSOLE_EXACT, [](const char*) { gsmModem.setMonitor(true); Serial.println(F("[GSM] Monitor ON")); },
+    "gsm:mon:on/off", "Forward GSM responses" },
+  { "gsm:mon:off", CONSOLE_EXACT, [](const char*) { gsmModem.setMonitor(false); Serial.println(F("[GSM] Monitor OFF")); },
+    nullptr, nullptr },
+  { "gsm:stats", CONSOLE_EXACT, [](const char*) { gsmModem.printStats(); },
+    "gsm:stats", "SMS queue, retries and AT latency" },
+  { "gsm:reset", CONSOLE_EXACT, [](const char*) { gsmModem.requestReset(); },
+    "gsm:reset", "Hardware-reset the SIM800L" },
+  { "gsm:", CONSOLE_PREFIX | CONSOLE_RAW, cmdGsmRaw,
+    "gsm:<AT CMD>", "Send AT command to SIM800L" },
+  { "status", CONSOLE_EXACT, [](const char*) { checkSystemHealth(); },
+    "status", "System health check" },
+  { "stats", CONSOLE_EXACT, cmdStats,
+    "stats", "Every subsystem's counters" },
+  { "trace", CONSOLE_EXACT, cmdTrace,
+    "trace", "Scan latency percentiles + boot phases" },
+  { "bench", CONSOLE_EXACT, [](const char*) { startBench(); },
+    "bench", "Micro-benchmarks (background task, core 0)" },
+  { "linkbench:", CONSOLE_PREFIX, cmdLinkBench,
+    "linkbench:<mode>", "CAM link: ping / tx / rx / survey" },
+  { nullptr, CONSOLE_EXACT, nullptr, "  [:size:count:cam]", "Frame bytes, frames, camera (64:200:1)" },
+  { "linkbench", CONSOLE_EXACT, [](const char*) { linkBench.printStats(); },
+    "linkbench", "Last link bench result" },
+  { "power", CONSOLE_EXACT, [](const char*) { power.printStats(); },
+    "power", "Idle profile, wake sources, unlock latency" },
+  { "power:on", CONSOLE_EXACT, [](const char*) { power.setEnabled(true); Serial.println(F("[POWER] Idle mode ON")); },
+    "power:on/off", "Allow light sleep when quiet" },
+  { "power:off", CONSOLE_EXACT, [](const char*) { power.setEnabled(false); Serial.println(F("[POWER] Idle mode OFF")); },
+    nullptr, nullptr },
+  { "snapshot", CONSOLE_EXACT, [](const char*) { snapshotRelay.printStats(); },
+    "snapshot", "Breach snapshot transfers / uploads" },
+  { "ota", CONSOLE_EXACT, [](const char*) { ota.printStats(); },
+    "ota", "Firmware versions, updates, relay stats" },
+  { "ota:check", CONSOLE_EXACT, [](const char*) { ota.requestCheck(); Serial.println(F("[OTA] Check on the next cloud pass")); },
+    "ota:check", "Read config/ota now" },
+  { "tasks", CONSOLE_EXACT, [](const char*) { taskRuntime.printStats(); },
+    "tasks", "Per-task stack/CPU usage" },
+  { "metrics", CONSOLE_EXACT, [](const char*) { systemMetrics.print(); },
+    "metrics", "Heap, stack and loop-time metrics" },
+  { "latency", CONSOLE_EXACT, [](const char*) { scanTrace.print(); },
+    "latency", "Scan latency percentiles per stage" },
+  { "commands", CONSOLE_EXACT, [](const char*) { commandChannel.printStats(); commandChannel.print(); },
+    "commands", "Remote command counts + latency" },
+  { "boot", CONSOLE_EXACT, [](const char*) { bootTimeline.print(); },
+    "boot", "Boot phase timings" },
+  { "tls", CONSOLE_EXACT, [](const char*) { cloudLink.printStats(); },
+    "tls", "TLS handshakes / reconnect-to-write time" },
+  { "link", CONSOLE_EXACT, [](const char*) { linkManager.printStats(); },
+    "link", "WiFi drops, outage time, AP channel" },
+  { "actuators", CONSOLE_EXACT, [](const char*) { actuators.printStats(); },
+    "actuators", "Tone and relay coil duty stats" },
+  { "log", CONSOLE_EXACT, [](const char*) { logRing.printStats(); },
+    "log", "Log ring records written / lost" },
+  { "crash", CONSOLE_EXACT, [](const char*) { logRing.printCrashDump(); },
+    "crash", "Log records saved before the last crash" },
+  { "door:debounce:", CONSOLE_PREFIX, cmdDebounce,
+    "door:debounce:<ms>", "Set reed switch debounce" },
+  { "cache:clear", CONSOLE_EXACT, [](const char*) { parcelCache.clear(); parcelCache.setSynced(false); Serial.println(F("[CACHE] Cleared")); },
+    "cache:clear", "Drop local parcel cache" },
+  { "help", CONSOLE_EXACT, [](const char*) { console.printHelp(); },
+    "help", "Show this help" },
+};
+
+void setupConsole() {
+  console.begin(Serial, CONSOLE_COMMANDS, sizeof(CONSOLE_COMMANDS) / sizeof(CONSOLE_COMMANDS[0]),
+                "PARCEL LOCKER COMMANDS");
+}
+
+// ============================================================================
+// BENCH — hot paths timed on a throwaway task
+// ============================================================================
+// Core 0 below the cloud task, so the control and io tasks on core 1 keep
+// their timing while it runs.
+#define BENCH_ITERATIONS 2000
+
+volatile bool benchRunning = false;
+
+static void benchRow(const char* name, int64_t startUs, int iterations) {
+  int64_t us = esp_timer_get_time() - startUs;
+  Serial.printf("[BENCH] %-24s %7u ns/op\n", name, (unsigned)(us * 1000 / iterations));
+}
+
+void benchTask(void* pvParameters) {
+  int64_t t0;
 
-    if (system_state.firebase_connected && system_state.current_parcel_id.length() > 0) {
-      logParcelHistory(system_state.current_parcel_id, "PARCEL_DELIVERED");
-      digitalWrite(RELAY_1_PIN, HIGH);
-      digitalWrite(RELAY_2_PIN, HIGH);
+  ParcelCacheEntry entry;
+  t0 = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) parcelCache.lookup("BENCH-NOT-A-PARCEL", &entry);
+  benchRow("parcel cache miss", t0, BENCH_ITERATIONS);
+
+  StatusWord word = { 0x03, 0x01, STATUS_FLAG_DELIVERY, -60, 120000, 3600 };
+  char b64[STATUS_WORD_B64_LEN + 1];
+  t0 = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) word.encode((uint8_t)i, b64);
+  benchRow("status word encode", t0, BENCH_ITERATIONS);
+
+  FixedString<32> event;
+  t0 = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) event.printf("REMOTE_LOCK_%d_%s", i & 7, "OPEN");
+  benchRow("FixedString printf", t0, BENCH_ITERATIONS);
+
+  // One cloud flush worth of keys (lock/door leaves + timestamp)
+  const int batches = BENCH_ITERATIONS / 20;
+  FirebaseJson json;
+  t0 = esp_timer_get_time();
+  for (int i = 0; i < batches; i++) {
+    json.clear();
+    json.add("locks_status/bench/lock1", true);
+    json.add("locks_status/bench/lock2", false);
+    json.add("locks_status/bench/door1", false);
+    json.add("locks_status/bench/door2", true);
+    json.add("device_status/bench/live", b64);
+  }
+  benchRow("FirebaseJson 5-key batch", t0, batches);
+
+  QueueHandle_t q = xQueueCreate(1, sizeof(CloudMsg_t));
+  if (q) {
+    CloudMsg_t msg = {};
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+      xQueueSend(q, &msg, 0);
+      xQueueReceive(q, &msg, 0);
     }
+    benchRow("queue send+receive", t0, BENCH_ITERATIONS);
+    vQueueDelete(q);
+  }
+
+  benchRunning = false;
+  vTaskDelete(nullptr);
+}
 
-    delay(2000);
-    displayLCD("READY", "Scan parcel QR",
-               "WiFi: " + String(system_state.wifi_connected ? "OK" : "---"),
-               "FB: " + String(system_state.firebase_connected ? "OK" : "---"));
-    system_state.current_parcel_id = "";
-    system_state.current_qr_code = "";
-    system_state.current_receiver_phone = "";
-    system_state.current_receiver_name = "";
-    system_state.valid_scan = false;
-    system_state.valid_delivery_sms_sent = false;
-  } else if (doorNum == 2) {
-    system_state.lock2_open = false;
-    debugPrint("Payment box closed");
+void startBench() {
+  if (benchRunning) {
+    Serial.println(F("[BENCH] Already running"));
+    return;
+  }
+  benchRunning = true;
+  if (xTaskCreatePinnedToCore(benchTask, "bench", 6 * 1024, nullptr, 1, nullptr, 0) != pdPASS) {
+    benchRunning = false;
+    Serial.println(F("[BENCH] Could not start task"));
   }
 }
 
 // ============================================================================
-// SIM800L GSM
+// POWER
 // ============================================================================
-void initSIM800L() {
-  Serial.print(F("[SIM800L] Resetting"));
-  digitalWrite(SIM800L_RST_PIN, LOW);
-  delay(100);
-  digitalWrite(SIM800L_RST_PIN, HIGH);
-  for (int i = 0; i < 8; i++) { delay(500); Serial.print("."); }
-  Serial.println(F(" boot done"));
-
-  Serial.print(F("[SIM800L] AT... "));
-  sim800l.println("AT");
-  delay(500);
-  if (sim800l.available()) {
-    Serial.println("response: " + sim800l.readStringUntil('\n'));
-  } else {
-    Serial.println(F("no response (check wiring/power)"));
+// Work in progress keeps the active profile; PowerManager idles after
+// POWER_IDLE_AFTER_MS without any of it and without a wake
+bool powerBusy() {
+  if (!lockerCore.idle() || breachBuzzerOn) return true;
+  if (linkBench.running() || benchRunning) return true;
+  if (snapshotRelay.busy() || ota.running()) return true;
+  if (netBootStage != NET_BOOT_DONE) return true;     // Portal / join in progress
+  if (gsmModem.pendingCount() || uxQueueMessagesWaiting(smsQueue)) return true;
+  for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+    const Compartment& c = lockerCore.compartment(id);
+    if (c.lock_open || c.door_open) return true;
   }
-  while (sim800l.available()) sim800l.read();
+  return false;
 }
 
-void resetSIM800L() {
-  Serial.print(F("[SIM800L] Hardware reset"));
-  digitalWrite(SIM800L_RST_PIN, LOW); delay(100);
-  digitalWrite(SIM800L_RST_PIN, HIGH); delay(1000);
-  Serial.println(F(" done"));
+// Cloud task, once OtaUpdater has set the new image to boot. The parcel
+// cache resyncs from Firebase on boot, so only the screen needs a moment.
+void restartForUpdate() {
+  Serial.println(F("[OTA] Restarting into the new firmware"));
+  displayLCD("UPDATING", "Restarting...");
+  delay(250);     // UI task draws it, UART drains
+  ESP.restart();
 }
 
-void sendSMS(String phone, String message) {
-  if (millis() - system_state.last_sms_time < SMS_COOLDOWN) {
-    debugPrint("SMS cooldown active");
-    return;
-  }
-  debugPrint("Sending SMS to: " + phone);
-  sim800l.println("AT+CMGF=1"); delay(100);
-  sim800l.print("AT+CMGS=\"");
-  sim800l.print(phone);
-  sim800l.println("\""); delay(100);
-  sim800l.print(message);
-  sim800l.write(26);
-  delay(1000);
-  system_state.last_sms_time = millis();
-  debugPrint("SMS sent!");
-  playBuzzer("click");
+// ============================================================================
+// BUZZER
+// ============================================================================
+// Patterns live in ActuatorSequencer.cpp; returns at once
+void playBuzzer(Tone tone) {
+  actuators.playTone(tone);
+}
+
+void playBreachBuzzer() {
+  actuators.playTone(TONE_BREACH);
+}
+
+void stopBreachBuzzer() {
+  actuators.stopTone(TONE_BREACH);
 }
 
 // ============================================================================
-// SMS TRIGGERS
+// DOOR SENSORS
 // ============================================================================
+// Drains debounced events from the ISR engine (io task only)
+void checkDoorSensors() {
+  doorSensors.settle();
 
-/**
- * smsSendValidDelivery() — triggered when:
- *   - QR scan was VALID
- *   - Locks were opened
- *   - Door 1 (parcel door) closes
- * Sends to: receiver's contact number (from Firebase)
- */
-void smsSendValidDelivery() {
-  if (system_state.current_receiver_phone.length() == 0) {
-    debugPrint("[SMS] No receiver phone — skipping delivery SMS");
-    return;
+  DoorEvent ev;
+  while (doorSensors.nextEvent(ev)) {
+    onDoorEvent(ev);
   }
-  String msg = "ParcelBox: Your parcel " + system_state.current_parcel_id +
-               " has been delivered successfully. Please check locker " +
-               system_state.current_qr_code + ". - ParcelBox System";
-  sendSMS(system_state.current_receiver_phone, msg);
-  system_state.valid_delivery_sms_sent = true;
-  logParcelHistory(system_state.current_parcel_id, "SMS_DELIVERY_SENT");
+
+  lockerCore.settle();
 }
 
-/**
- * smsSendInvalidAttempt() — triggered when:
- *   - Invalid QR scanned 3 times in a row (consecutive)
- * Sends to: admin/monitoring number (device owner)
- */
-void smsSendInvalidAttempt() {
-  String msg = "[ALERT] ParcelBox " + system_state.device_id +
-               ": 3 invalid QR attempts detected. Possible tampering. - ParcelBox System";
-  // Send to a predefined monitoring/admin number
-  // The admin number could be stored in Preferences; for now, use a placeholder.
-  // Replace "+63XXXXXXXXXX" with your actual admin phone number:
-  String adminPhone = "+639123456789";
-  sendSMS(adminPhone, msg);
-  logParcelHistory("SYSTEM", "SMS_INVALID_ATTEMPT_3X");
+// Breach SMS from here; the closing is completed on the control task
+void onDoorEvent(const DoorEvent& ev) {
+  power.wake(POWER_WAKE_DOOR);
+  if (!lockerCore.onDoorChanged(ev.door, ev.open, ev.timestampUs)) return;
+  actuators.doorChanged(ev.door, ev.open);
+
+  DoorEventMsg_t msg = { ev.door, ev.open, ev.timestampUs };
+  xQueueSend(doorEventQueue, &msg, 0);
 }
 
-/**
- * smsSendDoorBreach() — triggered when:
- *   - ANY door opens WITHOUT a valid scan (no valid QR scan in progress)
- *   - Only sends once per breach event (door_breach_alerted flag)
- * Sends to: admin/monitoring number
- */
-void smsSendDoorBreach() {
-  if (system_state.door_breach_alerted) return;  // already alerted for this breach
-  system_state.door_breach_alerted = true;
-
-  String doorLabel = "";
-  if (system_state.door1_open) doorLabel += "Parcel Door ";
-  if (system_state.door2_open) doorLabel += "Payment Box ";
-  if (doorLabel == "") doorLabel = "Unknown Door";
-
-  String msg = "[BREACH ALERT] ParcelBox " + system_state.device_id +
-               ": " + doorLabel + "opened without authorization! - ParcelBox System";
-  String adminPhone = "+639123456789";
-  sendSMS(adminPhone, msg);
-  logParcelHistory("SYSTEM", "SMS_DOOR_BREACH");
-  
+// ============================================================================
+// SMS
+// ============================================================================
+// Queue an SMS for the gsm task — never blocks the caller. The modem driver
+// orders by priority and retries; nothing is rate-limited away.
+void sendSMS(const char* phone, const char* message, uint8_t priority) {
+  SmsMsg_t sms = {};
+  sms.priority = priority;
+  sms.queuedUs = esp_timer_get_time();
+  strlcpy(sms.phone, phone, sizeof(sms.phone));
+  strlcpy(sms.message, message, sizeof(sms.message));
+  if (xQueueSend(smsQueue, &sms, 0) != pdTRUE) {
+    debugPrint("SMS queue full - message dropped");
+  }
 }
 
 // ============================================================================
 // WIFI
 // ============================================================================
+// Portal path (cloud task): blocks until connected or the portal times out
 void setupWiFi() {
   debugPrint("Initializing WiFi Manager...");
+  displayLCD("Setting up WiFi", "Join: ParcelBox", "_Setup or wait...", "pw: password123");
   if (!wifiManager.begin("ParcelBox_Setup", "password123")) {
     debugPrint("WiFi setup timeout");
     displayLCD("WiFi Timeout", "Will retry in", "offline mode", "");
@@ -666,55 +1065,151 @@ void setupWiFi() {
     return;
   }
   debugPrint("WiFi Connected!");
-  debugPrint("IP Address: " + wifiManager.getLocalIP());
-  displayLCD("WiFi Connected", "IP: " + wifiManager.getLocalIP(), "", "");
+  IPAddress ip = WiFi.localIP();
+  FixedString<21> ipLine;
+  ipLine.printf("IP: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  displayLCD("WiFi Connected", ipLine.c_str(), "", "");
   system_state.wifi_connected = true;
-  delay(2000);
-  initializeNTP();
 }
 
+// Non-blocking: SNTP syncs in the background, serviceCloudBoot() notices
 void initializeNTP() {
-  debugPrint("Syncing time with NTP...");
+  debugPrint("Starting NTP sync...");
   configTime(8 * 3600, 0, "pool.ntp.org", "time.nist.gov");
-  time_t now = time(nullptr);
-  int attempts = 0;
-  while (now < 24 * 3600 && attempts < 20) { delay(500); now = time(nullptr); attempts++; }
-  struct tm timeinfo = *localtime(&now);
-  debugPrint("Time: " + String(asctime(&timeinfo)));
 }
 
-void checkWiFiConnection() {
-  unsigned long now = millis();
-  if (now - lastReconnectCheck < RECONNECT_CHECK_INTERVAL) return;
-  lastReconnectCheck = now;
+// ============================================================================
+// NETWORK BOOT (cloud task)
+// ============================================================================
+// Saved credentials: join in the background while the cloud task keeps
+// running its passes. No credentials, or no association within
+// WIFI_FAST_JOIN_TIMEOUT: fall back to the WiFiManager portal, which blocks
+// only this task. Afterwards serviceLink() owns the link.
+void serviceNetworkBoot() {
+  static unsigned long joinStartedAt = 0;
+
+  switch (netBootStage) {
+    case NET_BOOT_START:
+      if (wifiManager.beginStored()) {
+        debugPrint("WiFi: joining saved network");
+        joinStartedAt = millis();
+        netBootStage = NET_BOOT_JOINING;
+      } else {
+        debugPrint("WiFi: no saved network");
+        netBootStage = NET_BOOT_PORTAL;
+      }
+      break;
+
+    case NET_BOOT_JOINING:
+      if (wifiManager.isConnected()) {
+        onWiFiUp();
+        netBootStage = NET_BOOT_DONE;
+      } else if (millis() - joinStartedAt > WIFI_FAST_JOIN_TIMEOUT) {
+        debugPrint("WiFi: saved network not joined - opening portal");
+        netBootStage = NET_BOOT_PORTAL;
+      } else {
+        vTaskDelay(pdMS_TO_TICKS(100));
+      }
+      break;
+
+    case NET_BOOT_PORTAL:
+      setupWiFi();
+      setupEspNow();    // The portal ran the radio in AP+STA mode
+      if (system_state.wifi_connected) onWiFiUp();
+      displayReady("SYSTEM READY", "Waiting for parcel", 2000);
+      netBootStage = NET_BOOT_DONE;
+      break;
+  }
+}
 
-  bool connected = wifiManager.isConnected();
+// WiFi associated during boot: start what depends on it
+void onWiFiUp() {
+  system_state.wifi_connected = true;
+  bootTimeline.mark(BOOT_PHASE_WIFI);
+  IPAddress ip = WiFi.localIP();
+  debugPrint("WiFi up, IP %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  espNow.announceChannel(WiFi.channel());   // A scanning CAM may be listening here
+  initializeNTP();
+  initializeFirebase();   // Auth completes in serviceCloudBoot()
+  refreshIdleScreen();
+}
 
-  if (!connected && system_state.wifi_connected) {
-    debugPrint("WiFi connection lost!");
-    system_state.wifi_connected = false;
-    displayLCD("WiFi Disconnected", "Reconnecting...", "", "");
+// Boot phases that complete on their own after onWiFiUp()
+void serviceCloudBoot() {
+  if (!bootTimeline.done(BOOT_PHASE_NTP) && system_state.wifi_connected) {
+    time_t now = time(nullptr);
+    if (now > 24 * 3600) {
+      bootTimeline.mark(BOOT_PHASE_NTP);
+      struct tm timeinfo;
+      localtime_r(&now, &timeinfo);
+      debugPrint("Time: %s", asctime(&timeinfo));
+    }
   }
 
-  if (!connected) {
-    wifiManager.reconnect();
-  } else if (!system_state.wifi_connected) {
-    debugPrint("WiFi reconnected!");
+  if (firebaseInitialized && !firebaseStreamReady && Firebase.ready()) {
+    LOG_I("FB", "✅ Connected");
+    firebaseStreamReady = true;
+    system_state.firebase_connected = true;
+    registerDeviceInFirebase();
+    ota.confirmBoot();          // Online: keep this image
+    initCommandStream();
+    initParcelStream();
+    bootTimeline.mark(BOOT_PHASE_FIREBASE);
+    refreshIdleScreen();
+  }
+}
 
-    // Re-init ESP-NOW after WiFi reconnect (WiFi channel may have changed)
-    setupEspNow();
+// Update the link lines of the idle screen; leaves a scan in progress alone
+void refreshIdleScreen() {
+  if (lockerCore.idle()) {
+    displayReady("SYSTEM READY", "Waiting for parcel");
+  }
+}
 
-    system_state.wifi_connected = true;
-    if (!firebaseInitialized) {
-      initializeFirebase();
+// Link transitions as LinkManager reports them (WiFi events wake this task).
+// ESP-NOW stays up throughout. When the AP moves channel the radio has already
+// followed it, so a CAM left on the old channel finds us by probing.
+void serviceLink() {
+  LinkEvent ev;
+  while ((ev = linkManager.service()) != LINK_EVENT_NONE) {
+    if (ev == LINK_EVENT_DOWN) {
+      if (!system_state.wifi_connected) continue;
+      debugPrint("WiFi connection lost!");
+      system_state.wifi_connected = false;
+      cloudLink.linkDown();
+      displayLCD("WiFi Disconnected", "Reconnecting...", "", "");
+    } else if (!system_state.wifi_connected) {
+      onWiFiRestored();
     }
   }
+
+  uint8_t channel;
+  if (linkManager.channelChanged(&channel)) {
+    debugPrint("AP moved to channel %u - the CAM finds it by probing", channel);
+  }
 }
 
-void reconnectWiFi() {
-  wifiManager.reset();
-  delay(1000);
-  setupWiFi();
+// Re-associated after a drop (boot-time association goes through onWiFiUp())
+void onWiFiRestored() {
+  debugPrint("WiFi reconnected!");
+  system_state.wifi_connected = true;
+  bootTimeline.mark(BOOT_PHASE_WIFI);   // Booted offline: first association is late
+  if (!bootTimeline.done(BOOT_PHASE_NTP)) initializeNTP();
+  if (!firebaseInitialized) {
+    initializeFirebase();
+  }
+
+  // Time-to-first-write starts now. No outage backoff, and a fresh
+  // heartbeat so there is something to send even without journaled events;
+  // CloudWriter replays the journal ahead of new events from the next flush
+  cloudLink.linkUp();
+  cloudWriter.linkRestored();
+  cloudWriter.setHeartbeat(millis());
+  size_t pending = journal.pendingCount();
+  if (pending > 0) {
+    debugPrint("Replaying %u journaled events", (unsigned)pending);
+  }
+  refreshIdleScreen();
 }
 
 // ============================================================================
@@ -724,127 +1219,76 @@ void setupI2C_LCD() {
   lcd.init();
   lcd.backlight();
   lcd.clear();
+  lcdRenderer.begin(lcd);
   debugPrint("LCD Initialized");
 }
 
-void displayLCD(String line1, String line2, String line3, String line4) {
-  lcd.clear();
-  if (line1.length() > 0) { lcd.setCursor(0, 0); lcd.print(line1.substring(0, LCD_COLS)); }
-  if (line2.length() > 0) { lcd.setCursor(0, 1); lcd.print(line2.substring(0, LCD_COLS)); }
-  if (line3.length() > 0) { lcd.setCursor(0, 2); lcd.print(line3.substring(0, LCD_COLS)); }
-  if (line4.length() > 0) { lcd.setCursor(0, 3); lcd.print(line4.substring(0, LCD_COLS)); }
+// Queue a screen for the ui task — I2C traffic stays off the caller's task
+void displayLCD(const char* line1, const char* line2, const char* line3, const char* line4) {
+  postScreen(0, line1, line2, line3, line4);
 }
 
-// ============================================================================
-// ESP-NOW — SINGLE INIT, SINGLE CALLBACK
-// ============================================================================
-void setupEspNow() {
-  esp_err_t err;
-
-  // 1. Ensure WiFi is STA mode
-  WiFi.mode(WIFI_STA);
-
-  // 2. Deinit first if already initialized (safe for reinit after reconnect)
-  esp_now_deinit();
-
-  // 3. Init fresh
-  err = esp_now_init();
-  if (err != ESP_OK) {
-    Serial.printf("[ESPNOW] Init failed: %d\n", err);
+// delayMs > 0: timed transition, cancelled if any other screen comes first
+void postScreen(uint32_t delayMs, const char* line1, const char* line2, const char* line3, const char* line4) {
+  UiMsg_t msg = {};
+  strlcpy(msg.lines[0], line1, sizeof(msg.lines[0]));
+  strlcpy(msg.lines[1], line2, sizeof(msg.lines[1]));
+  strlcpy(msg.lines[2], line3, sizeof(msg.lines[2]));
+  strlcpy(msg.lines[3], line4, sizeof(msg.lines[3]));
+  msg.delayMs = delayMs;
+  if (uiQueue == nullptr) {
+    lcdRenderer.submit(msg);
+    lcdRenderer.service();
     return;
   }
-
-  // 4. Register callbacks
-  esp_now_register_send_cb(onEspNowSent);
-  esp_now_register_recv_cb(onEspNowReceived);
-
-  // 5. Add CAM as peer
-  memset(&camPeerInfo, 0, sizeof(camPeerInfo));
-  camPeerInfo.channel = 0;  // Will be locked via esp_wifi_set_channel()
-  camPeerInfo.encrypt = false;
-  camPeerInfo.ifidx = WIFI_IF_STA;
-  camPeerInfo.peer_addr[0] = CAM_MAC_0;
-  camPeerInfo.peer_addr[1] = CAM_MAC_1;
-  camPeerInfo.peer_addr[2] = CAM_MAC_2;
-  camPeerInfo.peer_addr[3] = CAM_MAC_3;
-  camPeerInfo.peer_addr[4] = CAM_MAC_4;
-  camPeerInfo.peer_addr[5] = CAM_MAC_5;
-
-  err = esp_now_add_peer(&camPeerInfo);
-  if (err != ESP_OK) {
-    Serial.printf("[ESPNOW] Peer add failed: %d\n", err);
-  }
-
-  // 6. Channel sync — force ESP-NOW to WiFi channel
-  syncEspNowChannel();
-
-  Serial.printf("[ESPNOW] Ready. MAC: %s, Channel: %d\n",
-    WiFi.macAddress().c_str(), WiFi.channel());
-}
-
-void syncEspNowChannel() {
-  if (WiFi.status() == WL_CONNECTED) {
-    int ch = WiFi.channel();
-    esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
-    // Log only on change (no flooding)
-    Serial.printf("[ESPNOW] Channel synced: %d\n", ch);
+  // Screens are superseded quickly; drop the oldest rather than block
+  if (xQueueSend(uiQueue, &msg, 0) != pdTRUE) {
+    UiMsg_t stale;
+    xQueueReceive(uiQueue, &stale, 0);
+    xQueueSend(uiQueue, &msg, 0);
   }
 }
 
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-void onEspNowSent(const wifi_tx_info_t *wifi_tx_info, esp_now_send_status_t status) {
-#else
-void onEspNowSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-#endif
-  // Only log failures to avoid flooding on ACKs
-  if (status != ESP_NOW_SEND_SUCCESS) {
-    Serial.println(F("[ESPNOW] Send FAILED"));
-  }
+// Idle screen with the link status on the bottom two lines
+void displayReady(const char* line1, const char* line2, uint32_t afterMs) {
+  postScreen(afterMs, line1, line2,
+             system_state.wifi_connected ? "WiFi: OK" : "WiFi: ---",
+             system_state.firebase_connected ? "FB: OK" : "FB: ---");
 }
 
-void onEspNowReceived(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
-  // Verify packet size matches ESPNOW_QRPacket_t (42 bytes)
-  if (len != sizeof(ESPNOW_QRPacket_t)) {
-    // Silently discard mismatched packets — no serial spam
-    return;
-  }
-
-  memcpy(&espNowPacket, data, sizeof(ESPNOW_QRPacket_t));
-
-  // Sanitize QR data
-  espNowPacket.qrData[31] = '\0';
-  String qrClean = String(espNowPacket.qrData);
-  qrClean.trim();
-  qrClean.replace("\r", "");
-  qrClean.replace("\n", "");
-  strncpy(espNowPacket.qrData, qrClean.c_str(), 31);
-  espNowPacket.qrData[31] = '\0';
-
-  espNowQrAvailable = true;
+// ============================================================================
+// ESP-NOW — SINGLE INIT, SINGLE CALLBACK
+// ============================================================================
+void setupEspNow() {
+  // 1. Ensure WiFi is STA mode
+  WiFi.mode(WIFI_STA);
 
-  // Single clean print when QR arrives
-  Serial.print(F("[QR RX] Received QR: "));
-  Serial.println(espNowPacket.qrData);
+  // 2. Init once, callbacks and one peer per camera. Peers follow the STA
+  //    channel, so nothing needs redoing when the AP is (re)joined
+  if (!espNow.begin()) return;
+  for (const CameraConfig_t& cam : CAMERAS) espNow.addPeer(cam.mac);
+  linkBench.begin(&espNow);
+  espNow.setBench(&linkBench);
+  snapshotRelay.begin(&espNow, system_state.device_id.c_str());
+  espNow.setSnapshots(&snapshotRelay);
+  ota.begin(&espNow, FIRMWARE_VERSION);
+  espNow.setOta(&ota);
+  espNow.setConsumer(xTaskGetCurrentTaskHandle());    // Control task
+  bootTimeline.mark(BOOT_PHASE_ESPNOW);
+
+  Serial.printf("[ESPNOW] Ready. MAC: %s, Channel: %d, %u cameras\n",
+    WiFi.macAddress().c_str(), WiFi.channel(), (unsigned)espNow.peerCount());
 }
 
 void processEspNowQR() {
-  if (!espNowQrAvailable) return;
-  espNowQrAvailable = false;
-
-  String qr_code = String(espNowPacket.qrData);
-
-  // Duplicate protection
-  if (qr_code == lastProcessedEspNowQR &&
-      (millis() - lastEspNowProcessTime) < ESPNOW_DUPLICATE_COOLDOWN) {
-    return;
-  }
-
-  lastProcessedEspNowQR = qr_code;
-  lastEspNowProcessTime = millis();
-
-  Serial.println("[ESPNOW] Processing QR: " + qr_code);
-  displayLCD("QR via CAM", qr_code, "Validating...", "");
-  handleParcelScanned(qr_code);
+  EspNowQrScan scan;
+  if (!espNow.receiveQr(scan)) return;
+  // Wake-to-unlock counts from the decode on the CAM when the clocks are synced
+  int64_t fromUs;
+  if (!scan.camDecodeUs || !espNow.camToLocalUs(scan.camera, scan.camDecodeUs, fromUs)) fromUs = scan.rxUs;
+  power.wake(POWER_WAKE_ESPNOW, fromUs);
+  scanTrace.begin(scan, espNow);
+  lockerCore.onScan(scan);    // ACKs, then validates
 }
 
 // ============================================================================
@@ -863,85 +1307,45 @@ void initializeFirebase() {
   fbConfig.timeout.rtdbStreamReconnect = 1 * 1000;
   fbConfig.timeout.rtdbStreamError = 3 * 1000;
 
-  // Set buffer sizes
-  fbdo.setBSSLBufferSize(2048, 1024);
-  fbdo.setResponseSize(2048);
-  commandStream.setBSSLBufferSize(2048, 1024);
-  commandStream.setResponseSize(2048);
+  // Buffer sizes; fbdo stays open between requests, the streams are long-lived anyway
+  cloudLink.configure(fbdo, 2048, true);
+  cloudLink.configure(commandStream, 2048, false);
+  cloudLink.configure(parcelStream, 4096, false);
+  cloudLink.releasePool();    // First handshakes take the reserved block
 
-  // Begin
+  // Begin — returns at once; serviceCloudBoot() registers the device and
+  // starts the streams when the first Firebase.ready() succeeds
   Firebase.begin(&fbConfig, &auth);
-  Firebase.reconnectWiFi(true);
-
-  Serial.print(F("[FB] Awaiting connection"));
-  unsigned long start = millis();
-  while (!Firebase.ready() && millis() - start < 10000) {
-    Serial.print("."); delay(500);
-  }
-  Serial.println();
-
-  if (Firebase.ready()) {
-    Serial.println(F("[FB] ✅ Connected"));
-    system_state.firebase_connected = true;
-    firebaseInitialized = true;
-    registerDeviceInFirebase();
-    initCommandStream();
-  } else {
-    Serial.println(F("[FB] ❌ Connection FAILED"));
-    firebaseInitialized = true;
-  }
+  Firebase.reconnectWiFi(false);   // LinkManager owns reconnects
+  firebaseInitialized = true;
+  Serial.println(F("[FB] Authenticating in background"));
 }
 
 void registerDeviceInFirebase() {
-  String path = String(ParcelBoxFirebaseConfig::getDeviceStatusPath()) + "/" + system_state.device_id;
   FirebaseJson json;
-  json.set("device_id", system_state.device_id);
+  json.set("device_id", system_state.device_id.c_str());
   json.set("model", "ParcelBox_ESP32");
-  json.set("version", "2.0.0");
+  json.set("version", FIRMWARE_VERSION);
+  json.set("reset_reason", BootTimeline::resetReason());
   json.set("wifi_connected", true);
   json.set("firebase_connected", true);
   json.set("last_heartbeat", millis());
 
-  if (Firebase.RTDB.setJSON(&fbdo, path.c_str(), &json)) {
+  int64_t t0 = cloudLink.request(fbdo);
+  bool ok = Firebase.RTDB.setJSON(&fbdo, device_paths.deviceStatus.c_str(), &json);
+  cloudLink.requestDone(t0, ok);
+  if (ok) {
     debugPrint("Device registered in Firebase");
   } else {
-    debugPrint("Register failed: " + String(fbdo.errorReason()));
+    debugPrint("Register failed: %s", fbdo.errorReason().c_str());
   }
 }
 
-void updateFirebaseStatus() {
-  if (!system_state.firebase_connected || !Firebase.ready()) return;
-
-  String path = String(ParcelBoxFirebaseConfig::getLocksStatusPath()) + "/" + system_state.device_id;
-  FirebaseJson json;
-  json.set("lock1", system_state.lock1_open ? "open" : "closed");
-  json.set("lock2", system_state.lock2_open ? "open" : "closed");
-  json.set("door1", system_state.door1_open ? "open" : "closed");
-  json.set("door2", system_state.door2_open ? "closed" : "open");
-  json.set("timestamp/.sv", "timestamp");
-
-  if (Firebase.RTDB.setJSON(&fbdo, path.c_str(), &json)) {
-    // Print only once per state change — no flooding
-    debugPrint("FB: Lock status updated");
-  } else {
-    debugPrint("FB update failed: " + String(fbdo.errorReason()));
-  }
-}
-
-void logParcelHistory(String parcel_id, String event) {
-  if (!system_state.firebase_connected || !Firebase.ready()) return;
-
-  String path = String(ParcelBoxFirebaseConfig::getHistoryPath()) + "/" + system_state.device_id;
-  FirebaseJson entry;
-  entry.set("parcel_id", parcel_id);
-  entry.set("event", event);
-  entry.set("timestamp/.sv", "timestamp");
-  entry.set("device_id", system_state.device_id);
-
-  if (Firebase.RTDB.pushJSON(&fbdo, path.c_str(), &entry)) {
-    debugPrint("History: " + parcel_id + " -> " + event);
-  } else {
-    debugPrint("History failed: " + String(fbdo.errorReason()));
+// Fire-and-forget: batched by CloudWriter and sent from the cloud task.
+// While offline the cloud task spills queued events to the journal.
+void logParcelHistory(const char* parcel_id, const char* event) {
+  if (!cloudWriter.queueHistory(parcel_id, event)) {
+    debugPrint("History queue full: %s", event);
   }
 }
 
@@ -951,252 +1355,285 @@ void logParcelHistory(String parcel_id, String event) {
 void initCommandStream() {
   if (!firebaseInitialized || !Firebase.ready()) return;
 
-  String cmdPath = String(ParcelBoxFirebaseConfig::getDeviceStatusPath()) +
-    "/" + system_state.device_id + "/commands";
+  const char* cmdPath = device_paths.commands.c_str();
+  LOG_I("FB", "Starting command stream: %s", cmdPath);
 
-  Serial.println("[FB] Starting command stream: " + cmdPath);
-
-  if (!Firebase.RTDB.beginMultiPathStream(&commandStream, cmdPath)) {
-    Serial.printf("[FB] Stream init failed: %s\n", commandStream.errorReason().c_str());
+  if (!Firebase.RTDB.beginStream(&commandStream, cmdPath)) {
+    LOG_E("FB", "Stream init failed: %s", commandStream.errorReason().c_str());
     commandStreamActive = false;
   } else {
-    Firebase.RTDB.setMultiPathStreamCallback(&commandStream, commandStreamCallback, commandStreamTimeoutCallback);
+    Firebase.RTDB.setStreamCallback(&commandStream, commandStreamCallback, commandStreamTimeoutCallback);
     commandStreamActive = true;
-    Serial.println(F("[FB] ✅ Command stream active"));
+    LOG_I("FB", "✅ Command stream active");
   }
+  cloudLink.streamStarted(STREAM_COMMANDS, commandStreamActive);
 }
 
+// Both streams are read by the library's stream task, which runs the
+// callbacks; this only restarts one that dropped, with backoff
 void handleFirebaseStream() {
-  if (!commandStreamActive) return;
-
-  if (!Firebase.RTDB.readStream(&commandStream)) {
-    int httpCode = commandStream.httpCode();
-    if (httpCode < 0 || httpCode == FIREBASE_ERROR_HTTP_CODE_OK) {
-      // stream data just not available yet — normal
-      return;
-    }
-    Serial.printf("[FB] Stream error: %s\n", commandStream.errorReason().c_str());
-    commandStreamActive = false;
-    // Reinit on next loop
+  // The parcel cache keeps serving scans while its stream is down
+  if (!parcelStreamActive && cloudLink.streamDue(STREAM_PARCELS)) {
+    initParcelStream();
+  }
+  // A new command stream's first event replays the queue; already acked
+  // or recently run commands are skipped by commandChannel
+  if (!commandStreamActive && cloudLink.streamDue(STREAM_COMMANDS)) {
     initCommandStream();
   }
 }
 
-void commandStreamCallback(MultiPathStream stream) {
-  if (stream.get("/lock1")) {
-    String cmd = stream.value;
-    cmd.replace("\"", "");
-    if (cmd == "open" || cmd == "close") {
-      Serial.println("[FB] Lock1 cmd: " + cmd);
-      if (cmd == "open") { onLockCommandFromFirebase(1, true); }
-      else { onLockCommandFromFirebase(1, false); }
-    }
-  }
-  if (stream.get("/lock2")) {
-    String cmd = stream.value;
-    cmd.replace("\"", "");
-    if (cmd == "open" || cmd == "close") {
-      Serial.println("[FB] Lock2 cmd: " + cmd);
-      if (cmd == "open") { onLockCommandFromFirebase(2, true); }
-      else { onLockCommandFromFirebase(2, false); }
-    }
-  }
-  if (stream.get("/emergency_unlock")) {
-    if (stream.value == "true") {
-      Serial.println(F("[FB] Emergency unlock commanded"));
-      onEmergencyFromFirebase();
-    }
+void commandStreamCallback(FirebaseStream data) {
+  commandChannel.onStream(data);
+}
+
+// commandChannel sink (cloud task, once "accepted" is written); the control
+// task acks after running it
+bool queueRemoteCommand(uint8_t slot, CommandType type, uint8_t lock) {
+  power.wake(POWER_WAKE_COMMAND, type == COMMAND_UNLOCK ? esp_timer_get_time() : 0);
+  ControlMsg_t msg = {};
+  msg.command = slot;
+  if (type == COMMAND_EMERGENCY) {
+    LOG_W("FB", "Emergency unlock commanded");
+    msg.type = CONTROL_MSG_EMERGENCY;
+  } else {
+    msg.type = CONTROL_MSG_REMOTE_LOCK;
+    msg.lockNum = lock;
+    msg.flag = type == COMMAND_UNLOCK;
   }
+  return xQueueSend(controlQueue, &msg, 0) == pdTRUE;
 }
 
 void commandStreamTimeoutCallback(bool timeout) {
   if (timeout) {
-    Serial.println(F("[FB] Stream timeout"));
+    LOG_W("FB", "Stream timeout");
   }
   if (!commandStream.httpConnected()) {
-    Serial.printf("[FB] Stream disconnected: %d\n", commandStream.httpCode());
+    LOG_W("FB", "Stream disconnected: %d", commandStream.httpCode());
     commandStreamActive = false;
   }
 }
 
 // ============================================================================
-// FIREBASE COMMAND CALLBACKS
-// ============================================================================
-void onLockCommandFromFirebase(int lockNum, bool open) {
-  if (open) {
-    openLock(lockNum);
-    displayLCD("Remote: Lock " + String(lockNum), "Opening...", "", "");
-    logParcelHistory("remote", "REMOTE_LOCK_" + String(lockNum) + "_OPEN");
-  } else {
-    closeLock(lockNum);
-    displayLCD("Remote: Lock " + String(lockNum), "Closing...", "", "");
-    logParcelHistory("remote", "REMOTE_LOCK_" + String(lockNum) + "_CLOSE");
-  }
-}
-
-void onEmergencyFromFirebase() {
-  emergencyLockdown();
-}
-
-// ============================================================================
-// PARCEL QR WORKFLOW
+// FIREBASE STREAM — PARCEL CACHE
 // ============================================================================
-void processGSM() {
-  if (sim800l.available()) {
-    String line = sim800l.readStringUntil('\n');
-    line.trim();
-    if (line.length() > 0 && (gsm_monitor || millis() < gsmRespTimeout)) {
-      Serial.print("[GSM] "); Serial.println(line);
-    }
-  }
-}
-
-void handleParcelScanned(String qr_code) {
-  system_state.current_qr_code = qr_code;
-  system_state.last_scan_time = millis();
+void initParcelStream() {
+  if (!firebaseInitialized || !Firebase.ready()) return;
 
-  displayLCD("QR SCANNED", qr_code, "Validating...", "");
+  const char* path = ParcelBoxFirebaseConfig::getParcelsDatabasePath();
+  LOG_I("FB", "Starting parcel stream: %s", path);
 
-  if (system_state.firebase_connected) {
-    logParcelHistory(qr_code, "QR_SCANNED");
+  if (!Firebase.RTDB.beginStream(&parcelStream, path)) {
+    LOG_E("FB", "Parcel stream init failed: %s", parcelStream.errorReason().c_str());
+    parcelStreamActive = false;
+  } else {
+    Firebase.RTDB.setStreamCallback(&parcelStream, parcelStreamCallback, parcelStreamTimeoutCallback);
+    parcelStreamActive = true;
+    LOG_I("FB", "✅ Parcel stream active");
   }
-
-  validateAndOpenLocks(qr_code);
+  cloudLink.streamStarted(STREAM_PARCELS, parcelStreamActive);
 }
 
-void validateAndOpenLocks(String qr_code) {
-  debugPrint("Validating QR: " + qr_code);
-
-  bool is_valid = false;
-
-  if (system_state.firebase_connected && Firebase.ready()) {
-    String parcelPath = String(ParcelBoxFirebaseConfig::getParcelsDatabasePath()) + "/" + qr_code;
-    if (Firebase.RTDB.getJSON(&fbdo, parcelPath.c_str())) {
-      if (fbdo.dataType() == "json") {
-        is_valid = true;
-        system_state.current_parcel_id = qr_code;
-        debugPrint("Parcel found in Firebase");
-
-        // — Extract receiver contact info for SMS —
-        FirebaseJson* jsonPtr = fbdo.to<FirebaseJson*>();
-        if (jsonPtr) {
-          FirebaseJsonData jsonData;
-          if (jsonPtr->get(jsonData, "contact_number")) {
-            system_state.current_receiver_phone = jsonData.stringValue;
-          }
-          if (jsonPtr->get(jsonData, "receiver_name")) {
-            system_state.current_receiver_name = jsonData.stringValue;
-          }
-          debugPrint("Receiver phone: " + system_state.current_receiver_phone);
+void parcelStreamCallback(FirebaseStream data) {
+  // Copied once out of the library's Strings; parsed in place below
+  FixedString<96> path = data.dataPath().c_str();
+  FixedString<12> type = data.dataType().c_str();
+
+  // Root event: "put" carries the whole tree, "patch" a set of child nodes
+  if (path == "/") {
+    if (type == "null") {
+      parcelCache.clear();
+    } else if (type == "json") {
+      FirebaseJson* json = data.jsonObjectPtr();
+      if (data.eventType() == "put") parcelCache.clear();
+
+      size_t count = json->iteratorBegin();
+      int topDepth = -1;
+      for (size_t i = 0; i < count; i++) {
+        FirebaseJson::IteratorValue node = json->valueAt(i);
+        if (topDepth < 0) topDepth = node.depth;
+        if (node.depth != topDepth) continue;
+        if (node.type == FirebaseJson::JSON_OBJECT) {
+          FirebaseJson child;
+          child.setJsonData(node.value);
+          cacheParcelFromJson(node.key.c_str(), &child);
+        } else if (node.value == "null") {
+          parcelCache.remove(node.key.c_str());
         }
-
-        logParcelHistory(qr_code, "PARCEL_FOUND");
-
-        // — Reset invalid scan counter on success —
-        system_state.invalid_scan_count = 0;
       }
+      json->iteratorEnd();
     }
-  } else {
-    if (qr_code.length() >= 5) {
-      is_valid = true;
-      system_state.current_parcel_id = qr_code;
-      // Reset invalid scan counter on offline success
-      system_state.invalid_scan_count = 0;
-    }
+    parcelCache.setSynced(true);
+    LOG_I("CACHE", "Synced: %u parcels", (unsigned)parcelCache.size());
+    return;
   }
 
-  if (is_valid) {
-    debugPrint("QR Validation: SUCCESS");
-    system_state.valid_scan = true;
-    system_state.valid_delivery_sms_sent = false;
-    displayLCD("Access Granted", "Opening locks...", "", "");
-    logParcelHistory(qr_code, "VALIDATION_SUCCESS");
-
-    openLock(1);
-    delay(LOCK_OPERATION_DELAY);
-    openLock(2);
-    delay(LOCK_OPERATION_DELAY);
-
-    playBuzzer("success");
-    displayLCD("DOORS OPEN", "Place parcel in box", "Complete payment", "Door closes auto");
-    Serial.println(F("[AUTH] Valid parcel - Locks opened"));
+  // Child event: "/<parcelId>" or "/<parcelId>/<field>"
+  const char* fieldSep = strchr(path.c_str() + 1, '/');
+  FixedString<PARCEL_ID_LEN> parcelId;
+  if (fieldSep) {
+    size_t idLen = fieldSep - (path.c_str() + 1);
+    if (idLen > parcelId.capacity()) idLen = parcelId.capacity();
+    char id[PARCEL_ID_LEN];
+    memcpy(id, path.c_str() + 1, idLen);
+    id[idLen] = '\0';
+    parcelId = id;
   } else {
-    debugPrint("QR Validation: FAILED");
-    system_state.valid_scan = false;
-    playBuzzer("alert");
-    displayLCD("Access Denied", "Invalid QR Code", "Try again", "");
-
-    // — SMS: invalid count (3 consecutive failures) —
-    system_state.invalid_scan_count++;
-    debugPrint("Invalid scan count: " + String(system_state.invalid_scan_count));
-    if (system_state.invalid_scan_count >= 3) {
-      smsSendInvalidAttempt();
-      system_state.invalid_scan_count = 0;  // reset after alert sent
+    parcelId = path.c_str() + 1;
+  }
+
+  if (!fieldSep) {
+    if (type == "null") {
+      parcelCache.remove(parcelId.c_str());
+    } else if (type == "json") {
+      cacheParcelFromJson(parcelId.c_str(), data.jsonObjectPtr());
     }
+  } else {
+    FixedString<64> value;
+    if (type != "null") value = data.stringData().c_str();
+    value.remove('"');
+    parcelCache.updateField(parcelId.c_str(), fieldSep + 1, value.c_str());
+  }
+}
 
-    logParcelHistory(qr_code, "VALIDATION_FAILED");
-    delay(3000);
-    displayLCD("READY", "Scan parcel QR",
-               "WiFi: " + String(system_state.wifi_connected ? "OK" : "---"),
-               "FB: " + String(system_state.firebase_connected ? "OK" : "---"));
+void parcelStreamTimeoutCallback(bool timeout) {
+  if (timeout) {
+    LOG_W("FB", "Parcel stream timeout");
+  }
+  if (!parcelStream.httpConnected()) {
+    LOG_W("FB", "Parcel stream disconnected: %d", parcelStream.httpCode());
+    parcelStreamActive = false;
   }
 }
 
+void cacheParcelFromJson(const char* parcelId, FirebaseJson* json) {
+  if (!json) return;
+  FirebaseJsonData field;
+  FixedString<PARCEL_NAME_LEN> name;
+  FixedString<PARCEL_PHONE_LEN> phone;
+  FixedString<16> status;
+  if (json->get(field, "receiver_name")) name = field.stringValue.c_str();
+  if (json->get(field, "contact_number")) phone = field.stringValue.c_str();
+  if (json->get(field, "status")) status = field.stringValue.c_str();
+  parcelCache.upsert(parcelId, name.c_str(), phone.c_str(),
+                     ParcelCache::parseStatus(status.c_str()));
+}
+
 // ============================================================================
 // HEALTH
 // ============================================================================
 void checkSystemHealth() {
   // Only print health if something changed
   Serial.println(F("\n=== System Health ==="));
-  Serial.println("Uptime: " + String(millis() / 1000) + "s");
-  Serial.println("WiFi: " + String(system_state.wifi_connected ? "Connected" : "Disconnected"));
-  Serial.println("Firebase: " + String(system_state.firebase_connected ? "Connected" : "Disconnected"));
-  Serial.println("Lock 1: " + String(system_state.lock1_open ? "OPEN" : "CLOSED"));
-  Serial.println("Lock 2: " + String(system_state.lock2_open ? "OPEN" : "CLOSED"));
-  Serial.println("Door 1: " + String(system_state.door1_open ? "OPEN" : "CLOSED"));
-  Serial.println("Door 2: " + String(system_state.door2_open ? "OPEN" : "CLOSED"));
+  Serial.printf("Uptime: %lus\n", millis() / 1000);
+  Serial.printf("WiFi: %s\n", system_state.wifi_connected ? "Connected" : "Disconnected");
+  Serial.printf("Firebase: %s\n", system_state.firebase_connected ? "Connected" : "Disconnected");
+  for (uint8_t id = 1; id <= COMPARTMENT_COUNT; id++) {
+    const Compartment& c = lockerCore.compartment(id);
+    Serial.printf("Compartment %u (%s): lock %s, door %s", (unsigned)id, COMPARTMENTS[id - 1].label,
+                  c.lock_open ? "OPEN" : "CLOSED", c.door_open ? "OPEN" : "CLOSED");
+    if (c.owner >= 0) Serial.printf(", held by CAM %d", c.owner + 1);
+    Serial.println();
+  }
+  static const char* const STAGE_NAMES[] = { "idle", "validating", "open" };
+  for (uint8_t cam = 0; cam < CAMERA_COUNT; cam++) {
+    const Delivery& d = lockerCore.delivery(cam);
+    Serial.printf("CAM %u delivery: %s %s\n", (unsigned)(cam + 1), STAGE_NAMES[d.stage],
+                  d.stage == DELIVERY_OPEN ? d.parcel_id.c_str() : d.qr_code.c_str());
+  }
+  printSubsystemStats();
   Serial.println("=====================\n");
 }
 
-void closeLocksAfterDelivery() {
-  debugPrint("Closing locks...");
-  closeLock(1); delay(LOCK_OPERATION_DELAY);
-  closeLock(2);
+// Health check and `stats`
+void printSubsystemStats() {
+  systemMetrics.print();
+  doorSensors.printStats();
+  parcelCache.printStats();
+  cloudWriter.printStats();   // Includes journal stats
+  espNow.printStats();
+  linkBench.printStats();
+  snapshotRelay.printStats();
+  ota.printStats();
+  power.printStats();
+  gsmModem.printStats();
+  cloudLink.printStats();
+  linkManager.printStats();
+  actuators.printStats();
+  commandChannel.printStats();
+  logRing.printStats();
+  const LockerStats& core = lockerCore.stats();
+  Serial.printf("[CORE] %u scans: %u granted, %u denied, %u cloud lookups (%u stale), "
+                "%u deliveries, %u breaches, %u SMS\n",
+                (unsigned)core.scans, (unsigned)core.granted, (unsigned)core.denied,
+                (unsigned)core.fetches, (unsigned)core.staleResults, (unsigned)core.deliveries,
+                (unsigned)core.breaches, (unsigned)core.sms);
 }
 
-void emergencyLockdown() {
-  debugPrint("EMERGENCY LOCKDOWN!");
-  displayLCD("LOCKDOWN", "System Secured", "Contact Admin", "");
-  closeLock(1); delay(LOCK_OPERATION_DELAY); closeLock(2);
-  playBuzzer("alert");
-  logParcelHistory("SYSTEM", "EMERGENCY_LOCKDOWN");
+// ============================================================================
+// PARCEL LOOKUP HELPERS
+// ============================================================================
+// Runs on the cloud task: result is written into the cache, not the delivery
+bool fetchParcelFromFirebase(const char* qr_code) {
+  FixedString<64> parcelPath;
+  parcelPath.printf("%s/%s", ParcelBoxFirebaseConfig::getParcelsDatabasePath(), qr_code);
+  int64_t t0 = cloudLink.request(fbdo);
+  bool ok = Firebase.RTDB.getJSON(&fbdo, parcelPath.c_str());
+  cloudLink.requestDone(t0, ok);
+  if (!ok || fbdo.dataType() != "json") {
+    return false;
+  }
+
+  cacheParcelFromJson(qr_code, fbdo.to<FirebaseJson*>());
+
+  ParcelCacheEntry entry;
+  if (parcelCache.lookup(qr_code, &entry) && entry.status == PARCEL_STATUS_DELIVERED) {
+    debugPrint("Firebase: parcel already delivered");
+    return false;
+  }
+  debugPrint("Parcel found in Firebase");
+  logParcelHistory(qr_code, "PARCEL_FOUND");
+  return true;
 }
 
-void resetSystem() {
-  system_state.current_parcel_id = "";
-  system_state.current_qr_code = "";
-  system_state.current_receiver_phone = "";
-  system_state.current_receiver_name = "";
-  system_state.lock1_open = false;
-  system_state.lock2_open = false;
-  system_state.valid_scan = false;
-  system_state.valid_delivery_sms_sent = false;
-  system_state.invalid_scan_count = 0;
-  system_state.door_breach_alerted = false;
-  closeLocksAfterDelivery();
-  displayLCD("SYSTEM RESET", "Ready for next parcel", "", "");
+/**
+ * confirmParcelInFirebase() — runs on the cloud task after a cache hit:
+ *   - Re-reads /parcels/<id> once the locks are already open
+ *   - Refreshes the cache entry (the delivery SMS re-reads the phone)
+ *   - Logs VALIDATION_REVOKED if the parcel no longer exists in Firebase
+ */
+void confirmParcelInFirebase(const char* qr_code) {
+  if (!system_state.firebase_connected || !Firebase.ready()) return;
+
+  FixedString<64> parcelPath;
+  parcelPath.printf("%s/%s", ParcelBoxFirebaseConfig::getParcelsDatabasePath(), qr_code);
+  int64_t t0 = cloudLink.request(fbdo);
+  bool ok = Firebase.RTDB.getJSON(&fbdo, parcelPath.c_str());
+  cloudLink.requestDone(t0, ok);
+  if (!ok) {
+    debugPrint("Confirm failed: %s", fbdo.errorReason().c_str());
+    return;
+  }
+
+  if (fbdo.dataType() == "json") {
+    cacheParcelFromJson(qr_code, fbdo.to<FirebaseJson*>());
+    logParcelHistory(qr_code, "PARCEL_FOUND");
+  } else {
+    parcelCache.remove(qr_code);
+    debugPrint("Cached parcel not in Firebase: %s", qr_code);
+    logParcelHistory(qr_code, "VALIDATION_REVOKED");
+  }
 }
 
 void generateDeviceId() {
   uint8_t mac[6];
   WiFi.macAddress(mac);
-  char macStr[18];
-  snprintf(macStr, sizeof(macStr), "%02X%02X%02X%02X%02X%02X",
-           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  system_state.device_id = "PARCELBOX_" + String(macStr);
+  system_state.device_id.printf("PARCELBOX_%02X%02X%02X%02X%02X%02X",
+                                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+  // Per-device paths reused by every write and stream start
+  const char* id = system_state.device_id.c_str();
+  device_paths.deviceStatus.printf("%s/%s", ParcelBoxFirebaseConfig::getDeviceStatusPath(), id);
+  device_paths.commands.printf("%s/%s/commands", ParcelBoxFirebaseConfig::getDeviceStatusPath(), id);
 }
 
-void debugPrint(String msg) {
-  Serial.print("[ESP32] ");
-  Serial.println(msg);
-}
\ No newline at end of file
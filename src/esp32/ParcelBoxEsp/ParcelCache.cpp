@@ -0,0 +1,264 @@
+#include "ParcelCache.h"
+#include "LogRing.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+// ============================================================================
+// PARCEL CACHE IMPLEMENTATION
+// ============================================================================
+
+static const char* CACHE_FILE = "/parcel_cache.bin";
+static const char* CACHE_TMP_FILE = "/parcel_cache.bin.tmp";
+static const uint32_t CACHE_MAGIC = 0x43504250;   // "PBPC"
+static const uint16_t CACHE_VERSION = 1;
+
+// On-flash header; followed by `count` ParcelCacheEntry records
+struct __attribute__((packed)) CacheFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t crc;       // CRC32 over the entry records
+};
+
+ParcelCache::ParcelCache()
+    : entryCount(0), mutex(nullptr), cacheSynced(false), overflowed(false), dirty(false), lastChange(0) {
+    memset(entries, 0, sizeof(entries));
+    memset(slotState, SLOT_EMPTY, sizeof(slotState));
+}
+
+bool ParcelCache::begin() {
+    if (!mutex) mutex = xSemaphoreCreateMutex();
+
+    // Format on first boot so the cache works on a blank partition
+    if (!LittleFS.begin(true)) {
+        Serial.println("[CACHE] LittleFS mount FAILED - RAM only");
+        return false;
+    }
+    bool ok = load();
+    Serial.printf("[CACHE] %s, %u parcels\n", ok ? "Loaded" : "Empty", (unsigned)entryCount);
+    return ok;
+}
+
+// FNV-1a — cheap and well distributed for short ASCII keys
+uint32_t ParcelCache::hash(const char* key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int ParcelCache::findSlot(const char* parcelId) {
+    size_t idx = hash(parcelId) & (CAPACITY - 1);
+    for (size_t probe = 0; probe < CAPACITY; probe++) {
+        size_t i = (idx + probe) & (CAPACITY - 1);
+        if (slotState[i] == SLOT_EMPTY) return -1;
+        if (slotState[i] == SLOT_USED && strcmp(entries[i].parcelId, parcelId) == 0) return (int)i;
+    }
+    return -1;
+}
+
+int ParcelCache::findInsertSlot(const char* parcelId) {
+    int existing = findSlot(parcelId);
+    if (existing >= 0) return existing;
+
+    size_t idx = hash(parcelId) & (CAPACITY - 1);
+    for (size_t probe = 0; probe < CAPACITY; probe++) {
+        size_t i = (idx + probe) & (CAPACITY - 1);
+        if (slotState[i] != SLOT_USED) return (int)i;
+    }
+    return -1;
+}
+
+bool ParcelCache::lookup(const char* parcelId, ParcelCacheEntry* out) {
+    if (!parcelId || !*parcelId) return false;
+    lock();
+    int slot = findSlot(parcelId);
+    if (slot >= 0 && out) *out = entries[slot];
+    unlock();
+    return slot >= 0;
+}
+
+bool ParcelCache::upsert(const char* parcelId, const char* receiverName,
+                         const char* contactNumber, uint8_t status) {
+    if (!parcelId || !*parcelId || strlen(parcelId) >= PARCEL_ID_LEN) return false;
+
+    lock();
+    int slot = findInsertSlot(parcelId);
+    if (slot < 0) {
+        overflowed = true;
+        unlock();
+        LOG_W("CACHE", "Full - parcel not cached, lookups fall back to Firebase");
+        return false;
+    }
+
+    ParcelCacheEntry& e = entries[slot];
+    if (slotState[slot] != SLOT_USED) {
+        memset(&e, 0, sizeof(e));
+        strlcpy(e.parcelId, parcelId, sizeof(e.parcelId));
+        slotState[slot] = SLOT_USED;
+        entryCount++;
+    }
+    if (receiverName && *receiverName) strlcpy(e.receiverName, receiverName, sizeof(e.receiverName));
+    if (contactNumber && *contactNumber) strlcpy(e.contactNumber, contactNumber, sizeof(e.contactNumber));
+    e.status = status;
+    markDirty();
+    unlock();
+    return true;
+}
+
+bool ParcelCache::updateField(const char* parcelId, const char* field, const char* value) {
+    lock();
+    int slot = findSlot(parcelId);
+    if (slot < 0) {
+        unlock();
+        return false;
+    }
+    ParcelCacheEntry& e = entries[slot];
+    if (strcmp(field, "receiver_name") == 0) strlcpy(e.receiverName, value, sizeof(e.receiverName));
+    else if (strcmp(field, "contact_number") == 0) strlcpy(e.contactNumber, value, sizeof(e.contactNumber));
+    else if (strcmp(field, "status") == 0) e.status = parseStatus(value);
+    markDirty();
+    unlock();
+    return true;
+}
+
+bool ParcelCache::remove(const char* parcelId) {
+    lock();
+    int slot = findSlot(parcelId);
+    if (slot >= 0) {
+        slotState[slot] = SLOT_DELETED;
+        memset(&entries[slot], 0, sizeof(ParcelCacheEntry));
+        entryCount--;
+        markDirty();
+    }
+    unlock();
+    return slot >= 0;
+}
+
+void ParcelCache::clear() {
+    lock();
+    memset(entries, 0, sizeof(entries));
+    memset(slotState, SLOT_EMPTY, sizeof(slotState));
+    entryCount = 0;
+    overflowed = false;
+    markDirty();
+    unlock();
+}
+
+uint8_t ParcelCache::parseStatus(const char* status) {
+    if (!status) return PARCEL_STATUS_PENDING;
+    if (strcmp(status, "delivered") == 0) return PARCEL_STATUS_DELIVERED;
+    if (strcmp(status, "failed") == 0) return PARCEL_STATUS_FAILED;
+    return PARCEL_STATUS_PENDING;
+}
+
+void ParcelCache::markDirty() {
+    dirty = true;
+    lastChange = millis();
+}
+
+void ParcelCache::flushIfDirty() {
+    if (!dirty || millis() - lastChange < WRITE_BACK_DELAY) return;
+    save();
+}
+
+// ============================================================================
+// PERSISTENCE
+// ============================================================================
+bool ParcelCache::load() {
+    File f = LittleFS.open(CACHE_FILE, "r");
+    if (!f) return false;
+
+    CacheFileHeader hdr;
+    if (f.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+        hdr.magic != CACHE_MAGIC || hdr.version != CACHE_VERSION || hdr.count > CAPACITY) {
+        f.close();
+        return false;
+    }
+
+    lock();
+    memset(slotState, SLOT_EMPTY, sizeof(slotState));
+    entryCount = 0;
+
+    uint32_t crc = 0;
+    ParcelCacheEntry e;
+    bool ok = true;
+    for (uint16_t n = 0; n < hdr.count; n++) {
+        if (f.read((uint8_t*)&e, sizeof(e)) != sizeof(e)) { ok = false; break; }
+        crc = esp_rom_crc32_le(crc, (const uint8_t*)&e, sizeof(e));
+        e.parcelId[PARCEL_ID_LEN - 1] = '\0';
+        int slot = findInsertSlot(e.parcelId);
+        if (slot < 0) continue;
+        entries[slot] = e;
+        slotState[slot] = SLOT_USED;
+        entryCount++;
+    }
+
+    if (!ok || crc != hdr.crc) {
+        // Corrupt or truncated file — start empty, the stream will refill us
+        memset(slotState, SLOT_EMPTY, sizeof(slotState));
+        entryCount = 0;
+        ok = false;
+    }
+    unlock();
+    f.close();
+    return ok;
+}
+
+// Entries are copied out under the mutex and written without it, so scan
+// lookups never wait on LittleFS. Changes made meanwhile leave it dirty.
+bool ParcelCache::save() {
+    lock();
+    size_t count = entryCount;
+    ParcelCacheEntry* copy = (ParcelCacheEntry*)malloc((count ? count : 1) * sizeof(ParcelCacheEntry));
+    if (!copy) {
+        unlock();
+        return false;       // Still dirty: retried on a later flush
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < CAPACITY && n < count; i++) {
+        if (slotState[i] == SLOT_USED) copy[n++] = entries[i];
+    }
+    dirty = false;
+    unlock();
+
+    CacheFileHeader hdr = { CACHE_MAGIC, CACHE_VERSION, (uint16_t)n, 0 };
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t*)copy, n * sizeof(ParcelCacheEntry));
+
+    // Write to a temp file then rename so a power cut never leaves a torn cache
+    File f = LittleFS.open(CACHE_TMP_FILE, "w");
+    bool ok = f && f.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+              f.write((const uint8_t*)copy, n * sizeof(ParcelCacheEntry)) == n * sizeof(ParcelCacheEntry);
+    if (f) f.close();
+    free(copy);
+
+    if (ok) {
+        LittleFS.remove(CACHE_FILE);
+        ok = LittleFS.rename(CACHE_TMP_FILE, CACHE_FILE);
+    } else {
+        LittleFS.remove(CACHE_TMP_FILE);
+    }
+    if (!ok) {
+        lock();
+        dirty = true;
+        unlock();
+    }
+    return ok;
+}
+
+void ParcelCache::printStats() {
+    Serial.printf("Parcel cache: %u/%u entries, %s%s, %s\n",
+                  (unsigned)entryCount, (unsigned)CAPACITY,
+                  cacheSynced ? "synced" : "not synced", overflowed ? " (overflowed)" : "",
+                  dirty ? "dirty" : "clean");
+}
+
+void ParcelCache::lock() {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+}
+
+void ParcelCache::unlock() {
+    if (mutex) xSemaphoreGive(mutex);
+}
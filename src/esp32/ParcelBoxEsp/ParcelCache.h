@@ -0,0 +1,109 @@
+#ifndef PARCEL_CACHE_H
+#define PARCEL_CACHE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// ============================================================================
+// PARCEL CACHE - Smart Parcel Locker
+// ============================================================================
+// On-device index of /parcels so a QR scan is answered from RAM instead of a
+// blocking RTDB round-trip:
+// - Fixed-size open-addressed hash table (no heap allocation after begin())
+// - Filled and kept current by the /parcels Firebase stream
+// - Persisted to LittleFS so validation keeps working after an offline reboot
+// - Thread-safe: the stream callback and the main loop may run on different tasks
+// - A parcel that finds the table full marks it overflowed: it no longer
+//   counts as synced, so misses go to Firebase until the next full snapshot
+
+// Parcel states mirrored from /parcels/<id>/status
+#define PARCEL_STATUS_PENDING   0
+#define PARCEL_STATUS_DELIVERED 1
+#define PARCEL_STATUS_FAILED    2
+
+#define PARCEL_ID_LEN       32   // Matches ESPNOW_MAX_PAYLOAD (QR payload == parcelId)
+#define PARCEL_NAME_LEN     32
+#define PARCEL_PHONE_LEN    20
+
+struct ParcelCacheEntry {
+    char parcelId[PARCEL_ID_LEN];
+    char receiverName[PARCEL_NAME_LEN];
+    char contactNumber[PARCEL_PHONE_LEN];
+    uint8_t status;
+};
+
+class ParcelCache {
+public:
+    ParcelCache();
+
+    // Mount LittleFS and load the persisted index
+    // Returns: true if a valid cache file was loaded
+    bool begin();
+
+    // Lookup by parcelId (QR payload). Copies the entry into *out when found.
+    bool lookup(const char* parcelId, ParcelCacheEntry* out);
+
+    // Insert or replace a parcel. Empty name/phone leave existing values intact.
+    bool upsert(const char* parcelId, const char* receiverName,
+                const char* contactNumber, uint8_t status);
+
+    // Update a single field of an existing entry (stream patch events)
+    bool updateField(const char* parcelId, const char* field, const char* value);
+
+    // Remove a parcel (deleted in Firebase)
+    bool remove(const char* parcelId);
+
+    // Drop every entry (full stream snapshot replaced the tree)
+    void clear();
+
+    // Persist to flash if dirty and the write-back delay has elapsed.
+    // Call periodically from the main loop — never from the stream callback.
+    void flushIfDirty();
+
+    // Mark the cache as fully synchronised with Firebase. Never synced while
+    // a parcel is missing for lack of room.
+    void setSynced(bool synced) { cacheSynced = synced; }
+    bool isSynced() const { return cacheSynced && !overflowed; }
+
+    size_t size() const { return entryCount; }
+    size_t capacity() const { return CAPACITY; }
+
+    // Map /parcels/<id>/status strings to PARCEL_STATUS_*
+    static uint8_t parseStatus(const char* status);
+
+    void printStats();
+
+    // Table capacity (power of two). ~85 bytes/entry → ~22 KB RAM.
+    static const size_t CAPACITY = 256;
+
+private:
+    // Slot state kept alongside the entry so deletes can leave tombstones
+    enum SlotState : uint8_t { SLOT_EMPTY = 0, SLOT_USED = 1, SLOT_DELETED = 2 };
+
+    ParcelCacheEntry entries[CAPACITY];
+    uint8_t slotState[CAPACITY];
+    size_t entryCount;
+
+    SemaphoreHandle_t mutex;
+    bool cacheSynced;
+    bool overflowed;            // A parcel was turned away since the last clear()
+    bool dirty;
+    unsigned long lastChange;
+
+    // Minimum quiet period before a dirty table is written back (flash wear)
+    static const unsigned long WRITE_BACK_DELAY = 5000;
+
+    static uint32_t hash(const char* key);
+    int findSlot(const char* parcelId);       // Slot index or -1 (caller holds mutex)
+    int findInsertSlot(const char* parcelId); // Existing or free slot, -1 if full
+    void markDirty();
+
+    bool load();
+    bool save();
+
+    void lock();
+    void unlock();
+};
+
+#endif // PARCEL_CACHE_H
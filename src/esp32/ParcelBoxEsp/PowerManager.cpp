@@ -0,0 +1,218 @@
+#include "PowerManager.h"
+#include "LogRing.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_now.h>
+#include <esp_sleep.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <esp_idf_version.h>
+
+// ============================================================================
+// POWER MANAGER IMPLEMENTATION
+// ============================================================================
+
+static const char* const WAKE_NAMES[POWER_WAKE_COUNT] = {
+    "door", "espnow", "command", "console", "local"
+};
+
+PowerManager::PowerManager()
+    : controlTask(nullptr), doors(nullptr), cpuLock(nullptr), sleepLock(nullptr),
+      pmReady(false), lightSleep(false), enabled(true),
+      mux(portMUX_INITIALIZER_UNLOCKED), state(POWER_STATE_ACTIVE), lastActivityMs(0),
+      unlockFromUs(0), unlockFromIdle(false), unlockPending(false),
+      espNowWindowMs(POWER_ESPNOW_WINDOW_MS), underBudgetStreak(0), idleSince(0), idleMs(0),
+      idleEntries(0), overBudget(0) {
+    memset(wakes, 0, sizeof(wakes));
+    memset(latency, 0, sizeof(latency));
+}
+
+void PowerManager::begin(TaskHandle_t task, DoorSensorEngine* doorEngine) {
+    controlTask = task;
+    doors = doorEngine;
+    lastActivityMs = millis();
+
+    esp_pm_config_t pm = {};
+    pm.max_freq_mhz = POWER_MAX_FREQ_MHZ;
+    pm.min_freq_mhz = POWER_MIN_FREQ_MHZ;
+    pm.light_sleep_enable = true;
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        // Built without tickless idle: frequency scaling only
+        pm.light_sleep_enable = false;
+        err = esp_pm_configure(&pm);
+    } else if (err == ESP_OK) {
+        lightSleep = true;
+    }
+    if (err == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active", &cpuLock) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &sleepLock) == ESP_OK) {
+        pmReady = true;
+        takeLocks();
+    } else {
+        lightSleep = false;
+        LOG_W("POWER", "PM unavailable (%s): WiFi and task periods only", esp_err_to_name(err));
+    }
+
+    if (lightSleep) {
+        esp_sleep_enable_gpio_wakeup();
+        uart_set_wakeup_threshold(UART_NUM_0, POWER_UART_WAKE_EDGES);
+        esp_sleep_enable_uart_wakeup(UART_NUM_0);
+    }
+    WiFi.setSleep(WIFI_PS_NONE);
+
+    LOG_I("POWER", "%s, idle after %u s", lightSleep ? "light sleep + DFS" : pmReady ? "DFS" : "no PM",
+          (unsigned)(POWER_IDLE_AFTER_MS / 1000));
+}
+
+void PowerManager::takeLocks() {
+    if (!pmReady) return;
+    esp_pm_lock_acquire(cpuLock);
+    esp_pm_lock_acquire(sleepLock);
+}
+
+void PowerManager::wake(PowerWake source, int64_t fromUs) {
+    bool notify = false;
+    portENTER_CRITICAL(&mux);
+    lastActivityMs = millis();
+    if (source < POWER_WAKE_COUNT) wakes[source]++;
+    if (fromUs && !unlockPending) {
+        unlockFromUs = fromUs;
+        unlockFromIdle = state != POWER_STATE_ACTIVE;
+        unlockPending = true;
+    }
+    if (state == POWER_STATE_IDLE) {
+        state = POWER_STATE_WAKING;
+        notify = true;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (notify) {
+        // Locks first: the control task itself then runs at full clock
+        takeLocks();
+        if (controlTask) xTaskNotifyGive(controlTask);
+    }
+}
+
+void PowerManager::onUnlock() {
+    portENTER_CRITICAL(&mux);
+    bool pending = unlockPending;
+    bool fromIdle = unlockFromIdle;
+    int64_t fromUs = unlockFromUs;
+    unlockPending = false;
+    portEXIT_CRITICAL(&mux);
+    if (!pending) return;
+
+    int64_t elapsed = esp_timer_get_time() - fromUs;
+    uint32_t ms = elapsed > 0 ? (uint32_t)(elapsed / 1000) : 0;
+    Latency& l = latency[fromIdle ? 1 : 0];
+    l.count++;
+    l.lastMs = ms;
+    l.totalMs += ms;
+    if (ms > l.maxMs) l.maxMs = ms;
+    if (!fromIdle) return;
+
+    if (ms > POWER_UNLOCK_BUDGET_MS) {
+        overBudget++;
+        underBudgetStreak = 0;
+        uint16_t widened = espNowWindowMs * 2;
+        espNowWindowMs = widened > POWER_ESPNOW_INTERVAL_MS ? POWER_ESPNOW_INTERVAL_MS : widened;
+        LOG_W("POWER", "Wake-to-unlock %u ms over budget, ESP-NOW window %u ms",
+              (unsigned)ms, (unsigned)espNowWindowMs);
+    } else if (ms < POWER_UNLOCK_BUDGET_MS / 2 && ++underBudgetStreak >= POWER_BUDGET_STREAK) {
+        underBudgetStreak = 0;
+        uint16_t narrowed = espNowWindowMs / 2;
+        espNowWindowMs = narrowed < POWER_ESPNOW_WINDOW_MIN_MS ? POWER_ESPNOW_WINDOW_MIN_MS : narrowed;
+    }
+}
+
+void PowerManager::service(bool busy) {
+    unsigned long now = millis();
+    if (state == POWER_STATE_WAKING) {
+        leaveIdle(now);
+        return;
+    }
+    portENTER_CRITICAL(&mux);
+    // Rejected scan, relock command: nothing to time
+    if (unlockPending && esp_timer_get_time() - unlockFromUs >= (int64_t)POWER_UNLOCK_STALE_MS * 1000) {
+        unlockPending = false;
+    }
+    if (busy) lastActivityMs = now;
+    portEXIT_CRITICAL(&mux);
+    if (busy) return;
+    if (state == POWER_STATE_ACTIVE && enabled && now - lastActivityMs >= POWER_IDLE_AFTER_MS) {
+        enterIdle(now);
+    }
+}
+
+void PowerManager::enterIdle(unsigned long now) {
+    portENTER_CRITICAL(&mux);
+    // A wake() that slipped in since the check keeps us active
+    bool quiet = now - lastActivityMs >= POWER_IDLE_AFTER_MS;
+    if (quiet) state = POWER_STATE_IDLE;
+    portEXIT_CRITICAL(&mux);
+    if (!quiet) return;
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_wifi_connectionless_module_set_wake_interval(POWER_ESPNOW_INTERVAL_MS);
+    esp_now_set_wake_window(espNowWindowMs);
+#endif
+    WiFi.setSleep(WIFI_PS_MIN_MODEM);   // Radio up for every DTIM beacon
+    if (lightSleep && doors) doors->armWake();
+    idleSince = now;
+    idleEntries++;
+
+    // Last: from here on the scheduler may sleep whenever we block
+    if (pmReady) {
+        esp_pm_lock_release(sleepLock);
+        esp_pm_lock_release(cpuLock);
+    }
+    // A wake() between the state change and the release took the locks once
+    // more; it also queued a notification, so leaveIdle() runs next pass.
+}
+
+void PowerManager::leaveIdle(unsigned long now) {
+    // Locks were taken by wake()
+    WiFi.setSleep(WIFI_PS_NONE);
+    if (doors) doors->disarmWake();
+    idleMs += now - idleSince;
+    portENTER_CRITICAL(&mux);
+    state = POWER_STATE_ACTIVE;
+    lastActivityMs = now;
+    portEXIT_CRITICAL(&mux);
+}
+
+void PowerManager::setEnabled(bool on) {
+    enabled = on;
+    if (!on) wake(POWER_WAKE_LOCAL);
+}
+
+void PowerManager::printStats() {
+    static const char* const STATE_NAMES[] = { "active", "idle", "waking" };
+    uint32_t counts[POWER_WAKE_COUNT];
+    portENTER_CRITICAL(&mux);
+    memcpy(counts, wakes, sizeof(counts));
+    unsigned long quietMs = millis() - lastActivityMs;
+    portEXIT_CRITICAL(&mux);
+
+    uint64_t idleTotal = idleMs + (state == POWER_STATE_IDLE ? millis() - idleSince : 0);
+    Serial.printf("[POWER] %s%s | %s | idle %u times, %llu s total | quiet %lu ms | ESP-NOW window %u/%u ms\n",
+                  STATE_NAMES[state], enabled ? "" : " (idle off)",
+                  lightSleep ? "light sleep + DFS" : pmReady ? "DFS" : "no PM",
+                  (unsigned)idleEntries, (unsigned long long)(idleTotal / 1000), quietMs,
+                  (unsigned)espNowWindowMs, (unsigned)POWER_ESPNOW_INTERVAL_MS);
+    Serial.print("[POWER] Wakes:");
+    for (int i = 0; i < POWER_WAKE_COUNT; i++) {
+        Serial.printf(" %s %u", WAKE_NAMES[i], (unsigned)counts[i]);
+    }
+    Serial.println();
+    static const char* const FROM[] = { "active", "idle" };
+    for (int i = 0; i < 2; i++) {
+        const Latency& l = latency[i];
+        if (!l.count) continue;
+        Serial.printf("[POWER] Unlock from %s: n=%u last %u ms avg %u ms max %u ms\n",
+                      FROM[i], (unsigned)l.count, (unsigned)l.lastMs,
+                      (unsigned)(l.totalMs / l.count), (unsigned)l.maxMs);
+    }
+    Serial.printf("[POWER] Budget %u ms, %u over\n", (unsigned)POWER_UNLOCK_BUDGET_MS, (unsigned)overBudget);
+}
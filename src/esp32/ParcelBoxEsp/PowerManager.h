@@ -0,0 +1,132 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include "DoorSensors.h"
+
+// ============================================================================
+// POWER MANAGER - Smart Parcel Locker
+// ============================================================================
+// Two profiles, switched by activity:
+// - Active: PM locks held (CPU at max, no light sleep), WiFi modem sleep off.
+//   Scans, doors and commands see no power-saving latency.
+// - Idle (nothing happened for POWER_IDLE_AFTER_MS and nothing in progress):
+//   locks released, so the ESP-IDF power manager scales the CPU down and
+//   light-sleeps whenever every task is blocked. WiFi drops to modem sleep
+//   (radio up at each DTIM beacon) plus an ESP-NOW wake window every
+//   POWER_ESPNOW_INTERVAL_MS, so camera frames still get through; the CAM's
+//   retransmits cover the gaps. Periodic tasks wait POWER_IDLE_PERIOD_MS.
+// Wake sources: reed switch (GPIO level wake, DoorSensorEngine::armWake),
+// a scan from a camera, a Firebase command, console input (the bytes that
+// wake it are lost; repeat the command). Only UART0 can wake on this chip
+// pair, so the SIM800L is kept out of the way instead: AT+CSCLK=2 lets it
+// sleep between SMS and GsmModem wakes it before sending. Each wake() takes
+// the PM locks at once, before the control task has even run.
+//
+// Wake-to-unlock: a scan or command that may unlock stamps its start (CAM
+// decode time when time-synced, else arrival), the unlock closes it. Out of
+// idle over POWER_UNLOCK_BUDGET_MS doubles the ESP-NOW window; it halves
+// again after POWER_BUDGET_STREAK unlocks under half the budget. A window
+// as long as the interval keeps the radio on in idle (CPU savings only).
+//
+// Without light-sleep support in the ESP-IDF build (no tickless idle) this
+// falls back to frequency scaling; without PM at all it only does the WiFi
+// and task-period half.
+
+#define POWER_IDLE_AFTER_MS         30000   // Quiet time before the idle profile
+#define POWER_IDLE_PERIOD_MS        100     // Periodic task wait while idle
+#define POWER_MAX_FREQ_MHZ          240
+#define POWER_MIN_FREQ_MHZ          80      // Keeps APB at 80 MHz for the UARTs
+#define POWER_ESPNOW_INTERVAL_MS    100     // Radio wake interval for ESP-NOW while idle
+#define POWER_ESPNOW_WINDOW_MS      50      // ...and how long it listens (start value)
+#define POWER_ESPNOW_WINDOW_MIN_MS  10
+#define POWER_UNLOCK_BUDGET_MS      1000    // Wake → relays energised, out of idle
+#define POWER_BUDGET_STREAK         8       // Unlocks well under budget before stepping down
+#define POWER_UNLOCK_STALE_MS       10000   // A wake with no unlock by then stops counting
+#define POWER_UART_WAKE_EDGES       3       // Console RX edges that end light sleep
+
+enum PowerWake : uint8_t {
+    POWER_WAKE_DOOR = 0,
+    POWER_WAKE_ESPNOW,      // Scan from a camera
+    POWER_WAKE_COMMAND,     // Firebase /commands
+    POWER_WAKE_CONSOLE,
+    POWER_WAKE_LOCAL,       // Work started on the board itself (SMS, bench)
+    POWER_WAKE_COUNT
+};
+
+enum PowerState : uint8_t {
+    POWER_STATE_ACTIVE = 0,
+    POWER_STATE_IDLE,
+    POWER_STATE_WAKING      // Locks taken, control task still to finish the switch
+};
+
+class PowerManager {
+public:
+    PowerManager();
+
+    // Control task: PM config, locks and wake sources. Starts active.
+    void begin(TaskHandle_t controlTask, DoorSensorEngine* doors);
+
+    // Any task: activity that needs the active profile. unlockFromUs != 0 =
+    // an unlock may follow; its latency counts from there (esp_timer time).
+    void wake(PowerWake source, int64_t unlockFromUs = 0);
+
+    // Control task: relays just energised
+    void onUnlock();
+
+    // Control task, every pass. busy = work in progress, stays active.
+    void service(bool busy);
+
+    // Any task: wait of a periodic task for the current profile (idle never shortens it)
+    TickType_t period(uint32_t activeMs) const {
+        return pdMS_TO_TICKS(state == POWER_STATE_IDLE && activeMs < POWER_IDLE_PERIOD_MS
+                             ? POWER_IDLE_PERIOD_MS : activeMs);
+    }
+    bool idle() const { return state == POWER_STATE_IDLE; }
+
+    // Console: off = stay active (bench work, maintenance)
+    void setEnabled(bool on);
+
+    void printStats();
+
+private:
+    struct Latency {
+        uint32_t count;
+        uint32_t lastMs;
+        uint32_t maxMs;
+        uint64_t totalMs;
+    };
+
+    TaskHandle_t controlTask;
+    DoorSensorEngine* doors;
+    esp_pm_lock_handle_t cpuLock;
+    esp_pm_lock_handle_t sleepLock;
+    bool pmReady;
+    bool lightSleep;
+    volatile bool enabled;
+
+    // Shared with wake() callers (guarded by mux)
+    portMUX_TYPE mux;
+    volatile PowerState state;
+    unsigned long lastActivityMs;
+    int64_t unlockFromUs;
+    bool unlockFromIdle;
+    bool unlockPending;
+    uint32_t wakes[POWER_WAKE_COUNT];
+
+    // Control task only
+    uint16_t espNowWindowMs;
+    uint8_t underBudgetStreak;
+    unsigned long idleSince;
+    uint64_t idleMs;
+    uint32_t idleEntries;
+    Latency latency[2];             // Out of active / out of idle
+    uint32_t overBudget;
+
+    void enterIdle(unsigned long now);
+    void leaveIdle(unsigned long now);
+    void takeLocks();
+};
+
+#endif // POWER_MANAGER_H
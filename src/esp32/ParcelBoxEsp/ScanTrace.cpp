@@ -0,0 +1,152 @@
+#include "ScanTrace.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// SCAN TRACE IMPLEMENTATION
+// ============================================================================
+
+// Interval i spans stage i → i+1; the last one is decode (or the first
+// stage stamped) → last stage stamped
+static const char* const INTERVAL_NAMES[ScanTrace::INTERVAL_COUNT] = {
+    "decode_tx", "tx_rx", "rx_dequeue", "dequeue_validate",
+    "validate", "validate_actuate", "total"
+};
+
+ScanTrace::ScanTrace()
+    : active(false), seq(0), camDecodeToTxUs(-1), mux(portMUX_INITIALIZER_UNLOCKED), scansTraced(0) {
+    memset(stamp, 0, sizeof(stamp));
+    memset(have, 0, sizeof(have));
+    memset(samples, 0, sizeof(samples));
+    memset(sampleCount, 0, sizeof(sampleCount));
+    memset(sampleNext, 0, sizeof(sampleNext));
+}
+
+const char* ScanTrace::intervalName(int interval) {
+    return INTERVAL_NAMES[interval];
+}
+
+void ScanTrace::begin(const EspNowQrScan& scan, EspNowManager& espNow) {
+    memset(have, 0, sizeof(have));
+    active = true;
+    seq = scan.seq;
+
+    // Same clock on the CAM — valid with or without time sync
+    camDecodeToTxUs = (scan.camDecodeUs && scan.camTxUs >= scan.camDecodeUs)
+                      ? scan.camTxUs - scan.camDecodeUs : -1;
+
+    int64_t local;
+    if (scan.camDecodeUs && espNow.camToLocalUs(scan.camera, scan.camDecodeUs, local)) {
+        stamp[SCAN_STAGE_DECODE] = local;
+        have[SCAN_STAGE_DECODE] = true;
+    }
+    if (scan.camTxUs && espNow.camToLocalUs(scan.camera, scan.camTxUs, local)) {
+        stamp[SCAN_STAGE_CAM_TX] = local;
+        have[SCAN_STAGE_CAM_TX] = true;
+    }
+    stamp[SCAN_STAGE_RX] = scan.rxUs;
+    have[SCAN_STAGE_RX] = true;
+    mark(SCAN_STAGE_DEQUEUE);
+}
+
+void ScanTrace::mark(ScanStage stage) {
+    if (!active || have[stage]) return;
+    stamp[stage] = esp_timer_get_time();
+    have[stage] = true;
+}
+
+void ScanTrace::finish() {
+    if (!active) return;
+    active = false;
+
+    int64_t us[INTERVAL_COUNT];
+    for (int i = 0; i < INTERVAL_COUNT; i++) us[i] = -1;
+
+    for (int i = 0; i < SCAN_STAGE_COUNT - 1; i++) {
+        if (have[i] && have[i + 1]) us[i] = stamp[i + 1] - stamp[i];
+    }
+    if (us[SCAN_STAGE_DECODE] < 0) us[SCAN_STAGE_DECODE] = camDecodeToTxUs;
+
+    int first = -1, last = -1;
+    for (int i = 0; i < SCAN_STAGE_COUNT; i++) {
+        if (!have[i]) continue;
+        if (first < 0) first = i;
+        last = i;
+    }
+    if (first >= 0 && last > first) us[INTERVAL_COUNT - 1] = stamp[last] - stamp[first];
+
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        if (us[i] >= 0) record(i, us[i]);
+    }
+    portENTER_CRITICAL(&mux);
+    scansTraced++;
+    portEXIT_CRITICAL(&mux);
+
+    Serial.printf("[TRACE] seq %u:", seq);
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        if (us[i] >= 0) Serial.printf(" %s %lld", intervalName(i), (long long)us[i]);
+    }
+    Serial.println(F(" us"));
+}
+
+void ScanTrace::record(int interval, int64_t us) {
+    uint32_t v = (us > (int64_t)UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+    portENTER_CRITICAL(&mux);
+    samples[interval][sampleNext[interval]] = v;
+    sampleNext[interval] = (sampleNext[interval] + 1) % WINDOW;
+    if (sampleCount[interval] < WINDOW) sampleCount[interval]++;
+    portEXIT_CRITICAL(&mux);
+}
+
+// Nearest-rank percentiles over a sorted copy of the window
+void ScanTrace::percentiles(int interval, Percentiles& out) {
+    uint32_t sorted[WINDOW];
+    portENTER_CRITICAL(&mux);
+    uint16_t n = sampleCount[interval];
+    memcpy(sorted, samples[interval], n * sizeof(uint32_t));
+    portEXIT_CRITICAL(&mux);
+
+    for (uint16_t i = 1; i < n; i++) {
+        uint32_t v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v) { sorted[j + 1] = sorted[j]; j--; }
+        sorted[j + 1] = v;
+    }
+
+    out.n = n;
+    if (n == 0) {
+        out.p50 = out.p90 = out.p99 = out.max = 0;
+        return;
+    }
+    out.p50 = sorted[(n * 50 + 99) / 100 - 1];
+    out.p90 = sorted[(n * 90 + 99) / 100 - 1];
+    out.p99 = sorted[(n * 99 + 99) / 100 - 1];
+    out.max = sorted[n - 1];
+}
+
+void ScanTrace::print() {
+    Serial.printf("Scan latency (%u scans traced, last %d kept, us):\n", (unsigned)scansTraced, WINDOW);
+    Serial.println(F("Interval               n      p50      p90      p99      max"));
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        Percentiles p;
+        percentiles(i, p);
+        Serial.printf("%-18s %5u %8u %8u %8u %8u\n", intervalName(i), (unsigned)p.n,
+                      (unsigned)p.p50, (unsigned)p.p90, (unsigned)p.p99, (unsigned)p.max);
+    }
+}
+
+void ScanTrace::addTo(FirebaseJson& json, const char* prefix) {
+    char key[64];
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        Percentiles p;
+        percentiles(i, p);
+        if (p.n == 0) continue;
+        snprintf(key, sizeof(key), "%s/%s/n", prefix, intervalName(i));
+        json.set(key, (int)p.n);
+        snprintf(key, sizeof(key), "%s/%s/p50", prefix, intervalName(i));
+        json.set(key, (int)p.p50);
+        snprintf(key, sizeof(key), "%s/%s/p90", prefix, intervalName(i));
+        json.set(key, (int)p.p90);
+        snprintf(key, sizeof(key), "%s/%s/p99", prefix, intervalName(i));
+        json.set(key, (int)p.p99);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SCAN_TRACE_H
+#define SCAN_TRACE_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include "EspNowManager.h"
+
+// ============================================================================
+// SCAN TRACE - Smart Parcel Locker
+// ============================================================================
+// Per-scan latency from camera decode to relay actuation. One scan is traced
+// at a time; a scan taken while another is still being validated replaces it:
+//   decode → CAM TX → RX → dequeue → validation start → end → actuation
+// CAM stamps are mapped onto the local esp_timer through that camera's
+// ESP-NOW time sync; decode→TX needs no sync (both on the CAM clock). Each
+// finished scan adds its stage intervals to a window of the last WINDOW
+// scans, from which p50/p90/p99 are reported over serial and in the Firebase
+// metrics.
+
+enum ScanStage {
+    SCAN_STAGE_DECODE = 0,
+    SCAN_STAGE_CAM_TX,
+    SCAN_STAGE_RX,
+    SCAN_STAGE_DEQUEUE,
+    SCAN_STAGE_VALIDATE_START,
+    SCAN_STAGE_VALIDATE_END,
+    SCAN_STAGE_ACTUATE,
+    SCAN_STAGE_COUNT
+};
+
+class ScanTrace {
+public:
+    ScanTrace();
+
+    // Control task: start tracing a scan just taken from EspNowManager
+    void begin(const EspNowQrScan& scan, EspNowManager& espNow);
+
+    // Control task: stamp a stage of the active scan (first stamp wins)
+    void mark(ScanStage stage);
+
+    // Control task: close the active scan and fold it into the window
+    void finish();
+
+    // Any task: percentile table / Firebase snapshot under `prefix`
+    void print();
+    void addTo(FirebaseJson& json, const char* prefix);
+
+    static const int INTERVAL_COUNT = SCAN_STAGE_COUNT;    // 6 stage gaps + total
+    static const int WINDOW = 64;
+
+private:
+    // Active scan (control task only)
+    bool active;
+    uint16_t seq;
+    int64_t stamp[SCAN_STAGE_COUNT];
+    bool have[SCAN_STAGE_COUNT];
+    int64_t camDecodeToTxUs;
+
+    // Window of finished scans (guarded by mux)
+    portMUX_TYPE mux;
+    uint32_t samples[INTERVAL_COUNT][WINDOW];
+    uint16_t sampleCount[INTERVAL_COUNT];
+    uint16_t sampleNext[INTERVAL_COUNT];
+    uint32_t scansTraced;
+
+    struct Percentiles {
+        uint16_t n;
+        uint32_t p50, p90, p99, max;
+    };
+
+    void record(int interval, int64_t us);
+    void percentiles(int interval, Percentiles& out);
+    static const char* intervalName(int interval);
+};
+
+#endif // SCAN_TRACE_H
@@ -0,0 +1,104 @@
+#include "SerialConsole.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// SERIAL CONSOLE IMPLEMENTATION
+// ============================================================================
+
+SerialConsole::SerialConsole()
+    : in(nullptr), table(nullptr), tableCount(0), title(""), len(0), overflow(false),
+      lines(0), unknown(0), overflows(0), lastHandlerUs(0), maxHandlerUs(0) {
+    line[0] = '\0';
+}
+
+void SerialConsole::begin(Stream& stream, const ConsoleCommand* commands, size_t count,
+                          const char* heading) {
+    in = &stream;
+    table = commands;
+    tableCount = count;
+    title = heading;
+}
+
+void SerialConsole::poll() {
+    if (!in) return;
+    while (in->available() > 0) {
+        char c = (char)in->read();
+        if (c != '\n' && c != '\r') {
+            if (overflow) continue;
+            if (len < CONSOLE_LINE_MAX - 1) {
+                line[len++] = c;
+            } else {
+                overflow = true;
+                overflows++;
+            }
+            continue;
+        }
+
+        // Terminator: CRLF gives an empty second line, skipped below
+        bool complete = !overflow && len > 0;
+        if (overflow) Serial.printf("[ERR] Line over %u chars dropped\n", (unsigned)(CONSOLE_LINE_MAX - 1));
+        line[len] = '\0';
+        overflow = false;
+        if (complete) {
+            dispatch();
+            len = 0;
+            return;         // One command per pass; the rest waits for the next
+        }
+        len = 0;
+    }
+}
+
+void SerialConsole::dispatch() {
+    // Trim in place
+    char* raw = line;
+    while (*raw && isspace((unsigned char)*raw)) raw++;
+    char* end = raw + strlen(raw);
+    while (end > raw && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    if (*raw == '\0') return;
+
+    char cmd[CONSOLE_LINE_MAX];
+    size_t n = 0;
+    for (const char* p = raw; *p; p++) cmd[n++] = tolower((unsigned char)*p);
+    cmd[n] = '\0';
+
+    lines++;
+    Serial.printf("[Serial] Cmd: %s\n", raw);
+
+    for (size_t i = 0; i < tableCount; i++) {
+        const ConsoleCommand& c = table[i];
+        if (!c.name || !c.handler) continue;
+        size_t nameLen = strlen(c.name);
+        const char* args;
+        if (c.flags & CONSOLE_PREFIX) {
+            if (strncmp(cmd, c.name, nameLen) != 0) continue;
+            args = (c.flags & CONSOLE_RAW) ? raw + nameLen : cmd + nameLen;
+        } else {
+            if (strcmp(cmd, c.name) != 0) continue;
+            args = "";
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        c.handler(args);
+        lastHandlerUs = (uint32_t)(esp_timer_get_time() - t0);
+        if (lastHandlerUs > maxHandlerUs) maxHandlerUs = lastHandlerUs;
+        return;
+    }
+    unknown++;
+    Serial.printf("[ERR] Unknown: '%s' | Type help\n", cmd);
+}
+
+void SerialConsole::printHelp() {
+    Serial.printf("======= %s =======\n", title);
+    for (size_t i = 0; i < tableCount; i++) {
+        if (!table[i].usage) continue;
+        Serial.printf("%-*s%s\n", CONSOLE_HELP_COLUMN, table[i].usage, table[i].help);
+    }
+    Serial.println(F("======================================"));
+}
+
+void SerialConsole::printStats() {
+    Serial.printf("[CONSOLE] %u commands, %u unknown, %u over-long; handler %u us last, %u us max\n",
+                  (unsigned)lines, (unsigned)unknown, (unsigned)overflows,
+                  (unsigned)lastHandlerUs, (unsigned)maxHandlerUs);
+}
@@ -0,0 +1,71 @@
+#ifndef SERIAL_CONSOLE_H
+#define SERIAL_CONSOLE_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// SERIAL CONSOLE - Smart Parcel Locker
+// ============================================================================
+// Line-buffered command console for the control task:
+// - poll() takes whatever bytes the UART already has and returns; a partial
+//   line just waits in a fixed buffer (no readBytesUntil timeout)
+// - A complete line (LF, CR or CRLF) is lowercased and matched against a
+//   static command table, first match wins: exact names, or prefixes whose
+//   remainder is passed to the handler as arguments
+// - No String, no heap; over-long lines are dropped whole and counted
+// - help is generated from the same table
+//
+// Serial output should be buffered (CONSOLE_TX_BUFFER before Serial.begin)
+// so a long dump is copied out, not waited out, by the control loop.
+
+#define CONSOLE_LINE_MAX        96
+#define CONSOLE_TX_BUFFER       4096    // Serial.setTxBufferSize()
+#define CONSOLE_HELP_COLUMN     23
+
+typedef void (*ConsoleHandler)(const char* args);
+
+#define CONSOLE_EXACT           0x00
+#define CONSOLE_PREFIX          0x01    // `name` is a prefix; args = the rest
+#define CONSOLE_RAW             0x02    // args keep their original case
+
+struct ConsoleCommand {
+    const char* name;                   // nullptr = help line only
+    uint8_t flags;
+    ConsoleHandler handler;
+    const char* usage;                  // help column; nullptr = not listed
+    const char* help;
+};
+
+class SerialConsole {
+public:
+    SerialConsole();
+
+    void begin(Stream& in, const ConsoleCommand* table, size_t count, const char* title);
+
+    // Control task: consume available input, dispatch at most one line
+    void poll();
+
+    void printHelp();
+    void printStats();
+
+private:
+    Stream* in;
+    const ConsoleCommand* table;
+    size_t tableCount;
+    const char* title;
+
+    char line[CONSOLE_LINE_MAX];
+    size_t len;
+    bool overflow;                      // Discarding up to the next terminator
+
+    // Statistics
+    uint32_t lines;
+    uint32_t unknown;
+    uint32_t overflows;
+    uint32_t lastHandlerUs;
+    uint32_t maxHandlerUs;
+
+    void dispatch();
+};
+
+#endif // SERIAL_CONSOLE_H
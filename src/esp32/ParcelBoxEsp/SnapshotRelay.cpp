@@ -0,0 +1,295 @@
+#include "SnapshotRelay.h"
+#include "EspNowManager.h"
+#include "CloudWriter.h"
+#include "LogRing.h"
+#include <esp_now.h>
+#include <esp_timer.h>
+#include <mbedtls/base64.h>
+
+// ============================================================================
+// SNAPSHOT RELAY IMPLEMENTATION
+// ============================================================================
+
+static const char* const RESULT_NAMES[] = { "ok", "no frame", "too big" };
+
+SnapshotRelay::SnapshotRelay()
+    : espNow(nullptr), link(nullptr), writer(nullptr), buffer(nullptr),
+      mux(portMUX_INITIALIZER_UNLOCKED), state(SNAPSHOT_IDLE), id(0), camera(0), door(0),
+      openedUs(0), expected(0), received(0), gapAcked(false), ackDue(false), ended(false),
+      lastFrameAt(0), tries(0), stalls(0), nextSendAt(0), requestedUs(0), uploadPart(0),
+      uploadFailures(0), uploadRetryAt(0), requested(0), completed(0), uploaded(0), failures(0),
+      busyDrops(0), gaps(0), lastBytes(0), lastTransferMs(0), lastOffsetMs(0), lastError("") {
+    memset(&end, 0, sizeof(end));
+    memset(&uploadEnd, 0, sizeof(uploadEnd));
+    key[0] = '\0';
+    b64[0] = '\0';
+}
+
+bool SnapshotRelay::begin(EspNowManager* manager, const char* deviceId) {
+    espNow = manager;
+    basePath.printf("%s/%s", SNAPSHOT_PATH + 1, deviceId);
+    // Once, at boot: a breach must not depend on finding 16 KB contiguous later
+    if (!buffer) buffer = (uint8_t*)malloc(SNAPSHOT_MAX_BYTES);
+    if (!buffer) LOG_E("SNAP", "No buffer (%u bytes): breach snapshots off", (unsigned)SNAPSHOT_MAX_BYTES);
+    return buffer != nullptr;
+}
+
+// ============================================================================
+// TRANSFER
+// ============================================================================
+bool SnapshotRelay::request(uint8_t cam, uint8_t doorId, int64_t atUs) {
+    if (!buffer || !espNow || cam >= espNow->peerCount()) return false;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&mux);
+    bool free = state == SNAPSHOT_IDLE;
+    if (free) {
+        id = esp_random() | 1;
+        camera = cam;
+        door = doorId;
+        openedUs = atUs ? atUs : now;
+        expected = 0;
+        received = 0;
+        gapAcked = false;
+        ackDue = false;
+        ended = false;
+        lastFrameAt = millis();
+        tries = 0;
+        stalls = 0;
+        nextSendAt = lastFrameAt;
+        requestedUs = now;
+        state = SNAPSHOT_REQUESTING;    // Last: service() starts from here
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (!free) {
+        busyDrops++;
+        return false;
+    }
+    requested++;
+    return true;
+}
+
+bool SnapshotRelay::onFrame(uint8_t cam, const uint8_t* data, int len) {
+    const ESPNOW_Header_t* hdr = (const ESPNOW_Header_t*)data;
+    bool due = false;
+    portENTER_CRITICAL(&mux);
+    if ((state == SNAPSHOT_REQUESTING || state == SNAPSHOT_RECEIVING) && cam == camera &&
+        hdr->session == id) {
+        state = SNAPSHOT_RECEIVING;
+        lastFrameAt = millis();
+        if (hdr->status == ESPNOW_SNAP_END) {
+            memcpy(&end, data, sizeof(end));
+            ended = true;
+            ackDue = true;
+        } else {
+            size_t n = len - sizeof(ESPNOW_Header_t);
+            uint32_t offset = (uint32_t)hdr->seq * ESPNOW_SNAP_CHUNK_BYTES;
+            if (hdr->seq == 0) {        // First pass, or the CAM started over
+                expected = 0;
+                received = 0;
+                ended = false;
+            }
+            if (hdr->seq == expected && offset + n <= SNAPSHOT_MAX_BYTES) {
+                memcpy(buffer + offset, data + sizeof(ESPNOW_Header_t), n);
+                expected++;
+                received = offset + n;
+                gapAcked = false;
+                if (expected % ESPNOW_SNAP_WINDOW == 0) ackDue = true;
+            } else if ((int16_t)(hdr->seq - expected) > 0) {
+                if (!gapAcked) {        // One was lost: ask from there at once, once
+                    gaps++;
+                    gapAcked = true;
+                    ackDue = true;
+                }
+            } else if ((hdr->seq + 1) % ESPNOW_SNAP_WINDOW == 0) {
+                ackDue = true;          // Window resent: our ACK was lost
+            }
+        }
+        due = ackDue;
+    }
+    portEXIT_CRITICAL(&mux);
+    return due;
+}
+
+void SnapshotRelay::service() {
+    SnapshotState s = state;
+    if (s != SNAPSHOT_REQUESTING && s != SNAPSHOT_RECEIVING) return;
+    unsigned long now = millis();
+
+    if (s == SNAPSHOT_REQUESTING) {
+        if ((long)(now - nextSendAt) < 0) return;
+        if (tries >= SNAPSHOT_REQUEST_TRIES) {
+            fail("no answer");
+            return;
+        }
+        tries++;
+        nextSendAt = now + SNAPSHOT_REQUEST_MS;
+        sendRequest();
+        return;
+    }
+
+    portENTER_CRITICAL(&mux);
+    bool due = ackDue;
+    bool done = ended;
+    uint16_t next = expected;
+    uint32_t bytes = received;
+    ESPNOW_SnapFrame_t last = end;      // A repeated END may land while we read it
+    unsigned long heard = lastFrameAt;
+    ackDue = false;
+    portEXIT_CRITICAL(&mux);
+
+    if (done && last.result != ESPNOW_SNAP_OK) {
+        fail(last.result < sizeof(RESULT_NAMES) / sizeof(RESULT_NAMES[0]) ? RESULT_NAMES[last.result] : "?");
+        return;
+    }
+    if (done && bytes == last.bytes) {
+        sendAck(next);                  // Final: the CAM stops retrying END
+        completed++;
+        lastBytes = bytes;
+        lastTransferMs = (uint32_t)((esp_timer_get_time() - requestedUs) / 1000);
+        lastOffsetMs = last.offsetMs;
+        LOG_I("SNAP", "Door %u: %u bytes in %u ms, frame %d ms from opening", (unsigned)door,
+              (unsigned)bytes, (unsigned)lastTransferMs, (int)lastOffsetMs);
+        portENTER_CRITICAL(&mux);
+        state = SNAPSHOT_READY;
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+    if (due) {
+        stalls = 0;
+        sendAck(next);
+        return;
+    }
+    if (now - heard >= SNAPSHOT_STALL_MS) {
+        if (++stalls > SNAPSHOT_STALL_TRIES) {
+            fail("stalled");
+            return;
+        }
+        portENTER_CRITICAL(&mux);
+        lastFrameAt = now;
+        portEXIT_CRITICAL(&mux);
+        sendAck(next);
+    }
+}
+
+void SnapshotRelay::sendRequest() {
+    ESPNOW_SnapFrame_t f = {};
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_SNAPSHOT;
+    f.hdr.session = id;
+    f.hdr.attempt = tries;
+    f.hdr.status = ESPNOW_SNAP_REQUEST;
+    f.door = door;
+    f.maxBytes = SNAPSHOT_MAX_BYTES;
+    int64_t age = esp_timer_get_time() - openedUs;
+    f.ageMs = age > 0 ? (uint32_t)(age / 1000) : 0;
+    esp_now_send(espNow->peerMac(camera), (const uint8_t*)&f, sizeof(f));
+}
+
+void SnapshotRelay::sendAck(uint16_t next) {
+    ESPNOW_SnapFrame_t f = {};
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_SNAPSHOT;
+    f.hdr.seq = next;
+    f.hdr.session = id;
+    f.hdr.status = ESPNOW_SNAP_ACK;
+    f.door = door;
+    esp_now_send(espNow->peerMac(camera), (const uint8_t*)&f, sizeof(f));
+}
+
+void SnapshotRelay::fail(const char* why) {
+    failures++;
+    lastError = why;
+    LOG_W("SNAP", "Door %u snapshot dropped: %s", (unsigned)door, why);
+    portENTER_CRITICAL(&mux);
+    state = SNAPSHOT_IDLE;
+    portEXIT_CRITICAL(&mux);
+}
+
+// ============================================================================
+// UPLOAD (cloud task)
+// ============================================================================
+void SnapshotRelay::upload(FirebaseData* fbdo) {
+    portENTER_CRITICAL(&mux);
+    SnapshotState s = state;
+    bool starting = s == SNAPSHOT_READY;
+    if (starting) {
+        state = SNAPSHOT_UPLOADING;
+        uploadEnd = end;
+    }
+    portEXIT_CRITICAL(&mux);
+    if (s != SNAPSHOT_READY && s != SNAPSHOT_UPLOADING) return;
+    if (starting) {
+        CloudWriter::generatePushId(key);
+        uploadPart = 0;
+        uploadFailures = 0;
+    }
+    if (uploadFailures && (long)(millis() - uploadRetryAt) < 0) return;
+
+    uint16_t parts = (uint16_t)((uploadEnd.bytes + SNAPSHOT_UPLOAD_BYTES - 1) / SNAPSHOT_UPLOAD_BYTES);
+    bool meta = uploadPart >= parts;    // Last, so a reader never sees meta without the picture
+    if (!write(fbdo, meta, parts)) {
+        if (++uploadFailures >= SNAPSHOT_UPLOAD_TRIES) {
+            fail("upload failed");
+            return;
+        }
+        uploadRetryAt = millis() + SNAPSHOT_RETRY_MS;
+        return;
+    }
+    uploadFailures = 0;
+    if (!meta) {
+        uploadPart++;
+        return;
+    }
+
+    uploaded++;
+    if (writer) writer->queueHistory(key, "BREACH_SNAPSHOT");
+    LOG_I("SNAP", "Door %u snapshot uploaded: %s", (unsigned)door, key);
+    portENTER_CRITICAL(&mux);
+    state = SNAPSHOT_IDLE;
+    portEXIT_CRITICAL(&mux);
+}
+
+bool SnapshotRelay::write(FirebaseData* fbdo, bool meta, uint16_t parts) {
+    FixedString<96> path;
+    bool ok;
+    int64_t t0 = link ? link->request(*fbdo) : 0;
+    if (meta) {
+        path.printf("%s/%s/meta", basePath.c_str(), key);
+        FirebaseJson json;
+        json.set("door", (int)door);
+        json.set("camera", (int)camera + 1);
+        json.set("bytes", (int)uploadEnd.bytes);
+        json.set("parts", (int)parts);
+        json.set("width", (int)uploadEnd.width);
+        json.set("height", (int)uploadEnd.height);
+        json.set("offset_ms", (int)uploadEnd.offsetMs);
+        json.set("t/.sv", "timestamp");
+        ok = Firebase.RTDB.setJSON(fbdo, path.c_str(), &json);
+    } else {
+        uint32_t offset = (uint32_t)uploadPart * SNAPSHOT_UPLOAD_BYTES;
+        size_t n = uploadEnd.bytes - offset;
+        if (n > SNAPSHOT_UPLOAD_BYTES) n = SNAPSHOT_UPLOAD_BYTES;
+        size_t olen = 0;
+        mbedtls_base64_encode((unsigned char*)b64, sizeof(b64), &olen, buffer + offset, n);
+        b64[olen] = '\0';
+        path.printf("%s/%s/jpeg/%u", basePath.c_str(), key, (unsigned)uploadPart);
+        ok = Firebase.RTDB.setString(fbdo, path.c_str(), b64);
+    }
+    if (link) link->requestDone(t0, ok);
+    if (!ok) LOG_W("SNAP", "Write %s failed: %s", meta ? "meta" : "part", fbdo->errorReason().c_str());
+    return ok;
+}
+
+void SnapshotRelay::printStats() {
+    static const char* const STATE_NAMES[] = { "idle", "requesting", "receiving", "ready", "uploading" };
+    Serial.printf("[SNAP] %s | requested %u, received %u, uploaded %u, failed %u, busy %u, gaps %u\n",
+                  STATE_NAMES[state], (unsigned)requested, (unsigned)completed, (unsigned)uploaded,
+                  (unsigned)failures, (unsigned)busyDrops, (unsigned)gaps);
+    if (completed) {
+        Serial.printf("[SNAP] Last: %u bytes in %u ms, frame %d ms from opening\n",
+                      (unsigned)lastBytes, (unsigned)lastTransferMs, (int)lastOffsetMs);
+    }
+    if (failures) Serial.printf("[SNAP] Last failure: %s\n", lastError);
+    if (!buffer) Serial.println(F("[SNAP] No buffer - snapshots off"));
+}
@@ -0,0 +1,130 @@
+#ifndef SNAPSHOT_RELAY_H
+#define SNAPSHOT_RELAY_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include "ESPNOW_CONFIG.h"
+#include "CloudLink.h"
+#include "FixedString.h"
+
+class EspNowManager;
+class CloudWriter;
+
+// ============================================================================
+// SNAPSHOT RELAY - Smart Parcel Locker
+// ============================================================================
+// Breach pictures from the camera, relayed to RTDB:
+// - request() (breach, io task) asks the camera covering the compartment
+//   for its frame nearest the door opening. The CAM keeps a short ring of
+//   recent frames, so the picture shows the opening, not the SMS going out.
+// - The JPEG comes back in ESP-NOW chunks (ESPNOW_CONFIG.h), copied by the
+//   WiFi task straight into one buffer allocated at begin(). The control
+//   task ACKs every window and each gap, re-ACKs a stall and gives up
+//   after a few.
+// - The cloud task uploads it one RTDB write per pass, so queue handling
+//   and batched writes keep their turn between parts:
+//     snapshots/<device>/<pushId>/jpeg/<n>  — base64 of SNAPSHOT_UPLOAD_BYTES
+//     snapshots/<device>/<pushId>/meta      — door, size, parts, frame offset
+//   then a BREACH_SNAPSHOT history event with the push ID as parcel, which
+//   links the alert to its picture.
+// One snapshot at a time: a breach while one is in flight, or waiting for
+// the link, gets no picture (counted as busy).
+
+#define SNAPSHOT_PATH               "/snapshots"
+#define SNAPSHOT_MAX_BYTES          16384   // Receive buffer; QVGA gray JPEGs are ~5-12 KB
+#define SNAPSHOT_REQUEST_MS         300     // REQUEST retry until the CAM answers
+#define SNAPSHOT_REQUEST_TRIES      4
+#define SNAPSHOT_STALL_MS           1000    // No frame this long → ACK again
+#define SNAPSHOT_STALL_TRIES        3
+#define SNAPSHOT_UPLOAD_BYTES       1536    // JPEG bytes per RTDB write (2048 base64)
+#define SNAPSHOT_UPLOAD_TRIES       5       // Consecutive failed writes before dropping it
+#define SNAPSHOT_RETRY_MS           5000
+
+enum SnapshotState : uint8_t {
+    SNAPSHOT_IDLE = 0,
+    SNAPSHOT_REQUESTING,    // REQUEST sent, nothing back yet
+    SNAPSHOT_RECEIVING,
+    SNAPSHOT_READY,         // Complete, waiting for the cloud task
+    SNAPSHOT_UPLOADING
+};
+
+class SnapshotRelay {
+public:
+    SnapshotRelay();
+
+    bool begin(EspNowManager* espNow, const char* deviceId);
+    void setLink(CloudLink* cloudLink) { link = cloudLink; }
+    void setWriter(CloudWriter* cloudWriter) { writer = cloudWriter; }
+
+    // Any task: ask a camera for door's picture at esp_timer time openedUs.
+    // False if one is already in progress.
+    bool request(uint8_t camera, uint8_t door, int64_t openedUs);
+
+    // WiFi task: a MSG_TYPE_SNAPSHOT frame from camera. True when an ACK or
+    // the end is due, so the caller can wake the control task.
+    bool onFrame(uint8_t camera, const uint8_t* data, int len);
+
+    // Control task, every pass: REQUEST / ACK sends and timeouts
+    void service();
+
+    // Cloud task, online: next part of a finished snapshot
+    void upload(FirebaseData* fbdo);
+
+    bool busy() const { return state != SNAPSHOT_IDLE; }
+    void printStats();
+
+private:
+    EspNowManager* espNow;
+    CloudLink* link;
+    CloudWriter* writer;
+    uint8_t* buffer;
+    FixedString<48> basePath;       // snapshots/<device>
+
+    // Shared with the WiFi task (guarded by mux)
+    portMUX_TYPE mux;
+    volatile SnapshotState state;
+    uint32_t id;
+    uint8_t camera;
+    uint8_t door;
+    int64_t openedUs;
+    uint16_t expected;              // Next chunk
+    uint32_t received;              // Bytes in buffer
+    bool gapAcked;                  // Only one ACK per lost chunk
+    bool ackDue;
+    bool ended;
+    ESPNOW_SnapFrame_t end;
+    unsigned long lastFrameAt;
+
+    // Control task
+    uint8_t tries;
+    uint8_t stalls;                 // Re-ACKs without a frame in between
+    unsigned long nextSendAt;
+    int64_t requestedUs;
+
+    // Cloud task
+    char key[21];
+    ESPNOW_SnapFrame_t uploadEnd;   // Copy of end, taken with the upload
+    uint16_t uploadPart;
+    uint8_t uploadFailures;
+    unsigned long uploadRetryAt;
+    char b64[((SNAPSHOT_UPLOAD_BYTES + 2) / 3) * 4 + 1];
+
+    // Statistics
+    uint32_t requested;
+    uint32_t completed;
+    uint32_t uploaded;
+    uint32_t failures;
+    uint32_t busyDrops;
+    uint32_t gaps;                  // Lost chunks, re-asked from the gap
+    uint32_t lastBytes;
+    uint32_t lastTransferMs;        // Request → complete
+    int32_t lastOffsetMs;           // Frame time - door opening
+    const char* lastError;
+
+    void sendRequest();
+    void sendAck(uint16_t next);
+    void fail(const char* why);
+    bool write(FirebaseData* fbdo, bool meta, uint16_t parts);
+};
+
+#endif // SNAPSHOT_RELAY_H
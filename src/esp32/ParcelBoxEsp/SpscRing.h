@@ -0,0 +1,61 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// SPSC RING BUFFER - Smart Parcel Locker
+// ============================================================================
+// Lock-free single-producer / single-consumer ring of fixed-size records.
+// - No heap, no locks: safe to push() from an ISR or WiFi-task callback
+// - N must be a power of two; indices run freely and are masked on access
+// - A full ring rejects the new record and counts it in dropped()
+//
+// Exactly one context may call push() and exactly one may call pop().
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), droppedCount(0), highWater(0) {}
+
+    // Producer side. Returns false (and counts a drop) when full.
+    bool IRAM_ATTR push(const T& item) {
+        uint32_t h = head;
+        uint32_t used = h - tail;
+        if (used >= N) {
+            droppedCount++;
+            return false;
+        }
+        buffer[h & (N - 1)] = item;
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+        if (used + 1 > highWater) highWater = used + 1;
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& item) {
+        uint32_t t = tail;
+        if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) return false;
+        item = buffer[t & (N - 1)];
+        __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    size_t size() const { return head - tail; }
+    bool empty() const { return head == tail; }
+    static constexpr size_t capacity() { return N; }
+
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t peak() const { return highWater; }
+
+private:
+    T buffer[N];
+    volatile uint32_t head;       // Written by producer only
+    volatile uint32_t tail;       // Written by consumer only
+    volatile uint32_t droppedCount;
+    volatile uint32_t highWater;
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,36 @@
+#include "StatusWord.h"
+
+// ============================================================================
+// STATUS WORD IMPLEMENTATION
+// ============================================================================
+
+static const char B64_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void StatusWord::encode(uint8_t seq, char out[STATUS_WORD_B64_LEN + 1]) const {
+    uint32_t heapKb = heapFree / 1024;
+    if (heapKb > 0xFFFF) heapKb = 0xFFFF;
+
+    uint8_t b[STATUS_WORD_BYTES];
+    b[0] = STATUS_WORD_VERSION;
+    b[1] = seq;
+    b[2] = locksOpen;
+    b[3] = doorsOpen;
+    b[4] = flags;
+    b[5] = (uint8_t)rssi;
+    b[6] = heapKb & 0xFF;
+    b[7] = heapKb >> 8;
+    for (int i = 0; i < 4; i++) b[8 + i] = (uptimeS >> (8 * i)) & 0xFF;
+
+    // 12 bytes = four whole 3-byte groups
+    static_assert(STATUS_WORD_BYTES % 3 == 0, "status word must need no base64 padding");
+    char* p = out;
+    for (int i = 0; i < STATUS_WORD_BYTES; i += 3) {
+        uint32_t v = ((uint32_t)b[i] << 16) | ((uint32_t)b[i + 1] << 8) | b[i + 2];
+        *p++ = B64_CHARS[(v >> 18) & 0x3F];
+        *p++ = B64_CHARS[(v >> 12) & 0x3F];
+        *p++ = B64_CHARS[(v >> 6) & 0x3F];
+        *p++ = B64_CHARS[v & 0x3F];
+    }
+    *p = '\0';
+}
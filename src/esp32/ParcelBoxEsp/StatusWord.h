@@ -0,0 +1,46 @@
+#ifndef STATUS_WORD_H
+#define STATUS_WORD_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// STATUS WORD - Smart Parcel Locker
+// ============================================================================
+// Live device status packed into 12 bytes and published as one base64
+// string (device_status/<device>/live) once a second, instead of a JSON
+// object of "open"/"closed" strings. Decoded by DeviceLiveStatus in the app.
+//
+// Layout v1 (little-endian):
+//   0  u8   version (STATUS_WORD_VERSION)
+//   1  u8   sequence, +1 per word (a gap = a lost update)
+//   2  u8   locks open, bit n = compartment n+1
+//   3  u8   doors open, bit n = compartment n+1
+//   4  u8   STATUS_FLAG_* bits (0x01 and 0x02 reserved, always 0)
+//   5  i8   WiFi RSSI, dBm (0 = not associated)
+//   6  u16  free internal heap, KiB
+//   8  u32  uptime, s
+//
+// Fields are only ever appended; a decoder ignores bytes it doesn't know.
+// There are no link flags: the word is only published while WiFi and Firebase
+// are up, so a reader judges the link by the word arriving, not by its bits.
+
+#define STATUS_WORD_VERSION     1
+#define STATUS_WORD_BYTES       12
+#define STATUS_WORD_B64_LEN     16      // 4 * ceil(BYTES / 3), no padding needed
+
+#define STATUS_FLAG_DELIVERY    0x04    // A delivery is validating or open
+#define STATUS_FLAG_BREACH      0x08    // Breach buzzer sounding
+
+struct StatusWord {
+    uint8_t locksOpen;
+    uint8_t doorsOpen;
+    uint8_t flags;
+    int8_t rssi;
+    uint32_t heapFree;      // Bytes
+    uint32_t uptimeS;
+
+    // Pack with `seq` into the v1 layout, base64 into out (NUL-terminated)
+    void encode(uint8_t seq, char out[STATUS_WORD_B64_LEN + 1]) const;
+};
+
+#endif // STATUS_WORD_H
@@ -0,0 +1,182 @@
+#include "SystemMetrics.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// SYSTEM METRICS IMPLEMENTATION
+// ============================================================================
+
+static_assert(TASK_HIST_BUCKETS == ESPNOW_METRICS_HIST_BUCKETS,
+              "Main and CAM pass histograms must use the same buckets");
+
+SystemMetrics::SystemMetrics()
+    : tasks(nullptr), espNow(nullptr), trace(nullptr), boot(nullptr), link(nullptr), commands(nullptr), haveSample(false), baselineFree(0), lowestLargest(0) {
+    memset(&last, 0, sizeof(last));
+}
+
+void SystemMetrics::begin(const TaskRuntime* t, EspNowManager* e, ScanTrace* s) {
+    tasks = t;
+    espNow = e;
+    trace = s;
+}
+
+uint8_t SystemMetrics::fragPct(uint32_t freeBytes, uint32_t largest) {
+    if (freeBytes == 0) return 0;
+    return (uint8_t)(100 - (uint64_t)largest * 100 / freeBytes);
+}
+
+void SystemMetrics::read(MetricsSnapshot& out) {
+    out.uptimeS = (uint32_t)(esp_timer_get_time() / 1000000);
+    out.heap.freeBytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out.heap.minFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    out.heap.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    out.heap.fragPct = fragPct(out.heap.freeBytes, out.heap.largestBlock);
+    out.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    out.psramLargest = out.psramFree ? heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) : 0;
+}
+
+void SystemMetrics::sample() {
+    read(last);
+    if (!haveSample) {
+        baselineFree = last.heap.freeBytes;
+        lowestLargest = last.heap.largestBlock;
+        haveSample = true;
+    }
+    if (last.heap.largestBlock < lowestLargest) lowestLargest = last.heap.largestBlock;
+}
+
+// ============================================================================
+// PUBLISH
+// ============================================================================
+void SystemMetrics::addHistogram(FirebaseJson& json, const char* key, const uint32_t* hist) {
+    FirebaseJsonArray arr;
+    for (int i = 0; i < TASK_HIST_BUCKETS; i++) arr.add((int)hist[i]);
+    json.set(key, arr);
+}
+
+void SystemMetrics::addTo(FirebaseJson& update, const char* path) {
+    if (!haveSample) return;
+
+    FirebaseJson m;
+    m.set("up", (int)last.uptimeS);
+    m.set("heap/free", (int)last.heap.freeBytes);
+    m.set("heap/min", (int)last.heap.minFree);
+    m.set("heap/max_blk", (int)last.heap.largestBlock);
+    m.set("heap/frag", (int)last.heap.fragPct);
+    m.set("heap/drift", (int)last.heap.freeBytes - (int)baselineFree);
+    m.set("heap/blk_low", (int)lowestLargest);
+    if (last.psramFree) {
+        m.set("psram/free", (int)last.psramFree);
+        m.set("psram/max_blk", (int)last.psramLargest);
+    }
+
+    char key[48];
+    for (int i = 0; tasks && i < tasks->count(); i++) {
+        const TaskInfo* t = tasks->get(i);
+        snprintf(key, sizeof(key), "tasks/%s/stack", t->name);
+        m.set(key, t->handle ? (int)uxTaskGetStackHighWaterMark(t->handle) : 0);
+        snprintf(key, sizeof(key), "tasks/%s/max_us", t->name);
+        m.set(key, (int)t->maxWorkUs);
+        snprintf(key, sizeof(key), "tasks/%s/hist", t->name);
+        addHistogram(m, key, t->passHist);
+    }
+
+    // One node per camera: cam1, cam2, ...
+    ESPNOW_BoardMetrics_t cam;
+    uint32_t ageMs = 0;
+    for (uint8_t c = 0; espNow && c < espNow->peerCount(); c++) {
+        if (!espNow->camMetrics(c, cam, &ageMs)) continue;
+        snprintf(key, sizeof(key), "cam%u/age_s", (unsigned)(c + 1));
+        m.set(key, (int)(ageMs / 1000));
+        snprintf(key, sizeof(key), "cam%u/up", (unsigned)(c + 1));
+        m.set(key, (int)cam.uptimeS);
+        snprintf(key, sizeof(key), "cam%u/heap/free", (unsigned)(c + 1));
+        m.set(key, (int)cam.heapFree);
+        snprintf(key, sizeof(key), "cam%u/heap/min", (unsigned)(c + 1));
+        m.set(key, (int)cam.heapMinFree);
+        snprintf(key, sizeof(key), "cam%u/heap/max_blk", (unsigned)(c + 1));
+        m.set(key, (int)cam.heapLargest);
+        snprintf(key, sizeof(key), "cam%u/heap/frag", (unsigned)(c + 1));
+        m.set(key, (int)fragPct(cam.heapFree, cam.heapLargest));
+        snprintf(key, sizeof(key), "cam%u/psram/free", (unsigned)(c + 1));
+        m.set(key, (int)cam.psramFree);
+        snprintf(key, sizeof(key), "cam%u/psram/max_blk", (unsigned)(c + 1));
+        m.set(key, (int)cam.psramLargest);
+        snprintf(key, sizeof(key), "cam%u/stack/loop", (unsigned)(c + 1));
+        m.set(key, (int)cam.loopStackFree);
+        snprintf(key, sizeof(key), "cam%u/stack/qr", (unsigned)(c + 1));
+        m.set(key, (int)cam.qrStackFree);
+        snprintf(key, sizeof(key), "cam%u/stack/pipeline", (unsigned)(c + 1));
+        m.set(key, (int)cam.pipelineStackFree);
+        snprintf(key, sizeof(key), "cam%u/stack/snapshot", (unsigned)(c + 1));
+        m.set(key, (int)cam.snapshotStackFree);
+        snprintf(key, sizeof(key), "cam%u/stack/ota", (unsigned)(c + 1));
+        m.set(key, (int)cam.otaStackFree);
+        snprintf(key, sizeof(key), "cam%u/loop/max_us", (unsigned)(c + 1));
+        m.set(key, (int)cam.loopMaxUs);
+        snprintf(key, sizeof(key), "cam%u/loop/hist", (unsigned)(c + 1));
+        addHistogram(m, key, cam.loopHist);
+    }
+
+    if (trace) trace->addTo(m, "latency");
+    if (boot) boot->addTo(m, "boot");
+    if (link) link->addTo(m, "tls");
+    if (commands) commands->addTo(m, "commands");
+
+    m.set("timestamp/.sv", "timestamp");
+    update.add(path, m);
+}
+
+// ============================================================================
+// SERIAL REPORT
+// ============================================================================
+void SystemMetrics::printHistogram(const uint32_t* hist) {
+    for (int i = 0; i < TASK_HIST_BUCKETS; i++) Serial.printf(" %7u", (unsigned)hist[i]);
+    Serial.println();
+}
+
+void SystemMetrics::print() {
+    MetricsSnapshot now;
+    read(now);
+
+    Serial.printf("Heap: %u free, %u min, %u largest block (%u%% frag)\n",
+                  (unsigned)now.heap.freeBytes, (unsigned)now.heap.minFree,
+                  (unsigned)now.heap.largestBlock, (unsigned)now.heap.fragPct);
+    if (haveSample) {
+        Serial.printf("Heap: drift %+d bytes since first sample, lowest largest block %u\n",
+                      (int)now.heap.freeBytes - (int)baselineFree, (unsigned)lowestLargest);
+    }
+    if (now.psramFree) {
+        Serial.printf("PSRAM: %u free, %u largest block\n",
+                      (unsigned)now.psramFree, (unsigned)now.psramLargest);
+    }
+
+    if (tasks) {
+        Serial.println(F("Task       Stack free  MaxPass(us)   <100us    <1ms   <10ms  <100ms    more"));
+        for (int i = 0; i < tasks->count(); i++) {
+            const TaskInfo* t = tasks->get(i);
+            Serial.printf("%-10s %10u  %11lld", t->name,
+                          t->handle ? (unsigned)uxTaskGetStackHighWaterMark(t->handle) : 0,
+                          (long long)t->maxWorkUs);
+            printHistogram(t->passHist);
+        }
+    }
+
+    ESPNOW_BoardMetrics_t cam;
+    uint32_t ageMs = 0;
+    for (uint8_t c = 0; espNow && c < espNow->peerCount(); c++) {
+        if (!espNow->camMetrics(c, cam, &ageMs)) {
+            Serial.printf("CAM %u: no metrics received\n", (unsigned)(c + 1));
+            continue;
+        }
+        Serial.printf("CAM %u (%lu s ago): up %us, heap %u free / %u min / %u largest, PSRAM %u free\n",
+                      (unsigned)(c + 1), (unsigned long)(ageMs / 1000), (unsigned)cam.uptimeS,
+                      (unsigned)cam.heapFree, (unsigned)cam.heapMinFree, (unsigned)cam.heapLargest,
+                      (unsigned)cam.psramFree);
+        Serial.printf("CAM %u stack free: loop %u, qr %u, pipeline %u, snapshot %u, ota %u | loop max %u us, hist",
+                      (unsigned)(c + 1), (unsigned)cam.loopStackFree, (unsigned)cam.qrStackFree,
+                      (unsigned)cam.pipelineStackFree, (unsigned)cam.snapshotStackFree,
+                      (unsigned)cam.otaStackFree, (unsigned)cam.loopMaxUs);
+        printHistogram(cam.loopHist);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SYSTEM_METRICS_H
+#define SYSTEM_METRICS_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include "TaskRuntime.h"
+#include "EspNowManager.h"
+#include "ScanTrace.h"
+#include "BootTimeline.h"
+#include "CloudLink.h"
+#include "CommandChannel.h"
+
+// ============================================================================
+// SYSTEM METRICS - Smart Parcel Locker
+// ============================================================================
+// Memory and timing telemetry for both boards:
+// - Heap: free, min-ever free, largest block, fragmentation %, and drift
+//   against the first sample (a steady fall means a leak)
+// - PSRAM when fitted
+// - Per-task stack high-water mark, longest pass and pass time histogram
+//   (from TaskRuntime)
+// - The CAM's newest status frame, relayed via EspNowManager
+// - Scan latency percentiles from ScanTrace
+// - Boot phase timings from BootTimeline
+// - TLS handshakes and reconnect-to-first-write time from CloudLink
+// - Remote command latency percentiles from CommandChannel
+// sample() runs with each heartbeat; addTo() writes a compact snapshot to
+// /device_status/<id>/metrics in the same batch.
+
+struct HeapSample {
+    uint32_t freeBytes;
+    uint32_t minFree;         // Lowest free heap since boot
+    uint32_t largestBlock;    // Largest allocatable block
+    uint8_t fragPct;          // 100 - largest/free
+};
+
+struct MetricsSnapshot {
+    uint32_t uptimeS;
+    HeapSample heap;
+    uint32_t psramFree;       // 0 without PSRAM
+    uint32_t psramLargest;
+};
+
+class SystemMetrics {
+public:
+    SystemMetrics();
+
+    // Sources for task, CAM and latency metrics (any may be null)
+    void begin(const TaskRuntime* tasks, EspNowManager* espNow, ScanTrace* trace);
+    void setBootTimeline(BootTimeline* timeline) { boot = timeline; }
+    void setCloudLink(CloudLink* cloudLink) { link = cloudLink; }
+    void setCommandChannel(CommandChannel* channel) { commands = channel; }
+
+    // Cloud task: take the snapshot that the next heartbeat publishes
+    void sample();
+
+    // Cloud task: add the last sample under `path` of a multi-path update
+    void addTo(FirebaseJson& update, const char* path);
+
+    // Any task: live readout for the `metrics` command
+    void print();
+
+    static void read(MetricsSnapshot& out);
+
+private:
+    const TaskRuntime* tasks;
+    EspNowManager* espNow;
+    ScanTrace* trace;
+    BootTimeline* boot;
+    CloudLink* link;
+    CommandChannel* commands;
+
+    MetricsSnapshot last;
+    bool haveSample;
+    uint32_t baselineFree;        // Free heap at the first sample
+    uint32_t lowestLargest;       // Smallest largest-block seen
+
+    static uint8_t fragPct(uint32_t freeBytes, uint32_t largest);
+    static void addHistogram(FirebaseJson& json, const char* key, const uint32_t* hist);
+    static void printHistogram(const uint32_t* hist);
+};
+
+#endif // SYSTEM_METRICS_H
@@ -0,0 +1,111 @@
+#ifndef TASKS_CONFIG_H
+#define TASKS_CONFIG_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// FREERTOS TASK LAYOUT - Smart Parcel Locker
+// ============================================================================
+// Core 0 (PRO_CPU) runs the WiFi stack, so all cloud I/O is pinned there.
+// Core 1 (APP_CPU) runs the hardware side. Tasks only exchange work through
+// the bounded queues below — no task ever calls another task's blocking I/O.
+//
+//   Task      Core  Prio  Role
+//   io        1     5     Door ISR events, breach buzzer (never blocks on I/O)
+//   loopTask  1     1     Control: scans, door events, serial, remote cmds
+//   cloud     0     3     WiFi, Firebase streams/writes, heartbeat
+//   gsm       1     2     SIM800L driver: AT state machine, SMS queue
+//   ui        1     1     LCD rendering
+//   log       0     1     Formats and prints the deferred log ring
+
+// ============================================================================
+// TASK SETTINGS
+// ============================================================================
+#define IO_TASK_STACK           4096
+#define IO_TASK_PRIORITY        5
+#define IO_TASK_CORE            1
+#define IO_TASK_PERIOD_MS       5       // Debounce settle / buzzer period (edges wake it at once)
+
+#define CLOUD_TASK_STACK        12288   // TLS + FirebaseJson need headroom
+#define CLOUD_TASK_PRIORITY     3
+#define CLOUD_TASK_CORE         0
+#define CLOUD_TASK_PERIOD_MS    20
+
+#define GSM_TASK_STACK          4096
+#define GSM_TASK_PRIORITY       2
+#define GSM_TASK_CORE           1
+
+#define UI_TASK_STACK           3072
+#define UI_TASK_PRIORITY        1
+#define UI_TASK_CORE            1
+
+#define LOG_TASK_STACK          3072
+#define LOG_TASK_PRIORITY       1       // Below cloud: printing never delays I/O
+#define LOG_TASK_CORE           0
+#define LOG_TASK_PERIOD_MS      20
+
+#define CONTROL_PERIOD_MS       5       // loop() idle wait between passes
+
+// ============================================================================
+// QUEUE DEPTHS
+// ============================================================================
+#define CLOUD_QUEUE_LEN         16
+#define SMS_QUEUE_LEN           8
+#define UI_QUEUE_LEN            8
+#define DOOR_QUEUE_LEN          8
+#define CONTROL_QUEUE_LEN       8
+
+// ============================================================================
+// MESSAGE TYPES
+// ============================================================================
+// io → control
+typedef struct {
+  uint8_t door;           // Compartment ID (LOCKER_CONFIG.h)
+  bool open;
+  int64_t timestampUs;    // esp_timer time of the accepted edge
+} DoorEventMsg_t;
+
+// any → cloud
+// (history/status writes go through CloudWriter, not this queue)
+#define CLOUD_MSG_CONFIRM_PARCEL 1   // Re-check a cache hit against RTDB
+#define CLOUD_MSG_FETCH_PARCEL   2   // Cache miss: look up and reply to control
+
+typedef struct {
+  uint8_t type;
+  uint8_t camera;         // FETCH_PARCEL: echoed in the reply
+  char parcelId[32];
+  char event[32];
+} CloudMsg_t;
+
+// cloud → control
+#define CONTROL_MSG_REMOTE_LOCK   0
+#define CONTROL_MSG_EMERGENCY     1
+#define CONTROL_MSG_PARCEL_RESULT 2
+
+typedef struct {
+  uint8_t type;
+  uint8_t lockNum;        // REMOTE_LOCK: compartment ID
+  bool flag;              // REMOTE_LOCK: open, PARCEL_RESULT: found
+  uint8_t command;        // REMOTE_LOCK / EMERGENCY: CommandChannel slot to ack
+  uint8_t camera;         // PARCEL_RESULT: camera whose scan is waiting
+  char parcelId[32];
+} ControlMsg_t;
+
+// any → gsm (lower value is sent first)
+#define SMS_PRIORITY_ALERT   0   // Breach / tamper alerts
+#define SMS_PRIORITY_NOTICE  1   // Delivery confirmations
+
+typedef struct {
+  uint8_t priority;
+  int64_t queuedUs;       // esp_timer time sendSMS() was called
+  char phone[20];
+  char message[160];      // Single SMS segment
+} SmsMsg_t;
+
+// any → ui
+typedef struct {
+  char lines[4][21];      // LCD_ROWS x (LCD_COLS + NUL)
+  uint32_t delayMs;       // 0 = now; else shown after this unless a newer screen comes first
+} UiMsg_t;
+
+#endif // TASKS_CONFIG_H
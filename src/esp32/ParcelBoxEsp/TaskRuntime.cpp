@@ -0,0 +1,83 @@
+#include "TaskRuntime.h"
+#include <esp_timer.h>
+
+// ============================================================================
+// TASK RUNTIME IMPLEMENTATION
+// ============================================================================
+
+TaskRuntime::TaskRuntime() : taskCount(0), windowStartUs(0) {
+    memset(tasks, 0, sizeof(tasks));
+}
+
+TaskInfo* TaskRuntime::allocate(const char* name, uint32_t stackSize) {
+    if (taskCount >= MAX_TASKS) return nullptr;
+    TaskInfo* t = &tasks[taskCount++];
+    memset(t, 0, sizeof(TaskInfo));
+    t->name = name;
+    t->stackSize = stackSize;
+    if (windowStartUs == 0) windowStartUs = esp_timer_get_time();
+    return t;
+}
+
+TaskInfo* TaskRuntime::start(const char* name, TaskFunction_t fn, uint32_t stackSize,
+                             UBaseType_t priority, BaseType_t core) {
+    TaskInfo* t = allocate(name, stackSize);
+    if (!t) {
+        Serial.printf("[TASK] Registry full, cannot start %s\n", name);
+        return nullptr;
+    }
+    if (xTaskCreatePinnedToCore(fn, name, stackSize, t, priority, &t->handle, core) != pdPASS) {
+        Serial.printf("[TASK] Failed to start %s\n", name);
+        taskCount--;
+        return nullptr;
+    }
+    Serial.printf("[TASK] %s started (core %d, prio %u, stack %u)\n",
+                  name, (int)core, (unsigned)priority, (unsigned)stackSize);
+    return t;
+}
+
+TaskInfo* TaskRuntime::adoptCurrent(const char* name, uint32_t stackSize) {
+    TaskInfo* t = allocate(name, stackSize);
+    if (t) t->handle = xTaskGetCurrentTaskHandle();
+    return t;
+}
+
+void TaskRuntime::workBegin(TaskInfo* task) {
+    if (task) task->workStartUs = esp_timer_get_time();
+}
+
+void TaskRuntime::workEnd(TaskInfo* task) {
+    if (!task || task->workStartUs == 0) return;
+    int64_t spent = esp_timer_get_time() - task->workStartUs;
+    task->busyUs += spent;
+    task->iterations++;
+    if (spent > task->maxWorkUs) task->maxWorkUs = spent;
+    task->passHist[histBucket(spent)]++;
+    task->workStartUs = 0;
+}
+
+int TaskRuntime::histBucket(int64_t us) {
+    int bucket = 0;
+    for (int64_t limit = 100; bucket < TASK_HIST_BUCKETS - 1 && us >= limit; limit *= 10) bucket++;
+    return bucket;
+}
+
+void TaskRuntime::printStats() {
+    int64_t now = esp_timer_get_time();
+    int64_t window = now - windowStartUs;
+    if (window <= 0) window = 1;
+
+    Serial.println(F("Task       Core  Stack free/size   CPU%   Passes  MaxPass(us)"));
+    for (int i = 0; i < taskCount; i++) {
+        TaskInfo& t = tasks[i];
+        UBaseType_t freeStack = t.handle ? uxTaskGetStackHighWaterMark(t.handle) : 0;
+        BaseType_t core = t.handle ? xTaskGetCoreID(t.handle) : -1;
+        float cpu = 100.0f * (float)t.busyUs / (float)window;
+        Serial.printf("%-10s %-5d %6u/%-8u %6.2f  %7u  %lld\n",
+                      t.name, (int)core, (unsigned)freeStack, (unsigned)t.stackSize,
+                      cpu, (unsigned)t.iterations, (long long)t.maxWorkUs);
+        t.busyUs = 0;
+        t.iterations = 0;
+    }
+    windowStartUs = now;
+}
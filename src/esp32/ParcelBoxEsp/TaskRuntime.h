@@ -0,0 +1,67 @@
+#ifndef TASK_RUNTIME_H
+#define TASK_RUNTIME_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// ============================================================================
+// TASK RUNTIME - Smart Parcel Locker
+// ============================================================================
+// Thin registry around xTaskCreatePinnedToCore that tracks, per task:
+// - Stack high-water mark (uxTaskGetStackHighWaterMark)
+// - Busy time between workBegin()/workEnd() → CPU % over the last window
+// - Pass time histogram since boot (decades from 100 us), for slow-loop
+//   detection in the published metrics
+// Run-time stats are self-measured because the Arduino core ships FreeRTOS
+// without configGENERATE_RUN_TIME_STATS.
+
+#define TASK_HIST_BUCKETS 5     // <100us, <1ms, <10ms, <100ms, >=100ms
+
+struct TaskInfo {
+    const char* name;
+    TaskHandle_t handle;
+    uint32_t stackSize;       // Bytes requested at creation
+    int64_t workStartUs;      // esp_timer time of the current workBegin()
+    int64_t busyUs;           // Busy time accumulated in this window
+    uint32_t iterations;      // Work passes in this window
+    int64_t maxWorkUs;        // Longest single pass ever
+    uint32_t passHist[TASK_HIST_BUCKETS];   // Pass count per duration bucket
+};
+
+class TaskRuntime {
+public:
+    TaskRuntime();
+
+    // Create a pinned task; pvParameters receives its TaskInfo*
+    TaskInfo* start(const char* name, TaskFunction_t fn, uint32_t stackSize,
+                    UBaseType_t priority, BaseType_t core);
+
+    // Register an already running task (e.g. Arduino loopTask)
+    TaskInfo* adoptCurrent(const char* name, uint32_t stackSize);
+
+    // Bracket one unit of work in a task's loop
+    static void workBegin(TaskInfo* task);
+    static void workEnd(TaskInfo* task);
+
+    // Print stack / CPU table and reset the measurement window
+    void printStats();
+
+    // Read-only access for metrics sampling
+    int count() const { return taskCount; }
+    const TaskInfo* get(int i) const { return (i >= 0 && i < taskCount) ? &tasks[i] : nullptr; }
+
+    // Histogram bucket for a pass of `us` microseconds
+    static int histBucket(int64_t us);
+
+    static const int MAX_TASKS = 8;
+
+private:
+    TaskInfo tasks[MAX_TASKS];
+    int taskCount;
+    int64_t windowStartUs;
+
+    TaskInfo* allocate(const char* name, uint32_t stackSize);
+};
+
+#endif // TASK_RUNTIME_H
@@ -47,6 +47,15 @@ bool WiFiManagerCustom::begin(const char* apName, const char* apPassword) {
     return true;
 }
 
+bool WiFiManagerCustom::beginStored() {
+    if (!wifiManager.getWiFiIsSaved()) return false;
+    
+    // Credentials saved in NVS by the last portal session
+    WiFi.mode(WIFI_STA);
+    WiFi.begin();
+    return true;
+}
+
 bool WiFiManagerCustom::isConnected() {
     return WiFi.status() == WL_CONNECTED;
 }
@@ -24,6 +24,10 @@ public:
     // apPassword: Password for setup portal
     bool begin(const char* apName, const char* apPassword);
     
+    // Start joining the saved network without waiting (no portal)
+    // Returns: false if no credentials are stored yet
+    bool beginStored();
+    
     // Check if WiFi is currently connected
     bool isConnected();
     
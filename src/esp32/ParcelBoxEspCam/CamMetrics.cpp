@@ -0,0 +1,71 @@
+#include "CamMetrics.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// ESP32-CAM METRICS IMPLEMENTATION
+// ============================================================================
+
+CamMetrics::CamMetrics()
+    : loopTask(nullptr), qrTask(nullptr), pipelineTask(nullptr), snapshots(nullptr), ota(nullptr),
+      passStartUs(0), loopMaxUs(0) {
+    memset(loopHist, 0, sizeof(loopHist));
+}
+
+void CamMetrics::begin(TaskHandle_t loop, TaskHandle_t qr, TaskHandle_t pipeline,
+                       const SnapshotRing* snapshotRing, const OtaReceiver* otaReceiver) {
+    loopTask = loop;
+    qrTask = qr;
+    pipelineTask = pipeline;
+    snapshots = snapshotRing;
+    ota = otaReceiver;
+}
+
+void CamMetrics::loopBegin() {
+    passStartUs = esp_timer_get_time();
+}
+
+void CamMetrics::loopEnd() {
+    if (passStartUs == 0) return;
+    int64_t spent = esp_timer_get_time() - passStartUs;
+    passStartUs = 0;
+    if (spent > loopMaxUs) loopMaxUs = (uint32_t)spent;
+
+    // Same decade buckets as TaskRuntime on the Main ESP32
+    int bucket = 0;
+    for (int64_t limit = 100; bucket < ESPNOW_METRICS_HIST_BUCKETS - 1 && spent >= limit; limit *= 10) bucket++;
+    loopHist[bucket]++;
+}
+
+void CamMetrics::sample(ESPNOW_BoardMetrics_t& out) {
+    memset(&out, 0, sizeof(out));
+    out.uptimeS = (uint32_t)(esp_timer_get_time() / 1000000);
+    out.heapFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    out.heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    out.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    out.psramLargest = out.psramFree ? heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) : 0;
+    out.loopStackFree = loopTask ? uxTaskGetStackHighWaterMark(loopTask) : 0;
+    out.qrStackFree = qrTask ? uxTaskGetStackHighWaterMark(qrTask) : 0;
+    out.pipelineStackFree = pipelineTask ? uxTaskGetStackHighWaterMark(pipelineTask) : 0;
+    out.snapshotStackFree = snapshots ? snapshots->stackFree() : 0;
+    out.otaStackFree = ota ? ota->stackFree() : 0;
+    out.loopMaxUs = loopMaxUs;
+    memcpy(out.loopHist, loopHist, sizeof(out.loopHist));
+}
+
+void CamMetrics::print() {
+    ESPNOW_BoardMetrics_t m;
+    sample(m);
+    uint32_t frag = m.heapFree ? 100 - (uint32_t)((uint64_t)m.heapLargest * 100 / m.heapFree) : 0;
+    Serial.printf("[METRICS] Heap: %u free, %u min, %u largest block (%u%% frag)\n",
+                  (unsigned)m.heapFree, (unsigned)m.heapMinFree, (unsigned)m.heapLargest, (unsigned)frag);
+    Serial.printf("[METRICS] PSRAM: %u free, %u largest block\n",
+                  (unsigned)m.psramFree, (unsigned)m.psramLargest);
+    Serial.printf("[METRICS] Stack free: loop %u, qr %u, pipeline %u, snapshot %u, ota %u\n",
+                  (unsigned)m.loopStackFree, (unsigned)m.qrStackFree, (unsigned)m.pipelineStackFree,
+                  (unsigned)m.snapshotStackFree, (unsigned)m.otaStackFree);
+    Serial.printf("[METRICS] Loop max %u us | <100us %u, <1ms %u, <10ms %u, <100ms %u, more %u\n",
+                  (unsigned)m.loopMaxUs, (unsigned)m.loopHist[0], (unsigned)m.loopHist[1],
+                  (unsigned)m.loopHist[2], (unsigned)m.loopHist[3], (unsigned)m.loopHist[4]);
+}
@@ -0,0 +1,49 @@
+#ifndef CAM_METRICS_H
+#define CAM_METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "EspNowCamera.h"
+#include "SnapshotRing.h"
+#include "OtaReceiver.h"
+
+// ============================================================================
+// ESP32-CAM METRICS
+// ============================================================================
+// Heap, PSRAM (frame buffers live there), stack high-water marks and a loop
+// pass time histogram. The snapshot goes to the Main ESP32 as an ESP-NOW
+// status frame, which publishes it under /device_status/<id>/metrics/cam.
+// ============================================================================
+
+class CamMetrics {
+public:
+  CamMetrics();
+
+  // Tasks whose stack high-water marks are reported. The snapshot and OTA
+  // tasks come and go, so those report the marks of their ended runs.
+  void begin(TaskHandle_t loopTask, TaskHandle_t qrTask, TaskHandle_t pipelineTask,
+             const SnapshotRing* snapshots, const OtaReceiver* ota);
+
+  // Bracket one loop() pass (excluding its trailing delay)
+  void loopBegin();
+  void loopEnd();
+
+  // Current values plus the loop histogram
+  void sample(ESPNOW_BoardMetrics_t& out);
+
+  // `metrics` serial command
+  void print();
+
+private:
+  TaskHandle_t loopTask;
+  TaskHandle_t qrTask;
+  TaskHandle_t pipelineTask;
+  const SnapshotRing* snapshots;
+  const OtaReceiver* ota;
+  int64_t passStartUs;
+  uint32_t loopMaxUs;
+  uint32_t loopHist[ESPNOW_METRICS_HIST_BUCKETS];
+};
+
+#endif // CAM_METRICS_H
@@ -1,23 +1,533 @@
+#include "EspNowCamera.h"
+#include "SnapshotRing.h"
+#include "OtaReceiver.h"
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
 // ============================================================================
-// EspNowCamera.cpp — DEPRECATED
-// All ESP-NOW logic is inline in ParcelBoxEspCam.ino now.
-// Kept to avoid compilation errors.
-// Remove from project when fully migrated.
+// ESP32-CAM ESP-NOW IMPLEMENTATION
 // ============================================================================
-#include "EspNowCamera.h"
 
-static EspNowCamera* globalEspNowCamera = nullptr;
+EspNowCamera* EspNowCamera::instance = nullptr;
+
+EspNowCamera::EspNowCamera()
+    : session(0), nextSeq(0), txQueue(nullptr), snapshots(nullptr), ota(nullptr), inflightActive(false), sentAt(0), firstSentAt(0),
+      mux(portMUX_INITIALIZER_UNLOCKED), ackedSeq(0), ackStatus(0), ackReceived(false),
+      syncSeq(0), syncT1(0), syncT2(0), syncPending(false), offeredChannel(0),
+      lastHeardAt(0), macFailStreak(0), currentChannel(1), scanning(false), scanStartChannel(1),
+      scanProbed(0), nextProbeAt(0), resumeScanAt(0),
+      benchTask(nullptr), benchRun(0), benchMode(0), benchSize(0), benchCount(0),
+      benchStartPending(false), benchEndPending(false), benchFlooded(false), benchPingSeq(0),
+      benchPingTxUs(0), benchPingRxUs(0), benchPingRssi(0), benchPingPending(false), benchRx(0),
+      benchFirstUs(0), benchLastUs(0), benchRssiSum(0), benchRssiMin(0), benchTx(0),
+      benchRuns(0), benchPongs(0),
+      qrCodesSent(0), retransmits(0), acked(0), duplicatesAcked(0), failed(0), queueDrops(0),
+      macFailures(0), lastRttMs(0), syncReplies(0), scansStarted(0), channelMoves(0), foreignFrames(0) {
+    memset(mainEspMac, 0, sizeof(mainEspMac));
+    memset(benchFrame, 0, sizeof(benchFrame));
+    memset(ownMac, 0, sizeof(ownMac));
+    memset(&inflight, 0, sizeof(inflight));
+}
+
+bool EspNowCamera::begin(const uint8_t* mac) {
+    memcpy(mainEspMac, mac, sizeof(mainEspMac));
+    WiFi.macAddress(ownMac);
+    instance = this;
+    if (!txQueue) txQueue = xQueueCreate(ESPNOW_TX_QUEUE_LEN, sizeof(ESPNOW_QRPacket_t));
+    // New session per boot: the main board restarts its duplicate window
+    if (session == 0) session = esp_random() | 1;
+
+    // Deinit first (safe for reinit)
+    esp_now_deinit();
+    if (esp_now_init() != ESP_OK) {
+        Serial.println(F("[ESPNOW] Init FAILED"));
+        return false;
+    }
+
+    esp_now_register_send_cb(onSent);
+    esp_now_register_recv_cb(onReceive);
+
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mainEspMac, sizeof(mainEspMac));
+    peer.channel = 0;  // 0 = use current (locked) channel
+    peer.encrypt = false;
+    peer.ifidx = WIFI_IF_STA;
+    if (esp_now_add_peer(&peer) != ESP_OK) {
+        Serial.println(F("[ESPNOW] Peer add FAILED"));
+        return false;
+    }
+
+    // Nothing heard yet: the first service() call confirms the channel
+    currentChannel = WiFi.channel();
+    lastHeardAt = 0;
+    resumeScanAt = 0;
+    return true;
+}
+
+bool EspNowCamera::sendQrCode(const char* qrCode, int64_t decodeUs) {
+    if (!txQueue) return false;
+    ESPNOW_QRPacket_t packet = {};
+    strlcpy(packet.qrData, qrCode, sizeof(packet.qrData));
+    packet.timestamp = millis();
+    packet.decodeUs = decodeUs;
+    memcpy(packet.camMac, ownMac, sizeof(packet.camMac));
+    if (xQueueSend(txQueue, &packet, 0) != pdTRUE) {
+        queueDrops++;
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// CALLBACKS (WiFi task)
+// ============================================================================
+void EspNowCamera::onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+    EspNowCamera* self = instance;
+    if (!self) return;
+    // Only the main board: bench, snapshot, update and channel frames alike
+    if (memcmp(info->src_addr, self->mainEspMac, sizeof(self->mainEspMac)) != 0) {
+        self->foreignFrames++;
+        return;
+    }
+    const ESPNOW_Header_t* hdr = (const ESPNOW_Header_t*)data;
+    if (len < (int)sizeof(ESPNOW_Header_t) || hdr->magic != ESPNOW_MAGIC) return;
+    self->lastHeardAt = millis() | 1;
+
+    if (hdr->type == MSG_TYPE_BENCH) {
+        self->onBenchFrame(info, data, len);
+        return;
+    }
+    if (hdr->type == MSG_TYPE_SNAPSHOT) {
+        if (self->snapshots) self->snapshots->onFrame(data, len);
+        return;
+    }
+    if (hdr->type == MSG_TYPE_OTA) {
+        if (self->ota) self->ota->onFrame(data, len);
+        return;
+    }
+
+    if (len == sizeof(ESPNOW_ChannelFrame_t) && hdr->type == MSG_TYPE_CONFIG &&
+        hdr->status == ESPNOW_CONFIG_CHANNEL) {
+        portENTER_CRITICAL(&self->mux);
+        self->offeredChannel = ((const ESPNOW_ChannelFrame_t*)data)->channel;
+        portEXIT_CRITICAL(&self->mux);
+        return;
+    }
+
+    if (len == sizeof(ESPNOW_TimeSyncFrame_t) && hdr->magic == ESPNOW_MAGIC &&
+        hdr->type == MSG_TYPE_TIME_SYNC && hdr->status == ESPNOW_SYNC_REQUEST) {
+        int64_t now = esp_timer_get_time();     // t2: as close to arrival as possible
+        const ESPNOW_TimeSyncFrame_t* req = (const ESPNOW_TimeSyncFrame_t*)data;
+        portENTER_CRITICAL(&self->mux);
+        self->syncSeq = hdr->seq;
+        self->syncT1 = req->t1;
+        self->syncT2 = now;
+        self->syncPending = true;
+        portEXIT_CRITICAL(&self->mux);
+        return;
+    }
+
+    if (len != sizeof(ESPNOW_AckFrame_t)) return;
+    if (hdr->magic != ESPNOW_MAGIC || hdr->type != MSG_TYPE_ACK || hdr->session != self->session) return;
+
+    portENTER_CRITICAL(&self->mux);
+    self->ackedSeq = hdr->seq;
+    self->ackStatus = hdr->status;
+    self->ackReceived = true;
+    portEXIT_CRITICAL(&self->mux);
+}
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+void EspNowCamera::onSent(const wifi_tx_info_t* info, esp_now_send_status_t status) {
+#else
+void EspNowCamera::onSent(const uint8_t* mac, esp_now_send_status_t status) {
+#endif
+    // MAC-layer result only; delivery is decided by the application ACK.
+    // A failure streak is the quickest sign the main board changed channel.
+    if (!instance) return;
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        instance->macFailStreak = 0;
+    } else {
+        instance->macFailures++;
+        if (instance->macFailStreak < 255) instance->macFailStreak++;
+    }
+}
+
+// ============================================================================
+// SEND STATE MACHINE (loop)
+// ============================================================================
+void EspNowCamera::transmit() {
+    sentAt = millis();
+    inflight.qr.txUs = esp_timer_get_time();
+    if (esp_now_send(mainEspMac, (const uint8_t*)&inflight, sizeof(inflight)) != ESP_OK) {
+        Serial.println(F("[ESPNOW] Send queue FAILED"));
+    }
+}
+
+// Reply from the loop rather than the WiFi callback; the delay in between
+// is excluded by the t2/t3 pair
+void EspNowCamera::answerTimeSync() {
+    ESPNOW_TimeSyncFrame_t frame = {};
+    portENTER_CRITICAL(&mux);
+    bool pending = syncPending;
+    frame.hdr.seq = syncSeq;
+    frame.t1 = syncT1;
+    frame.t2 = syncT2;
+    syncPending = false;
+    portEXIT_CRITICAL(&mux);
+    if (!pending) return;
+
+    frame.hdr.magic = ESPNOW_MAGIC;
+    frame.hdr.type = MSG_TYPE_TIME_SYNC;
+    frame.hdr.session = session;
+    frame.hdr.status = ESPNOW_SYNC_RESPONSE;
+    frame.t3 = esp_timer_get_time();
+    if (esp_now_send(mainEspMac, (const uint8_t*)&frame, sizeof(frame)) == ESP_OK) syncReplies++;
+}
+
+// ============================================================================
+// CHANNEL DISCOVERY (loop)
+// ============================================================================
+void EspNowCamera::setChannel(uint8_t ch) {
+    esp_wifi_set_promiscuous(true);
+    esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+    esp_wifi_set_promiscuous(false);
+    currentChannel = ch;
+}
+
+void EspNowCamera::probe() {
+    ESPNOW_ChannelFrame_t frame = {};
+    frame.hdr.magic = ESPNOW_MAGIC;
+    frame.hdr.type = MSG_TYPE_CONFIG;
+    frame.hdr.seq = scanProbed;
+    frame.hdr.session = session;
+    frame.hdr.status = ESPNOW_CONFIG_PROBE;
+    esp_now_send(mainEspMac, (const uint8_t*)&frame, sizeof(frame));
+    nextProbeAt = millis() + ESPNOW_SCAN_DWELL_MS;
+}
+
+void EspNowCamera::startScan(const char* why) {
+    Serial.printf("[ESPNOW] %s - probing from channel %u\n", why, currentChannel);
+    scanning = true;
+    scanStartChannel = currentChannel;
+    scanProbed = 1;
+    scansStarted++;
+    probe();    // Current channel first: it is usually still right
+}
+
+void EspNowCamera::serviceLink() {
+    portENTER_CRITICAL(&mux);
+    uint8_t offered = offeredChannel;
+    offeredChannel = 0;
+    portEXIT_CRITICAL(&mux);
+
+    bool associated = WiFi.status() == WL_CONNECTED;
+    unsigned long now = millis();
+
+    if (offered >= 1 && offered <= ESPNOW_CHANNEL_MAX) {
+        if (scanning) {
+            Serial.printf("[ESPNOW] Main board answered on channel %u\n", currentChannel);
+            scanning = false;
+        }
+        if (offered != currentChannel) {
+            if (associated) {
+                Serial.printf("[ESPNOW] Main board on channel %u, our AP on %u - cannot follow\n",
+                              offered, currentChannel);
+            } else {
+                Serial.printf("[ESPNOW] Main board moved to channel %u\n", offered);
+                setChannel(offered);
+                channelMoves++;
+            }
+        }
+        macFailStreak = 0;
+        resumeScanAt = 0;
+        return;
+    }
+
+    if (associated) {
+        scanning = false;
+        return;
+    }
+
+    if (scanning) {
+        if ((long)(now - nextProbeAt) < 0) return;
+        if (scanProbed >= ESPNOW_CHANNEL_MAX) {
+            // Full sweep, no answer: main board is off or out of range
+            scanning = false;
+            setChannel(scanStartChannel);
+            resumeScanAt = now + ESPNOW_SCAN_PAUSE_MS;
+            return;
+        }
+        setChannel(currentChannel % ESPNOW_CHANNEL_MAX + 1);
+        scanProbed++;
+        probe();
+        return;
+    }
+
+    if (resumeScanAt != 0) {
+        if ((long)(now - resumeScanAt) < 0) return;
+        resumeScanAt = 0;
+        startScan("Main board still silent");
+        return;
+    }
+
+    unsigned long heard = lastHeardAt;
+    if (heard == 0) startScan("Looking for main board");
+    else if (macFailStreak >= ESPNOW_SCAN_AFTER_FAILURES) startScan("Sends failing");
+    else if (now - heard > ESPNOW_LINK_SILENCE_MS) startScan("Main board silent");
+}
+
+EspNowTxResult EspNowCamera::service() {
+    if (!txQueue) return ESPNOW_TX_IDLE;
+    answerTimeSync();
+    serviceLink();
+    serviceBench();
+
+    if (scanning) {
+        sentAt = millis();      // Hold the retry clock until the main board is found
+        return ESPNOW_TX_IDLE;
+    }
 
-EspNowCamera::EspNowCamera() : newMessageAvailable(false), qrCodesSent(0), commandsReceived(0) {
-    memset(deviceId, 0, sizeof(deviceId));
-    memset(mainEspMac, 0, 6);
-    globalEspNowCamera = this;
+    if (inflightActive) {
+        portENTER_CRITICAL(&mux);
+        bool gotAck = ackReceived && ackedSeq == inflight.hdr.seq;
+        uint8_t status = ackStatus;
+        ackReceived = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (gotAck) {
+            inflightActive = false;
+            lastRttMs = millis() - firstSentAt;
+            acked++;
+            if (status == ESPNOW_ACK_DUPLICATE) duplicatesAcked++;
+            return ESPNOW_TX_ACKED;
+        }
+
+        unsigned long timeout = (unsigned long)ESPNOW_ACK_TIMEOUT_MS << inflight.hdr.attempt;
+        if (millis() - sentAt < timeout) return ESPNOW_TX_IDLE;
+
+        if (inflight.hdr.attempt >= ESPNOW_RETRY_COUNT) {
+            inflightActive = false;
+            failed++;
+            Serial.printf("[ESPNOW] No ACK for seq %u after %u attempts\n",
+                          inflight.hdr.seq, inflight.hdr.attempt + 1);
+            return ESPNOW_TX_FAILED;
+        }
+        inflight.hdr.attempt++;
+        retransmits++;
+        transmit();
+        return ESPNOW_TX_IDLE;
+    }
+
+    // Idle: start the next queued scan
+    ESPNOW_QRPacket_t packet;
+    if (xQueueReceive(txQueue, &packet, 0) != pdTRUE) return ESPNOW_TX_IDLE;
+
+    memset(&inflight, 0, sizeof(inflight));
+    inflight.hdr.magic = ESPNOW_MAGIC;
+    inflight.hdr.type = MSG_TYPE_QR_SCAN;
+    inflight.hdr.seq = ++nextSeq;
+    inflight.hdr.session = session;
+    inflight.qr = packet;
+
+    portENTER_CRITICAL(&mux);
+    ackReceived = false;
+    portEXIT_CRITICAL(&mux);
+
+    inflightActive = true;
+    firstSentAt = millis();
+    qrCodesSent++;
+    transmit();
+    return ESPNOW_TX_IDLE;
 }
 
-void EspNowCamera::begin(const char*, const uint8_t*) {}
-void EspNowCamera::sendMessage(EspNowMessage&) {}
-void EspNowCamera::sendQrCode(const char*) {}
-bool EspNowCamera::hasCommand() { return false; }
-void EspNowCamera::processCommand() {}
-void EspNowCamera::onLockCommand(uint8_t, uint8_t, uint16_t) {}
-void EspNowCamera::printStatus() {}
\ No newline at end of file
+bool EspNowCamera::sendStatus(const ESPNOW_BoardMetrics_t& metrics) {
+    ESPNOW_StatusFrame_t frame = {};
+    frame.hdr.magic = ESPNOW_MAGIC;
+    frame.hdr.type = MSG_TYPE_STATUS;
+    frame.hdr.session = session;
+    frame.metrics = metrics;
+    return esp_now_send(mainEspMac, (const uint8_t*)&frame, sizeof(frame)) == ESP_OK;
+}
+
+// ============================================================================
+// LINK BENCH RESPONDER
+// ============================================================================
+// WiFi task: stamp and hand over; the bench task does the sending
+void EspNowCamera::onBenchFrame(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+    if (len < (int)sizeof(ESPNOW_BenchFrame_t) || len > ESPNOW_BENCH_MAX_LEN) return;
+    int64_t now = esp_timer_get_time();
+    const ESPNOW_BenchFrame_t* f = (const ESPNOW_BenchFrame_t*)data;
+    int8_t rssi = info->rx_ctrl ? info->rx_ctrl->rssi : 0;
+
+    bool wake = true;
+    portENTER_CRITICAL(&mux);
+    if (f->hdr.status == ESPNOW_BENCH_START) {
+        if (f->hdr.session != benchRun) {
+            // New run (a retried START keeps the counters)
+            benchRun = f->hdr.session;
+            benchMode = f->mode;
+            benchSize = f->size < sizeof(ESPNOW_BenchFrame_t) ? sizeof(ESPNOW_BenchFrame_t) : f->size;
+            if (benchSize > ESPNOW_BENCH_MAX_LEN) benchSize = ESPNOW_BENCH_MAX_LEN;     // Fits benchFrame
+            benchCount = f->count;
+            benchFlooded = false;
+            benchRx = 0;
+            benchRssiSum = 0;
+            benchRssiMin = 0;
+            benchPingPending = false;
+            benchEndPending = false;
+            benchRuns++;
+        }
+        benchStartPending = true;
+    } else if (f->hdr.session != benchRun) {
+        wake = false;
+    } else if (f->hdr.status == ESPNOW_BENCH_PING) {
+        benchPingSeq = f->hdr.seq;
+        benchPingTxUs = f->txUs;
+        benchPingRxUs = now;
+        benchPingRssi = rssi;
+        benchPingPending = true;
+    } else if (f->hdr.status == ESPNOW_BENCH_FLOOD) {
+        if (benchRx == 0 || rssi < benchRssiMin) benchRssiMin = rssi;
+        if (benchRx == 0) benchFirstUs = now;
+        benchLastUs = now;
+        benchRssiSum += rssi;
+        benchRx++;
+        wake = false;
+    } else if (f->hdr.status == ESPNOW_BENCH_END) {
+        benchEndPending = true;
+    } else {
+        wake = false;
+    }
+    TaskHandle_t task = benchTask;
+    portEXIT_CRITICAL(&mux);
+    if (wake && task) xTaskNotifyGive(task);
+}
+
+// Loop: start the bench task for a START that found none running
+void EspNowCamera::serviceBench() {
+    portENTER_CRITICAL(&mux);
+    bool start = benchStartPending && !benchTask;
+    portEXIT_CRITICAL(&mux);
+    if (!start) return;
+    // The handle is stored before the task first runs
+    if (xTaskCreate(benchTaskEntry, "espnowBench", ESPNOW_BENCH_TASK_STACK, this,
+                    ESPNOW_BENCH_TASK_PRIORITY, &benchTask) != pdPASS) {
+        Serial.println(F("[ESPNOW] Bench task FAILED"));
+    }
+}
+
+void EspNowCamera::benchTaskEntry(void* arg) {
+    static_cast<EspNowCamera*>(arg)->runBench();
+    vTaskDelete(nullptr);
+}
+
+void EspNowCamera::runBench() {
+    while (true) {
+        portENTER_CRITICAL(&mux);
+        uint32_t run = benchRun;
+        uint8_t mode = benchMode;
+        uint8_t size = benchSize;
+        uint16_t count = benchCount;
+        bool start = benchStartPending;
+        bool end = benchEndPending;
+        bool ping = benchPingPending;
+        bool flood = start && mode == ESPNOW_BENCH_MODE_FLOOD_RX && !benchFlooded;
+        if (flood) benchFlooded = true;
+        uint16_t pingSeq = benchPingSeq;
+        int64_t pingTxUs = benchPingTxUs;
+        int64_t pingRxUs = benchPingRxUs;
+        int8_t pingRssi = benchPingRssi;
+        benchStartPending = benchEndPending = benchPingPending = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (ping) {
+            ESPNOW_BenchFrame_t& f = benchHeader(run, ESPNOW_BENCH_PONG, pingSeq);
+            f.txUs = pingTxUs;
+            f.rssi = pingRssi;
+            f.spanUs = (uint32_t)(esp_timer_get_time() - pingRxUs);
+            if (sendBench(size)) benchPongs++;
+        }
+        if (start) {
+            ESPNOW_BenchFrame_t& f = benchHeader(run, ESPNOW_BENCH_READY, 0);
+            f.channel = currentChannel;
+            sendBench(sizeof(ESPNOW_BenchFrame_t));
+        }
+        if (flood) {
+            benchTx = 0;
+            for (uint16_t i = 0; i < count; i++) {
+                ESPNOW_BenchFrame_t& f = benchHeader(run, ESPNOW_BENCH_FLOOD, i);
+                f.txUs = esp_timer_get_time();
+                if (sendBench(size)) benchTx++;
+            }
+        }
+        if (end) {
+            ESPNOW_BenchFrame_t& f = benchHeader(run, ESPNOW_BENCH_REPORT, 0);
+            portENTER_CRITICAL(&mux);
+            f.count = mode == ESPNOW_BENCH_MODE_FLOOD_RX ? benchTx : benchRx;
+            f.spanUs = (uint32_t)(benchLastUs - benchFirstUs);
+            f.rssi = benchRx ? (int8_t)(benchRssiSum / benchRx) : 0;
+            f.rssiMin = benchRssiMin;
+            portEXIT_CRITICAL(&mux);
+            f.channel = currentChannel;
+            sendBench(sizeof(ESPNOW_BenchFrame_t));
+        }
+
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPNOW_BENCH_IDLE_MS)) == 0) {
+            // Quiet: done, unless something landed just now
+            portENTER_CRITICAL(&mux);
+            bool idle = !benchStartPending && !benchEndPending && !benchPingPending;
+            if (idle) benchTask = nullptr;
+            portEXIT_CRITICAL(&mux);
+            if (idle) return;
+        }
+    }
+}
+
+// Header of the next frame; padding past it is left as is
+ESPNOW_BenchFrame_t& EspNowCamera::benchHeader(uint32_t run, uint8_t op, uint16_t seq) {
+    ESPNOW_BenchFrame_t& f = *(ESPNOW_BenchFrame_t*)benchFrame;
+    memset(&f, 0, sizeof(f));
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_BENCH;
+    f.hdr.seq = seq;
+    f.hdr.session = run;
+    f.hdr.status = op;
+    return f;
+}
+
+// A full radio queue is waited out rather than counted as loss
+bool EspNowCamera::sendBench(size_t len) {
+    esp_err_t err;
+    while ((err = esp_now_send(mainEspMac, benchFrame, len)) == ESP_ERR_ESPNOW_NO_MEM) vTaskDelay(1);
+    return err == ESP_OK;
+}
+
+void EspNowCamera::printBench() {
+    portENTER_CRITICAL(&mux);
+    uint32_t run = benchRun;
+    uint8_t mode = benchMode;
+    uint8_t size = benchSize;
+    uint16_t count = benchCount;
+    uint16_t rx = benchRx;
+    int32_t rssiSum = benchRssiSum;
+    int8_t rssiMin = benchRssiMin;
+    portEXIT_CRITICAL(&mux);
+    Serial.printf("[ESPNOW] bench: %u runs, %u PONGs sent%s\n",
+                  (unsigned)benchRuns, (unsigned)benchPongs, benchTask ? ", running" : "");
+    if (!run) return;
+    Serial.printf("[ESPNOW] last run %08x: mode %u, %u x %u B, %u FLOOD received",
+                  (unsigned)run, mode, count, size, rx);
+    if (rx) Serial.printf(" (RSSI %d, min %d dBm)", (int)(rssiSum / rx), rssiMin);
+    Serial.printf(", %u sent, channel %u\n", benchTx, currentChannel);
+}
+
+void EspNowCamera::printStatus() {
+    Serial.printf("[ESPNOW] sent %u, acked %u (%u dup), retx %u, failed %u, queue drops %u, MAC fails %u, last RTT %lu ms, %u time syncs\n",
+                  (unsigned)qrCodesSent, (unsigned)acked, (unsigned)duplicatesAcked,
+                  (unsigned)retransmits, (unsigned)failed, (unsigned)queueDrops,
+                  (unsigned)macFailures, lastRttMs, (unsigned)syncReplies);
+    Serial.printf("[ESPNOW] channel %u%s, %u scans, %u channel moves, %u foreign frames dropped\n",
+                  currentChannel, scanning ? " (scanning)" : "",
+                  (unsigned)scansStarted, (unsigned)channelMoves, (unsigned)foreignFrames);
+}
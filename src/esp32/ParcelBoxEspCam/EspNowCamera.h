@@ -1,72 +1,399 @@
-#ifndef ESPNOW_CAMERA_H
-#define ESPNOW_CAMERA_H
-
-#include <Arduino.h>
-#include <esp_now.h>
-#include <WiFi.h>
-
-// ============================================================================
-// ESP32-CAM ESP-NOW COMMUNICATION
-// ============================================================================
-// Minimal ESP-NOW implementation for ESP32-CAM
-// Sends: QR codes via ESP-NOW to main ESP32
-// Receives: Lock control commands from main ESP32
-// ============================================================================
-
-// Message types (must match EspNowManager.h)
-#define MSG_TYPE_QR_SCAN        0
-#define MSG_TYPE_LOCK_CMD       1
-#define MSG_TYPE_STATUS         2
-#define MSG_TYPE_CONFIG         3
-#define MSG_TYPE_ACK            4
-
-typedef struct {
-  uint8_t type;
-  char deviceId[32];
-  uint32_t timestamp;
-  uint8_t retries;
-  union {
-    char qrCode[64];
-    struct {
-      uint8_t lock;
-      uint8_t command;
-      uint16_t duration;
-    } lockCmd;
-  } payload;
-} EspNowMessage;
-
-class EspNowCamera {
-public:
-  EspNowCamera();
-  
-  // Initialization
-  void begin(const char* deviceId, const uint8_t* mainEspMac);
-  
-  // Send QR scan to main ESP32
-  void sendQrCode(const char* qrCode);
-  
-  // Check for incoming lock commands
-  bool hasCommand();
-  void processCommand();
-  
-  // Lock command callback (user implements)
-  void onLockCommand(uint8_t lockNum, uint8_t command, uint16_t duration);
-  
-  // Statistics
-  void printStatus();
-
-private:
-  char deviceId[32];
-  uint8_t mainEspMac[6];
-  bool newMessageAvailable;
-
-  uint32_t qrCodesSent;
-
-  void sendMessage(EspNowMessage& msg);
-
-public:
-  EspNowMessage lastMessage;
-  uint32_t commandsReceived;
-};
-
-#endif // ESPNOW_CAMERA_H
+#ifndef ESPNOW_CAMERA_H
+#define ESPNOW_CAMERA_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+class SnapshotRing;
+class OtaReceiver;
+
+// ============================================================================
+// ESP32-CAM ESP-NOW COMMUNICATION
+// ============================================================================
+// Reliable sender for QR scans:
+// - Each scan gets a sequence number and is retransmitted with exponential
+//   backoff until the Main ESP32 ACKs that seq (end-to-end, not MAC-layer)
+// - Stop-and-wait: one frame in flight, further scans wait in a small queue,
+//   so different parcels can be scanned back-to-back without cooldown
+// - The main board drops retransmits by seq, never by comparing QR strings
+// - Scans carry decode and TX times; time-sync requests from the main board
+//   are answered from service() so it can map them onto its own clock
+// - Channel discovery: the main board's channel follows its AP. When nothing
+//   has been heard from it for a while (or MAC sends keep failing), the CAM
+//   probes channel 1..13 until the main board answers, then stays there.
+//   The main board's boot announcement is followed too. Sending pauses while
+//   scanning; the frame in flight keeps its retries. Skipped while the CAM is
+//   itself associated, since its AP then owns the channel.
+// - Link bench responder: the main board's `linkbench:` runs are answered
+//   by a short-lived task started on the first START (PONGs go out as soon
+//   as the PING lands; the turnaround is reported back). It ends after
+//   ESPNOW_BENCH_IDLE_MS without bench traffic.
+// - Frames from any MAC but the main board's are dropped first
+// - Breach snapshot frames go straight from the callback to SnapshotRing,
+//   firmware update frames to OtaReceiver
+// ============================================================================
+
+// Frame layout and settings — MUST match ESPNOW_CONFIG.h on Main ESP32
+#define ESPNOW_MAGIC            0xB7
+
+#define MSG_TYPE_QR_SCAN        0
+#define MSG_TYPE_LOCK_CMD       1
+#define MSG_TYPE_STATUS         2
+#define MSG_TYPE_CONFIG         3
+#define MSG_TYPE_ACK            4
+#define MSG_TYPE_TIME_SYNC      5
+#define MSG_TYPE_BENCH          6
+#define MSG_TYPE_SNAPSHOT       7
+#define MSG_TYPE_OTA            8
+
+#define ESPNOW_ACK_ACCEPTED     0
+#define ESPNOW_ACK_DUPLICATE    1
+
+#define ESPNOW_RETRY_COUNT      4          // Retransmissions after the first send
+#define ESPNOW_ACK_TIMEOUT_MS   250        // First ACK wait; doubles on each retry
+#define ESPNOW_TX_QUEUE_LEN     8          // Scans waiting behind the one in flight
+
+#define ESPNOW_CHANNEL_MAX      13
+#define ESPNOW_SCAN_DWELL_MS    60         // Wait for a probe answer on each channel
+#define ESPNOW_SCAN_PAUSE_MS    2000       // Rest between sweeps nobody answered
+#define ESPNOW_LINK_SILENCE_MS  12000      // Main board sends time sync every 5 s
+#define ESPNOW_SCAN_AFTER_FAILURES 3       // Consecutive MAC-layer send failures
+
+#define ESPNOW_BENCH_IDLE_MS    3000       // Bench task ends after this long unused
+#define ESPNOW_BENCH_TASK_STACK 3072
+#define ESPNOW_BENCH_TASK_PRIORITY 5       // Above onQrCode: PONG turnaround stays short
+
+typedef struct __attribute__((packed)) {
+  char qrData[32];     // QR payload (parcelId)
+  uint32_t timestamp;  // Scan timestamp (millis)
+  uint8_t camMac[6];   // ESP32-CAM MAC address
+  int64_t decodeUs;    // esp_timer time the QR was decoded
+  int64_t txUs;        // esp_timer time of this transmission
+} ESPNOW_QRPacket_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic;
+  uint8_t type;
+  uint16_t seq;
+  uint32_t session;
+  uint8_t attempt;
+  uint8_t status;
+} ESPNOW_Header_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  ESPNOW_QRPacket_t qr;
+} ESPNOW_QRFrame_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+} ESPNOW_AckFrame_t;
+
+// Time sync for scan tracing: the Main ESP32 requests (t1), the CAM stamps
+// its receive (t2) and reply (t3) times
+#define ESPNOW_SYNC_REQUEST     0   // hdr.status
+#define ESPNOW_SYNC_RESPONSE    1
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  int64_t t1;
+  int64_t t2;
+  int64_t t3;
+} ESPNOW_TimeSyncFrame_t;
+
+// Channel discovery (MSG_TYPE_CONFIG). The main board's channel follows its
+// AP. A CAM that stops hearing it probes channel by channel; the main board
+// answers each probe on the channel it is on. It also announces its channel
+// once associated at boot, for a CAM scanning meanwhile; after an AP channel
+// change it cannot (the radio has already moved), so probing is the recovery.
+#define ESPNOW_CONFIG_PROBE     0   // hdr.status: CAM → main
+#define ESPNOW_CONFIG_CHANNEL   1   // hdr.status: main → CAM
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t channel;        // Main board's primary channel (0 in probes)
+} ESPNOW_ChannelFrame_t;
+
+// CAM health snapshot, sent unacknowledged (MSG_TYPE_STATUS) every 30 s.
+// The Main ESP32 publishes the newest one with its own metrics. Fields are
+// only appended; one missing from an older CAM's frame reads as 0.
+#define ESPNOW_METRICS_HIST_BUCKETS 5   // Loop pass time: <100us, <1ms, <10ms, <100ms, more
+
+typedef struct __attribute__((packed)) {
+  uint32_t uptimeS;
+  uint32_t heapFree;       // Internal heap, bytes
+  uint32_t heapMinFree;    // Lowest free heap since boot
+  uint32_t heapLargest;    // Largest allocatable block
+  uint32_t psramFree;      // 0 without PSRAM
+  uint32_t psramLargest;
+  uint16_t loopStackFree;  // Stack high-water marks, bytes
+  uint16_t qrStackFree;
+  uint32_t loopMaxUs;      // Longest loop pass since boot
+  uint32_t loopHist[ESPNOW_METRICS_HIST_BUCKETS];
+  uint16_t pipelineStackFree;  // QR capture/decode task (quirc)
+  uint16_t snapshotStackFree;  // On-demand tasks: lowest of the runs that
+  uint16_t otaStackFree;       // ended, 0 = none since boot
+} ESPNOW_BoardMetrics_t;
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  ESPNOW_BoardMetrics_t metrics;
+} ESPNOW_StatusFrame_t;
+
+// Link bench (MSG_TYPE_BENCH), driven from the main board console. A run
+// opens with START/READY and closes with END/REPORT (both retried); in
+// between come the data frames, padded to the run's size. hdr.session is
+// the run id, hdr.seq the data frame number.
+#define ESPNOW_BENCH_START      0   // hdr.status: main → CAM, run parameters
+#define ESPNOW_BENCH_READY      1   // CAM → main
+#define ESPNOW_BENCH_PING       2   // main → CAM, echoed at once as PONG
+#define ESPNOW_BENCH_PONG       3
+#define ESPNOW_BENCH_FLOOD      4   // Either way, unanswered
+#define ESPNOW_BENCH_END        5   // main → CAM
+#define ESPNOW_BENCH_REPORT     6   // CAM → main: its side of the run
+
+#define ESPNOW_BENCH_MODE_PING      0   // Stop-and-wait round trips
+#define ESPNOW_BENCH_MODE_FLOOD_TX  1   // main → CAM, back to back
+#define ESPNOW_BENCH_MODE_FLOOD_RX  2   // CAM → main, back to back
+
+#define ESPNOW_BENCH_MAX_LEN    250 // ESP_NOW_MAX_DATA_LEN
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t mode;           // START: ESPNOW_BENCH_MODE_*
+  uint8_t size;           // START: data frame length, bytes
+  uint16_t count;         // START: data frames; REPORT: FLOOD frames received (TX) / sent (RX)
+  uint32_t spanUs;        // PONG: CAM turnaround; REPORT: first → last FLOOD arrival
+  int64_t txUs;           // PING: main send time, echoed in the PONG
+  int8_t rssi;            // PONG: dBm the PING arrived at; REPORT: mean of the FLOOD
+  int8_t rssiMin;         // REPORT
+  uint8_t channel;        // READY / REPORT: the CAM's channel
+} ESPNOW_BenchFrame_t;
+
+// Breach snapshot (MSG_TYPE_SNAPSHOT). The main board asks for the frame
+// nearest the moment a door opened; the CAM JPEG-encodes it out of its
+// pre-trigger ring straight into CHUNK frames (hdr.seq = chunk number,
+// ESPNOW_SNAP_CHUNK_BYTES each but the last) and closes with END. The main
+// board ACKs the next chunk it expects at every ESPNOW_SNAP_WINDOW boundary,
+// at a gap and after END; an ACK behind what was sent makes the CAM encode
+// again and resend from there. Chunk 0 always starts the image over.
+// hdr.session is the snapshot id; a new one replaces the snapshot in flight.
+#define ESPNOW_SNAP_REQUEST     0   // hdr.status: main → CAM
+#define ESPNOW_SNAP_CHUNK       1   // CAM → main, JPEG bytes after the header
+#define ESPNOW_SNAP_END         2   // CAM → main: result and size
+#define ESPNOW_SNAP_ACK         3   // main → CAM: hdr.seq = next chunk expected
+
+#define ESPNOW_SNAP_OK          0   // END result
+#define ESPNOW_SNAP_NO_FRAME    1   // Nothing in the ring (no PSRAM, camera down)
+#define ESPNOW_SNAP_TOO_BIG     2   // Over maxBytes even at the lowest quality
+
+#define ESPNOW_SNAP_WINDOW      8   // Chunks per ACK
+#define ESPNOW_SNAP_CHUNK_BYTES (ESPNOW_BENCH_MAX_LEN - sizeof(ESPNOW_Header_t))
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t door;           // REQUEST: compartment ID, echoed in END
+  uint8_t result;         // END: ESPNOW_SNAP_*
+  uint16_t maxBytes;      // REQUEST: JPEG size the main board can take
+  uint32_t ageMs;         // REQUEST: the door opened this long ago
+  int32_t offsetMs;       // END: frame capture time - door opening
+  uint32_t bytes;         // END: JPEG size
+  uint16_t width;         // END
+  uint16_t height;
+} ESPNOW_SnapFrame_t;
+
+// CAM firmware update (MSG_TYPE_OTA), relayed by the main board while it
+// downloads it. QUERY / INFO: the version the CAM runs. START: the delta's
+// base (DeltaPatch.h) and the SHA-256 of the new image; READY says whether
+// the running image is that base. CHUNK frames carry the delta from its
+// first byte (hdr.seq = chunk number, ESPNOW_OTA_CHUNK_BYTES each but the
+// last); the CAM ACKs the next chunk it expects at every ESPNOW_OTA_WINDOW
+// boundary once it is in flash, and with result ESPNOW_OTA_RESEND at a gap
+// or a window it already had. The main board keeps at most
+// ESPNOW_OTA_INFLIGHT chunks past the last ACK, resends from a RESEND and,
+// after ESPNOW_OTA_ACK_MS of silence, from the last ACK. END (repeated
+// until answered) gets DONE after the image is checked and set to boot;
+// the CAM restarts once its pipeline is idle. hdr.session is the update id.
+// START is tagged (auth) with an HMAC under the secret OTA key (OtaKey.h),
+// so the SHA-256 the CAM checks the image against is the main board's; an
+// untagged or mistagged START is dropped. A replayed START can only bring back a
+// genuine image, and only onto the base it was made against.
+#define ESPNOW_OTA_QUERY        0   // hdr.status: main → CAM
+#define ESPNOW_OTA_INFO         1   // CAM → main: running version
+#define ESPNOW_OTA_START        2   // main → CAM
+#define ESPNOW_OTA_READY        3   // CAM → main: result
+#define ESPNOW_OTA_CHUNK        4   // main → CAM, delta bytes
+#define ESPNOW_OTA_ACK          5   // CAM → main: hdr.seq = next chunk expected
+#define ESPNOW_OTA_END          6   // main → CAM: bytes = delta size
+#define ESPNOW_OTA_DONE         7   // CAM → main: result
+
+#define ESPNOW_OTA_OK           0   // READY / DONE result
+#define ESPNOW_OTA_BASE         1   // Running image is not the delta's base
+#define ESPNOW_OTA_FLASH        2   // No update partition, or a write failed
+#define ESPNOW_OTA_VERIFY       3   // Delta, CRC, SHA-256 or image check failed
+#define ESPNOW_OTA_RESEND       1   // ACK result: resend from hdr.seq
+
+#define ESPNOW_OTA_WINDOW       8   // Chunks per ACK
+#define ESPNOW_OTA_INFLIGHT     (2 * ESPNOW_OTA_WINDOW)
+#define ESPNOW_OTA_ACK_MS       300
+#define ESPNOW_OTA_CHUNK_BYTES  ESPNOW_SNAP_CHUNK_BYTES
+#define ESPNOW_OTA_VERSION_LEN  16
+
+typedef struct __attribute__((packed)) {
+  ESPNOW_Header_t hdr;
+  uint8_t result;         // READY / DONE: ESPNOW_OTA_*; ACK: 0 or RESEND
+  char version[ESPNOW_OTA_VERSION_LEN];   // INFO: running; START: the update's
+  uint32_t oldSize;       // START: delta base, 0 = full image
+  uint32_t oldCrc;
+  uint32_t newSize;       // START: image size
+  uint32_t bytes;         // START / END: delta size
+  uint8_t sha256[32];     // START: of the new image
+  uint8_t auth[32];       // START: HMAC-SHA256 of the bytes before it
+} ESPNOW_OtaFrame_t;
+
+// Outcome of service() for the frame in flight
+enum EspNowTxResult {
+  ESPNOW_TX_IDLE = 0,     // Nothing finished this call
+  ESPNOW_TX_ACKED,        // Main ESP32 processed the scan
+  ESPNOW_TX_FAILED        // No ACK after all retries — scan dropped
+};
+
+class EspNowCamera {
+public:
+  EspNowCamera();
+
+  // esp_now_init, callbacks and the main board peer (channel set by caller)
+  bool begin(const uint8_t* mainEspMac);
+
+  // Any task: queue a scan decoded at esp_timer time decodeUs.
+  // Returns false if the queue is full.
+  bool sendQrCode(const char* qrCode, int64_t decodeUs);
+
+  // Loop: answer time sync, start / retransmit / complete the frame in flight
+  EspNowTxResult service();
+
+  // Best-effort health snapshot (not sequenced, not ACKed)
+  bool sendStatus(const ESPNOW_BoardMetrics_t& metrics);
+
+  // Statistics
+  void printStatus();
+
+  // Channel the CAM currently talks on
+  uint8_t channel() const { return currentChannel; }
+
+  // Link bench responder: runs served and the last one's receive side
+  void printBench();
+
+  // Optional: receiver of MSG_TYPE_SNAPSHOT frames
+  void setSnapshots(SnapshotRing* ring) { snapshots = ring; }
+
+  // Optional: receiver of MSG_TYPE_OTA frames
+  void setOta(OtaReceiver* receiver) { ota = receiver; }
+
+private:
+  static EspNowCamera* instance;
+
+  uint8_t mainEspMac[6];
+  uint8_t ownMac[6];
+  uint32_t session;
+  uint16_t nextSeq;
+  QueueHandle_t txQueue;
+  SnapshotRing* snapshots;
+  OtaReceiver* ota;
+
+  // Frame in flight (loop task)
+  ESPNOW_QRFrame_t inflight;
+  bool inflightActive;
+  unsigned long sentAt;
+  unsigned long firstSentAt;
+
+  // ACK hand-off from the WiFi task (guarded by mux)
+  portMUX_TYPE mux;
+  uint16_t ackedSeq;
+  uint8_t ackStatus;
+  bool ackReceived;
+
+  // Time-sync request awaiting its reply (guarded by mux)
+  uint16_t syncSeq;
+  int64_t syncT1;
+  int64_t syncT2;
+  bool syncPending;
+
+  // Channel offered by the main board (guarded by mux)
+  uint8_t offeredChannel;
+
+  // Link watch and channel scan (loop task; lastHeardAt / macFailStreak
+  // are also bumped by the WiFi task)
+  volatile unsigned long lastHeardAt;     // millis() of the last frame from the main board
+  volatile uint8_t macFailStreak;
+  uint8_t currentChannel;
+  bool scanning;
+  uint8_t scanStartChannel;
+  uint8_t scanProbed;
+  unsigned long nextProbeAt;
+  unsigned long resumeScanAt;
+
+  // Link bench responder. Run state is written by the WiFi task and read by
+  // the bench task (guarded by mux); the task handle is set by the loop.
+  TaskHandle_t benchTask;
+  uint32_t benchRun;              // Run id (hdr.session of its frames)
+  uint8_t benchMode;
+  uint8_t benchSize;
+  uint16_t benchCount;
+  bool benchStartPending;
+  bool benchEndPending;
+  bool benchFlooded;              // CAM → main flood of this run sent
+  uint16_t benchPingSeq;
+  int64_t benchPingTxUs;
+  int64_t benchPingRxUs;
+  int8_t benchPingRssi;
+  bool benchPingPending;
+  uint16_t benchRx;               // FLOOD frames of this run
+  int64_t benchFirstUs;
+  int64_t benchLastUs;
+  int32_t benchRssiSum;
+  int8_t benchRssiMin;
+  uint16_t benchTx;               // FLOOD frames sent this run (rx mode, bench task only)
+  uint8_t benchFrame[ESPNOW_BENCH_MAX_LEN];
+  uint32_t benchRuns;
+  uint32_t benchPongs;
+
+  // Statistics
+  uint32_t qrCodesSent;
+  uint32_t retransmits;
+  uint32_t acked;
+  uint32_t duplicatesAcked;
+  uint32_t failed;
+  uint32_t queueDrops;
+  volatile uint32_t macFailures;
+  unsigned long lastRttMs;
+  uint32_t syncReplies;
+  uint32_t scansStarted;
+  uint32_t channelMoves;
+  volatile uint32_t foreignFrames;  // Not from mainEspMac, dropped
+
+  void transmit();
+  void answerTimeSync();
+  void serviceLink();
+  void startScan(const char* why);
+  void probe();
+  void setChannel(uint8_t ch);
+  void onBenchFrame(const esp_now_recv_info_t* info, const uint8_t* data, int len);
+  void serviceBench();
+  void runBench();
+  ESPNOW_BenchFrame_t& benchHeader(uint32_t run, uint8_t op, uint16_t seq);
+  bool sendBench(size_t len);
+  static void benchTaskEntry(void* arg);
+
+  static void onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int len);
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  static void onSent(const wifi_tx_info_t* info, esp_now_send_status_t status);
+#else
+  static void onSent(const uint8_t* mac, esp_now_send_status_t status);
+#endif
+};
+
+#endif // ESPNOW_CAMERA_H
@@ -0,0 +1,305 @@
+#include "ImageKernels.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// ESP32-CAM IMAGE KERNELS IMPLEMENTATION
+// ============================================================================
+// SWAR lanes: a 32-bit word holds pixels x..x+3 (little endian, byte k =
+// pixel x+k). Pair sums are formed in 16-bit lanes (mask 0x00FF00FF), which
+// leaves enough headroom for 2x2 (max 1020) and 4x4 (max 4080) box sums.
+
+namespace ImageKernels {
+
+static const uint32_t LO_BYTES = 0x00FF00FF;
+static const uint32_t HIGH_BITS = 0x80808080;
+
+static inline bool wordAligned(const void* p, int w) {
+    return ((uintptr_t)p & 3) == 0 && (w & 3) == 0;
+}
+
+// ============================================================================
+// DOWNSCALE
+// ============================================================================
+void downscale2xScalar(const uint8_t* src, int w, int h, uint8_t* dst) {
+    int ow = w / 2;
+    for (int y = 0; y < h / 2; y++) {
+        const uint8_t* r0 = src + (2 * y) * w;
+        const uint8_t* r1 = r0 + w;
+        uint8_t* out = dst + y * ow;
+        for (int x = 0; x < ow; x++) {
+            out[x] = (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+        }
+    }
+}
+
+// 8 source pixels per row per step → 4 output pixels in one word store
+void downscale2xSwar(const uint8_t* src, int w, int h, uint8_t* dst) {
+    int ow = w / 2;
+    for (int y = 0; y < h / 2; y++) {
+        const uint32_t* r0 = (const uint32_t*)(src + (2 * y) * w);
+        const uint32_t* r1 = (const uint32_t*)(src + (2 * y + 1) * w);
+        uint8_t* out = dst + y * ow;
+        int x = 0;
+        if (((uintptr_t)out & 3) == 0) {
+            uint32_t* out32 = (uint32_t*)out;
+            for (; x + 8 <= w; x += 8) {
+                uint32_t a0 = r0[x / 4], a1 = r0[x / 4 + 1];
+                uint32_t b0 = r1[x / 4], b1 = r1[x / 4 + 1];
+                uint32_t s0 = (a0 & LO_BYTES) + ((a0 >> 8) & LO_BYTES) +
+                              (b0 & LO_BYTES) + ((b0 >> 8) & LO_BYTES) + 0x00020002;
+                uint32_t s1 = (a1 & LO_BYTES) + ((a1 >> 8) & LO_BYTES) +
+                              (b1 & LO_BYTES) + ((b1 >> 8) & LO_BYTES) + 0x00020002;
+                s0 = (s0 >> 2) & LO_BYTES;      // Outputs in bytes 0 and 2
+                s1 = (s1 >> 2) & LO_BYTES;
+                out32[x / 8] = (s0 & 0xFF) | ((s0 >> 8) & 0xFF00) |
+                               ((s1 & 0xFF) << 16) | ((s1 << 8) & 0xFF000000);
+            }
+        }
+        const uint8_t* p0 = (const uint8_t*)r0;
+        const uint8_t* p1 = (const uint8_t*)r1;
+        for (; x < w; x += 2) {
+            out[x / 2] = (p0[x] + p0[x + 1] + p1[x] + p1[x + 1] + 2) >> 2;
+        }
+    }
+}
+
+void downscale2x(const uint8_t* src, int w, int h, uint8_t* dst) {
+    if (wordAligned(src, w)) downscale2xSwar(src, w, h, dst);
+    else downscale2xScalar(src, w, h, dst);
+}
+
+void downscale4xScalar(const uint8_t* src, int w, int h, uint8_t* dst) {
+    int ow = w / 4;
+    for (int y = 0; y < h / 4; y++) {
+        uint8_t* out = dst + y * ow;
+        for (int x = 0; x < ow; x++) {
+            uint32_t sum = 0;
+            for (int r = 0; r < 4; r++) {
+                const uint8_t* p = src + (4 * y + r) * w + 4 * x;
+                sum += p[0] + p[1] + p[2] + p[3];
+            }
+            out[x] = (sum + 8) >> 4;
+        }
+    }
+}
+
+// One word per source row per output pixel; lanes folded at the end
+void downscale4xSwar(const uint8_t* src, int w, int h, uint8_t* dst) {
+    int ow = w / 4;
+    int words = w / 4;
+    for (int y = 0; y < h / 4; y++) {
+        const uint32_t* r0 = (const uint32_t*)(src + (4 * y) * w);
+        const uint32_t* r1 = r0 + words;
+        const uint32_t* r2 = r1 + words;
+        const uint32_t* r3 = r2 + words;
+        uint8_t* out = dst + y * ow;
+        for (int x = 0; x < ow; x++) {
+            uint32_t a = r0[x], b = r1[x], c = r2[x], d = r3[x];
+            uint32_t s = (a & LO_BYTES) + ((a >> 8) & LO_BYTES) +
+                         (b & LO_BYTES) + ((b >> 8) & LO_BYTES) +
+                         (c & LO_BYTES) + ((c >> 8) & LO_BYTES) +
+                         (d & LO_BYTES) + ((d >> 8) & LO_BYTES);
+            out[x] = ((s & 0xFFFF) + (s >> 16) + 8) >> 4;
+        }
+    }
+}
+
+void downscale4x(const uint8_t* src, int w, int h, uint8_t* dst) {
+    if (wordAligned(src, w)) downscale4xSwar(src, w, h, dst);
+    else downscale4xScalar(src, w, h, dst);
+}
+
+// ============================================================================
+// INTEGRAL IMAGE
+// ============================================================================
+void integralScalar(const uint8_t* src, int w, int h, uint32_t* out) {
+    int stride = w + 1;
+    memset(out, 0, stride * sizeof(uint32_t));
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = src + y * w;
+        const uint32_t* above = out + y * stride;
+        uint32_t* cur = out + (y + 1) * stride;
+        uint32_t rowSum = 0;
+        cur[0] = 0;
+        for (int x = 0; x < w; x++) {
+            rowSum += row[x];
+            cur[x + 1] = above[x + 1] + rowSum;
+        }
+    }
+}
+
+// Prefix sums don't vectorize across lanes, but one word load per 4 pixels
+// and an unrolled body save most of the load/loop overhead
+void integralPacked(const uint8_t* src, int w, int h, uint32_t* out) {
+    if (!wordAligned(src, w)) {
+        integralScalar(src, w, h, out);
+        return;
+    }
+    int stride = w + 1;
+    memset(out, 0, stride * sizeof(uint32_t));
+    for (int y = 0; y < h; y++) {
+        const uint32_t* row = (const uint32_t*)(src + y * w);
+        const uint32_t* above = out + y * stride + 1;
+        uint32_t* cur = out + (y + 1) * stride;
+        uint32_t rowSum = 0;
+        cur[0] = 0;
+        cur++;
+        for (int i = 0; i < w / 4; i++) {
+            uint32_t px = row[i];
+            rowSum += px & 0xFF;         cur[0] = above[0] + rowSum;
+            rowSum += (px >> 8) & 0xFF;  cur[1] = above[1] + rowSum;
+            rowSum += (px >> 16) & 0xFF; cur[2] = above[2] + rowSum;
+            rowSum += px >> 24;          cur[3] = above[3] + rowSum;
+            cur += 4;
+            above += 4;
+        }
+    }
+}
+
+void integral(const uint8_t* src, int w, int h, uint32_t* out) {
+    integralPacked(src, w, h, out);
+}
+
+// ============================================================================
+// ADAPTIVE BINARIZATION
+// ============================================================================
+void tileThresholds(const uint32_t* ii, int w, int h, int tile, int biasPct, uint8_t* thresholds) {
+    int stride = w + 1;
+    int tilesX = (w + tile - 1) / tile;
+    int tilesY = (h + tile - 1) / tile;
+    for (int ty = 0; ty < tilesY; ty++) {
+        int y0 = max(0, (ty - 1) * tile);
+        int y1 = min(h, (ty + 2) * tile);
+        for (int tx = 0; tx < tilesX; tx++) {
+            int x0 = max(0, (tx - 1) * tile);
+            int x1 = min(w, (tx + 2) * tile);
+            uint32_t sum = ii[y1 * stride + x1] - ii[y0 * stride + x1] -
+                           ii[y1 * stride + x0] + ii[y0 * stride + x0];
+            uint32_t area = (uint32_t)(x1 - x0) * (uint32_t)(y1 - y0);
+            uint32_t mean = sum / area;
+            thresholds[ty * tilesX + tx] = (uint8_t)(mean * (100 - biasPct) / 100);
+        }
+    }
+}
+
+void binarizeScalar(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst) {
+    int tilesX = (w + tile - 1) / tile;
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = src + y * w;
+        const uint8_t* thr = thresholds + (y / tile) * tilesX;
+        uint8_t* out = dst + y * w;
+        for (int x = 0; x < w; x++) {
+            out[x] = row[x] >= thr[x / tile] ? 255 : 0;
+        }
+    }
+}
+
+// Bytewise unsigned x >= t on 4 pixels at once:
+// low 7 bits compared via (x | 0x80) - (t & 0x7F), which cannot borrow
+// across bytes; the top bits then decide where they differ
+static inline uint32_t geMask(uint32_t x, uint32_t t) {
+    uint32_t low = (x | HIGH_BITS) - (t & ~HIGH_BITS);
+    uint32_t ge = ((x & ~t) | (~(x ^ t) & low)) & HIGH_BITS;
+    return (ge >> 7) * 0xFF;      // 0x80 → 0xFF per byte
+}
+
+void binarizeSwar(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst) {
+    if (!wordAligned(src, w) || !wordAligned(dst, w) || (tile & 3) != 0) {
+        binarizeScalar(src, w, h, thresholds, tile, dst);
+        return;
+    }
+    int tilesX = (w + tile - 1) / tile;
+    for (int y = 0; y < h; y++) {
+        const uint32_t* row = (const uint32_t*)(src + y * w);
+        const uint8_t* thr = thresholds + (y / tile) * tilesX;
+        uint32_t* out = (uint32_t*)(dst + y * w);
+        for (int tx = 0; tx < tilesX; tx++) {
+            uint32_t t = thr[tx] * 0x01010101u;
+            int end = min(w, (tx + 1) * tile) / 4;
+            for (int i = tx * tile / 4; i < end; i++) out[i] = geMask(row[i], t);
+        }
+    }
+}
+
+void binarize(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst) {
+    binarizeSwar(src, w, h, thresholds, tile, dst);
+}
+
+// ============================================================================
+// BENCHMARK
+// ============================================================================
+static void* benchAlloc(size_t bytes) {
+    void* p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+}
+
+// QR-like 8 px modules under a left-to-right illumination gradient
+static void syntheticFrame(uint8_t* img, int w, int h) {
+    uint32_t seed = 0x1234567;
+    for (int by = 0; by < h; by += 8) {
+        for (int bx = 0; bx < w; bx += 8) {
+            seed = seed * 1664525u + 1013904223u;
+            bool dark = (seed >> 24) & 1;
+            for (int y = by; y < min(h, by + 8); y++) {
+                for (int x = bx; x < min(w, bx + 8); x++) {
+                    int light = 90 + 120 * x / w;
+                    img[y * w + x] = dark ? light / 4 : light;
+                }
+            }
+        }
+    }
+}
+
+static void benchRow(const char* name, int64_t scalarUs, int64_t fastUs, int iterations, bool match) {
+    Serial.printf("[BENCH] %-12s scalar %7lld us  swar %7lld us  x%.2f  %s\n", name,
+                  (long long)(scalarUs / iterations), (long long)(fastUs / iterations),
+                  fastUs ? (float)scalarUs / (float)fastUs : 0.0f, match ? "match" : "MISMATCH");
+}
+
+#define BENCH_TIME(total, call) do {                              \
+        int64_t t0 = esp_timer_get_time();                        \
+        for (int i = 0; i < iterations; i++) { call; }            \
+        total = esp_timer_get_time() - t0;                        \
+    } while (0)
+
+void runBenchmark(int w, int h, int iterations) {
+    const int tile = 16;
+    size_t px = (size_t)w * h;
+    size_t iiBytes = (size_t)(w + 1) * (h + 1) * sizeof(uint32_t);
+    int tilesX = (w + tile - 1) / tile, tilesY = (h + tile - 1) / tile;
+
+    uint8_t* src = (uint8_t*)benchAlloc(px);
+    uint8_t* outA = (uint8_t*)benchAlloc(px);
+    uint8_t* outB = (uint8_t*)benchAlloc(px);
+    uint32_t* iiA = (uint32_t*)benchAlloc(iiBytes);
+    uint32_t* iiB = (uint32_t*)benchAlloc(iiBytes);
+    uint8_t* thr = (uint8_t*)benchAlloc(tilesX * tilesY);
+    if (!src || !outA || !outB || !iiA || !iiB || !thr) {
+        Serial.println(F("[BENCH] Not enough memory"));
+    } else {
+        syntheticFrame(src, w, h);
+        Serial.printf("[BENCH] %dx%d grayscale, %d iterations\n", w, h, iterations);
+        int64_t a, b;
+
+        BENCH_TIME(a, downscale2xScalar(src, w, h, outA));
+        BENCH_TIME(b, downscale2xSwar(src, w, h, outB));
+        benchRow("downscale2x", a, b, iterations, memcmp(outA, outB, px / 4) == 0);
+
+        BENCH_TIME(a, downscale4xScalar(src, w, h, outA));
+        BENCH_TIME(b, downscale4xSwar(src, w, h, outB));
+        benchRow("downscale4x", a, b, iterations, memcmp(outA, outB, px / 16) == 0);
+
+        BENCH_TIME(a, integralScalar(src, w, h, iiA));
+        BENCH_TIME(b, integralPacked(src, w, h, iiB));
+        benchRow("integral", a, b, iterations, memcmp(iiA, iiB, iiBytes) == 0);
+
+        tileThresholds(iiA, w, h, tile, 15, thr);
+        BENCH_TIME(a, binarizeScalar(src, w, h, thr, tile, outA));
+        BENCH_TIME(b, binarizeSwar(src, w, h, thr, tile, outB));
+        benchRow("binarize", a, b, iterations, memcmp(outA, outB, px) == 0);
+    }
+    free(src); free(outA); free(outB); free(iiA); free(iiB); free(thr);
+}
+
+}  // namespace ImageKernels
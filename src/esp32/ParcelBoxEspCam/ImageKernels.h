@@ -0,0 +1,56 @@
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// ESP32-CAM IMAGE KERNELS
+// ============================================================================
+// Grayscale (8-bit) preprocessing for the QR pipeline, each with a scalar
+// baseline and a word-packed / SWAR variant that works on 4 pixels per
+// 32-bit register:
+// - 2x / 4x box downscale (rounded mean)
+// - Integral image ((w+1) x (h+1), zero first row/column)
+// - Adaptive binarization: per-tile thresholds from the 3x3-tile mean
+//   around each tile (via the integral image), then a SWAR compare
+// The plain-named functions dispatch to the fastest variant the buffer
+// allows: SWAR needs 4-byte-aligned rows (aligned pointer, width % 4 == 0)
+// since the ESP32 faults on unaligned word loads.
+// The AI-Thinker board is an ESP32 (LX6) with no SIMD unit; an ESP32-S3 PIE
+// variant would slot into the same dispatch functions.
+// runBenchmark() times every variant on a synthetic frame and checks that
+// they produce identical output (`bench` serial command).
+// ============================================================================
+
+namespace ImageKernels {
+
+// dst is (w/2) x (h/2); w, h even
+void downscale2xScalar(const uint8_t* src, int w, int h, uint8_t* dst);
+void downscale2xSwar(const uint8_t* src, int w, int h, uint8_t* dst);
+void downscale2x(const uint8_t* src, int w, int h, uint8_t* dst);
+
+// dst is (w/4) x (h/4); w, h multiples of 4
+void downscale4xScalar(const uint8_t* src, int w, int h, uint8_t* dst);
+void downscale4xSwar(const uint8_t* src, int w, int h, uint8_t* dst);
+void downscale4x(const uint8_t* src, int w, int h, uint8_t* dst);
+
+// out holds (w+1) * (h+1) sums
+void integralScalar(const uint8_t* src, int w, int h, uint32_t* out);
+void integralPacked(const uint8_t* src, int w, int h, uint32_t* out);
+void integral(const uint8_t* src, int w, int h, uint32_t* out);
+
+// One threshold per tile x tile block (row-major, ceil(w/tile) x ceil(h/tile)):
+// mean of the surrounding 3x3 tiles, lowered by biasPct percent
+void tileThresholds(const uint32_t* integral, int w, int h, int tile, int biasPct, uint8_t* thresholds);
+
+// dst = 255 where src >= its tile threshold, else 0. tile must be a multiple of 4.
+void binarizeScalar(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst);
+void binarizeSwar(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst);
+void binarize(const uint8_t* src, int w, int h, const uint8_t* thresholds, int tile, uint8_t* dst);
+
+// Scalar vs SWAR timings and output check on a w x h synthetic frame
+void runBenchmark(int w, int h, int iterations);
+
+}  // namespace ImageKernels
+
+#endif // IMAGE_KERNELS_H
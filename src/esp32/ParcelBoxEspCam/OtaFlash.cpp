@@ -0,0 +1,146 @@
+#include "OtaFlash.h"
+
+// ============================================================================
+// OTA FLASH IMPLEMENTATION
+// ============================================================================
+
+OtaFlash::OtaFlash()
+    : running(nullptr), target(nullptr), handle(0), block(nullptr), blockStart(0), blockFill(0),
+      lastError("") {
+    mbedtls_sha256_init(&sha);
+}
+
+OtaFlash::~OtaFlash() {
+    abort();
+    mbedtls_sha256_free(&sha);
+}
+
+bool OtaFlash::baseMatches(uint32_t size, uint32_t crc) {
+    if (size == 0) return true;
+    const esp_partition_t* part = esp_ota_get_running_partition();
+    if (!part || size > part->size) return false;
+    uint8_t buf[512];
+    uint32_t sum = 0;
+    for (uint32_t off = 0; off < size; off += sizeof(buf)) {
+        size_t n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+        if (esp_partition_read(part, off, buf, n) != ESP_OK) return false;
+        sum = DeltaPatch::crc32(sum, buf, n);
+    }
+    return sum == crc;
+}
+
+bool OtaFlash::hmac(const char* key, const uint8_t* data, size_t len, uint8_t out[32]) {
+    return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*)key,
+                           strlen(key), data, len, out) == 0;
+}
+
+bool OtaFlash::begin(uint32_t imageSize) {
+    abort();
+    running = esp_ota_get_running_partition();
+    target = esp_ota_get_next_update_partition(nullptr);
+    if (!running || !target) {
+        lastError = "no OTA partition";
+        return false;
+    }
+    if (imageSize > target->size) {
+        lastError = "image larger than partition";
+        return false;
+    }
+    block = (uint8_t*)malloc(OTA_FLASH_BLOCK);
+    if (!block) {
+        lastError = "no block buffer";
+        return false;
+    }
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK) {
+        handle = 0;
+        release();
+        lastError = "esp_ota_begin failed";
+        return false;
+    }
+    blockStart = 0;
+    blockFill = 0;
+    mbedtls_sha256_starts(&sha, 0);
+    lastError = "";
+    return true;
+}
+
+bool OtaFlash::readOld(uint32_t offset, uint8_t* out, size_t len) {
+    return running && esp_partition_read(running, offset, out, len) == ESP_OK;
+}
+
+bool OtaFlash::readNew(uint32_t offset, uint8_t* out, size_t len) {
+    if (!handle || offset + len > blockStart + blockFill) return false;
+    if (offset < blockStart) {
+        // Older part is in flash already
+        size_t n = blockStart - offset < len ? blockStart - offset : len;
+        if (esp_partition_read(target, offset, out, n) != ESP_OK) return false;
+        offset += n;
+        out += n;
+        len -= n;
+    }
+    memcpy(out, block + (offset - blockStart), len);
+    return true;
+}
+
+bool OtaFlash::write(const uint8_t* data, size_t len) {
+    if (!handle) return false;
+    mbedtls_sha256_update(&sha, data, len);
+    while (len) {
+        size_t n = OTA_FLASH_BLOCK - blockFill;
+        if (n > len) n = len;
+        memcpy(block + blockFill, data, n);
+        blockFill += n;
+        data += n;
+        len -= n;
+        if (blockFill == OTA_FLASH_BLOCK && !flush()) return false;
+    }
+    return true;
+}
+
+bool OtaFlash::flush() {
+    if (blockFill && esp_ota_write(handle, block, blockFill) != ESP_OK) {
+        lastError = "flash write failed";
+        return false;
+    }
+    blockStart += blockFill;
+    blockFill = 0;
+    return true;
+}
+
+bool OtaFlash::finish(const uint8_t expected[32]) {
+    if (!handle) return false;
+    uint8_t digest[32];
+    bool ok = flush();
+    mbedtls_sha256_finish(&sha, digest);
+    if (ok && memcmp(digest, expected, sizeof(digest)) != 0) {
+        lastError = "SHA-256 mismatch";
+        ok = false;
+    }
+    if (!ok) {
+        abort();
+        return false;
+    }
+    esp_err_t err = esp_ota_end(handle);
+    handle = 0;
+    release();
+    if (err != ESP_OK) {
+        lastError = err == ESP_ERR_OTA_VALIDATE_FAILED ? "image check failed" : "esp_ota_end failed";
+        return false;
+    }
+    if (esp_ota_set_boot_partition(target) != ESP_OK) {
+        lastError = "set boot partition failed";
+        return false;
+    }
+    return true;
+}
+
+void OtaFlash::abort() {
+    if (handle) esp_ota_abort(handle);
+    handle = 0;
+    release();
+}
+
+void OtaFlash::release() {
+    free(block);
+    block = nullptr;
+}
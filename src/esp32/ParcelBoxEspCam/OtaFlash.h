@@ -0,0 +1,72 @@
+#ifndef OTA_FLASH_H
+#define OTA_FLASH_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/md.h>
+#include <mbedtls/sha256.h>
+#include "DeltaPatch.h"
+
+// ============================================================================
+// OTA FLASH - Smart Parcel Locker
+// ============================================================================
+// Copy of ParcelBoxEsp/OtaFlash.h: each sketch builds only its own folder.
+// Keep them in step.
+// DeltaIo on the OTA partitions, for DeltaPatch:
+// - readOld() reads the running partition; baseMatches() checks its first
+//   oldSize bytes against the delta's base CRC before anything is written
+// - write() fills one OTA_FLASH_BLOCK buffer and hands full blocks to
+//   esp_ota_write(); readNew() takes back-references from that buffer or
+//   the inactive partition, so the image never sits in RAM whole
+// - esp_ota_begin() uses sequential writes: sectors are erased as the
+//   image reaches them, not in one long erase that stalls flash for
+//   seconds while the board is serving scans
+// - finish(): SHA-256 of everything written against the expected one,
+//   esp_ota_end() (image format and its own hash), then the boot partition.
+//   The restart is left to the caller.
+// - hmac() tags and checks relayed START frames (ESPNOW_OtaFrame_t.auth)
+
+#define OTA_FLASH_BLOCK         4096
+
+class OtaFlash : public DeltaIo {
+public:
+    OtaFlash();
+    ~OtaFlash();
+
+    // CRC-32 of the running image's first size bytes is crc; size 0 = any
+    static bool baseMatches(uint32_t size, uint32_t crc);
+
+    // HMAC-SHA256 of data under the NUL-terminated key
+    static bool hmac(const char* key, const uint8_t* data, size_t len, uint8_t out[32]);
+
+    // Next OTA partition, for an image of imageSize bytes
+    bool begin(uint32_t imageSize);
+
+    bool readOld(uint32_t offset, uint8_t* out, size_t len) override;
+    bool readNew(uint32_t offset, uint8_t* out, size_t len) override;
+    bool write(const uint8_t* data, size_t len) override;
+
+    // Last block, SHA-256 == sha256, image check, boot partition
+    bool finish(const uint8_t sha256[32]);
+    void abort();
+
+    bool active() const { return handle != 0; }
+    uint32_t written() const { return blockStart + blockFill; }
+    const char* error() const { return lastError; }
+
+private:
+    const esp_partition_t* running;
+    const esp_partition_t* target;
+    esp_ota_handle_t handle;
+    uint8_t* block;
+    uint32_t blockStart;        // Image offset of block[0]
+    uint32_t blockFill;
+    mbedtls_sha256_context sha;
+    const char* lastError;
+
+    bool flush();
+    void release();
+};
+
+#endif // OTA_FLASH_H
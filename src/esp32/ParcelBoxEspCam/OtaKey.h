@@ -0,0 +1,32 @@
+#ifndef OTA_KEY_H
+#define OTA_KEY_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// OTA KEY - Smart Parcel Locker
+// ============================================================================
+// Copy of ParcelBoxEsp/OtaKey.h: each sketch builds only its own folder;
+// keep them in step.
+// Shared secret for relayed camera updates: the main board tags each START
+// with an HMAC under it, and the CAM drops a START without a matching tag.
+// DO NOT COMMIT OtaKey.cpp TO PUBLIC REPOSITORY
+// Copy OtaKey.cpp.template to OtaKey.cpp in both sketches, with the same key.
+// While the placeholder (or a key shorter than OTA_KEY_MIN_LEN) is in place
+// the main board relays no camera update and the CAM refuses every START.
+
+#define OTA_KEY_PLACEHOLDER     "YOUR_OTA_KEY_HERE"
+#define OTA_KEY_MIN_LEN         16
+
+class ParcelBoxOtaKey {
+public:
+  static const char* getKey();
+
+  // A real key replaced the placeholder
+  static bool isSet() {
+    const char* key = getKey();
+    return key && strlen(key) >= OTA_KEY_MIN_LEN && strcmp(key, OTA_KEY_PLACEHOLDER) != 0;
+  }
+};
+
+#endif // OTA_KEY_H
@@ -0,0 +1,285 @@
+#include "OtaReceiver.h"
+#include <esp_now.h>
+#include <esp_ota_ops.h>
+#include <esp_timer.h>
+
+// ============================================================================
+// ESP32-CAM FIRMWARE UPDATE IMPLEMENTATION
+// ============================================================================
+
+// START's auth against the OTA key, compared in constant time. No key set:
+// nothing is authentic.
+static bool startTagged(const ESPNOW_OtaFrame_t* f) {
+    uint8_t tag[32];
+    if (!ParcelBoxOtaKey::isSet()) return false;
+    if (!OtaFlash::hmac(ParcelBoxOtaKey::getKey(), (const uint8_t*)f, offsetof(ESPNOW_OtaFrame_t, auth), tag)) return false;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(tag); i++) diff |= tag[i] ^ f->auth[i];
+    return diff == 0;
+}
+
+OtaReceiver::OtaReceiver()
+    : version(""), bootConfirmed(false), restartDue(false), queue(nullptr),
+      mux(portMUX_INITIALIZER_UNLOCKED), task(nullptr), id(0), startPending(false), infoDue(false),
+      readyDue(false), endDue(false), resendDue(false), gapAcked(false), expected(0), lastHeardAt(0),
+      stackLowest(0), chunks(0), bytesIn(0), readyResult(ESPNOW_OTA_OK), doneResult(0xFF), updates(0),
+      failures(0), chunksQueued(0), gaps(0), queueFull(0), untagged(0), lastBytes(0), lastMs(0), lastError("") {
+    memset(mainEspMac, 0, sizeof(mainEspMac));
+    memset(&startFrame, 0, sizeof(startFrame));
+    memset(&job, 0, sizeof(job));
+}
+
+void OtaReceiver::begin(const uint8_t* mac, const char* running) {
+    memcpy(mainEspMac, mac, sizeof(mainEspMac));
+    version = running;
+}
+
+// ============================================================================
+// FRAMES (WiFi task)
+// ============================================================================
+void OtaReceiver::onFrame(const uint8_t* data, int len) {
+    if (len < (int)sizeof(ESPNOW_Header_t)) return;
+    const ESPNOW_Header_t* hdr = (const ESPNOW_Header_t*)data;
+
+    if (hdr->status == ESPNOW_OTA_CHUNK) {
+        size_t n = len - sizeof(ESPNOW_Header_t);
+        portENTER_CRITICAL(&mux);
+        bool mine = task && hdr->session == id;
+        uint16_t want = expected;
+        portEXIT_CRITICAL(&mux);
+        if (!mine || n == 0 || n > ESPNOW_OTA_CHUNK_BYTES) return;
+        lastHeardAt = millis();
+
+        if (hdr->seq == want) {
+            OtaChunk c;
+            c.seq = hdr->seq;
+            c.len = (uint8_t)n;
+            memcpy(c.data, data + sizeof(ESPNOW_Header_t), n);
+            if (xQueueSend(queue, &c, 0) == pdTRUE) {
+                portENTER_CRITICAL(&mux);
+                expected = want + 1;
+                gapAcked = false;
+                portEXIT_CRITICAL(&mux);
+                chunksQueued++;
+                return;
+            }
+            queueFull++;        // Dropped: resent from here like a gap
+        }
+        bool ask;
+        portENTER_CRITICAL(&mux);
+        if ((int16_t)(hdr->seq - want) >= 0) {
+            ask = !gapAcked;    // Once per lost chunk, not for every one behind it
+            gapAcked = true;
+        } else {
+            ask = (hdr->seq + 1) % ESPNOW_OTA_WINDOW == 0;  // Window resent: our ACK was lost
+        }
+        if (ask) resendDue = true;
+        TaskHandle_t t = task;
+        portEXIT_CRITICAL(&mux);
+        if (ask && hdr->seq != want) gaps++;
+        if (ask && t) xTaskNotifyGive(t);
+        return;
+    }
+
+    if (len != sizeof(ESPNOW_OtaFrame_t)) return;
+    if (hdr->status == ESPNOW_OTA_START && !startTagged((const ESPNOW_OtaFrame_t*)data)) {
+        untagged++;
+        return;
+    }
+    bool wake = false;
+    portENTER_CRITICAL(&mux);
+    if (hdr->status == ESPNOW_OTA_QUERY) {
+        infoDue = true;
+    } else if (hdr->status == ESPNOW_OTA_START && hdr->session == id) {
+        readyDue = true;        // Retry of the START in hand
+        wake = true;
+    } else if (hdr->status == ESPNOW_OTA_START && !task) {
+        memcpy(&startFrame, data, sizeof(startFrame));
+        id = hdr->session;
+        startPending = true;
+        expected = 0;
+        gapAcked = false;
+        readyDue = endDue = resendDue = false;
+        lastHeardAt = millis();
+    } else if (hdr->status == ESPNOW_OTA_END && hdr->session == id) {
+        endDue = true;
+        wake = true;
+    }
+    if (wake) lastHeardAt = millis();
+    TaskHandle_t t = task;
+    portEXIT_CRITICAL(&mux);
+    if (wake && t) xTaskNotifyGive(t);
+}
+
+void OtaReceiver::service() {
+    portENTER_CRITICAL(&mux);
+    bool info = infoDue;
+    infoDue = false;
+    bool start = startPending && !task;
+    portEXIT_CRITICAL(&mux);
+
+    if (info) {
+        sendReply(ESPNOW_OTA_INFO, 0, ESPNOW_OTA_OK);
+        if (!bootConfirmed) {       // The main board is reached: keep this image
+            bootConfirmed = true;
+            esp_ota_img_states_t imgState;
+            if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &imgState) == ESP_OK &&
+                imgState == ESP_OTA_IMG_PENDING_VERIFY) {
+                esp_ota_mark_app_valid_cancel_rollback();
+                Serial.printf("[OTA] Firmware %s confirmed\n", version);
+            }
+        }
+    }
+    if (!start) return;
+    if (!queue) queue = xQueueCreate(OTA_RX_QUEUE_LEN, sizeof(OtaChunk));
+    // The handle is stored before the task first runs
+    if (!queue || xTaskCreatePinnedToCore(taskEntry, "ota", OTA_RX_TASK_STACK, this,
+                                          OTA_RX_TASK_PRIORITY, &task, OTA_RX_TASK_CORE) != pdPASS) {
+        portENTER_CRITICAL(&mux);
+        startPending = false;       // The main board's retries find READY missing and give up
+        portEXIT_CRITICAL(&mux);
+        failures++;
+        lastError = "no task";
+        Serial.println(F("[OTA] Task FAILED"));
+    }
+}
+
+// ============================================================================
+// UPDATE (OTA task)
+// ============================================================================
+void OtaReceiver::taskEntry(void* arg) {
+    static_cast<OtaReceiver*>(arg)->run();
+    vTaskDelete(nullptr);
+}
+
+void OtaReceiver::run() {
+    int64_t startUs = esp_timer_get_time();
+    portENTER_CRITICAL(&mux);
+    memcpy(&job, &startFrame, sizeof(job));
+    startPending = false;
+    portEXIT_CRITICAL(&mux);
+
+    xQueueReset(queue);
+    uint32_t chunkCount = (job.bytes + ESPNOW_OTA_CHUNK_BYTES - 1) / ESPNOW_OTA_CHUNK_BYTES;
+    chunks = (uint16_t)chunkCount;
+    bytesIn = 0;
+    doneResult = 0xFF;
+    readyResult = ESPNOW_OTA_OK;
+    lastError = "";
+    if (job.bytes <= DELTA_HEADER_BYTES || chunkCount > 0xFFFF) {
+        readyResult = ESPNOW_OTA_VERIFY;
+        lastError = "bad START";
+    } else if (!OtaFlash::baseMatches(job.oldSize, job.oldCrc)) {
+        readyResult = ESPNOW_OTA_BASE;
+        lastError = "not the delta's base";
+    } else if (!flash.begin(job.newSize)) {
+        readyResult = ESPNOW_OTA_FLASH;
+        lastError = flash.error();
+    }
+    patch.begin(&flash);
+    if (readyResult != ESPNOW_OTA_OK) doneResult = readyResult;
+    sendReply(ESPNOW_OTA_READY, 0, readyResult);
+    Serial.printf("[OTA] Update to %.*s: %u byte delta, %s\n", ESPNOW_OTA_VERSION_LEN, job.version,
+                  (unsigned)job.bytes, readyResult == ESPNOW_OTA_OK ? "receiving" : lastError);
+
+    uint16_t written = 0;
+    while (true) {
+        OtaChunk c;
+        while (xQueueReceive(queue, &c, 0) == pdTRUE) {
+            if (doneResult != 0xFF) continue;       // Failed or finished: drain
+            DeltaResult r = patch.feed(c.data, c.len);
+            bytesIn += c.len;
+            written = c.seq + 1;
+            if (r != DELTA_OK) {
+                doneResult = r == DELTA_IO ? ESPNOW_OTA_FLASH : ESPNOW_OTA_VERIFY;
+                lastError = r == DELTA_IO && flash.error()[0] ? flash.error() : DeltaPatch::resultName(r);
+                flash.abort();
+                sendReply(ESPNOW_OTA_DONE, written, doneResult);    // Stops the relay now
+                continue;
+            }
+            if (written % ESPNOW_OTA_WINDOW == 0 || written == chunks) sendReply(ESPNOW_OTA_ACK, written, 0);
+        }
+
+        portENTER_CRITICAL(&mux);
+        bool ready = readyDue;
+        bool resend = resendDue;
+        bool end = endDue;
+        uint16_t next = expected;
+        unsigned long heard = lastHeardAt;
+        readyDue = resendDue = endDue = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (ready) sendReply(ESPNOW_OTA_READY, 0, readyResult);
+        if (resend && doneResult == 0xFF) sendReply(ESPNOW_OTA_ACK, next, ESPNOW_OTA_RESEND);
+        if (end) {
+            if (doneResult == 0xFF && written == chunks && bytesIn == job.bytes) doneResult = verify();
+            if (doneResult != 0xFF) {
+                sendReply(ESPNOW_OTA_DONE, written, doneResult);
+            } else if (next < chunks) {
+                sendReply(ESPNOW_OTA_ACK, next, ESPNOW_OTA_RESEND);     // Tail lost
+            }
+        }
+        if (millis() - heard >= (doneResult != 0xFF ? OTA_RX_LINGER_MS : OTA_RX_SILENCE_MS)) break;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_RX_POLL_MS));
+    }
+
+    flash.abort();      // No-op once finished
+    bool ok = doneResult == ESPNOW_OTA_OK;
+    if (ok) {
+        updates++;
+        lastBytes = bytesIn;
+        lastMs = (uint32_t)((esp_timer_get_time() - startUs) / 1000);
+        Serial.printf("[OTA] %.*s set to boot (%u ms), restart when idle\n", ESPNOW_OTA_VERSION_LEN,
+                      job.version, (unsigned)lastMs);
+    } else {
+        failures++;
+        if (doneResult == 0xFF) lastError = "main board went silent";
+        Serial.printf("[OTA] Update failed: %s\n", lastError);
+    }
+    uint32_t stack = uxTaskGetStackHighWaterMark(nullptr);
+    portENTER_CRITICAL(&mux);
+    task = nullptr;
+    if (!stackLowest || stack < stackLowest) stackLowest = stack;
+    portEXIT_CRITICAL(&mux);
+    if (ok) restartDue = true;
+}
+
+// Stream complete: delta CRC, then SHA-256 and image check in OtaFlash
+uint8_t OtaReceiver::verify() {
+    DeltaResult r = patch.finish();
+    if (r != DELTA_OK) {
+        lastError = DeltaPatch::resultName(r);
+        flash.abort();
+        return ESPNOW_OTA_VERIFY;
+    }
+    if (!flash.finish(job.sha256)) {
+        lastError = flash.error();
+        return ESPNOW_OTA_VERIFY;
+    }
+    return ESPNOW_OTA_OK;
+}
+
+// A full radio queue is waited out rather than counted as loss
+void OtaReceiver::sendReply(uint8_t status, uint16_t seq, uint8_t result) {
+    ESPNOW_OtaFrame_t f = {};
+    f.hdr.magic = ESPNOW_MAGIC;
+    f.hdr.type = MSG_TYPE_OTA;
+    f.hdr.seq = seq;
+    f.hdr.session = status == ESPNOW_OTA_INFO ? 0 : id;
+    f.hdr.status = status;
+    f.result = result;
+    strlcpy(f.version, version, sizeof(f.version));
+    f.bytes = bytesIn;
+    while (esp_now_send(mainEspMac, (const uint8_t*)&f, sizeof(f)) == ESP_ERR_ESPNOW_NO_MEM) vTaskDelay(1);
+}
+
+void OtaReceiver::printStats() {
+    Serial.printf("[OTA] %s %s | updates %u, failed %u, chunks %u, gaps %u, queue full %u, untagged %u\n",
+                  version, busy() ? "receiving" : "idle", (unsigned)updates, (unsigned)failures,
+                  (unsigned)chunksQueued, (unsigned)gaps, (unsigned)queueFull, (unsigned)untagged);
+    if (busy()) Serial.printf("[OTA] %u/%u delta bytes written\n", (unsigned)bytesIn, (unsigned)job.bytes);
+    if (updates) Serial.printf("[OTA] Last: %u byte delta in %u ms\n", (unsigned)lastBytes, (unsigned)lastMs);
+    if (failures) Serial.printf("[OTA] Last failure: %s\n", lastError);
+    if (restartDue) Serial.println(F("[OTA] New image set to boot, restart when idle"));
+    if (!ParcelBoxOtaKey::isSet()) Serial.println(F("[OTA] No OTA key (OtaKey.cpp) - every START refused"));
+}
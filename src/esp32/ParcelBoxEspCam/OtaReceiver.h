@@ -0,0 +1,123 @@
+#ifndef OTA_RECEIVER_H
+#define OTA_RECEIVER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "EspNowCamera.h"
+#include "DeltaPatch.h"
+#include "OtaFlash.h"
+#include "OtaKey.h"
+
+// ============================================================================
+// ESP32-CAM FIRMWARE UPDATES
+// ============================================================================
+// Receiving end of the main board's relayed updates (MSG_TYPE_OTA in
+// EspNowCamera.h):
+// - QUERY is answered with this build's version (INFO) from the loop
+// - Frames come only from the main board's MAC (EspNowCamera). START must
+//   carry a valid HMAC under the OTA key (OtaKey.h), else it is dropped: the
+//   SHA-256 it brings is what the image is checked against before boot.
+// - START is checked against the running image (the delta's base CRC) and
+//   opens the inactive partition; READY carries the outcome
+// - The WiFi task only queues the next chunk in order; anything else is a
+//   gap or a resend, answered once with an ACK that says where to resume.
+//   A full queue counts as a gap, never blocks the radio.
+// - A short-lived task on core 0 feeds the chunks through DeltaPatch into
+//   OtaFlash and ACKs every window once it is in flash. On END with every
+//   byte written it checks the image (CRC, SHA-256, esp_ota_end) and sets
+//   it to boot; DONE carries the outcome and is repeated for every END.
+// - The task ends after OTA_RX_SILENCE_MS without the main board (update
+//   abandoned, partition left alone) or OTA_RX_LINGER_MS after DONE. Then
+//   rebootDue() asks the loop to restart once the pipeline is idle.
+// - The first QUERY after an update marks the new image valid (rollback
+//   needs it enabled in the bootloader).
+// Needs a partition scheme with two app slots ("Minimal SPIFFS ... with
+// OTA"); without one START gets ESPNOW_OTA_FLASH.
+// ============================================================================
+
+#define OTA_RX_QUEUE_LEN        ESPNOW_OTA_INFLIGHT
+#define OTA_RX_SILENCE_MS       60000   // Outlasts a main board download stall and its resume
+#define OTA_RX_LINGER_MS        2000    // Repeated ENDs still get DONE
+#define OTA_RX_POLL_MS          20
+#define OTA_RX_TASK_STACK       (6 * 1024)
+#define OTA_RX_TASK_PRIORITY    1       // Below the QR pipeline and onQrCode
+#define OTA_RX_TASK_CORE        0       // Away from the pipeline on core 1
+
+struct OtaChunk {
+  uint16_t seq;
+  uint8_t len;
+  uint8_t data[ESPNOW_OTA_CHUNK_BYTES];
+};
+
+class OtaReceiver {
+public:
+  OtaReceiver();
+
+  // Main board to answer and the version this build reports
+  void begin(const uint8_t* mainEspMac, const char* version);
+
+  // WiFi task: a MSG_TYPE_OTA frame from the main board
+  void onFrame(const uint8_t* data, int len);
+
+  // Loop: INFO replies, and the task for a START that found none running
+  void service();
+
+  bool busy() const { return task != nullptr; }
+  bool rebootDue() const { return restartDue; }
+
+  // Lowest stack high-water mark of an update task that ended, bytes (0 = none)
+  uint32_t stackFree() const { return stackLowest; }
+
+  void printStats();
+
+private:
+  uint8_t mainEspMac[6];
+  const char* version;
+  bool bootConfirmed;
+  volatile bool restartDue;
+  QueueHandle_t queue;          // Created with the first update
+
+  // Shared with the WiFi task (guarded by mux)
+  portMUX_TYPE mux;
+  TaskHandle_t task;
+  ESPNOW_OtaFrame_t startFrame;
+  uint32_t id;                  // Update in hand, 0 = none
+  bool startPending;
+  bool infoDue;
+  bool readyDue;                // START repeated: READY was lost
+  bool endDue;                  // END received since the task last looked
+  bool resendDue;
+  bool gapAcked;                // Only one RESEND per lost chunk
+  uint16_t expected;            // Next chunk to queue
+  unsigned long lastHeardAt;
+  uint32_t stackLowest;
+
+  // Task
+  ESPNOW_OtaFrame_t job;        // START of the update in hand
+  DeltaPatch patch;
+  OtaFlash flash;
+  uint16_t chunks;              // Of this delta
+  uint32_t bytesIn;             // Delta bytes fed
+  uint8_t readyResult;
+  uint8_t doneResult;           // 0xFF until the image is checked
+
+  // Statistics
+  uint32_t updates;
+  uint32_t failures;
+  uint32_t chunksQueued;
+  uint32_t gaps;
+  uint32_t queueFull;
+  uint32_t untagged;             // START frames with a bad HMAC
+  uint32_t lastBytes;
+  uint32_t lastMs;
+  const char* lastError;
+
+  static void taskEntry(void* arg);
+  void run();
+  uint8_t verify();
+  void sendReply(uint8_t status, uint16_t seq, uint8_t result);
+};
+
+#endif // OTA_RECEIVER_H
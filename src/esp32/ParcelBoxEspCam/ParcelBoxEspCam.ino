@@ -8,15 +8,20 @@
  * Sends scanned QR codes wirelessly to Main ESP32
  *
  * Libraries:
- * - ESP32QRCodeReader (by Alois Zingl)
+ * - ESP32QRCodeReader (by Alois Zingl) — its bundled quirc decoder
  * - ESP32 Board Package
  */
 
 #include <Arduino.h>
-#include <ESP32QRCodeReader.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
 #include "WiFiManagerCustom.h"
+#include "EspNowCamera.h"
+#include "CamMetrics.h"
+#include "QrPipeline.h"
+#include "ImageKernels.h"
+#include "SnapshotRing.h"
+#include "OtaReceiver.h"
 
 // ============================================================================
 // CONFIGURATION
@@ -25,56 +30,49 @@
 // Main ESP32 MAC Address (Receiver)
 uint8_t receiverMac[] = { 0xB0, 0xCB, 0xD8, 0x03, 0xD6, 0xA4 };  // B0:CB:D8:03:D6:A4
 
+// Reported to the main board, which compares it with config/ota
+#define FIRMWARE_VERSION "2.0.0"
+
 // Built-in LED for visual feedback
 #define LED_PIN 33
 
-// WiFi channel lock — MUST match Main ESP32's WiFi channel
-// Find main ESP32 channel with: Serial.println(WiFi.channel());
-#define ESPNOW_FIXED_CHANNEL 1  // Set this to your main ESP32's WiFi channel
-
-// ============================================================================
-// ESP-NOW QR PACKET STRUCTURE — MUST match ESPNOW_CONFIG.h on Main ESP32
-// ============================================================================
-typedef struct __attribute__((packed)) {
-  char qrData[32];     // QR payload (parcelId)
-  uint32_t timestamp;  // Scan timestamp (millis)
-  uint8_t camMac[6];   // ESP32-CAM MAC address
-} ESPNOW_QRPacket_t;
+// First channel tried when not associated. The Main ESP32's channel follows
+// its AP; EspNowCamera probes the other channels until it answers.
+#define ESPNOW_START_CHANNEL 1
 
 // ============================================================================
 // GLOBAL OBJECTS
 // ============================================================================
-ESP32QRCodeReader reader(CAMERA_MODEL_AI_THINKER);
-ESPNOW_QRPacket_t packet;
+QrPipeline qrPipeline;   // Capture → finder scan → ROI decode (QrPipeline.h)
 WiFiManagerCustom wifiManager;
 
-// Debounce control
+// Sequenced, ACKed sender (packet layout in EspNowCamera.h)
+EspNowCamera espNow;
+
+// Recent frames for the main board's breach snapshots (SnapshotRing.h)
+SnapshotRing snapshots;
+
+// Firmware updates relayed by the main board (OtaReceiver.h)
+OtaReceiver otaReceiver;
+
+// Heap / PSRAM / stack / loop-time telemetry, sent to the Main ESP32
+CamMetrics metrics;
+const unsigned long METRICS_INTERVAL_MS = 30000;
+
+// Same-QR hold suppression: a code left in front of the camera is read many
+// times a second. Different parcels are never throttled.
 unsigned long lastScanTime = 0;
-const unsigned long SCAN_COOLDOWN_MS = 3000;  // 3 second debounce
+const unsigned long SCAN_COOLDOWN_MS = 3000;
 char lastQrSent[32] = "";
 
-// Last scan result from QR reader (persisted across task calls)
-String lastQrPayload = "";
 unsigned long lastInvalidPrint = 0;
 const unsigned long INVALID_PRINT_COOLDOWN = 5000;  // Only print [QR] Invalid once per 5s
 
-// ESP-NOW peer handle
-esp_now_peer_info_t peerInfo;
-
-// ACK tracking — the Main ESP32 can send back an EspNowMessage ACK
-// For simplicity, we use send callback as ACK confirmation
-bool lastSendSucceeded = true;
-
 // ============================================================================
 // FUNCTION DECLARATIONS
 // ============================================================================
 void setupEspNow();
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-void onEspNowSent(const wifi_tx_info_t *wifi_tx_info, esp_now_send_status_t status);
-#else
-void onEspNowSent(const uint8_t *mac_addr, esp_now_send_status_t status);
-#endif
-void sendQrCode(const char *qrPayload);
+void sendQrCode(const char *qrPayload, int64_t decodeUs);
 void onQrCodeTask(void *pvParameters);
 void blinkLed(int count, int duration);
 
@@ -85,7 +83,7 @@ void setup() {
   Serial.begin(115200);
   Serial.println();
   Serial.println("========================================");
-  Serial.println("ParcelBox ESP32-CAM QR Scanner v2.0");
+  Serial.println("ParcelBox ESP32-CAM QR Scanner v" FIRMWARE_VERSION);
   Serial.println("========================================");
 
   // Initialize LED
@@ -100,16 +98,22 @@ void setup() {
     Serial.println("[SETUP] Enable PSRAM in Tools -> Board Settings");
   }
 
-  // Initialize QR Code Reader
+  // Initialize camera + QR decode pipeline
   Serial.println(F("[SETUP] Initializing camera..."));
-  if (reader.setup()) {
+  if (qrPipeline.begin()) {
     Serial.println(F("[SETUP] Camera OK"));
   } else {
     Serial.println(F("[SETUP] ERROR: Camera init FAILED"));
   }
 
-  reader.beginOnCore(1);
-  Serial.println(F("[SETUP] QR reader on Core 1"));
+  // Flash LED as illuminator: full brightness (0-255) only while the
+  // pipeline is decoding; off while it idles on an empty scene
+  ledcAttach(4, 5000, 8);
+  qrPipeline.setIlluminator(4, 255);
+
+  qrPipeline.setSnapshots(&snapshots);
+  qrPipeline.startOnCore(1, 5);
+  Serial.println(F("[SETUP] QR pipeline on Core 1"));
 
   // Connect to WiFi
   Serial.println(F("[SETUP] Starting WiFi..."));
@@ -124,11 +128,6 @@ void setup() {
   Serial.println(F("[SETUP] Initializing ESP-NOW..."));
   setupEspNow();
 
-  ledcAttach(4, 5000, 8);
-
-  // Full brightness (0-255)
-  ledcWrite(4, 255);
-
   // Success indication
   blinkLed(3, 100);
   Serial.println(F("[SETUP] Ready - scanning for QR codes"));
@@ -137,16 +136,36 @@ void setup() {
   Serial.println("========================================");
 
   // Start QR processing task
-  xTaskCreate(onQrCodeTask, "onQrCode", 6 * 1024, NULL, 4, NULL);
+  TaskHandle_t qrTask = NULL;
+  xTaskCreate(onQrCodeTask, "onQrCode", 6 * 1024, NULL, 4, &qrTask);
+  metrics.begin(xTaskGetCurrentTaskHandle(), qrTask, qrPipeline.taskHandle(), &snapshots, &otaReceiver);
 }
 
 // ============================================================================
 // LOOP (non-blocking)
 // ============================================================================
 void loop() {
+  metrics.loopBegin();
+
   // Maintain WiFi connection — reconnects when dropped
   wifiManager.reconnect();
 
+  // ESP-NOW: send / retransmit / complete queued scans
+  switch (espNow.service()) {
+    case ESPNOW_TX_ACKED:  blinkLed(1, 50); break;
+    case ESPNOW_TX_FAILED: blinkLed(3, 100); break;
+    default: break;
+  }
+  snapshots.service();
+  otaReceiver.service();
+
+  // New firmware set to boot: restart between scans
+  if (otaReceiver.rebootDue() && qrPipeline.idle()) {
+    Serial.println(F("[OTA] Restarting into the new firmware"));
+    delay(100);
+    ESP.restart();
+  }
+
   // Print heartbeat every 60s
   static unsigned long lastHeartbeat = 0;
   if (millis() - lastHeartbeat > 60000) {
@@ -154,7 +173,35 @@ void loop() {
     Serial.print("[HEARTBEAT] UP ");
     Serial.print(millis() / 1000);
     Serial.println("s");
+    espNow.printStatus();
+    qrPipeline.printStatus();
+  }
+
+  // Health snapshot to the Main ESP32 (published with its heartbeat)
+  static unsigned long lastMetrics = 0;
+  if (millis() - lastMetrics > METRICS_INTERVAL_MS) {
+    lastMetrics = millis();
+    ESPNOW_BoardMetrics_t snapshot;
+    metrics.sample(snapshot);
+    espNow.sendStatus(snapshot);
+  }
+
+  // Serial: `metrics` prints the local snapshot, `bench` times the image
+  // kernels (blocks this loop for about a second), `linkbench` shows the
+  // ESP-NOW bench responder (runs are started from the main board),
+  // `snapshot` the breach snapshot ring and sender, `ota` firmware updates
+  if (Serial.available()) {
+    char line[16];
+    size_t n = Serial.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    while (n > 0 && isspace((unsigned char)line[n - 1])) line[--n] = '\0';
+    if (strcmp(line, "metrics") == 0) metrics.print();
+    else if (strcmp(line, "bench") == 0) ImageKernels::runBenchmark(320, 240, 10);
+    else if (strcmp(line, "linkbench") == 0) espNow.printBench();
+    else if (strcmp(line, "snapshot") == 0) snapshots.printStats();
+    else if (strcmp(line, "ota") == 0) otaReceiver.printStats();
   }
+  metrics.loopEnd();
 
   // No delay! WiFi handling and task scheduler run freely.
   delay(10);  // Small yield for watchdog
@@ -169,37 +216,22 @@ void setupEspNow() {
 
   WiFi.mode(WIFI_STA);
 
-  // CRITICAL: Lock WiFi channel to match Main ESP32
-  // ESP-NOW only works when both devices are on the same channel
-  wifi_promiscuous_filter_t filter = { .filter_mask = WIFI_PROMIS_FILTER_MASK_ALL };
-  esp_wifi_set_promiscuous(true);
-  esp_wifi_set_channel(ESPNOW_FIXED_CHANNEL, WIFI_SECOND_CHAN_NONE);
-  esp_wifi_set_promiscuous(false);
-
-  Serial.printf("[ESPNOW] Forced to channel %d\n", ESPNOW_FIXED_CHANNEL);
-
-  if (esp_now_init() != ESP_OK) {
-    Serial.println(F("[ESPNOW] Init FAILED"));
-    return;
+  // ESP-NOW only works when both devices are on the same channel. Associated:
+  // our AP sets it. Otherwise start on the usual channel; service() finds
+  // the Main ESP32 if it is elsewhere.
+  if (WiFi.status() != WL_CONNECTED) {
+    esp_wifi_set_promiscuous(true);
+    esp_wifi_set_channel(ESPNOW_START_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    esp_wifi_set_promiscuous(false);
   }
+  Serial.printf("[ESPNOW] Starting on channel %d\n", WiFi.channel());
 
-  // Register send callback
-  esp_now_register_send_cb(onEspNowSent);
-
-  // Register receive callback (for potential ACKs from main ESP32)
-  // esp_now_register_recv_cb(onEspNowReceived);  // Uncomment if ACK handling needed
-
-  // Add peer — Main ESP32
-  memset(&peerInfo, 0, sizeof(peerInfo));
-  memcpy(peerInfo.peer_addr, receiverMac, 6);
-  peerInfo.channel = 0;  // 0 = use current (locked) channel
-  peerInfo.encrypt = false;
-  peerInfo.ifidx = WIFI_IF_STA;
-
-  if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-    Serial.println(F("[ESPNOW] Peer add FAILED"));
-    return;
-  }
+  // Init, ACK receive callback and main ESP32 peer
+  if (!espNow.begin(receiverMac)) return;
+  if (!snapshots.begin(receiverMac)) Serial.println(F("[SNAP] No PSRAM - breach snapshots off"));
+  espNow.setSnapshots(&snapshots);
+  otaReceiver.begin(receiverMac, FIRMWARE_VERSION);
+  espNow.setOta(&otaReceiver);
 
   Serial.print(F("[ESPNOW] Peer added (Main ESP32)"));
   Serial.printf(" %02X:%02X:%02X:%02X:%02X:%02X\n",
@@ -207,35 +239,10 @@ void setupEspNow() {
                 receiverMac[3], receiverMac[4], receiverMac[5]);
 }
 
-// ============================================================================
-// ESP-NOW SEND CALLBACK
-// ============================================================================
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-void onEspNowSent(const wifi_tx_info_t *wifi_tx_info, esp_now_send_status_t status)
-#else
-void onEspNowSent(const uint8_t *mac_addr, esp_now_send_status_t status)
-#endif
-{
-  if (status == ESP_NOW_SEND_SUCCESS) {
-    if (!lastSendSucceeded) {
-      // Only print on state change from fail to success
-      Serial.println(F("[ESPNOW] ACK RECEIVED"));
-      lastSendSucceeded = true;
-    }
-    blinkLed(1, 100);
-  } else {
-    if (lastSendSucceeded) {
-      Serial.println(F("[ESPNOW] Send FAILED"));
-      lastSendSucceeded = false;
-    }
-    blinkLed(3, 300);
-  }
-}
-
 // ============================================================================
 // SEND QR CODE VIA ESP-NOW
 // ============================================================================
-void sendQrCode(const char *qrPayload) {
+void sendQrCode(const char *qrPayload, int64_t decodeUs) {
   // Layer 1: Duplicate scan (CAM side)
   if (strcmp(qrPayload, lastQrSent) == 0 && (millis() - lastScanTime) < SCAN_COOLDOWN_MS) {
     return;  // Silent — don't print debounce noise
@@ -246,37 +253,27 @@ void sendQrCode(const char *qrPayload) {
   lastQrSent[31] = '\0';
   lastScanTime = millis();
 
-  // Sanitize payload
-  String qrClean = String(qrPayload);
-  qrClean.trim();
-  qrClean.replace("\r", "");
-  qrClean.replace("\n", "");
+  // Sanitize payload in a stack buffer: drop CR/LF, trim surrounding spaces
+  char qrClean[sizeof(lastQrSent)];
+  size_t len = 0;
+  for (const char* p = qrPayload; *p && len < sizeof(qrClean) - 1; p++) {
+    if (*p != '\r' && *p != '\n') qrClean[len++] = *p;
+  }
+  while (len > 0 && isspace((unsigned char)qrClean[len - 1])) len--;
+  qrClean[len] = '\0';
+  const char* start = qrClean;
+  while (*start && isspace((unsigned char)*start)) start++;
 
-  if (qrClean.length() == 0) {
+  if (*start == '\0') {
     return;  // Don't send empty QR
   }
 
-  // Prepare packet
-  memset(&packet, 0, sizeof(packet));
-  strncpy(packet.qrData, qrClean.c_str(), 31);
-  packet.qrData[31] = '\0';
-  packet.timestamp = millis();
-  WiFi.macAddress(packet.camMac);
-
   // Clean output
-  Serial.print("[QR] Payload: ");
-  Serial.println(packet.qrData);
+  Serial.printf("[QR] Payload: %s\n", start);
 
-  // Pre-send LED
-  digitalWrite(LED_PIN, HIGH);
-
-  // Send via ESP-NOW
-  esp_err_t result = esp_now_send(receiverMac, (uint8_t *)&packet, sizeof(packet));
-
-  digitalWrite(LED_PIN, LOW);
-
-  if (result != ESP_OK) {
-    Serial.println(F("[ESPNOW] Send queue FAILED"));
+  // Queued; loop() sends it and retransmits until the Main ESP32 ACKs
+  if (!espNow.sendQrCode(start, decodeUs)) {
+    Serial.println(F("[ESPNOW] Send queue FULL"));
   }
 }
 
@@ -284,44 +281,30 @@ void sendQrCode(const char *qrPayload) {
 // QR CODE DETECTION TASK (FreeRTOS)
 // ============================================================================
 void onQrCodeTask(void *pvParameters) {
-  struct QRCodeData qrCodeData;
-  unsigned long cooldownUntil = 0;
+  QrResult result;
 
   while (true) {
-    if (reader.receiveQrCode(&qrCodeData, 100)) {
-      if (qrCodeData.valid) {
-        const char *payload = (const char *)qrCodeData.payload;
-        String payloadStr = String(payload);
-        payloadStr.trim();
-
-        // Minimal validation — skip empty/trash reads
-        if (payloadStr.length() < 3) {
-          // Too short to be valid — silently ignore
-          // Print only once per 5s to avoid flooding
-          if (millis() - lastInvalidPrint > INVALID_PRINT_COOLDOWN) {
-            Serial.println(F("[QR] Invalid QR code data"));
-            lastInvalidPrint = millis();
-          }
-          vTaskDelay(100 / portTICK_PERIOD_MS);
-          continue;
-        }
-
-        // Check cooldown to avoid re-scanning the same QR too fast
-        if (millis() < cooldownUntil) {
-          vTaskDelay(100 / portTICK_PERIOD_MS);
-          continue;
-        }
-
-        sendQrCode(payload);
-        cooldownUntil = millis() + 2000;  // 2s min cooldown between sends
-      } else {
-        if (millis() - lastInvalidPrint > INVALID_PRINT_COOLDOWN) {
-          Serial.println(F("[QR] Invalid QR code data"));
-          lastInvalidPrint = millis();
-        }
+    // Blocks until the pipeline decodes something — no polling delay
+    if (!qrPipeline.receive(result, portMAX_DELAY)) continue;
+
+    const char *payload = result.payload;
+    const char *first = payload;
+    while (*first && isspace((unsigned char)*first)) first++;
+    size_t printable = strlen(first);
+    while (printable > 0 && isspace((unsigned char)first[printable - 1])) printable--;
+
+    // Minimal validation — skip empty/trash reads
+    if (printable < 3) {
+      // Too short to be valid — silently ignore
+      // Print only once per 5s to avoid flooding
+      if (millis() - lastInvalidPrint > INVALID_PRINT_COOLDOWN) {
+        Serial.println(F("[QR] Invalid QR code data"));
+        lastInvalidPrint = millis();
       }
+      continue;
     }
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+
+    sendQrCode(payload, result.decodeUs);  // Trace stage 0: decode time
   }
 }
 
@@ -0,0 +1,478 @@
+#include "QrPipeline.h"
+#include "ImageKernels.h"
+#include "SnapshotRing.h"
+#include <ESP32QRCodeReader.h>      // Only for its bundled quirc decoder
+#include <quirc/quirc.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+// ============================================================================
+// ESP32-CAM QR PIPELINE IMPLEMENTATION
+// ============================================================================
+
+// AI-Thinker ESP32-CAM wiring
+#define CAM_PIN_PWDN    32
+#define CAM_PIN_RESET   -1
+#define CAM_PIN_XCLK    0
+#define CAM_PIN_SIOD    26
+#define CAM_PIN_SIOC    27
+#define CAM_PIN_D7      35
+#define CAM_PIN_D6      34
+#define CAM_PIN_D5      39
+#define CAM_PIN_D4      36
+#define CAM_PIN_D3      21
+#define CAM_PIN_D2      19
+#define CAM_PIN_D1      18
+#define CAM_PIN_D0      5
+#define CAM_PIN_VSYNC   25
+#define CAM_PIN_HREF    23
+#define CAM_PIN_PCLK    22
+
+QrPipeline::QrPipeline()
+    : results(nullptr), task(nullptr), qFull(nullptr), qRoiSmall(nullptr), qRoiLarge(nullptr),
+      detectBuf(nullptr), snapshots(nullptr),
+      highRes(false), failedWithFinders(0), lastFinderAt(0), settleFrames(0), frameIndex(0),
+      canStepUp(false), active(true), lastActivityAt(0), thumbs{nullptr, nullptr}, thumbCur(0),
+      thumbW(0), thumbH(0), illuminatorPin(-1), illuminatorDuty(0), wokeAtUs(0),
+      awaitingFirstDecode(false), frames(0), framesWithFinders(0), roiDecodes(0), roiSuccesses(0),
+      fullDecodes(0), fullSuccesses(0), stepUps(0), resultDrops(0), detectUsTotal(0),
+      decodeUsTotal(0), decodeCount(0), idleFrames(0), wakes(0), lastWakeToDecodeMs(0),
+      maxWakeToDecodeMs(0), statsSince(0) {
+}
+
+static struct quirc* newDecoder(int w, int h) {
+    struct quirc* q = quirc_new();
+    if (q && quirc_resize(q, w, h) < 0) {
+        quirc_destroy(q);
+        q = nullptr;
+    }
+    return q;
+}
+
+bool QrPipeline::begin() {
+    canStepUp = psramFound();
+
+    camera_config_t config = {};
+    config.pin_pwdn = CAM_PIN_PWDN;
+    config.pin_reset = CAM_PIN_RESET;
+    config.pin_xclk = CAM_PIN_XCLK;
+    config.pin_sccb_sda = CAM_PIN_SIOD;
+    config.pin_sccb_scl = CAM_PIN_SIOC;
+    config.pin_d7 = CAM_PIN_D7;
+    config.pin_d6 = CAM_PIN_D6;
+    config.pin_d5 = CAM_PIN_D5;
+    config.pin_d4 = CAM_PIN_D4;
+    config.pin_d3 = CAM_PIN_D3;
+    config.pin_d2 = CAM_PIN_D2;
+    config.pin_d1 = CAM_PIN_D1;
+    config.pin_d0 = CAM_PIN_D0;
+    config.pin_vsync = CAM_PIN_VSYNC;
+    config.pin_href = CAM_PIN_HREF;
+    config.pin_pclk = CAM_PIN_PCLK;
+    config.xclk_freq_hz = 20000000;
+    config.ledc_timer = LEDC_TIMER_0;
+    config.ledc_channel = LEDC_CHANNEL_0;
+    config.pixel_format = PIXFORMAT_GRAYSCALE;
+    config.jpeg_quality = 12;
+    if (canStepUp) {
+        // Buffers sized for the largest step; QVGA frames use part of them.
+        // Two buffers + GRAB_LATEST: capture continues during decode.
+        config.frame_size = FRAMESIZE_VGA;
+        config.fb_count = 2;
+        config.fb_location = CAMERA_FB_IN_PSRAM;
+    } else {
+        config.frame_size = FRAMESIZE_QVGA;
+        config.fb_count = 1;
+        config.fb_location = CAMERA_FB_IN_DRAM;
+    }
+    config.grab_mode = CAMERA_GRAB_LATEST;
+
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK) {
+        Serial.printf("[QR] Camera init failed: 0x%x\n", err);
+        return false;
+    }
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (sensor) sensor->set_framesize(sensor, FRAMESIZE_QVGA);
+
+    // Decoders allocated once; their buffers never change size
+    qFull = newDecoder(320, 240);
+    qRoiSmall = newDecoder(QR_ROI_SMALL, QR_ROI_SMALL);
+    qRoiLarge = newDecoder(QR_ROI_LARGE, QR_ROI_LARGE);
+    if (!qFull || !qRoiSmall || !qRoiLarge) {
+        Serial.println(F("[QR] Decoder allocation failed"));
+        return false;
+    }
+    if (canStepUp) {
+        detectBuf = (uint8_t*)heap_caps_malloc(320 * 240, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!detectBuf) canStepUp = false;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        thumbs[i] = (uint8_t*)heap_caps_malloc(QR_THUMB_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!thumbs[i]) thumbs[i] = (uint8_t*)malloc(QR_THUMB_MAX);
+    }
+
+    if (!results) results = xQueueCreate(QR_RESULT_QUEUE_LEN, sizeof(QrResult));
+    statsSince = millis();
+    lastActivityAt = millis();      // Start active; idle once the scene is quiet
+    return results != nullptr;
+}
+
+void QrPipeline::setIlluminator(uint8_t pin, uint8_t activeDuty) {
+    illuminatorPin = pin;
+    illuminatorDuty = activeDuty;
+    ledcWrite(pin, active ? activeDuty : QR_IDLE_LIGHT_DUTY);
+}
+
+bool QrPipeline::startOnCore(BaseType_t core, UBaseType_t priority) {
+    if (task) return true;
+    return xTaskCreatePinnedToCore(taskEntry, "qrPipeline", 8 * 1024, this, priority, &task, core) == pdPASS;
+}
+
+bool QrPipeline::receive(QrResult& out, TickType_t wait) {
+    return results && xQueueReceive(results, &out, wait) == pdTRUE;
+}
+
+void QrPipeline::taskEntry(void* arg) {
+    ((QrPipeline*)arg)->run();
+}
+
+void QrPipeline::run() {
+    while (true) {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (!fb) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        processFrame(fb);
+        if (snapshots) snapshots->offer(fb);
+        esp_camera_fb_return(fb);
+        if (!active) vTaskDelay(pdMS_TO_TICKS(QR_IDLE_FRAME_MS));
+    }
+}
+
+void QrPipeline::setHighRes(bool on) {
+    if (on == highRes || (on && !canStepUp)) return;
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (!sensor || sensor->set_framesize(sensor, on ? FRAMESIZE_VGA : FRAMESIZE_QVGA) != 0) return;
+    highRes = on;
+    settleFrames = 2;       // Frames already in flight have the old size
+    failedWithFinders = 0;
+    if (on) stepUps++;
+}
+
+// ============================================================================
+// MOTION GATING
+// ============================================================================
+void QrPipeline::setActive(bool on) {
+    if (on == active) return;
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (sensor) sensor->set_framesize(sensor, on ? FRAMESIZE_QVGA : FRAMESIZE_QQVGA);
+    active = on;
+    highRes = false;
+    failedWithFinders = 0;
+    settleFrames = 2;       // Frames already in flight have the old size
+    thumbW = thumbH = 0;    // New size and lighting: no reference yet
+    if (illuminatorPin >= 0) ledcWrite(illuminatorPin, on ? illuminatorDuty : QR_IDLE_LIGHT_DUTY);
+    if (on) {
+        wakes++;
+        wokeAtUs = esp_timer_get_time();
+        awaitingFirstDecode = true;
+        lastActivityAt = millis();
+    }
+}
+
+// Frame differencing on a 4x downscale against the previous call's
+bool QrPipeline::motion(const uint8_t* img, int w, int h) {
+    int tw = w / 4, th = h / 4;
+    if (!thumbs[0] || !thumbs[1] || tw * th > QR_THUMB_MAX) return false;
+
+    uint8_t* cur = thumbs[thumbCur];
+    const uint8_t* prev = thumbs[thumbCur ^ 1];
+    ImageKernels::downscale4x(img, w, h, cur);
+
+    bool moved = false;
+    if (tw == thumbW && th == thumbH) {
+        int n = tw * th;
+        int changed = 0;
+        for (int i = 0; i < n; i++) {
+            if (abs((int)cur[i] - (int)prev[i]) > QR_MOTION_PIXEL_DELTA) changed++;
+        }
+        moved = changed * 100 >= n * QR_MOTION_MIN_PCT;
+    }
+    thumbW = tw;
+    thumbH = th;
+    thumbCur ^= 1;
+    return moved;
+}
+
+// ============================================================================
+// FINDER PATTERN DETECTION
+// ============================================================================
+// Dark-light-dark-light-dark runs in 1:1:3:1:1 proportion, ±0.5 module per
+// run (fixed point x4 to stay in integers)
+static bool finderRatio(const int* len) {
+    int total = len[0] + len[1] + len[2] + len[3] + len[4];
+    if (total < 7) return false;
+    int module4 = total * 4 / 7;
+    int var4 = module4 / 2;
+    return abs(len[0] * 4 - module4) < var4 &&
+           abs(len[1] * 4 - module4) < var4 &&
+           abs(len[2] * 4 - 3 * module4) < 3 * var4 &&
+           abs(len[3] * 4 - module4) < var4 &&
+           abs(len[4] * 4 - module4) < var4;
+}
+
+bool QrPipeline::confirmColumn(const uint8_t* img, int w, int h, int x, int y, uint8_t thr, int module) {
+    int maxRun = module * 5;
+    int len[5] = {0, 0, 0, 0, 0};
+    const uint8_t* col = img + x;
+
+    // Centre run (dark), then light and dark runs on each side
+    int up = y, down = y;
+    while (up >= 0 && col[up * w] < thr && len[2] <= maxRun) { up--; len[2]++; }
+    while (down < h && col[down * w] < thr && len[2] <= maxRun) { down++; len[2]++; }
+    len[2]--;   // y counted twice
+    while (up >= 0 && col[up * w] >= thr && len[1] <= maxRun) { up--; len[1]++; }
+    while (up >= 0 && col[up * w] < thr && len[0] <= maxRun) { up--; len[0]++; }
+    while (down < h && col[down * w] >= thr && len[3] <= maxRun) { down++; len[3]++; }
+    while (down < h && col[down * w] < thr && len[4] <= maxRun) { down++; len[4]++; }
+    return finderRatio(len);
+}
+
+int QrPipeline::findFinders(const uint8_t* img, int w, int h, QrFinder* out) {
+    int count = 0;
+    const int rowStep = 2;
+
+    for (int y = rowStep; y < h - rowStep; y += rowStep) {
+        const uint8_t* row = img + y * w;
+
+        // Row-local threshold copes with uneven lighting across the frame
+        uint32_t sum = 0;
+        for (int x = 0; x < w; x += 4) sum += row[x];
+        uint8_t thr = (uint8_t)(sum / ((w + 3) / 4));
+
+        int len[5] = {0, 0, 0, 0, 0};
+        int runs = 0;
+        bool dark = row[0] < thr;
+        int runStart = 0;
+        for (int x = 1; x <= w; x++) {
+            bool d = (x < w) ? row[x] < thr : !dark;
+            if (d == dark) continue;
+
+            memmove(len, len + 1, 4 * sizeof(int));
+            len[4] = x - runStart;
+            runs++;
+
+            // The run that just ended is dark, so len[0], len[2], len[4] are dark
+            if (dark && runs >= 5 && finderRatio(len)) {
+                int cx = x - len[4] - len[3] - len[2] / 2;
+                int module = (len[0] + len[1] + len[2] + len[3] + len[4]) / 7;
+                if (module > 0 && confirmColumn(img, w, h, cx, y, thr, module)) {
+                    int i = 0;
+                    for (; i < count; i++) {
+                        if (abs(out[i].x - cx) <= module * 2 && abs(out[i].y - y) <= module * 4) break;
+                    }
+                    if (i < count) {
+                        out[i].y = (int16_t)((out[i].y * out[i].hits + y) / (out[i].hits + 1));
+                        if (out[i].hits < 255) out[i].hits++;
+                    } else if (count < MAX_FINDERS) {
+                        out[count].x = (int16_t)cx;
+                        out[count].y = (int16_t)y;
+                        out[count].module = (uint8_t)min(module, 255);
+                        out[count].hits = 1;
+                        count++;
+                    }
+                }
+            }
+            dark = d;
+            runStart = x;
+        }
+    }
+
+    // Single-row hits are mostly texture noise
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (out[i].hits >= 2) out[kept++] = out[i];
+    }
+    return kept;
+}
+
+// ============================================================================
+// DECODE
+// ============================================================================
+bool QrPipeline::decode(struct quirc* q, const uint8_t* img, int w, int h,
+                        int x0, int y0, int cw, int ch) {
+    int qw, qh;
+    uint8_t* buf = quirc_begin(q, &qw, &qh);
+    if (cw > qw) cw = qw;
+    if (ch > qh) ch = qh;
+
+    // Crop into the fixed-size decoder; white around it reads as quiet zone
+    for (int r = 0; r < qh; r++) {
+        uint8_t* dst = buf + r * qw;
+        if (r < ch) {
+            memcpy(dst, img + (y0 + r) * w + x0, cw);
+            if (cw < qw) memset(dst + cw, 255, qw - cw);
+        } else {
+            memset(dst, 255, qw);
+        }
+    }
+    quirc_end(q);
+
+    int n = quirc_count(q);
+    for (int i = 0; i < n; i++) {
+        struct quirc_code code;
+        struct quirc_data data;
+        quirc_extract(q, i, &code);
+        if (quirc_decode(&code, &data) != QUIRC_SUCCESS) continue;
+
+        QrResult result;
+        result.decodeUs = esp_timer_get_time();
+        size_t len = min((size_t)data.payload_len, sizeof(result.payload) - 1);
+        memcpy(result.payload, data.payload, len);
+        result.payload[len] = '\0';
+        if (xQueueSend(results, &result, 0) != pdTRUE) resultDrops++;
+        return true;
+    }
+    return false;
+}
+
+void QrPipeline::processFrame(camera_fb_t* fb) {
+    frames++;
+    frameIndex++;
+    if (settleFrames > 0) {
+        settleFrames--;
+        return;
+    }
+
+    const uint8_t* img = fb->buf;
+    int w = fb->width, h = fb->height;
+
+    if (!active) {
+        idleFrames++;
+        if (motion(img, w, h)) setActive(true);
+        return;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    QrFinder finders[MAX_FINDERS];
+    int n;
+    if (highRes && w == 640 && h == 480) {
+        // Finders were already visible at QVGA (that's why we stepped up), so
+        // detect on the downscale and keep full resolution for the decode
+        ImageKernels::downscale2x(img, w, h, detectBuf);
+        n = findFinders(detectBuf, w / 2, h / 2, finders);
+        for (int i = 0; i < n; i++) {
+            finders[i].x *= 2;
+            finders[i].y *= 2;
+            finders[i].module = (uint8_t)min(finders[i].module * 2, 255);
+        }
+        if (n == 0 && motion(detectBuf, w / 2, h / 2)) lastActivityAt = millis();
+    } else {
+        n = findFinders(img, w, h, finders);
+        if (n == 0 && motion(img, w, h)) lastActivityAt = millis();
+    }
+    int64_t t1 = esp_timer_get_time();
+    detectUsTotal += t1 - t0;
+
+    // Quiet scene: back to idle sampling, illuminator off
+    if (n == 0 && millis() - lastActivityAt > QR_IDLE_AFTER_MS) {
+        setActive(false);
+        return;
+    }
+
+    // Safety net: detection can miss low-contrast codes, so decode a full
+    // frame now and then even with nothing detected
+    bool probe = !highRes && (frameIndex % QR_FULL_PROBE_EVERY) == 0;
+    if (n > 0) {
+        framesWithFinders++;
+        lastFinderAt = millis();
+    } else if (!probe) {
+        if (highRes && millis() - lastFinderAt > QR_STEP_DOWN_MS) setHighRes(false);
+        return;
+    }
+
+    bool ok = false;
+    bool tried = false;
+    if (n >= 3) {
+        // Three strongest finders bound the symbol; pad by 4.5 modules
+        // (finder centre to edge + one module of quiet zone)
+        for (int i = 0; i < 3; i++) {
+            for (int j = i + 1; j < n; j++) {
+                if (finders[j].hits > finders[i].hits) {
+                    QrFinder t = finders[i]; finders[i] = finders[j]; finders[j] = t;
+                }
+            }
+        }
+        int minX = w, minY = h, maxX = 0, maxY = 0, module = 0;
+        for (int i = 0; i < 3; i++) {
+            minX = min(minX, (int)finders[i].x);
+            maxX = max(maxX, (int)finders[i].x);
+            minY = min(minY, (int)finders[i].y);
+            maxY = max(maxY, (int)finders[i].y);
+            module = max(module, (int)finders[i].module);
+        }
+        int margin = module * 9 / 2 + 1;
+        int x0 = max(0, minX - margin), y0 = max(0, minY - margin);
+        int x1 = min(w, maxX + margin), y1 = min(h, maxY + margin);
+        int size = max(x1 - x0, y1 - y0);
+
+        struct quirc* q = (size <= QR_ROI_SMALL) ? qRoiSmall : (size <= QR_ROI_LARGE) ? qRoiLarge : nullptr;
+        if (q) {
+            roiDecodes++;
+            tried = true;
+            ok = decode(q, img, w, h, x0, y0, x1 - x0, y1 - y0);
+            if (ok) roiSuccesses++;
+        } else if (highRes) {
+            setHighRes(false);  // Symbol bigger than any crop: it reads fine at QVGA
+            return;
+        }
+    }
+    if (!ok && !highRes) {
+        fullDecodes++;
+        tried = true;
+        ok = decode(qFull, img, w, h, 0, 0, w, h);
+        if (ok) fullSuccesses++;
+    }
+    if (tried) {
+        decodeUsTotal += esp_timer_get_time() - t1;
+        decodeCount++;
+    }
+
+    if (ok) {
+        failedWithFinders = 0;
+        if (awaitingFirstDecode) {
+            awaitingFirstDecode = false;
+            lastWakeToDecodeMs = (uint32_t)((esp_timer_get_time() - wokeAtUs) / 1000);
+            if (lastWakeToDecodeMs > maxWakeToDecodeMs) maxWakeToDecodeMs = lastWakeToDecodeMs;
+        }
+    } else if (n > 0 && ++failedWithFinders >= QR_STEP_UP_AFTER) {
+        setHighRes(true);   // Something is in view but too small to read
+    }
+}
+
+void QrPipeline::printStatus() {
+    unsigned long window = millis() - statsSince;
+    if (window == 0) window = 1;
+    Serial.printf("[QR] %.1f fps at %s, finders in %u/%u frames, ROI %u/%u ok, full %u/%u ok, %u step-ups, %u results dropped\n",
+                  frames * 1000.0f / window, !active ? "QQVGA" : highRes ? "VGA" : "QVGA",
+                  (unsigned)framesWithFinders, (unsigned)frames,
+                  (unsigned)roiSuccesses, (unsigned)roiDecodes,
+                  (unsigned)fullSuccesses, (unsigned)fullDecodes,
+                  (unsigned)stepUps, (unsigned)resultDrops);
+    Serial.printf("[QR] avg detect %u us/frame, avg decode %u us/attempt\n",
+                  (unsigned)(frames > idleFrames ? detectUsTotal / (frames - idleFrames) : 0),
+                  (unsigned)(decodeCount ? decodeUsTotal / decodeCount : 0));
+    Serial.printf("[QR] %s, %u/%u frames idle-sampled, %u wakes, wake to first decode %u ms last, %u ms max\n",
+                  active ? "active" : "idle", (unsigned)idleFrames, (unsigned)frames,
+                  (unsigned)wakes, (unsigned)lastWakeToDecodeMs, (unsigned)maxWakeToDecodeMs);
+
+    // New window
+    frames = framesWithFinders = roiDecodes = roiSuccesses = fullDecodes = fullSuccesses = 0;
+    idleFrames = 0;
+    detectUsTotal = decodeUsTotal = 0;
+    decodeCount = 0;
+    statsSince = millis();
+}
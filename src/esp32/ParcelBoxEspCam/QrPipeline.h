@@ -0,0 +1,148 @@
+#ifndef QR_PIPELINE_H
+#define QR_PIPELINE_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+class SnapshotRing;
+
+// ============================================================================
+// ESP32-CAM QR CAPTURE / DECODE PIPELINE
+// ============================================================================
+// Replaces the full-frame ESP32QRCodeReader task:
+// - Grayscale capture into two PSRAM frame buffers (GRAB_LATEST): the sensor
+//   fills one while the other is being decoded, so it never idles
+// - Cheap finder-pattern scan (1:1:3:1:1 runs on every other row, confirmed
+//   on the column) decides whether a code is in view at all. At VGA it runs
+//   on a SWAR 2x downscale (ImageKernels), so detection cost stays at QVGA.
+// - With three finder patterns, only the crop around them is decoded
+//   (fixed-size quirc instances, white padding); otherwise the full frame
+// - Resolution starts at QVGA and steps up to VGA only when finders are seen
+//   but decoding keeps failing (code too small); it steps back down once
+//   nothing has been in view for a while
+// - Motion gating: with nothing happening in front of the box the pipeline
+//   idles at QQVGA, one frame every QR_IDLE_FRAME_MS, and only compares a
+//   4x-downscaled thumbnail with the previous one (no finder scan, no
+//   decode, illuminator off). Enough changed pixels switch to full-rate
+//   QVGA decoding with the illuminator on; QR_IDLE_AFTER_MS without motion
+//   or finders drops back.
+// - Every frame is offered to the breach snapshot ring, if set
+// Decoded payloads are queued for receive(); nothing here blocks on ESP-NOW.
+// ============================================================================
+
+#define QR_PAYLOAD_MAX          64
+#define QR_RESULT_QUEUE_LEN     4
+#define QR_ROI_SMALL            160     // Crop decoder sizes (pixels, square)
+#define QR_ROI_LARGE            320
+#define QR_STEP_UP_AFTER        3       // Frames with finders but no decode → VGA
+#define QR_STEP_DOWN_MS         3000    // Nothing in view this long → back to QVGA
+#define QR_FULL_PROBE_EVERY     8       // Full-frame decode every Nth frame regardless
+#define QR_IDLE_FRAME_MS        200     // Idle sampling interval
+#define QR_IDLE_AFTER_MS        10000   // No motion / finders this long → idle
+#define QR_IDLE_LIGHT_DUTY      0       // Raise for enclosures with no ambient light
+#define QR_MOTION_PIXEL_DELTA   24      // Thumbnail pixel change that counts
+#define QR_MOTION_MIN_PCT       2       // Changed thumbnail pixels for motion
+#define QR_THUMB_MAX            (80 * 60)   // QVGA / 4
+
+struct QrResult {
+  char payload[QR_PAYLOAD_MAX];
+  int64_t decodeUs;         // esp_timer time the decode succeeded
+};
+
+// Finder pattern candidate (centre in frame pixels)
+struct QrFinder {
+  int16_t x;
+  int16_t y;
+  uint8_t module;           // Estimated module size in pixels
+  uint8_t hits;             // Sampled rows that confirmed it
+};
+
+class QrPipeline {
+public:
+  QrPipeline();
+
+  // Camera (grayscale, 2 PSRAM buffers) and decoder buffers
+  bool begin();
+
+  // LEDC-attached illuminator, switched with the idle/active mode.
+  // Before startOnCore().
+  void setIlluminator(uint8_t pin, uint8_t activeDuty);
+
+  // Pre-trigger ring for breach snapshots. Before startOnCore().
+  void setSnapshots(SnapshotRing* ring) { snapshots = ring; }
+
+  // Start the capture/decode task
+  bool startOnCore(BaseType_t core, UBaseType_t priority);
+  TaskHandle_t taskHandle() const { return task; }
+
+  // Any task: next decoded payload. Blocks up to `wait`.
+  bool receive(QrResult& out, TickType_t wait);
+
+  void printStatus();
+
+  // Idle sampling, no code in view: a restart loses nothing
+  bool idle() const { return !active; }
+
+  static const int MAX_FINDERS = 8;
+
+private:
+  QueueHandle_t results;
+  TaskHandle_t task;
+  struct quirc* qFull;      // QVGA full frame
+  struct quirc* qRoiSmall;  // ROI_SMALL x ROI_SMALL crop
+  struct quirc* qRoiLarge;  // ROI_LARGE x ROI_LARGE crop
+  uint8_t* detectBuf;       // QVGA downscale of VGA frames for detection
+  SnapshotRing* snapshots;
+
+  bool highRes;             // VGA instead of QVGA
+  uint8_t failedWithFinders;
+  unsigned long lastFinderAt;
+  uint8_t settleFrames;     // Frames to drop after a resolution change
+  uint32_t frameIndex;
+  bool canStepUp;           // VGA needs the PSRAM frame buffers
+
+  // Motion gating
+  bool active;              // Full-rate decoding; false = idle sampling
+  unsigned long lastActivityAt;
+  uint8_t* thumbs[2];       // Current / previous 4x downscale
+  uint8_t thumbCur;
+  int thumbW, thumbH;       // Size of the previous thumbnail, 0 = none
+  int illuminatorPin;       // -1 = none
+  uint8_t illuminatorDuty;
+  int64_t wokeAtUs;
+  bool awaitingFirstDecode;
+
+  // Statistics
+  uint32_t frames;
+  uint32_t framesWithFinders;
+  uint32_t roiDecodes;
+  uint32_t roiSuccesses;
+  uint32_t fullDecodes;
+  uint32_t fullSuccesses;
+  uint32_t stepUps;
+  uint32_t resultDrops;
+  int64_t detectUsTotal;
+  int64_t decodeUsTotal;
+  uint32_t decodeCount;
+  uint32_t idleFrames;
+  uint32_t wakes;
+  uint32_t lastWakeToDecodeMs;
+  uint32_t maxWakeToDecodeMs;
+  unsigned long statsSince;
+
+  static void taskEntry(void* arg);
+  void run();
+  void processFrame(camera_fb_t* fb);
+
+  int findFinders(const uint8_t* img, int w, int h, QrFinder* out);
+  bool confirmColumn(const uint8_t* img, int w, int h, int x, int y, uint8_t thr, int module);
+  bool decode(struct quirc* q, const uint8_t* img, int w, int h, int x0, int y0, int cw, int ch);
+  void setHighRes(bool on);
+  void setActive(bool on);
+  bool motion(const uint8_t* img, int w, int h);
+};
+
+#endif // QR_PIPELINE_H
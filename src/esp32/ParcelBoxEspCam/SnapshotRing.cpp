@@ -0,0 +1,350 @@
+#include "SnapshotRing.h"
+#include "ImageKernels.h"
+#include <img_converters.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+// ============================================================================
+// ESP32-CAM BREACH SNAPSHOT IMPLEMENTATION
+// ============================================================================
+
+SnapshotRing::SnapshotRing()
+    : slotCount(0), mux(portMUX_INITIALIZER_UNLOCKED), nextSlot(0), lockedSlot(-1), lastOfferUs(0),
+      task(nullptr), requestId(0), requestDoor(0), requestMaxBytes(0), requestOpenedUs(0),
+      requestPending(false), ackNext(0), ackNew(false), stackLowest(0), id(0),
+      offered(0), requests(0), sent(0), noFrame(0), tooBig(0), resumes(0), chunksSent(0),
+      lastBytes(0), lastMs(0), lastOffsetMs(0), lastQuality(0) {
+    memset(mainEspMac, 0, sizeof(mainEspMac));
+    memset(slots, 0, sizeof(slots));
+    memset(&pass, 0, sizeof(pass));
+    memset(frame, 0, sizeof(frame));
+}
+
+bool SnapshotRing::begin(const uint8_t* mac) {
+    memcpy(mainEspMac, mac, sizeof(mainEspMac));
+    if (slotCount || !psramFound()) return slotCount > 0;
+    // Allocated once; a short ring is still a ring
+    for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+        slots[i].pixels = (uint8_t*)heap_caps_malloc(SNAPSHOT_SLOT_W * SNAPSHOT_SLOT_H,
+                                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!slots[i].pixels) break;
+        slotCount++;
+    }
+    return slotCount > 0;
+}
+
+// ============================================================================
+// PRE-TRIGGER RING (pipeline task)
+// ============================================================================
+void SnapshotRing::offer(const camera_fb_t* fb) {
+    if (!slotCount || fb->format != PIXFORMAT_GRAYSCALE) return;
+    int64_t now = esp_timer_get_time();
+    if (now - lastOfferUs < (int64_t)SNAPSHOT_OFFER_MS * 1000) return;
+    bool halve = fb->width > SNAPSHOT_SLOT_W;
+    int w = halve ? fb->width / 2 : fb->width;
+    int h = halve ? fb->height / 2 : fb->height;
+    if (w > SNAPSHOT_SLOT_W || h > SNAPSHOT_SLOT_H || fb->len < (size_t)fb->width * fb->height) return;
+
+    portENTER_CRITICAL(&mux);
+    uint8_t i = nextSlot;
+    if (i == lockedSlot) i = (i + 1) % slotCount;
+    bool free = i != lockedSlot;
+    if (free) {
+        nextSlot = (i + 1) % slotCount;
+        slots[i].atUs = 0;          // Being written: never picked meanwhile
+    }
+    portEXIT_CRITICAL(&mux);
+    if (!free) return;
+
+    SnapshotSlot& s = slots[i];
+    if (halve) ImageKernels::downscale2x(fb->buf, fb->width, fb->height, s.pixels);
+    else memcpy(s.pixels, fb->buf, (size_t)w * h);
+
+    portENTER_CRITICAL(&mux);
+    s.width = w;
+    s.height = h;
+    s.atUs = now;
+    portEXIT_CRITICAL(&mux);
+    lastOfferUs = now;
+    offered++;
+}
+
+int8_t SnapshotRing::lockNearest(int64_t atUs) {
+    int8_t best = -1;
+    int64_t bestDiff = 0;
+    portENTER_CRITICAL(&mux);
+    for (int i = 0; i < slotCount; i++) {
+        if (!slots[i].atUs) continue;
+        int64_t diff = llabs(slots[i].atUs - atUs);
+        if (best < 0 || diff < bestDiff) {
+            best = i;
+            bestDiff = diff;
+        }
+    }
+    lockedSlot = best;
+    portEXIT_CRITICAL(&mux);
+    return best;
+}
+
+// ============================================================================
+// REQUESTS (WiFi task / loop)
+// ============================================================================
+void SnapshotRing::onFrame(const uint8_t* data, int len) {
+    if (len != sizeof(ESPNOW_SnapFrame_t)) return;
+    const ESPNOW_SnapFrame_t* f = (const ESPNOW_SnapFrame_t*)data;
+    int64_t now = esp_timer_get_time();
+    bool wake = true;
+
+    portENTER_CRITICAL(&mux);
+    if (f->hdr.status == ESPNOW_SNAP_REQUEST && f->hdr.session != requestId) {
+        // Retries of the request in hand are ignored; a new one replaces it
+        requestId = f->hdr.session;
+        requestDoor = f->door;
+        requestMaxBytes = f->maxBytes;
+        requestOpenedUs = now - (int64_t)f->ageMs * 1000;
+        requestPending = true;
+        ackNext = 0;
+        ackNew = false;
+    } else if (f->hdr.status == ESPNOW_SNAP_ACK && f->hdr.session == requestId) {
+        ackNext = f->hdr.seq;
+        ackNew = true;
+    } else {
+        wake = false;
+    }
+    TaskHandle_t t = task;
+    portEXIT_CRITICAL(&mux);
+    if (wake && t) xTaskNotifyGive(t);
+}
+
+void SnapshotRing::service() {
+    portENTER_CRITICAL(&mux);
+    bool start = requestPending && !task;
+    portEXIT_CRITICAL(&mux);
+    if (!start) return;
+    // The handle is stored before the task first runs
+    if (xTaskCreatePinnedToCore(taskEntry, "snapshot", SNAPSHOT_TASK_STACK, this,
+                                SNAPSHOT_TASK_PRIORITY, &task, SNAPSHOT_TASK_CORE) != pdPASS) {
+        Serial.println(F("[SNAP] Task FAILED"));
+    }
+}
+
+void SnapshotRing::taskEntry(void* arg) {
+    static_cast<SnapshotRing*>(arg)->run();
+    vTaskDelete(nullptr);
+}
+
+void SnapshotRing::run() {
+    while (true) {
+        portENTER_CRITICAL(&mux);
+        bool pending = requestPending;
+        id = requestId;
+        uint8_t door = requestDoor;
+        uint16_t maxBytes = requestMaxBytes;
+        int64_t openedUs = requestOpenedUs;
+        requestPending = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (pending) {
+            send(door, maxBytes, openedUs);
+            continue;               // A request that replaced it is next
+        }
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SNAPSHOT_IDLE_MS)) == 0) {
+            uint32_t stack = uxTaskGetStackHighWaterMark(nullptr);
+            portENTER_CRITICAL(&mux);
+            bool idle = !requestPending;
+            if (idle) {
+                task = nullptr;
+                if (!stackLowest || stack < stackLowest) stackLowest = stack;
+            }
+            portEXIT_CRITICAL(&mux);
+            if (idle) return;
+        }
+    }
+}
+
+// ============================================================================
+// SENDER (snapshot task)
+// ============================================================================
+void SnapshotRing::send(uint8_t door, uint16_t maxBytes, int64_t openedUs) {
+    int64_t startUs = esp_timer_get_time();
+    requests++;
+    ESPNOW_SnapFrame_t end = {};
+    end.hdr.magic = ESPNOW_MAGIC;
+    end.hdr.type = MSG_TYPE_SNAPSHOT;
+    end.hdr.session = id;
+    end.hdr.status = ESPNOW_SNAP_END;
+    end.door = door;
+
+    int8_t slot = lockNearest(openedUs);
+    if (slot < 0) {
+        noFrame++;
+        end.result = ESPNOW_SNAP_NO_FRAME;
+        sendFrame(&end, sizeof(end));
+        return;
+    }
+    // A camera_fb_t view of the slot: the encoder reads it in place
+    const SnapshotSlot& s = slots[slot];
+    camera_fb_t fb = {};
+    fb.buf = s.pixels;
+    fb.len = (size_t)s.width * s.height;
+    fb.width = s.width;
+    fb.height = s.height;
+    fb.format = PIXFORMAT_GRAYSCALE;
+    end.width = s.width;
+    end.height = s.height;
+    end.offsetMs = (int32_t)((s.atUs - openedUs) / 1000);
+
+    uint8_t quality = SNAPSHOT_QUALITY;
+    uint16_t resumeFrom = 0;
+    uint8_t resumesLeft = SNAPSHOT_RESUMES;
+    bool done = false;
+    while (true) {
+        memset(&pass, 0, sizeof(pass));
+        pass.resumeFrom = resumeFrom;
+        pass.maxBytes = maxBytes;
+        frame2jpg_cb(&fb, quality, jpegOut, this);
+        if (!pass.stopped && pass.fill) emitChunk(true);
+        if (pass.superseded) break;
+
+        if (pass.tooBig) {
+            if (quality <= SNAPSHOT_QUALITY_MIN) {
+                tooBig++;
+                end.result = ESPNOW_SNAP_TOO_BIG;
+                sendFrame(&end, sizeof(end));
+                break;
+            }
+            quality -= SNAPSHOT_QUALITY_STEP;
+            resumeFrom = 0;         // Chunk 0: the main board starts over
+            portENTER_CRITICAL(&mux);
+            ackNext = 0;
+            portEXIT_CRITICAL(&mux);
+            continue;
+        }
+
+        // END until the main board holds every chunk, or asks for one again
+        end.result = ESPNOW_SNAP_OK;
+        end.bytes = pass.bytes;
+        for (uint8_t tries = 0; !pass.stopped && tries < SNAPSHOT_END_TRIES && !done; tries++) {
+            sendFrame(&end, sizeof(end));
+            done = awaitAck(pass.chunk, false);
+        }
+        if (done || pass.superseded || !pass.stopped) break;   // Sent, replaced, or nobody ACKs
+        if (resumesLeft == 0) break;
+        resumesLeft--;
+        resumes++;
+        resumeFrom = pass.resumeFrom;
+    }
+
+    portENTER_CRITICAL(&mux);
+    lockedSlot = -1;
+    portEXIT_CRITICAL(&mux);
+    if (!done) return;
+    sent++;
+    lastBytes = end.bytes;
+    lastMs = (uint32_t)((esp_timer_get_time() - startUs) / 1000);
+    lastOffsetMs = end.offsetMs;
+    lastQuality = quality;
+}
+
+// Encoder output: fill the chunk frame in place, send it when full. The
+// encoder can't be stopped, so a finished pass only drains it.
+size_t SnapshotRing::jpegOut(void* arg, size_t index, const void* data, size_t len) {
+    SnapshotRing* self = static_cast<SnapshotRing*>(arg);
+    Pass& p = self->pass;
+    if (p.stopped) return len;
+    p.bytes += len;
+    if (p.bytes > p.maxBytes) {
+        p.stopped = p.tooBig = true;
+        return len;
+    }
+    const uint8_t* in = (const uint8_t*)data;
+    size_t left = len;
+    while (left && !p.stopped) {
+        size_t n = ESPNOW_SNAP_CHUNK_BYTES - p.fill;
+        if (n > left) n = left;
+        memcpy(self->frame + sizeof(ESPNOW_Header_t) + p.fill, in, n);
+        p.fill += n;
+        in += n;
+        left -= n;
+        if (p.fill == ESPNOW_SNAP_CHUNK_BYTES) self->emitChunk(false);
+    }
+    return len;
+}
+
+bool SnapshotRing::emitChunk(bool last) {
+    uint16_t n = pass.fill;
+    uint16_t seq = pass.chunk++;
+    pass.fill = 0;
+    if (seq < pass.resumeFrom) return true;     // The main board has it
+
+    ESPNOW_Header_t* hdr = (ESPNOW_Header_t*)frame;
+    hdr->magic = ESPNOW_MAGIC;
+    hdr->type = MSG_TYPE_SNAPSHOT;
+    hdr->seq = seq;
+    hdr->session = id;
+    hdr->attempt = 0;
+    hdr->status = ESPNOW_SNAP_CHUNK;
+    sendFrame(frame, sizeof(ESPNOW_Header_t) + n);
+    chunksSent++;
+    if (!last && (seq + 1) % ESPNOW_SNAP_WINDOW == 0) return awaitAck(seq + 1, true);
+    return true;
+}
+
+// True once the main board expects `want` or more. An ACK behind it, a new
+// request, or (window) a timeout stops the pass; pass.resumeFrom is then
+// where the next one picks up.
+bool SnapshotRing::awaitAck(uint16_t want, bool resumeOnTimeout) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)SNAPSHOT_ACK_MS * 1000;
+    while (true) {
+        portENTER_CRITICAL(&mux);
+        bool fresh = ackNew;
+        uint16_t next = ackNext;
+        bool replaced = requestPending;
+        ackNew = false;
+        portEXIT_CRITICAL(&mux);
+
+        if (replaced) {
+            pass.stopped = pass.superseded = true;
+            return false;
+        }
+        if (fresh && next >= want) {
+            if (next > pass.resumeFrom) pass.resumeFrom = next;     // Already has more
+            return true;
+        }
+        if (fresh) {
+            pass.stopped = true;
+            pass.resumeFrom = next;
+            return false;
+        }
+        int64_t left = deadline - esp_timer_get_time();
+        if (left <= 0) {
+            if (resumeOnTimeout) {
+                pass.stopped = true;
+                pass.resumeFrom = next;
+            }
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(left / 1000) + 1);
+    }
+}
+
+// A full radio queue is waited out rather than counted as loss
+bool SnapshotRing::sendFrame(const void* data, size_t len) {
+    esp_err_t err;
+    while ((err = esp_now_send(mainEspMac, (const uint8_t*)data, len)) == ESP_ERR_ESPNOW_NO_MEM) vTaskDelay(1);
+    return err == ESP_OK;
+}
+
+void SnapshotRing::printStats() {
+    if (!slotCount) {
+        Serial.printf("[SNAP] ring off (no PSRAM), %u requests answered NO_FRAME\n", (unsigned)noFrame);
+        return;
+    }
+    Serial.printf("[SNAP] ring %u slots, %u frames in | %u requests: %u sent, %u no frame, %u too big, %u resumes, %u chunks%s\n",
+                  slotCount, (unsigned)offered, (unsigned)requests, (unsigned)sent, (unsigned)noFrame,
+                  (unsigned)tooBig, (unsigned)resumes, (unsigned)chunksSent, task ? ", sending" : "");
+    if (sent) {
+        Serial.printf("[SNAP] last: %u bytes at quality %u in %u ms, frame %d ms from opening\n",
+                      (unsigned)lastBytes, lastQuality, (unsigned)lastMs, (int)lastOffsetMs);
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef SNAPSHOT_RING_H
+#define SNAPSHOT_RING_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "EspNowCamera.h"
+
+// ============================================================================
+// ESP32-CAM BREACH SNAPSHOTS
+// ============================================================================
+// Pre-trigger ring and JPEG sender for the main board's breach snapshots
+// (MSG_TYPE_SNAPSHOT in EspNowCamera.h):
+// - The QR pipeline offers every frame; one every SNAPSHOT_OFFER_MS is
+//   copied into a small PSRAM ring (VGA halved with ImageKernels). The
+//   camera only has two frame buffers and the pipeline holds them, so the
+//   moment a door opened is already gone from them by the time the request
+//   arrives.
+// - A request picks the slot nearest the opening and locks it; the ring
+//   writes around it. frame2jpg_cb encodes from the slot straight into
+//   ESP-NOW chunk frames: no JPEG buffer, the chunk is the only copy.
+// - The sender task waits for the main board's ACK at every window. A lost
+//   chunk encodes the slot again and resends from the chunk it asks for
+//   (the encoder is deterministic); an image over the main board's size
+//   limit starts over at lower quality.
+// - The task is created for a request and ends when idle, like the bench
+//   responder. Without PSRAM the ring is off and requests get NO_FRAME.
+// ============================================================================
+
+#define SNAPSHOT_SLOTS          4
+#define SNAPSHOT_SLOT_W         320     // QVGA; VGA frames are halved
+#define SNAPSHOT_SLOT_H         240
+#define SNAPSHOT_OFFER_MS       250     // Ring covers the last ~1 s
+#define SNAPSHOT_QUALITY        60      // frame2jpg quality (1-100)
+#define SNAPSHOT_QUALITY_STEP   20
+#define SNAPSHOT_QUALITY_MIN    20
+#define SNAPSHOT_ACK_MS         300     // Wait per window / END
+#define SNAPSHOT_RESUMES        6       // Resends from a lost chunk per snapshot
+#define SNAPSHOT_END_TRIES      4
+#define SNAPSHOT_TASK_STACK     (8 * 1024)
+#define SNAPSHOT_TASK_PRIORITY  1       // Below the QR pipeline and onQrCode
+#define SNAPSHOT_TASK_CORE      0       // Away from the pipeline on core 1
+#define SNAPSHOT_IDLE_MS        2000    // No request this long → task ends
+
+struct SnapshotSlot {
+  uint8_t* pixels;          // SNAPSHOT_SLOT_W x SNAPSHOT_SLOT_H, PSRAM
+  int64_t atUs;             // esp_timer time of the copy, 0 = empty
+  uint16_t width;
+  uint16_t height;
+};
+
+class SnapshotRing {
+public:
+  SnapshotRing();
+
+  // Ring slots in PSRAM and the main board to answer. False: ring off.
+  bool begin(const uint8_t* mainEspMac);
+
+  // Pipeline task, every grayscale frame: copied if a slot is due
+  void offer(const camera_fb_t* fb);
+
+  // WiFi task: a MSG_TYPE_SNAPSHOT frame from the main board
+  void onFrame(const uint8_t* data, int len);
+
+  // Loop: start the sender task for a request that found none running
+  void service();
+
+  // Lowest stack high-water mark of a sender task run that ended, bytes
+  // (0 = none yet). The task is deleted when idle, so there is no handle.
+  uint32_t stackFree() const { return stackLowest; }
+
+  void printStats();
+
+private:
+  uint8_t mainEspMac[6];
+  SnapshotSlot slots[SNAPSHOT_SLOTS];
+  uint8_t slotCount;        // 0 = ring off
+
+  // Ring (pipeline task) vs. the slot being encoded (sender task); mux
+  portMUX_TYPE mux;
+  uint8_t nextSlot;
+  int8_t lockedSlot;        // -1 = none
+  int64_t lastOfferUs;
+
+  // Request and ACKs from the WiFi task (guarded by mux)
+  TaskHandle_t task;
+  uint32_t requestId;
+  uint8_t requestDoor;
+  uint16_t requestMaxBytes;
+  int64_t requestOpenedUs;  // CAM clock
+  bool requestPending;
+  uint16_t ackNext;
+  bool ackNew;
+  uint32_t stackLowest;
+
+  // Sender task: the snapshot in flight
+  struct Pass {
+    uint16_t chunk;         // Next chunk number produced by the encoder
+    uint16_t resumeFrom;    // Chunks below this are not sent; once stopped,
+                            // where the next pass resumes
+    uint16_t fill;          // Bytes in the current chunk
+    uint32_t bytes;         // JPEG bytes produced
+    uint16_t maxBytes;
+    bool stopped;           // Rest of this pass is discarded
+    bool tooBig;
+    bool superseded;
+  };
+  uint32_t id;
+  Pass pass;
+  uint8_t frame[ESPNOW_BENCH_MAX_LEN];
+
+  // Statistics
+  uint32_t offered;
+  uint32_t requests;
+  uint32_t sent;
+  uint32_t noFrame;
+  uint32_t tooBig;
+  uint32_t resumes;
+  uint32_t chunksSent;
+  uint32_t lastBytes;
+  uint32_t lastMs;
+  int32_t lastOffsetMs;
+  uint8_t lastQuality;
+
+  static void taskEntry(void* arg);
+  void run();
+  void send(uint8_t door, uint16_t maxBytes, int64_t openedUs);
+  int8_t lockNearest(int64_t atUs);
+  bool emitChunk(bool last);
+  bool awaitAck(uint16_t want, bool resumeOnTimeout);
+  bool sendFrame(const void* data, size_t len);
+  static size_t jpegOut(void* arg, size_t index, const void* data, size_t len);
+};
+
+#endif // SNAPSHOT_RING_H
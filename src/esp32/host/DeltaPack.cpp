@@ -0,0 +1,265 @@
+// ============================================================================
+// DELTA PACK - Smart Parcel Locker (host build)
+// ============================================================================
+// Makes the firmware deltas DeltaPatch applies on the boards (format in
+// DeltaPatch.h), then replays the result through DeltaPatch in network-
+// sized pieces to check it rebuilds the new image:
+//
+//   delta_pack <old.bin | -> <new.bin> <out.pbd>     "-": full image
+//   delta_pack --apply <old.bin | -> <in.pbd> <out.bin>
+//
+// Greedy matcher: at each position the longest of three candidates wins,
+//   the continuation of the previous COPY_OLD (code that moved as a block),
+//   the last old position with the same 8 bytes, and the last new one
+// (back-reference). Shorter than DELTA_MIN_MATCH stays literal.
+// Publish the .pbd with the SHA-256 of new.bin (config/ota in RTDB).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "DeltaPatch.h"
+
+#define DELTA_MIN_MATCH     8
+#define DELTA_HASH_BITS     20
+
+typedef std::vector<uint8_t> Bytes;
+
+static bool readFile(const char* path, Bytes& out) {
+    out.clear();
+    if (strcmp(path, "-") == 0) return true;
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "[DELTA] Cannot open %s\n", path);
+        return false;
+    }
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static bool writeFile(const char* path, const Bytes& data) {
+    FILE* f = fopen(path, "wb");
+    if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+        fprintf(stderr, "[DELTA] Cannot write %s\n", path);
+        if (f) fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+static inline uint32_t hash8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - DELTA_HASH_BITS));
+}
+
+static void putU32(Bytes& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void putVarint(Bytes& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static size_t matchLength(const uint8_t* a, const uint8_t* b, size_t max) {
+    size_t n = 0;
+    while (n < max && a[n] == b[n]) n++;
+    return n;
+}
+
+struct Counts {
+    size_t ops[3];
+    size_t bytes[3];
+};
+
+static Bytes encode(const Bytes& oldImg, const Bytes& newImg, Counts& counts) {
+    memset(&counts, 0, sizeof(counts));
+    Bytes out;
+    putU32(out, DELTA_MAGIC);
+    putU32(out, (uint32_t)oldImg.size());
+    putU32(out, DeltaPatch::crc32(0, oldImg.data(), oldImg.size()));
+    putU32(out, (uint32_t)newImg.size());
+    putU32(out, DeltaPatch::crc32(0, newImg.data(), newImg.size()));
+
+    std::vector<int32_t> oldHash(1u << DELTA_HASH_BITS, -1);
+    std::vector<int32_t> newHash(1u << DELTA_HASH_BITS, -1);
+    for (size_t i = 0; i + 8 <= oldImg.size(); i++) oldHash[hash8(&oldImg[i])] = (int32_t)i;
+
+    const size_t n = newImg.size();
+    size_t i = 0, litStart = 0;
+    uint32_t oldPos = 0;            // Decoder's end of the previous COPY_OLD
+    size_t lastCopyEnd = 0;         // New position right after it
+
+    auto flushLiteral = [&](size_t end) {
+        if (end == litStart) return;
+        putVarint(out, (uint64_t)(end - litStart) << 2 | DELTA_OP_LITERAL);
+        out.insert(out.end(), newImg.begin() + litStart, newImg.begin() + end);
+        counts.ops[DELTA_OP_LITERAL]++;
+        counts.bytes[DELTA_OP_LITERAL] += end - litStart;
+    };
+
+    while (i + 8 <= n) {
+        size_t bestLen = 0;
+        size_t bestFrom = 0;
+        DeltaOp bestOp = DELTA_OP_LITERAL;
+
+        size_t cont = oldPos + (i - lastCopyEnd);
+        if (cont < oldImg.size()) {
+            size_t len = matchLength(&oldImg[cont], &newImg[i], std::min(oldImg.size() - cont, n - i));
+            if (len >= DELTA_MIN_MATCH / 2) {   // Costs a byte or two: worth it shorter
+                bestLen = len;
+                bestFrom = cont;
+                bestOp = DELTA_OP_COPY_OLD;
+            }
+        }
+        uint32_t h = hash8(&newImg[i]);
+        int32_t o = oldHash[h];
+        if (o >= 0) {
+            size_t len = matchLength(&oldImg[o], &newImg[i], std::min(oldImg.size() - o, n - i));
+            if (len >= DELTA_MIN_MATCH && len > bestLen) {
+                bestLen = len;
+                bestFrom = (size_t)o;
+                bestOp = DELTA_OP_COPY_OLD;
+            }
+        }
+        int32_t b = newHash[h];
+        if (b >= 0) {
+            size_t len = matchLength(&newImg[b], &newImg[i], n - i);
+            if (len >= DELTA_MIN_MATCH && len > bestLen) {
+                bestLen = len;
+                bestFrom = (size_t)b;
+                bestOp = DELTA_OP_COPY_NEW;
+            }
+        }
+
+        if (bestOp == DELTA_OP_LITERAL) {
+            newHash[h] = (int32_t)i;
+            i++;
+            continue;
+        }
+        flushLiteral(i);
+        putVarint(out, (uint64_t)bestLen << 2 | bestOp);
+        if (bestOp == DELTA_OP_COPY_OLD) {
+            int64_t rel = (int64_t)bestFrom - (int64_t)oldPos;
+            putVarint(out, (uint64_t)((rel << 1) ^ (rel >> 63)));       // Zigzag
+            oldPos = (uint32_t)(bestFrom + bestLen);
+            lastCopyEnd = i + bestLen;
+        } else {
+            putVarint(out, i - bestFrom);
+        }
+        counts.ops[bestOp]++;
+        counts.bytes[bestOp] += bestLen;
+        for (size_t k = i; k < i + bestLen && k + 8 <= n; k++) newHash[hash8(&newImg[k])] = (int32_t)k;
+        i += bestLen;
+        litStart = i;
+    }
+    flushLiteral(n);
+    return out;
+}
+
+// ============================================================================
+// DECODER CHECK
+// ============================================================================
+struct MemoryIo : DeltaIo {
+    const Bytes& oldImg;
+    Bytes image;
+
+    explicit MemoryIo(const Bytes& base) : oldImg(base) {}
+    bool readOld(uint32_t offset, uint8_t* out, size_t len) override {
+        if (offset + len > oldImg.size()) return false;
+        memcpy(out, &oldImg[offset], len);
+        return true;
+    }
+    bool readNew(uint32_t offset, uint8_t* out, size_t len) override {
+        if (offset + len > image.size()) return false;
+        memcpy(out, &image[offset], len);
+        return true;
+    }
+    bool write(const uint8_t* data, size_t len) override {
+        image.insert(image.end(), data, data + len);
+        return true;
+    }
+};
+
+// In ESP-NOW chunk / TCP segment sized pieces, as the boards see it
+static DeltaResult apply(const Bytes& oldImg, const Bytes& delta, Bytes& out, double& ms) {
+    MemoryIo io(oldImg);
+    DeltaPatch patch;
+    patch.begin(&io);
+    static const size_t PIECES[] = { 240, 1436, 1, 4096, 77 };
+    auto t0 = std::chrono::steady_clock::now();
+    DeltaResult r = DELTA_OK;
+    for (size_t pos = 0, k = 0; pos < delta.size() && r == DELTA_OK; k++) {
+        size_t n = std::min(PIECES[k % 5], delta.size() - pos);
+        r = patch.feed(&delta[pos], n);
+        pos += n;
+    }
+    if (r == DELTA_OK) r = patch.finish();
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    out.swap(io.image);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    bool applyOnly = argc == 5 && strcmp(argv[1], "--apply") == 0;
+    if (argc != 4 && !applyOnly) {
+        fprintf(stderr, "usage: %s <old.bin|-> <new.bin> <out.pbd>\n"
+                        "       %s --apply <old.bin|-> <in.pbd> <out.bin>\n", argv[0], argv[0]);
+        return 2;
+    }
+    char** args = applyOnly ? argv + 2 : argv + 1;
+    Bytes oldImg, input;
+    if (!readFile(args[0], oldImg) || !readFile(args[1], input)) return 1;
+
+    if (applyOnly) {
+        Bytes image;
+        double ms;
+        DeltaResult r = apply(oldImg, input, image, ms);
+        if (r != DELTA_OK) {
+            fprintf(stderr, "[DELTA] Apply failed: %s\n", DeltaPatch::resultName(r));
+            return 1;
+        }
+        printf("[DELTA] %zu byte image from %zu byte delta in %.1f ms\n", image.size(), input.size(), ms);
+        return writeFile(args[2], image) ? 0 : 1;
+    }
+
+    if (input.empty()) {
+        fprintf(stderr, "[DELTA] Empty new image\n");
+        return 1;
+    }
+    Counts counts;
+    auto t0 = std::chrono::steady_clock::now();
+    Bytes delta = encode(oldImg, input, counts);
+    double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    Bytes check;
+    double applyMs;
+    DeltaResult r = apply(oldImg, delta, check, applyMs);
+    if (r != DELTA_OK || check != input) {
+        fprintf(stderr, "[DELTA] Self-check failed: %s\n", r != DELTA_OK ? DeltaPatch::resultName(r) : "image differs");
+        return 1;
+    }
+    if (!writeFile(args[2], delta)) return 1;
+
+    printf("[DELTA] %s %zu → %zu bytes: %zu byte delta (%.1f%%) in %.0f ms, applies in %.1f ms\n",
+           oldImg.empty() ? "full" : "delta", oldImg.size(), input.size(), delta.size(),
+           100.0 * delta.size() / input.size(), encodeMs, applyMs);
+    printf("[DELTA] copy old %zu ops / %zu B, copy new %zu / %zu B, literal %zu / %zu B\n",
+           counts.ops[DELTA_OP_COPY_OLD], counts.bytes[DELTA_OP_COPY_OLD],
+           counts.ops[DELTA_OP_COPY_NEW], counts.bytes[DELTA_OP_COPY_NEW],
+           counts.ops[DELTA_OP_LITERAL], counts.bytes[DELTA_OP_LITERAL]);
+    return 0;
+}
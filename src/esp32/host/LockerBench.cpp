@@ -0,0 +1,558 @@
+// ============================================================================
+// LOCKER BENCH - Smart Parcel Locker (host build)
+// ============================================================================
+// Replays a scan / door / network trace through LockerCore on the mock HAL,
+// as fast as the host allows (or --speed N times real time), and reports:
+// - core events per second (wall time of the replay)
+// - latency per transition: one core call and what it moved the state to
+//   (the ESP-NOW frame checks are part of a scan)
+// - heap allocations per event: counted in operator new and, on GNU
+//   toolchains, malloc / calloc / realloc of everything linked in
+//
+//   locker_bench [trace] [--runs N] [--speed X] [--generate N]
+//
+// Without a trace file it generates one (--generate deliveries, default
+// 1000). Trace format: one event per line, '#' starts a comment:
+//   <ms> parcel <id> <phone> [delivered] [cloud]   row; "cloud" = not in the index
+//   <ms> net online|offline
+//   <ms> index synced|stale                        stale: misses go to the cloud
+//   <ms> latency <ms>                              cloud lookup time from now on
+//   <ms> scan <cam> <seq> <qr>                     ESP-NOW QR frame, cam 1-based
+//   <ms> door <id> open|close
+//   <ms> remote <id> open|close
+//   <ms> emergency
+//   <ms> reset
+// Times are trace milliseconds; events are replayed in time order.
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "LockerCore.h"
+#include "MockHal.h"
+
+// ============================================================================
+// ALLOCATION COUNTING
+// ============================================================================
+static bool counting = false;
+static uint64_t allocCount = 0;
+static uint64_t allocBytes = 0;
+
+static inline void countAlloc(size_t n) {
+    if (!counting) return;
+    allocCount++;
+    allocBytes += n;
+}
+
+#ifdef LOCKER_BENCH_WRAP_MALLOC
+// -Wl,--wrap: every malloc / calloc / realloc call in the linked objects
+extern "C" void* __real_malloc(size_t n);
+extern "C" void* __real_calloc(size_t count, size_t n);
+extern "C" void* __real_realloc(void* p, size_t n);
+
+extern "C" void* __wrap_malloc(size_t n) {
+    countAlloc(n);
+    return __real_malloc(n);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t n) {
+    countAlloc(count * n);
+    return __real_calloc(count, n);
+}
+
+extern "C" void* __wrap_realloc(void* p, size_t n) {
+    countAlloc(n);
+    return __real_realloc(p, n);
+}
+
+#define rawMalloc __real_malloc
+#else
+#define rawMalloc malloc
+#endif
+
+void* operator new(size_t n) {
+    countAlloc(n);
+    void* p = rawMalloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t n) {
+    countAlloc(n);
+    void* p = rawMalloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ============================================================================
+// TRACE
+// ============================================================================
+enum TraceKind : uint8_t {
+    TRACE_PARCEL = 0,
+    TRACE_NET,
+    TRACE_INDEX,
+    TRACE_LATENCY,
+    TRACE_SCAN,
+    TRACE_DOOR,
+    TRACE_REMOTE,
+    TRACE_EMERGENCY,
+    TRACE_RESET
+};
+
+struct TraceEvent {
+    uint32_t atMs;
+    TraceKind kind;
+    uint8_t id;             // Camera (0-based) / compartment ID
+    uint16_t seq;
+    bool flag;              // open / online / synced / delivered
+    bool indexed;           // parcel: in the device index
+    uint32_t value;         // latency
+    char text[32];          // QR / parcel ID
+    char phone[20];
+};
+
+static bool parseLine(char* line, TraceEvent& ev) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+
+    char* tok[6] = {};
+    int n = 0;
+    for (char* t = strtok(line, " \t\r\n"); t && n < 6; t = strtok(nullptr, " \t\r\n")) tok[n++] = t;
+    if (n == 0) return false;
+    if (n < 2) return false;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.atMs = strtoul(tok[0], nullptr, 10);
+    const char* kind = tok[1];
+    if (strcmp(kind, "parcel") == 0 && n >= 4) {
+        ev.kind = TRACE_PARCEL;
+        strlcpy(ev.text, tok[2], sizeof(ev.text));
+        strlcpy(ev.phone, tok[3], sizeof(ev.phone));
+        ev.indexed = true;
+        for (int i = 4; i < n; i++) {
+            if (strcmp(tok[i], "delivered") == 0) ev.flag = true;
+            if (strcmp(tok[i], "cloud") == 0) ev.indexed = false;
+        }
+    } else if (strcmp(kind, "net") == 0 && n >= 3) {
+        ev.kind = TRACE_NET;
+        ev.flag = strcmp(tok[2], "online") == 0;
+    } else if (strcmp(kind, "index") == 0 && n >= 3) {
+        ev.kind = TRACE_INDEX;
+        ev.flag = strcmp(tok[2], "synced") == 0;
+    } else if (strcmp(kind, "latency") == 0 && n >= 3) {
+        ev.kind = TRACE_LATENCY;
+        ev.value = strtoul(tok[2], nullptr, 10);
+    } else if (strcmp(kind, "scan") == 0 && n >= 5) {
+        ev.kind = TRACE_SCAN;
+        ev.id = (uint8_t)(strtoul(tok[2], nullptr, 10) - 1);
+        ev.seq = (uint16_t)strtoul(tok[3], nullptr, 10);
+        strlcpy(ev.text, tok[4], sizeof(ev.text));
+    } else if ((strcmp(kind, "door") == 0 || strcmp(kind, "remote") == 0) && n >= 4) {
+        ev.kind = kind[0] == 'd' ? TRACE_DOOR : TRACE_REMOTE;
+        ev.id = (uint8_t)strtoul(tok[2], nullptr, 10);
+        ev.flag = strcmp(tok[3], "open") == 0;
+    } else if (strcmp(kind, "emergency") == 0) {
+        ev.kind = TRACE_EMERGENCY;
+    } else if (strcmp(kind, "reset") == 0) {
+        ev.kind = TRACE_RESET;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool loadTrace(const char* path, std::vector<TraceEvent>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[BENCH] Cannot open %s\n", path);
+        return false;
+    }
+    char line[256];
+    unsigned lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char copy[256];
+        strlcpy(copy, line, sizeof(copy));
+        TraceEvent ev;
+        if (parseLine(copy, ev)) {
+            out.push_back(ev);
+        } else {
+            // Blank and comment lines are fine; anything else is reported
+            const char* p = line;
+            while (isspace((unsigned char)*p)) p++;
+            if (*p && *p != '#') fprintf(stderr, "[BENCH] %s:%u: skipped: %s", path, lineNo, line);
+        }
+    }
+    fclose(f);
+    std::stable_sort(out.begin(), out.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) { return a.atMs < b.atMs; });
+    return true;
+}
+
+// ============================================================================
+// GENERATED TRACE
+// ============================================================================
+// Per delivery, one of: index hit (most), cloud lookup with a stale index,
+// invalid QR, already delivered parcel, or a breach plus a remote unlock.
+// Every fifth index hit has a retransmitted frame.
+static void addEvent(std::vector<TraceEvent>& out, uint32_t atMs, TraceKind kind, uint8_t id = 0,
+                     bool flag = false, const char* text = "", uint16_t seq = 0) {
+    TraceEvent ev = {};
+    ev.atMs = atMs;
+    ev.kind = kind;
+    ev.id = id;
+    ev.flag = flag;
+    ev.seq = seq;
+    ev.indexed = true;
+    strlcpy(ev.text, text, sizeof(ev.text));
+    out.push_back(ev);
+}
+
+static void generateTrace(unsigned deliveries, std::vector<TraceEvent>& out) {
+    const unsigned INDEXED = 40;
+    const unsigned CLOUD = 16;
+    const unsigned DELIVERED = 4;
+    char id[32];
+
+    for (unsigned i = 0; i < INDEXED + CLOUD + DELIVERED; i++) {
+        snprintf(id, sizeof(id), "PARCEL-%04u", i);
+        addEvent(out, 0, TRACE_PARCEL, 0, i >= INDEXED + CLOUD, id);
+        TraceEvent& row = out.back();
+        strlcpy(row.phone, "+639170000000", sizeof(row.phone));
+        row.indexed = i < INDEXED || i >= INDEXED + CLOUD;
+    }
+    addEvent(out, 0, TRACE_NET, 0, true);
+    addEvent(out, 0, TRACE_INDEX, 0, true);
+
+    uint32_t t = 1000;
+    uint16_t seq = 1;
+    for (unsigned d = 0; d < deliveries; d++, t += 20000) {
+        switch (d % 10) {
+            case 7:     // Invalid QR
+                snprintf(id, sizeof(id), "BAD-%05u", d);
+                addEvent(out, t, TRACE_SCAN, 0, false, id, seq++);
+                break;
+            case 8:     // Delivered already
+                snprintf(id, sizeof(id), "PARCEL-%04u", INDEXED + CLOUD + d % DELIVERED);
+                addEvent(out, t, TRACE_SCAN, 0, false, id, seq++);
+                break;
+            case 9:     // Door forced, then opened remotely
+                addEvent(out, t, TRACE_DOOR, 2, true);
+                addEvent(out, t + 4000, TRACE_DOOR, 2, false);
+                addEvent(out, t + 6000, TRACE_REMOTE, 2, true);
+                addEvent(out, t + 7000, TRACE_DOOR, 2, true);
+                addEvent(out, t + 9000, TRACE_DOOR, 2, false);
+                addEvent(out, t + 9100, TRACE_REMOTE, 2, false);
+                break;
+            default: {
+                bool cloud = d % 10 == 6;
+                if (cloud) {
+                    snprintf(id, sizeof(id), "PARCEL-%04u", INDEXED + d % CLOUD);
+                    addEvent(out, t - 10, TRACE_INDEX, 0, false);
+                } else {
+                    snprintf(id, sizeof(id), "PARCEL-%04u", d % INDEXED);
+                }
+                addEvent(out, t, TRACE_SCAN, 0, false, id, seq);
+                if (d % 5 == 0) addEvent(out, t + 250, TRACE_SCAN, 0, false, id, seq);
+                seq++;
+                uint32_t open = cloud ? t + 1000 : t + 800;
+                addEvent(out, open, TRACE_DOOR, 1, true);
+                addEvent(out, open + 1500, TRACE_DOOR, 2, true);
+                addEvent(out, open + 6000, TRACE_DOOR, 2, false);
+                addEvent(out, open + 8000, TRACE_DOOR, 1, false);
+                if (cloud) addEvent(out, open + 8100, TRACE_INDEX, 0, true);
+                break;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// TRANSITIONS
+// ============================================================================
+enum Transition : uint8_t {
+    T_SCAN_OPEN = 0,
+    T_SCAN_LOOKUP,
+    T_SCAN_DENIED,
+    T_FRAME_DUPLICATE,
+    T_LOOKUP_OPEN,
+    T_LOOKUP_DENIED,
+    T_LOOKUP_STALE,
+    T_DOOR_OPEN,
+    T_DOOR_BREACH,
+    T_DOOR_DELIVERED,
+    T_DOOR_CLOSE,
+    T_DOOR_UNCHANGED,
+    T_REMOTE,
+    T_EMERGENCY,
+    T_RESET,
+    T_COUNT
+};
+
+static const char* const TRANSITION_NAMES[T_COUNT] = {
+    "scan -> open (index hit)",
+    "scan -> validating",
+    "scan -> denied",
+    "frame -> duplicate",
+    "lookup -> open",
+    "lookup -> denied",
+    "lookup -> stale",
+    "door open",
+    "door open -> breach",
+    "door close -> delivered",
+    "door close",
+    "door unchanged",
+    "remote lock",
+    "emergency lockdown",
+    "reset",
+};
+
+struct Sample {
+    uint32_t ns;
+    uint32_t allocs;
+    uint8_t transition;
+};
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+struct Bench {
+    MockGpio gpio;
+    MockLcd lcd;
+    MockUart uart;
+    MockEspNow espNow;
+    MockFirebase firebase;
+    LockerCore core;
+    std::vector<Sample> samples;
+
+    void begin() {
+        gpio.reset();
+        lcd.reset();
+        uart.reset();
+        espNow.reset();
+        firebase.reset();
+        core = LockerCore();
+        core.begin({ &gpio, &lcd, &uart, &espNow, &firebase }, "PARCELBOX_HOSTBENCH0");
+    }
+
+    template <typename F>
+    void timed(F&& work) {
+        uint64_t allocs = allocCount;
+        counting = true;
+        auto t0 = std::chrono::steady_clock::now();
+        uint8_t transition = work();
+        auto t1 = std::chrono::steady_clock::now();
+        counting = false;
+        Sample s;
+        s.ns = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        s.allocs = (uint32_t)(allocCount - allocs);
+        s.transition = transition;
+        samples.push_back(s);
+    }
+
+    void scan(const TraceEvent& ev) {
+        // What the CAM puts on air
+        ESPNOW_QRFrame_t frame = {};
+        frame.hdr.magic = ESPNOW_MAGIC;
+        frame.hdr.type = MSG_TYPE_QR_SCAN;
+        frame.hdr.seq = ev.seq;
+        frame.hdr.session = 1;
+        snprintf(frame.qr.qrData, sizeof(frame.qr.qrData), "%s\r\n", ev.text);
+        frame.qr.timestamp = ev.atMs;
+        int64_t rxUs = (int64_t)ev.atMs * 1000;
+
+        timed([&]() -> uint8_t {
+            EspNowQrScan qr;
+            if (!espNow.receive(ev.id, (const uint8_t*)&frame, sizeof(frame), rxUs, qr)) {
+                return T_FRAME_DUPLICATE;
+            }
+            uint32_t granted = core.stats().granted;
+            core.onScan(qr);
+            if (ev.id < CAMERA_COUNT && core.delivery(ev.id).stage == DELIVERY_VALIDATING) {
+                return T_SCAN_LOOKUP;
+            }
+            return core.stats().granted != granted ? T_SCAN_OPEN : T_SCAN_DENIED;
+        });
+    }
+
+    void reply(const MockFirebase::Fetch& fetch, bool found) {
+        timed([&]() -> uint8_t {
+            uint32_t stale = core.stats().staleResults;
+            core.onParcelResult(fetch.camera, fetch.id, found);
+            if (core.stats().staleResults != stale) return T_LOOKUP_STALE;
+            return found ? T_LOOKUP_OPEN : T_LOOKUP_DENIED;
+        });
+    }
+
+    // io task side, then the control task side of the door queue
+    void door(const TraceEvent& ev) {
+        timed([&]() -> uint8_t {
+            bool breach = ev.flag && ev.id >= 1 && ev.id <= COMPARTMENT_COUNT &&
+                          core.compartment(ev.id).owner < 0;
+            uint32_t deliveries = core.stats().deliveries;
+            bool changed = core.onDoorChanged(ev.id, ev.flag, (int64_t)ev.atMs * 1000);
+            core.settle();
+            if (!changed) return T_DOOR_UNCHANGED;
+            if (ev.flag) return breach ? T_DOOR_BREACH : T_DOOR_OPEN;
+            core.onDoorClosed(ev.id);
+            return core.stats().deliveries != deliveries ? T_DOOR_DELIVERED : T_DOOR_CLOSE;
+        });
+    }
+
+    void replies(uint32_t untilMs) {
+        MockFirebase::Fetch fetch;
+        bool found;
+        while (firebase.nextReply(untilMs, fetch, found)) {
+            firebase.nowMs = fetch.dueMs;
+            reply(fetch, found);
+        }
+    }
+
+    void run(const std::vector<TraceEvent>& events, double speed) {
+        begin();
+        uint32_t lastMs = events.empty() ? 0 : events.front().atMs;
+        for (const TraceEvent& ev : events) {
+            replies(ev.atMs);
+            if (speed > 0 && ev.atMs > lastMs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(
+                    (int64_t)((ev.atMs - lastMs) * 1000.0 / speed)));
+            }
+            lastMs = ev.atMs;
+            firebase.nowMs = ev.atMs;
+
+            switch (ev.kind) {
+                case TRACE_PARCEL:
+                    firebase.addParcel(ev.text, ev.phone, ev.flag, ev.indexed);
+                    break;
+                case TRACE_NET:
+                    firebase.isOnline = ev.flag;
+                    break;
+                case TRACE_INDEX:
+                    firebase.isSynced = ev.flag;
+                    break;
+                case TRACE_LATENCY:
+                    firebase.fetchLatencyMs = ev.value;
+                    break;
+                case TRACE_SCAN:
+                    scan(ev);
+                    break;
+                case TRACE_DOOR:
+                    door(ev);
+                    break;
+                case TRACE_REMOTE:
+                    timed([&]() -> uint8_t { core.remoteLock(ev.id, ev.flag); return T_REMOTE; });
+                    break;
+                case TRACE_EMERGENCY:
+                    timed([&]() -> uint8_t { core.emergencyLockdown(); return T_EMERGENCY; });
+                    break;
+                case TRACE_RESET:
+                    timed([&]() -> uint8_t { core.reset(); return T_RESET; });
+                    break;
+            }
+        }
+        replies(UINT32_MAX);
+    }
+};
+
+// ============================================================================
+// REPORT
+// ============================================================================
+static uint32_t percentile(const std::vector<uint32_t>& sorted, int pct) {
+    size_t i = (sorted.size() * pct + 99) / 100;
+    return sorted[i ? i - 1 : 0];
+}
+
+static void report(const Bench& bench, double wallS, uint64_t traceSpanMs, unsigned runs) {
+    const std::vector<Sample>& samples = bench.samples;
+    uint64_t allocs = 0;
+    for (const Sample& s : samples) allocs += s.allocs;
+    double events = (double)samples.size();
+
+    printf("[BENCH] %zu core events in %.1f ms: %.0f events/s\n", samples.size(), wallS * 1000,
+           events / wallS);
+    printf("[BENCH] Trace time %.1f s x %u runs, replayed at %.0fx real time\n",
+           traceSpanMs / 1000.0, runs, traceSpanMs * runs / 1000.0 / wallS);
+    printf("[BENCH] Allocations: %llu (%.3f per event, %llu bytes)\n", (unsigned long long)allocs,
+           events ? allocs / events : 0.0, (unsigned long long)allocBytes);
+    printf("[BENCH] %-26s %8s %8s %8s %8s %8s %9s\n", "transition", "count", "p50 ns", "p90 ns",
+           "p99 ns", "max ns", "allocs/ev");
+
+    std::vector<uint32_t> ns;
+    for (int t = 0; t < T_COUNT; t++) {
+        ns.clear();
+        uint64_t tAllocs = 0;
+        for (const Sample& s : samples) {
+            if (s.transition != t) continue;
+            ns.push_back(s.ns);
+            tAllocs += s.allocs;
+        }
+        if (ns.empty()) continue;
+        std::sort(ns.begin(), ns.end());
+        printf("[BENCH] %-26s %8zu %8u %8u %8u %8u %9.3f\n", TRANSITION_NAMES[t], ns.size(),
+               percentile(ns, 50), percentile(ns, 90), percentile(ns, 99), ns.back(),
+               (double)tAllocs / ns.size());
+    }
+
+    // Last run's outcome, as a sanity check on the trace
+    const LockerStats& c = bench.core.stats();
+    printf("[CORE] %u scans: %u granted, %u denied, %u cloud lookups (%u stale), "
+           "%u deliveries, %u breaches, %u SMS\n",
+           (unsigned)c.scans, (unsigned)c.granted, (unsigned)c.denied, (unsigned)c.fetches,
+           (unsigned)c.staleResults, (unsigned)c.deliveries, (unsigned)c.breaches, (unsigned)c.sms);
+    printf("[MOCK] ESP-NOW %u frames (%u duplicate, %u malformed, %u snapshots), %u relay unlocks, "
+           "%u screens, %u history events, %u lookups dropped\n",
+           (unsigned)bench.espNow.frames, (unsigned)bench.espNow.duplicates,
+           (unsigned)bench.espNow.malformed, (unsigned)bench.espNow.snapshots, (unsigned)bench.gpio.unlocks,
+           (unsigned)bench.lcd.screens, (unsigned)bench.firebase.history,
+           (unsigned)bench.firebase.fetchesDropped);
+}
+
+int main(int argc, char** argv) {
+    const char* tracePath = nullptr;
+    unsigned runs = 0;
+    unsigned generate = 1000;
+    double speed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            generate = strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-') {
+            tracePath = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [trace] [--runs N] [--speed X] [--generate N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<TraceEvent> events;
+    if (tracePath) {
+        if (!loadTrace(tracePath, events)) return 1;
+        printf("[BENCH] Trace %s: %zu events\n", tracePath, events.size());
+    } else {
+        generateTrace(generate, events);
+        printf("[BENCH] Generated trace: %u deliveries, %zu events\n", generate, events.size());
+    }
+    if (events.empty()) return 1;
+    if (runs == 0) runs = speed > 0 ? 1 : 20;
+
+    Bench bench;
+    bench.samples.reserve(events.size() * runs + 64 * runs);
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < runs; r++) bench.run(events, speed);
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t spanMs = events.back().atMs - events.front().atMs;
+    report(bench, wallS, spanMs, runs);
+    return 0;
+}
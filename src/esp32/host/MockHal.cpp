@@ -0,0 +1,186 @@
+#include "MockHal.h"
+#include "EspNowFrame.h"
+
+// ============================================================================
+// MOCK HAL IMPLEMENTATION
+// ============================================================================
+
+// ============================================================================
+// GPIO / LCD / UART
+// ============================================================================
+void MockGpio::reset() {
+    relays = 0;
+    unlocks = locks = 0;
+    memset(tones, 0, sizeof(tones));
+    memset(marks, 0, sizeof(marks));
+}
+
+void MockGpio::unlock(uint8_t mask) {
+    relays |= mask;
+    unlocks++;
+}
+
+void MockGpio::lock(uint8_t mask) {
+    relays &= ~mask;
+    locks++;
+}
+
+void MockGpio::playTone(LockerTone tone) {
+    tones[tone]++;
+}
+
+void MockGpio::mark(LockerMark mark) {
+    marks[mark]++;
+}
+
+void MockLcd::reset() {
+    memset(lines, 0, sizeof(lines));
+    screens = readyScreens = 0;
+}
+
+void MockLcd::show(const char* line1, const char* line2, const char* line3, const char* line4) {
+    strlcpy(lines[0], line1, sizeof(lines[0]));
+    strlcpy(lines[1], line2, sizeof(lines[1]));
+    strlcpy(lines[2], line3, sizeof(lines[2]));
+    strlcpy(lines[3], line4, sizeof(lines[3]));
+    screens++;
+}
+
+void MockLcd::showReady(const char* line1, const char* line2, uint32_t) {
+    show(line1, line2, "WiFi: OK", "FB: OK");
+    readyScreens++;
+}
+
+void MockUart::reset() {
+    memset(sent, 0, sizeof(sent));
+    lastPhone[0] = lastMessage[0] = '\0';
+}
+
+void MockUart::sendSms(const char* phone, const char* message, uint8_t priority) {
+    if (priority < 2) sent[priority]++;
+    strlcpy(lastPhone, phone, sizeof(lastPhone));
+    strlcpy(lastMessage, message, sizeof(lastMessage));
+}
+
+// ============================================================================
+// ESP-NOW
+// ============================================================================
+void MockEspNow::reset() {
+    memset(seq, 0, sizeof(seq));
+    frames = malformed = duplicates = snapshots = 0;
+    memset(acks, 0, sizeof(acks));
+}
+
+bool MockEspNow::receive(uint8_t camera, const uint8_t* data, int len, int64_t rxUs,
+                         EspNowQrScan& out) {
+    frames++;
+    if (camera >= CAMERA_COUNT || espNowFrameKind(data, len) != ESPNOW_FRAME_QR) {
+        malformed++;
+        return false;
+    }
+    ESPNOW_QRFrame_t frame;
+    memcpy(&frame, data, sizeof(frame));
+
+    memset(&out, 0, sizeof(out));
+    out.seq = frame.hdr.seq;
+    out.session = frame.hdr.session;
+    out.attempt = frame.hdr.attempt;
+    out.camera = camera;
+    out.rxUs = rxUs;
+    if (seq[camera].isDuplicate(frame.hdr.session, frame.hdr.seq)) {
+        duplicates++;
+        ack(out, ESPNOW_ACK_DUPLICATE);
+        return false;
+    }
+    seq[camera].accept(frame.hdr.session, frame.hdr.seq);
+
+    espNowCopyQr(frame.qr, out.qrData, sizeof(out.qrData));
+    out.camTimestamp = frame.qr.timestamp;
+    out.camDecodeUs = frame.qr.decodeUs;
+    out.camTxUs = frame.qr.txUs;
+    return true;
+}
+
+void MockEspNow::ack(const EspNowQrScan&, uint8_t status) {
+    if (status < 2) acks[status]++;
+}
+
+// ============================================================================
+// FIREBASE
+// ============================================================================
+void MockFirebase::reset() {
+    parcelCount = 0;
+    fetchCount = 0;
+    isOnline = true;
+    isSynced = true;
+    fetchLatencyMs = MOCK_FETCH_MS;
+    nowMs = 0;
+    lookups = fetchRequests = fetchesDropped = confirms = history = 0;
+}
+
+MockFirebase::Parcel* MockFirebase::find(const char* id) {
+    for (uint16_t i = 0; i < parcelCount; i++) {
+        if (strcmp(parcels[i].id, id) == 0) return &parcels[i];
+    }
+    return nullptr;
+}
+
+bool MockFirebase::addParcel(const char* id, const char* phone, bool delivered, bool indexed) {
+    Parcel* p = find(id);
+    if (!p) {
+        if (parcelCount >= MOCK_PARCELS) return false;
+        p = &parcels[parcelCount++];
+        strlcpy(p->id, id, sizeof(p->id));
+    }
+    strlcpy(p->info.receiverName, "Receiver", sizeof(p->info.receiverName));
+    strlcpy(p->info.contactNumber, phone, sizeof(p->info.contactNumber));
+    p->info.delivered = delivered;
+    p->indexed = indexed;
+    return true;
+}
+
+bool MockFirebase::lookupParcel(const char* parcelId, LockerParcel& out) {
+    lookups++;
+    Parcel* p = find(parcelId);
+    if (!p || !p->indexed) return false;
+    out = p->info;
+    return true;
+}
+
+void MockFirebase::fetchParcel(uint8_t camera, const char* parcelId) {
+    fetchRequests++;
+    if (fetchCount >= MOCK_FETCHES) {
+        fetchesDropped++;   // As a full cloudQueue would
+        return;
+    }
+    Fetch& f = fetches[fetchCount++];
+    f.camera = camera;
+    strlcpy(f.id, parcelId, sizeof(f.id));
+    f.dueMs = nowMs + fetchLatencyMs;
+}
+
+bool MockFirebase::nextReply(uint32_t untilMs, Fetch& out, bool& found) {
+    // Earliest first (the latency may change between requests)
+    int8_t next = -1;
+    for (uint8_t i = 0; i < fetchCount; i++) {
+        if (next < 0 || (int32_t)(fetches[i].dueMs - fetches[next].dueMs) < 0) next = i;
+    }
+    if (next < 0 || (int32_t)(fetches[next].dueMs - untilMs) > 0) return false;
+    out = fetches[next];
+    fetchCount--;
+    memmove(&fetches[next], &fetches[next + 1], (fetchCount - next) * sizeof(Fetch));
+
+    // Found rows land in the device index (cacheParcelFromJson)
+    Parcel* p = find(out.id);
+    found = p && !p->info.delivered;
+    if (p) p->indexed = true;
+    return true;
+}
+
+void MockFirebase::confirmParcel(const char*) {
+    confirms++;
+}
+
+void MockFirebase::logHistory(const char*, const char*) {
+    history++;
+}
@@ -0,0 +1,120 @@
+#ifndef MOCK_HAL_H
+#define MOCK_HAL_H
+
+#include <Arduino.h>
+#include "LOCKER_CONFIG.h"
+#include "LockerHal.h"
+
+// ============================================================================
+// MOCK HAL - Smart Parcel Locker (host build)
+// ============================================================================
+// LockerHal.h implemented over plain memory for the trace-replay bench:
+// - GPIO / LCD / UART record what the core asked for (relay mask, tones,
+//   last screen, SMS by priority)
+// - ESP-NOW is the radio end of EspNowManager: raw frames go through the
+//   firmware's frame checks and per-camera duplicate tracking, and come out
+//   as EspNowQrScan; ACKs are counted by status
+// - Firebase holds the parcel table. Rows are either in the device index or
+//   only in the cloud; fetchParcel() answers after fetchLatencyMs of trace
+//   time and puts the row in the index, as the cloud task does
+// Fixed-size storage only, so every allocation the bench counts is the core's.
+
+#define MOCK_PARCELS        64
+#define MOCK_FETCHES        8       // Lookups in flight (cloudQueue stand-in)
+#define MOCK_FETCH_MS       150     // Default lookup latency, trace time
+
+struct MockGpio : LockerGpio {
+    uint8_t relays;                 // COMPARTMENT_BIT() set = unlocked
+    uint32_t unlocks;
+    uint32_t locks;
+    uint32_t tones[LOCKER_TONE_ALERT + 1];
+    uint32_t marks[LOCKER_MARK_DONE + 1];
+
+    void reset();
+    void unlock(uint8_t mask) override;
+    void lock(uint8_t mask) override;
+    void playTone(LockerTone tone) override;
+    void mark(LockerMark mark) override;
+};
+
+struct MockLcd : LockerLcd {
+    char lines[4][21];
+    uint32_t screens;
+    uint32_t readyScreens;
+
+    void reset();
+    void show(const char* line1, const char* line2, const char* line3, const char* line4) override;
+    void showReady(const char* line1, const char* line2, uint32_t afterMs) override;
+};
+
+struct MockUart : LockerUart {
+    uint32_t sent[2];               // By SMS_PRIORITY_*
+    char lastPhone[20];
+    char lastMessage[160];
+
+    void reset();
+    void sendSms(const char* phone, const char* message, uint8_t priority) override;
+};
+
+struct MockEspNow : LockerEspNow {
+    EspNowSeqState seq[CAMERA_COUNT];
+    uint32_t frames;
+    uint32_t malformed;
+    uint32_t duplicates;
+    uint32_t acks[2];               // By ESPNOW_ACK_*
+    uint32_t snapshots;
+
+    void reset();
+    // A frame from `camera`; false = nothing new (malformed, or a duplicate,
+    // which is ACKed here the way EspNowManager::receiveQr does)
+    bool receive(uint8_t camera, const uint8_t* data, int len, int64_t rxUs, EspNowQrScan& out);
+    void ack(const EspNowQrScan& scan, uint8_t status) override;
+    void requestSnapshot(uint8_t, int64_t) override { snapshots++; }
+};
+
+struct MockFirebase : LockerFirebase {
+    struct Parcel {
+        char id[32];
+        LockerParcel info;
+        bool indexed;               // In the device's parcel cache
+    };
+    struct Fetch {
+        uint8_t camera;
+        char id[32];
+        uint32_t dueMs;
+    };
+
+    Parcel parcels[MOCK_PARCELS];
+    uint16_t parcelCount;
+    Fetch fetches[MOCK_FETCHES];
+    uint8_t fetchCount;
+
+    bool isOnline;
+    bool isSynced;                  // Index synced and its stream up
+    uint32_t fetchLatencyMs;
+    uint32_t nowMs;                 // Trace time, set by the bench
+
+    uint32_t lookups;
+    uint32_t fetchRequests;
+    uint32_t fetchesDropped;
+    uint32_t confirms;
+    uint32_t history;
+
+    void reset();
+    // Insert or replace a row
+    bool addParcel(const char* id, const char* phone, bool delivered, bool indexed);
+    // Pop the next lookup answer due by untilMs
+    bool nextReply(uint32_t untilMs, Fetch& out, bool& found);
+
+    bool lookupParcel(const char* parcelId, LockerParcel& out) override;
+    bool indexAuthoritative() override { return isSynced; }
+    bool online() override { return isOnline; }
+    void fetchParcel(uint8_t camera, const char* parcelId) override;
+    void confirmParcel(const char* parcelId) override;
+    void logHistory(const char* parcelId, const char* event) override;
+
+private:
+    Parcel* find(const char* id);
+};
+
+#endif // MOCK_HAL_H
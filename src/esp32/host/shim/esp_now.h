@@ -0,0 +1,7 @@
+#ifndef HOST_ESP_NOW_H
+#define HOST_ESP_NOW_H
+
+// Host shim: ESPNOW_CONFIG.h includes this for the radio API, which the
+// host build never calls. Its frame structs need nothing from here.
+
+#endif // HOST_ESP_NOW_H
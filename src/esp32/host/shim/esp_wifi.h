@@ -0,0 +1,7 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+// Host shim: ESPNOW_CONFIG.h includes this for the radio API, which the
+// host build never calls. Its frame structs need nothing from here.
+
+#endif // HOST_ESP_WIFI_H